@@ -0,0 +1,52 @@
+"""
+# Visual data update benchmark
+
+Measure the latency of the visual data updates, and the number and size of the copies of the
+data, when the data is copied, borrowed without copy, or converted to the dtype of the prop.
+
+"""
+
+import time
+import tracemalloc
+
+import numpy as np
+import numpy.random as nr
+
+from datoviz import canvas, data_stats
+
+c = canvas()
+panel = c.panel(controller='axes')
+visual = panel.visual('marker')
+
+n = 1_000_000
+n_iter = 20
+
+pos64 = nr.randn(n, 3)
+pos32 = pos64.astype(np.float32)
+pos_strided = np.c_[pos64, pos64][:, :3]
+color = nr.randint(low=0, high=255, size=(n, 4)).astype(np.uint8)
+visual.data('color', color)
+
+
+def bench(name, pos, **kwargs):
+    stats = data_stats()
+    tracemalloc.start()
+    t0 = time.perf_counter()
+    for _ in range(n_iter):
+        visual.data('pos', pos, **kwargs)
+    dt = (time.perf_counter() - t0) / n_iter
+    _, peak = tracemalloc.get_traced_memory()
+    tracemalloc.stop()
+    new = data_stats()
+    print(
+        f"{name:<24} {dt * 1000:8.3f} ms/update  "
+        f"{(new['copies'] - stats['copies']) / n_iter:4.1f} copies/update  "
+        f"{(new['conversions'] - stats['conversions']) / n_iter:4.1f} conversions/update  "
+        f"peak Python allocations {peak / 1024 ** 2:8.1f} MB")
+
+
+print(f"{n} positions, {pos64.nbytes / 1024 ** 2:.1f} MB, {n_iter} updates")
+bench("copy", pos64)
+bench("borrow", pos64, borrow=True)
+bench("convert float32", pos32)
+bench("non-contiguous", pos_strided, borrow=True)
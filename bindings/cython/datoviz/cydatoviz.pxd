@@ -1129,6 +1129,8 @@ cdef extern from "<datoviz/datoviz.h>":
 
     # from file: visuals.h
     void dvz_visual_data(DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count, const void* data)
+    void dvz_visual_data_borrow(DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count, void* data)
+    void dvz_visual_data_convert(DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count, DvzDataType dtype, const void* data)
     void dvz_visual_data_source(DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, uint32_t first_item, uint32_t item_count, uint32_t data_item_count, const void* data)
     void dvz_visual_texture(DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx, DvzTexture* texture)
     DvzProp* dvz_prop_get(DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx)
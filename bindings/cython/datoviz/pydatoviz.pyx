@@ -194,6 +194,13 @@ _DTYPES = {
     cv.DVZ_DTYPE_MAT4: (np.float32, (4, 4)),
 }
 
+# Datoviz dtype of the vector data of a given NumPy dtype and number of components.
+_NP_DTYPES = {
+    (np.dtype(dt), nc): dtype for dtype, (dt, nc) in _DTYPES.items() if not hasattr(nc, '__len__')}
+
+# Number of full copies and C conversions of the visual data passed to Visual.data().
+_DATA_STATS = {'copies': 0, 'conversions': 0, 'borrows': 0}
+
 _TRANSFORMS = {
     'earth': cv.DVZ_TRANSFORM_EARTH_MERCATOR_WEB,
 }
@@ -418,9 +425,16 @@ def _get_prop(name):
 # -------------------------------------------------------------------------------------------------
 
 def _validate_data(dt, nc, data):
-    data = data.astype(dt)
+    if data.dtype != dt:
+        data = data.astype(dt)
+        _DATA_STATS['copies'] += 1
+    return _validate_shape(nc, data)
+
+
+def _validate_shape(nc, data):
     if not data.flags['C_CONTIGUOUS']:
         data = np.ascontiguousarray(data)
+        _DATA_STATS['copies'] += 1
     if not hasattr(nc, '__len__'):
         nc = (nc,)
     nd = len(nc)  # expected dimension of the data - 1
@@ -434,6 +448,12 @@ def _validate_data(dt, nc, data):
 
 
 
+def data_stats():
+    """Return the number of copies, C conversions and borrows of the visual data so far."""
+    return dict(_DATA_STATS)
+
+
+
 cdef _get_ev_args(cv.DvzEvent c_ev):
     cdef float* fvalue
     cdef int* ivalue
@@ -810,6 +830,7 @@ cdef class Visual:
     cdef cv.DvzVisual* _c_visual
     cdef cv.DvzContext* _c_context
     cdef unicode vtype
+    cdef dict _pinned
     _textures = {}
 
     cdef create(self, cv.DvzPanel* c_panel, cv.DvzVisual* c_visual, unicode vtype):
@@ -817,14 +838,48 @@ cdef class Visual:
         self._c_visual = c_visual
         self._c_context = c_visual.canvas.gpu.context
         self.vtype = vtype
+        # Arrays borrowed by the visual, kept alive until the next update of their prop.
+        self._pinned = {}
+
+    def data(self, name, np.ndarray value, idx=0, borrow=False):
+        """Set the data of a visual prop.
 
-    def data(self, name, np.ndarray value, idx=0):
+        By default, the data is copied, or converted in C when its dtype differs from the dtype
+        of the prop. With `borrow=True`, a C-contiguous array with the dtype of the prop is not
+        copied: the visual references the array until the next update of the prop, so that the
+        array must not be modified in place until then, or passed again after being modified.
+
+        """
         prop_type = _get_prop(name)
         c_prop = cv.dvz_prop_get(self._c_visual, prop_type, idx)
         dtype, nc = _DTYPES[c_prop.dtype]
-        value = _validate_data(dtype, nc, value)
+        self._pinned.pop((prop_type, idx), None)
+
+        value = _validate_shape(nc, value)
         N = value.shape[0]
-        cv.dvz_visual_data(self._c_visual, prop_type, idx, N, &value.data[0])
+
+        # The visual references the array, which must not be modified until the next update.
+        if value.dtype == dtype and borrow:
+            cv.dvz_visual_data_borrow(self._c_visual, prop_type, idx, N, &value.data[0])
+            self._pinned[prop_type, idx] = value
+            _DATA_STATS['borrows'] += 1
+
+        # Copy the data in the visual.
+        elif value.dtype == dtype:
+            cv.dvz_visual_data(self._c_visual, prop_type, idx, N, &value.data[0])
+            _DATA_STATS['copies'] += 1
+
+        # The array is converted to the dtype of the prop in C.
+        elif (value.dtype, nc) in _NP_DTYPES:
+            cv.dvz_visual_data_convert(
+                self._c_visual, prop_type, idx, N, _NP_DTYPES[value.dtype, nc], &value.data[0])
+            _DATA_STATS['conversions'] += 1
+
+        # The array is converted in NumPy, then copied in the visual.
+        else:
+            value = _validate_data(dtype, nc, value)
+            cv.dvz_visual_data(self._c_visual, prop_type, idx, N, &value.data[0])
+            _DATA_STATS['copies'] += 1
 
     def _create_texture(self, source_type, arr, idx=0):
         # Find the Vulkan format for the texture
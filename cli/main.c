@@ -23,7 +23,10 @@
 static TestCase TEST_CASES[] = {
 
     // common tests
-    CASE_FIXTURE_NONE(test_container),
+    CASE_FIXTURE_NONE(test_container),      //
+    CASE_FIXTURE_NONE(test_colormap_batch), //
+    CASE_FIXTURE_NONE(test_png_fast),       //
+    CASE_FIXTURE_NONE(test_log_async),      //
 
     // vklite2
     CASE_FIXTURE_NONE(test_vklite_app),            //
@@ -35,6 +38,7 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_vklite_buffer_resize),  //
     CASE_FIXTURE_NONE(test_vklite_compute),        //
     CASE_FIXTURE_NONE(test_vklite_push),           //
+    CASE_FIXTURE_NONE(test_vklite_bindings),       //
     CASE_FIXTURE_NONE(test_vklite_images),         //
     CASE_FIXTURE_NONE(test_vklite_sampler),        //
     CASE_FIXTURE_NONE(test_vklite_barrier),        //
@@ -44,6 +48,7 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_basic_canvas_1),        //
     CASE_FIXTURE_NONE(test_basic_canvas_triangle), //
     CASE_FIXTURE_NONE(test_shader_compile),        //
+    CASE_FIXTURE_NONE(test_spirv_cache),           //
 
     // context
     CASE_FIXTURE_NONE(test_fifo_1),      //
@@ -53,6 +58,7 @@ static TestCase TEST_CASES[] = {
     // canvas
     CASE_FIXTURE_NONE(test_canvas_transfer_buffer),  //
     CASE_FIXTURE_NONE(test_canvas_transfer_texture), //
+    CASE_FIXTURE_NONE(test_canvas_transfer_stream),  //
     CASE_FIXTURE_NONE(test_canvas_1),                //
     CASE_FIXTURE_NONE(test_canvas_2),                //
     CASE_FIXTURE_NONE(test_canvas_3),                //
@@ -65,8 +71,13 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_canvas_append),           //
     CASE_FIXTURE_NONE(test_canvas_particles),        //
     CASE_FIXTURE_NONE(test_canvas_offscreen),        //
+    CASE_FIXTURE_NONE(test_canvas_coalesce),         //
+    CASE_FIXTURE_NONE(test_canvas_parallel),         //
+    CASE_FIXTURE_NONE(test_canvas_batch),            //
     CASE_FIXTURE_NONE(test_canvas_gui_1),            //
     CASE_FIXTURE_NONE(test_canvas_screencast),       //
+    CASE_FIXTURE_NONE(test_canvas_bindings),         //
+    CASE_FIXTURE_NONE(test_canvas_video),            //
 
     // graphics
     CASE_FIXTURE_NONE(test_graphics_dynamic), //
@@ -97,6 +108,9 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_graphics_volume_1),     //
     CASE_FIXTURE_NONE(test_graphics_volume_slice), //
     CASE_FIXTURE_NONE(test_graphics_mesh),         //
+    CASE_FIXTURE_NONE(test_graphics_mesh_normals), //
+    CASE_FIXTURE_NONE(test_graphics_mesh_obj),     //
+    CASE_FIXTURE_NONE(test_graphics_mesh_lod),     //
 
     // transforms
     CASE_FIXTURE_NONE(test_transforms_1), //
@@ -106,16 +120,18 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_transforms_5), //
 
     // array
-    CASE_FIXTURE_NONE(test_array_1),    //
-    CASE_FIXTURE_NONE(test_array_2),    //
-    CASE_FIXTURE_NONE(test_array_3),    //
-    CASE_FIXTURE_NONE(test_array_4),    //
-    CASE_FIXTURE_NONE(test_array_5),    //
-    CASE_FIXTURE_NONE(test_array_6),    //
-    CASE_FIXTURE_NONE(test_array_7),    //
-    CASE_FIXTURE_NONE(test_array_cast), //
-    CASE_FIXTURE_NONE(test_array_mvp),  //
-    CASE_FIXTURE_NONE(test_array_3D),   //
+    CASE_FIXTURE_NONE(test_array_1),      //
+    CASE_FIXTURE_NONE(test_array_2),      //
+    CASE_FIXTURE_NONE(test_array_3),      //
+    CASE_FIXTURE_NONE(test_array_4),      //
+    CASE_FIXTURE_NONE(test_array_5),      //
+    CASE_FIXTURE_NONE(test_array_6),      //
+    CASE_FIXTURE_NONE(test_array_7),      //
+    CASE_FIXTURE_NONE(test_array_cast),   //
+    CASE_FIXTURE_NONE(test_array_mvp),    //
+    CASE_FIXTURE_NONE(test_array_3D),     //
+    CASE_FIXTURE_NONE(test_array_npy),    //
+    CASE_FIXTURE_NONE(test_array_borrow), //
 
     // visuals
     CASE_FIXTURE_NONE(test_visuals_1), //
@@ -131,7 +147,8 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_interact_camera),  //
 
     // panel
-    CASE_FIXTURE_NONE(test_panel_1), //
+    CASE_FIXTURE_NONE(test_panel_1),    //
+    CASE_FIXTURE_NONE(test_panel_pick), //
 
     // builtin visuals
     CASE_FIXTURE_NONE(test_visuals_point),          //
@@ -161,15 +178,35 @@ static TestCase TEST_CASES[] = {
     CASE_FIXTURE_NONE(test_axes_3), //
 
     // scene
-    CASE_FIXTURE_NONE(test_scene_0),        //
-    CASE_FIXTURE_NONE(test_scene_1),        //
-    CASE_FIXTURE_NONE(test_scene_mesh),     //
-    CASE_FIXTURE_NONE(test_scene_axes),     //
-    CASE_FIXTURE_NONE(test_scene_logistic), //
+    CASE_FIXTURE_NONE(test_scene_0),              //
+    CASE_FIXTURE_NONE(test_scene_1),              //
+    CASE_FIXTURE_NONE(test_scene_mesh),           //
+    CASE_FIXTURE_NONE(test_scene_axes),           //
+    CASE_FIXTURE_NONE(test_scene_logistic),       //
+    CASE_FIXTURE_NONE(test_scene_lod),            //
+    CASE_FIXTURE_NONE(test_scene_pick),           //
+    CASE_FIXTURE_NONE(test_scene_tiles),          //
+    CASE_FIXTURE_NONE(test_scene_bricks),         //
+    CASE_FIXTURE_NONE(test_scene_mesh_lod),       //
+    CASE_FIXTURE_NONE(test_scene_instanced),      //
+    CASE_FIXTURE_NONE(test_scene_culling),        //
+    CASE_FIXTURE_NONE(test_scene_culling_margin), //
+    CASE_FIXTURE_NONE(test_scene_depth_sort),     //
+    CASE_FIXTURE_NONE(test_scene_mvp),            //
 
 };
 static uint32_t N_TESTS = sizeof(TEST_CASES) / sizeof(TestCase);
 
+// Benchmarks, which mostly log timings and may require a lot of memory, run with `bench`.
+static TestCase BENCH_CASES[] = {
+    CASE_FIXTURE_NONE(test_container_bench),        //
+    CASE_FIXTURE_NONE(test_colormap_bench),         //
+    CASE_FIXTURE_NONE(test_graphics_mesh_bench),    //
+    CASE_FIXTURE_NONE(test_scene_lod_bench),        //
+    CASE_FIXTURE_NONE(test_scene_depth_sort_bench), //
+};
+static uint32_t N_BENCHS = sizeof(BENCH_CASES) / sizeof(TestCase);
+
 
 
 /*************************************************************************************************/
@@ -185,6 +222,13 @@ static TestCase get_test_case(const char* name)
             return TEST_CASES[i];
         }
     }
+    for (uint32_t i = 0; i < N_BENCHS; i++)
+    {
+        if (strcmp(BENCH_CASES[i].name, name) == 0)
+        {
+            return BENCH_CASES[i];
+        }
+    }
     log_error("test case %s not found!", name);
     return (TestCase){0};
 }
@@ -257,7 +301,7 @@ static int launcher(TestContext* context, const char* name)
 /*  Main functions                                                                               */
 /*************************************************************************************************/
 
-static int test(int argc, char** argv)
+static int run_cases(TestCase* cases, uint32_t case_count, int argc, char** argv)
 {
     // argv: test, <name>, --live
     // bool is_live = argc >= 3 && strcmp(argv[2], "--live") == 0;
@@ -271,15 +315,15 @@ static int test(int argc, char** argv)
     int res = 0;
     int index = 0;
     // Loop over all possible tests.
-    for (uint32_t i = 0; i < N_TESTS; i++)
+    for (uint32_t i = 0; i < case_count; i++)
     {
         // Run a test only if all tests are requested, or if the requested test matches
         // the current test.
-        if (argc == 1 || strstr(TEST_CASES[i].name, argv[1]) != NULL)
+        if (argc == 1 || strstr(cases[i].name, argv[1]) != NULL)
         {
-            print_case(index, TEST_CASES[i].name);
-            cur_res = launcher(NULL, TEST_CASES[i].name);
-            print_res(index, TEST_CASES[i].name, cur_res);
+            print_case(index, cases[i].name);
+            cur_res = launcher(NULL, cases[i].name);
+            print_res(index, cases[i].name, cur_res);
             res += cur_res == 0 ? 0 : 1;
             index++;
         }
@@ -292,6 +336,10 @@ static int test(int argc, char** argv)
     return res;
 }
 
+static int test(int argc, char** argv) { return run_cases(TEST_CASES, N_TESTS, argc, argv); }
+
+static int bench(int argc, char** argv) { return run_cases(BENCH_CASES, N_BENCHS, argc, argv); }
+
 static int info(int argc, char** argv)
 {
     DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
@@ -322,13 +370,14 @@ int main(int argc, char** argv)
     log_set_level_env();
     if (argc <= 1)
     {
-        log_error("specify a command: info, demo, test");
+        log_error("specify a command: info, demo, test, bench");
         return 1;
     }
     ASSERT(argc >= 2);
     int res = 0;
     SWITCH_CLI_ARG(info)
     SWITCH_CLI_ARG(test)
+    SWITCH_CLI_ARG(bench)
     SWITCH_CLI_ARG(demo)
     return res;
 }
@@ -332,3 +332,166 @@ int test_array_3D(TestContext* context)
     dvz_array_destroy(&arr);
     return 0;
 }
+
+
+
+static void
+_write_npy(const char* path, const char* descr, const char* shape, void* data, size_t size)
+{
+    // Write a NPY file with a version 1 header, padded to 64 bytes.
+    char header[128] = {0};
+    snprintf(
+        header, sizeof(header), "{'descr': '%s', 'fortran_order': False, 'shape': %s, }", descr,
+        shape);
+    uint16_t header_len = 128 - 10;
+    memset(header + strlen(header), ' ', header_len - strlen(header) - 1);
+    header[header_len - 1] = '\n';
+
+    FILE* fp = fopen(path, "wb");
+    ASSERT(fp != NULL);
+    fwrite("\x93NUMPY\x01\x00", 1, 8, fp);
+    fwrite(&header_len, 2, 1, fp);
+    fwrite(header, 1, header_len, fp);
+    fwrite(data, 1, size, fp);
+    fclose(fp);
+}
+
+int test_array_npy(TestContext* context)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/array.npy", ARTIFACTS_DIR);
+
+    // 1D array of vec3.
+    float values[] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+    _write_npy(path, "<f4", "(4, 3)", values, sizeof(values));
+    DvzArray arr = dvz_array_npy(path);
+    AT(dvz_obj_is_created(&arr.obj));
+    AT(arr.mapping != NULL);
+    AT(arr.dtype == DVZ_DTYPE_VEC3);
+    AT(arr.item_count == 4);
+    AT(arr.buffer_size == sizeof(values));
+    AT(memcmp(arr.data, values, sizeof(values)) == 0);
+
+    // The data is not copied, and modifying it does not change the file.
+    ((float*)arr.data)[0] = 100;
+    AT(((float*)arr.data)[0] == 100);
+
+    // Resizing copies the data to the heap.
+    dvz_array_resize(&arr, 8);
+    AT(arr.mapping == NULL);
+    AT(((float*)arr.data)[0] == 100);
+    AT(((float*)arr.data)[3 * 8 - 1] == 11);
+    dvz_array_destroy(&arr);
+
+    // 3D volume.
+    uint8_t volume[2 * 3 * 5] = {0};
+    for (uint32_t i = 0; i < sizeof(volume); i++)
+        volume[i] = (uint8_t)i;
+    _write_npy(path, "|u1", "(2, 3, 5)", volume, sizeof(volume));
+    arr = dvz_array_npy(path);
+    AT(arr.dtype == DVZ_DTYPE_CHAR);
+    AT(arr.item_count == 30);
+    AT(arr.ndims == 3);
+    AT(arr.shape[0] == 5 && arr.shape[1] == 3 && arr.shape[2] == 2);
+    AT(*(uint8_t*)dvz_array_item(&arr, 29) == 29);
+    dvz_array_destroy(&arr);
+
+    // Invalid files.
+    _write_npy(path, ">f4", "(3,)", values, 3 * sizeof(float));
+    arr = dvz_array_npy(path);
+    AT(!dvz_obj_is_created(&arr.obj));
+    AT(arr.data == NULL);
+
+    _write_npy(path, "<f4", "(100,)", values, sizeof(values));
+    arr = dvz_array_npy(path);
+    AT(arr.data == NULL);
+
+    // Unsupported dtypes.
+    int64_t longs[] = {1, 2, 3};
+    _write_npy(path, "<i8", "(3,)", longs, sizeof(longs));
+    arr = dvz_array_npy(path);
+    AT(arr.data == NULL);
+
+    _write_npy(path, "<u8", "(3,)", longs, sizeof(longs));
+    arr = dvz_array_npy(path);
+    AT(arr.data == NULL);
+
+    _write_npy(path, "|i1", "(3,)", (int8_t[]){-1, 0, 1}, 3);
+    arr = dvz_array_npy(path);
+    AT(arr.data == NULL);
+
+    // Copying NPY reader.
+    _write_npy(path, "<f8", "(2,)", (double[]){1, 2}, 2 * sizeof(double));
+    size_t size = 0;
+    double* buf = (double*)dvz_read_npy(path, &size);
+    AT(size == 2 * sizeof(double));
+    AT(buf[0] == 1 && buf[1] == 2);
+    FREE(buf);
+
+    return 0;
+}
+
+
+
+int test_array_borrow(TestContext* context)
+{
+    double values[] = {1, 2, 3, 4, 5, 6};
+    DvzArray arr = dvz_array(0, DVZ_DTYPE_DVEC2);
+
+    // The buffer is not copied.
+    dvz_array_borrow(&arr, 3, values);
+    AT(arr.borrowed);
+    AT(arr.data == values);
+    AT(arr.item_count == 3);
+    AT(((double*)dvz_array_item(&arr, 2))[1] == 6);
+
+    // A partial update copies the buffer before modifying it.
+    double value[] = {10, 20};
+    dvz_array_data(&arr, 1, 1, 1, value);
+    AT(!arr.borrowed);
+    AT(arr.data != values);
+    AT(values[2] == 3);
+    AT(((double*)arr.data)[2] == 10);
+    AT(((double*)arr.data)[5] == 6);
+
+    // Growing a borrowed array copies the buffer.
+    dvz_array_borrow(&arr, 3, values);
+    dvz_array_resize(&arr, 5);
+    AT(!arr.borrowed);
+    AT(arr.data != values);
+    AT(((double*)arr.data)[9] == 6);
+
+    // Destroying the array does not free the buffer.
+    dvz_array_borrow(&arr, 3, values);
+    dvz_array_destroy(&arr);
+    AT(arr.data == NULL);
+    AT(values[0] == 1);
+
+    // Conversion from another dtype with the same number of components.
+    arr = dvz_array(0, DVZ_DTYPE_DVEC2);
+    dvz_array_borrow(&arr, 3, values);
+    float fvalues[600] = {0};
+    for (uint32_t i = 0; i < 600; i++)
+        fvalues[i] = i * .5f;
+    AT(dvz_array_convert(&arr, 300, DVZ_DTYPE_VEC2, fvalues) == 0);
+    AT(!arr.borrowed);
+    AT(arr.item_count == 300);
+    AT(values[0] == 1);
+    for (uint32_t i = 0; i < 600; i++)
+        AT(((double*)arr.data)[i] == i * .5);
+
+    // Incompatible dtypes.
+    AT(dvz_array_convert(&arr, 100, DVZ_DTYPE_VEC3, fvalues) != 0);
+    AT(arr.item_count == 300);
+    dvz_array_destroy(&arr);
+
+    // Conversion to 8-bit integers.
+    arr = dvz_array(0, DVZ_DTYPE_CVEC4);
+    double dvalues[] = {0, 1, 2, 3, 252, 253, 254, 255};
+    AT(dvz_array_convert(&arr, 2, DVZ_DTYPE_DVEC4, dvalues) == 0);
+    AT(((uint8_t*)arr.data)[1] == 1);
+    AT(((uint8_t*)arr.data)[7] == 255);
+    dvz_array_destroy(&arr);
+
+    return 0;
+}
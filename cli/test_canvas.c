@@ -102,6 +102,55 @@ int test_canvas_transfer_texture(TestContext* context)
 
 
 
+int test_canvas_transfer_stream(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzContext* ctx = gpu->context;
+
+    // Force streaming with a chunk much smaller than the uploads.
+    dvz_context_staging_chunk(ctx, 1024);
+
+    // Buffer upload spanning many chunks.
+    VkDeviceSize size = 10000;
+    DvzBufferRegions br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_VERTEX, 1, size);
+    uint8_t* data = calloc(size, sizeof(uint8_t));
+    for (uint32_t i = 0; i < size; i++)
+        data[i] = (uint8_t)(i % 251);
+    dvz_upload_buffers(canvas, br, 0, size, data);
+    dvz_app_run(app, 3);
+
+    uint8_t* data2 = calloc(size, sizeof(uint8_t));
+    dvz_download_buffers(canvas, br, 0, size, data2);
+    dvz_app_run(app, 3);
+    AT(memcmp(data, data2, size) == 0);
+    FREE(data);
+    FREE(data2);
+
+    // 3D texture upload: each slice (32x32x4 bytes) is larger than a chunk, so it is split
+    // into rows.
+    uvec3 shape = {32, 32, 4};
+    size = shape[0] * shape[1] * shape[2] * 4;
+    DvzTexture* tex = dvz_ctx_texture(ctx, 3, shape, VK_FORMAT_R8G8B8A8_UNORM);
+    data = calloc(size, sizeof(uint8_t));
+    for (uint32_t i = 0; i < size; i++)
+        data[i] = (uint8_t)(i % 253);
+    dvz_upload_texture(canvas, tex, DVZ_ZERO_OFFSET, DVZ_ZERO_OFFSET, size, data);
+    dvz_app_run(app, 3);
+
+    data2 = calloc(size, sizeof(uint8_t));
+    dvz_download_texture(canvas, tex, (uvec3){0}, shape, size, data2);
+    dvz_app_run(app, 3);
+    AT(memcmp(data, data2, size) == 0);
+
+    FREE(data);
+    FREE(data2);
+    TEST_END
+}
+
+
+
 /*************************************************************************************************/
 /*  Canvas 1                                                                                     */
 /*************************************************************************************************/
@@ -1165,6 +1214,222 @@ int test_canvas_offscreen(TestContext* context)
 
 
 
+typedef struct
+{
+    uint32_t moves, wheels, presses;
+    vec2 pos, dir;
+    bool wheel_before_move;
+} _MouseEvents;
+
+static void _coalesce_callback(DvzCanvas* canvas, DvzEvent ev)
+{
+    ASSERT(canvas != NULL);
+    _MouseEvents* events = (_MouseEvents*)ev.user_data;
+    ASSERT(events != NULL);
+    switch (ev.type)
+    {
+    case DVZ_EVENT_MOUSE_MOVE:
+        events->moves++;
+        glm_vec2_copy(ev.u.m.pos, events->pos);
+        break;
+    case DVZ_EVENT_MOUSE_WHEEL:
+        events->wheels++;
+        events->wheel_before_move = events->moves == 1;
+        glm_vec2_copy(ev.u.w.dir, events->dir);
+        break;
+    case DVZ_EVENT_MOUSE_PRESS:
+        events->presses++;
+        // The moves before the press have been emitted.
+        ASSERT(events->moves == 1);
+        break;
+    default:
+        break;
+    }
+}
+
+int test_canvas_coalesce(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    _MouseEvents events = {0};
+    DvzEventType types[] = {DVZ_EVENT_MOUSE_MOVE, DVZ_EVENT_MOUSE_WHEEL, DVZ_EVENT_MOUSE_PRESS};
+    for (uint32_t i = 0; i < 3; i++)
+        dvz_event_callback(
+            canvas, types[i], 0, DVZ_EVENT_MODE_SYNC, _coalesce_callback, &events);
+    dvz_app_run(app, 1);
+
+    // Storm of moves, then a press that emits them.
+    for (uint32_t i = 0; i < 1000; i++)
+        dvz_event_mouse_move(canvas, (vec2){i, 2 * i}, 0);
+    AT(events.moves == 0);
+    dvz_event_mouse_press(canvas, DVZ_MOUSE_BUTTON_LEFT, 0);
+    AT(events.moves == 1);
+    AT(events.presses == 1);
+    AT(events.pos[0] == 999 && events.pos[1] == 1998);
+    AT(canvas->mouse.press_pos[0] == 999);
+
+    // Interleaved wheel and move events, emitted at the next frame.
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        dvz_event_mouse_wheel(canvas, (vec2){0, 1}, 0);
+        dvz_event_mouse_move(canvas, (vec2){10, i}, 0);
+    }
+    AT(events.wheels == 0);
+    dvz_app_run(app, 1);
+    AT(events.moves == 2);
+    AT(events.wheels == 1);
+    AT(events.wheel_before_move);
+    AT(events.dir[1] == 100);
+    AT(events.pos[1] == 99);
+    AT(canvas->mouse.wheel_delta[1] == 100);
+    AT(dvz_event_coalesced(canvas) == 999 + 99 + 99);
+
+    // Events with other modifiers are not merged.
+    dvz_event_mouse_move(canvas, (vec2){0, 0}, 0);
+    dvz_event_mouse_move(canvas, (vec2){0, 0}, DVZ_KEY_MODIFIER_SHIFT);
+    AT(events.moves == 3);
+    dvz_app_run(app, 1);
+    AT(events.moves == 4);
+
+    // Without coalescing, every event is emitted right away.
+    dvz_event_coalesce(canvas, DVZ_EVENT_COALESCE_NONE);
+    for (uint32_t i = 0; i < 10; i++)
+        dvz_event_mouse_move(canvas, (vec2){i, i}, 0);
+    AT(events.moves == 14);
+    AT(dvz_event_coalesced(canvas) == 999 + 99 + 99);
+
+    TEST_END
+}
+
+
+
+#define N_PARALLEL_CANVASES 4
+#define N_PARALLEL_FRAMES   100
+
+static void _parallel_frame(DvzCanvas* canvas, DvzEvent ev)
+{
+    ASSERT(canvas != NULL);
+    // Mock some CPU work in every frame.
+    float* x = (float*)ev.user_data;
+    for (uint32_t i = 0; i < 100000; i++)
+        *x += sin(i * .001);
+}
+
+static double _run_canvases(DvzApp* app)
+{
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    dvz_app_run(app, N_PARALLEL_FRAMES);
+    return N_PARALLEL_CANVASES * N_PARALLEL_FRAMES / _clock_get(&clock);
+}
+
+int test_canvas_parallel(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+
+    DvzCanvas* canvases[N_PARALLEL_CANVASES] = {0};
+    float values[N_PARALLEL_CANVASES] = {0};
+    for (uint32_t i = 0; i < N_PARALLEL_CANVASES; i++)
+    {
+        canvases[i] = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+        dvz_event_callback(
+            canvases[i], DVZ_EVENT_FRAME, 0, DVZ_EVENT_MODE_SYNC, _parallel_frame, &values[i]);
+    }
+
+    // Serial mode.
+    double fps_serial = _run_canvases(app);
+    for (uint32_t i = 0; i < N_PARALLEL_CANVASES; i++)
+        AT(canvases[i]->frame_idx == N_PARALLEL_FRAMES);
+
+    // Parallel mode: one persistent worker thread per canvas.
+    dvz_app_parallel(app, true);
+    pthread_t threads[N_PARALLEL_CANVASES] = {0};
+    for (uint32_t i = 0; i < N_PARALLEL_CANVASES; i++)
+    {
+        AT(dvz_obj_is_created(&canvases[i]->frame_thread.obj));
+        threads[i] = canvases[i]->frame_thread.thread;
+    }
+    double fps_parallel = _run_canvases(app);
+    for (uint32_t i = 0; i < N_PARALLEL_CANVASES; i++)
+    {
+        AT(canvases[i]->frame_idx == 2 * N_PARALLEL_FRAMES);
+        AT(!canvases[i]->frame_pending);
+        AT(pthread_equal(canvases[i]->frame_thread.thread, threads[i]));
+    }
+
+    // The worker threads are stopped with the parallel mode.
+    dvz_app_parallel(app, false);
+    for (uint32_t i = 0; i < N_PARALLEL_CANVASES; i++)
+        AT(!dvz_obj_is_created(&canvases[i]->frame_thread.obj));
+
+    log_info(
+        "%d offscreen canvases: %.1f frames/s (serial), %.1f frames/s (parallel)",
+        N_PARALLEL_CANVASES, fps_serial, fps_parallel);
+
+    TEST_END
+}
+
+
+
+#define N_BATCH_JOBS 16
+
+static void _batch_setup(DvzCanvas* canvas, uint32_t job_idx, void* user_data)
+{
+    ASSERT(canvas != NULL);
+    dvz_canvas_clear_color(canvas, job_idx / (float)N_BATCH_JOBS, 0, 1);
+}
+
+int test_canvas_batch(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzBatch* batch = dvz_batch(canvas, 4);
+
+    // Every job changes the background color and renders to a CPU buffer, and every other job
+    // also writes a file.
+    uint8_t* rgb = calloc(N_BATCH_JOBS * TEST_WIDTH * TEST_HEIGHT, 3);
+    char path[1024];
+    for (uint32_t i = 0; i < N_BATCH_JOBS; i++)
+    {
+        snprintf(
+            path, sizeof(path), "%s/batch_%02d.%s", ARTIFACTS_DIR, i, i % 4 == 0 ? "png" : "ppm");
+        dvz_batch_job(
+            batch, _batch_setup, NULL, i % 2 == 0 ? path : NULL,
+            &rgb[i * TEST_WIDTH * TEST_HEIGHT * 3]);
+    }
+
+    DvzBatchStats stats = dvz_batch_run(batch);
+    AT(stats.job_count == N_BATCH_JOBS);
+    AT(stats.images_per_second > 0);
+    AT(batch->job_count == 0);
+
+    // Check the background color of each image.
+    uint8_t* img = NULL;
+    for (uint32_t i = 0; i < N_BATCH_JOBS; i++)
+    {
+        img = &rgb[i * TEST_WIDTH * TEST_HEIGHT * 3];
+        AT(abs((int)img[0] - (int)(255 * i / N_BATCH_JOBS)) <= 2);
+        AT(img[1] == 0);
+        AT(img[2] == 255);
+    }
+
+    // The batch can be run again with new jobs.
+    dvz_batch_job(batch, NULL, NULL, NULL, rgb);
+    stats = dvz_batch_run(batch);
+    AT(stats.job_count == 1);
+
+    dvz_batch_destroy(batch);
+    FREE(rgb);
+    TEST_END
+}
+
+
+
 /*************************************************************************************************/
 /*  Canvas GUI                                                                                   */
 /*************************************************************************************************/
@@ -1251,3 +1516,199 @@ int test_canvas_screencast(TestContext* context)
     dvz_app_run(app, N_FRAMES);
     TEST_END
 }
+
+
+
+int test_canvas_bindings(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    dvz_app_run(app, 3);
+
+    DvzBuffer buffer = dvz_buffer(gpu);
+    const VkDeviceSize size = 256;
+    dvz_buffer_size(&buffer, 2 * size);
+    dvz_buffer_usage(&buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    dvz_buffer_memory(
+        &buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    dvz_buffer_queue_access(&buffer, 0);
+    dvz_buffer_create(&buffer);
+    DvzBufferRegions br0 = {.buffer = &buffer, .size = size, .count = 1};
+    DvzBufferRegions br1 = {.buffer = &buffer, .size = size, .count = 1, .offsets = {size}};
+
+    DvzSlots slots = dvz_slots(gpu);
+    dvz_slots_binding(&slots, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    dvz_slots_create(&slots);
+
+    // Two bindings with their own descriptor sets.
+    DvzBindings bindings1 = dvz_bindings(&slots, 1);
+    dvz_bindings_buffer(&bindings1, 0, br0);
+    dvz_bindings_update(&bindings1);
+    DvzBindings bindings2 = dvz_bindings(&slots, 1);
+    dvz_bindings_buffer(&bindings2, 0, br1);
+    dvz_bindings_update(&bindings2);
+    VkDescriptorSet released = bindings2.dsets[0];
+    AT(released != bindings1.dsets[0]);
+    dvz_canvas_to_refill(canvas);
+    dvz_app_run(app, 5);
+
+    // In the same frame, the second bindings share the sets of the first ones, which releases
+    // their own sets, then stop sharing them, and new bindings are created. The released sets may
+    // still be used by the command buffers and they are not reused.
+    dvz_bindings_buffer(&bindings2, 0, br0);
+    dvz_bindings_update(&bindings2);
+    AT(bindings2.dsets[0] == bindings1.dsets[0]);
+    dvz_bindings_buffer(&bindings2, 0, br1);
+    dvz_bindings_update(&bindings2);
+    AT(bindings2.dsets[0] != bindings1.dsets[0]);
+    AT(bindings2.dsets[0] != released);
+    DvzBindings bindings3 = dvz_bindings(&slots, 1);
+    AT(bindings3.dsets[0] != released);
+
+    // The released sets are reused once the command buffers have been refilled.
+    dvz_canvas_to_refill(canvas);
+    dvz_app_run(app, 5);
+    AT(gpu->bindings_cache.retired == gpu->bindings_cache.serial);
+    DvzBindings bindings4 = dvz_bindings(&slots, 1);
+    AT(bindings4.dsets[0] == released);
+
+    dvz_bindings_destroy(&bindings1);
+    dvz_bindings_destroy(&bindings2);
+    dvz_bindings_destroy(&bindings3);
+    dvz_bindings_destroy(&bindings4);
+    dvz_slots_destroy(&slots);
+    dvz_buffer_destroy(&buffer);
+    TEST_END
+}
+
+
+
+#define N_VIDEO_FRAMES 40
+
+// The encoding callback waits until the gate is open, so that the frames of the pool are
+// deterministically exhausted.
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool open;
+    DvzVideoEncoder* encoder;
+    cvec4 pixel; // first pixel of the last encoded frame
+} _VideoGate;
+
+static void _video_gate(_VideoGate* gate, bool open)
+{
+    pthread_mutex_lock(&gate->lock);
+    gate->open = open;
+    pthread_cond_broadcast(&gate->cond);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+static void _video_encode(
+    DvzCanvas* canvas, uint64_t idx, uint32_t width, uint32_t height, uint8_t* rgba,
+    void* user_data)
+{
+    ASSERT(rgba != NULL);
+    _VideoGate* gate = (_VideoGate*)user_data;
+    ASSERT(gate != NULL);
+    pthread_mutex_lock(&gate->lock);
+    while (!gate->open)
+        pthread_cond_wait(&gate->cond, &gate->lock);
+    memcpy(gate->pixel, rgba, 4);
+    pthread_mutex_unlock(&gate->lock);
+}
+
+// Open the gate once the pool is exhausted, while the render thread waits for a free frame.
+static void* _video_gate_thread(void* user_data)
+{
+    _VideoGate* gate = (_VideoGate*)user_data;
+    ASSERT(gate != NULL);
+    for (uint32_t k = 0; k < 1000 && dvz_fifo_size(&gate->encoder->free_queue) > 0; k++)
+        dvz_sleep(1);
+    dvz_sleep(20);
+    _video_gate(gate, true);
+    return NULL;
+}
+
+int test_canvas_video(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    dvz_canvas_clear_color(canvas, 0, 0, 1);
+
+    _VideoGate gate = {0};
+    pthread_mutex_init(&gate.lock, NULL);
+    pthread_cond_init(&gate.cond, NULL);
+
+    // The encoder requires a screencast with an alpha channel.
+    AT(dvz_video_encoder(canvas, 2, DVZ_VIDEO_POLICY_DROP, _video_encode, &gate) == NULL);
+    AT(canvas->video == NULL);
+
+    dvz_screencast(canvas, 0, true);
+    DvzVideoEncoder* encoder =
+        dvz_video_encoder(canvas, 2, DVZ_VIDEO_POLICY_DROP, _video_encode, &gate);
+    AT(canvas->video == encoder);
+    gate.encoder = encoder;
+
+    // While the encoder waits, the 2 frames of the pool are used and the other ones are dropped.
+    dvz_app_run(app, N_VIDEO_FRAMES);
+    DvzVideoStats stats = dvz_video_encoder_stats(encoder);
+    AT(stats.frame_count > 2);
+    AT(stats.encoded_count == 0);
+    AT(stats.dropped_count == stats.frame_count - 2);
+    AT(stats.downscaled_count == 0);
+    AT(stats.queue_max <= 2);
+    _video_gate(&gate, true);
+    dvz_video_encoder_flush(encoder);
+    stats = dvz_video_encoder_stats(encoder);
+    AT(stats.encoded_count == 2);
+    AT(stats.latency_mean >= stats.encode_mean);
+    AT(gate.pixel[0] == 0 && gate.pixel[1] == 0 && gate.pixel[2] == 255);
+
+    // No frame is dropped when the render thread waits for the encoder.
+    _video_gate(&gate, false);
+    dvz_video_encoder_policy(encoder, DVZ_VIDEO_POLICY_BLOCK);
+    dvz_canvas_clear_color(canvas, 1, 0, 0);
+    pthread_t thread = {0};
+    pthread_create(&thread, NULL, _video_gate_thread, &gate);
+    dvz_app_run(app, N_VIDEO_FRAMES);
+    pthread_join(thread, NULL);
+    dvz_video_encoder_flush(encoder);
+    DvzVideoStats stats_block = dvz_video_encoder_stats(encoder);
+    AT(stats_block.frame_count > stats.frame_count);
+    AT(stats_block.dropped_count == stats.dropped_count);
+    AT(stats_block.downscaled_count == 0);
+    AT(stats_block.encoded_count == stats_block.frame_count - stats_block.dropped_count);
+    AT(gate.pixel[0] == 255 && gate.pixel[1] == 0 && gate.pixel[2] == 0);
+
+    // While the encoder waits, 2 frames are queued at full resolution, 2 at half resolution,
+    // and the other ones are dropped.
+    _video_gate(&gate, false);
+    dvz_video_encoder_policy(encoder, DVZ_VIDEO_POLICY_DOWNSCALE);
+    dvz_canvas_clear_color(canvas, 0, 1, 0);
+    dvz_app_run(app, N_VIDEO_FRAMES);
+    DvzVideoStats stats_down = dvz_video_encoder_stats(encoder);
+    uint64_t frame_count = stats_down.frame_count - stats_block.frame_count;
+    AT(frame_count > 4);
+    AT(stats_down.downscaled_count == 2);
+    AT(stats_down.dropped_count - stats_block.dropped_count == frame_count - 4);
+    _video_gate(&gate, true);
+    dvz_video_encoder_flush(encoder);
+    stats_down = dvz_video_encoder_stats(encoder);
+    AT(stats_down.encoded_count - stats_block.encoded_count == 4);
+    AT(stats_down.encoded_count + stats_down.dropped_count == stats_down.frame_count);
+    AT(gate.pixel[0] == 0 && gate.pixel[1] == 255 && gate.pixel[2] == 0);
+    log_info(
+        "video: %d frames, %d dropped, %d downscaled, latency %.1f ms, blocked %.1f ms",
+        (int)stats_down.frame_count, (int)stats_down.dropped_count,
+        (int)stats_down.downscaled_count, 1000 * stats_down.latency_mean,
+        1000 * stats_down.block_time);
+
+    // The encoder is destroyed with the canvas, before the gate.
+    int res = dvz_app_destroy(app);
+    pthread_cond_destroy(&gate.cond);
+    pthread_mutex_destroy(&gate.lock);
+    return res;
+}
@@ -1,4 +1,5 @@
 #include "test_common.h"
+#include "../include/datoviz/colormaps.h"
 #include "../include/datoviz/common.h"
 
 
@@ -103,3 +104,369 @@ int test_container(TestContext* context)
     dvz_container_destroy(&container);
     return 0;
 }
+
+
+
+int test_container_bench(TestContext* context)
+{
+    const uint32_t sizes[] = {10000, 100000, 1000000};
+    DvzClock clock = {0};
+    double t_alloc = 0, t_iter = 0, t_realloc = 0, t_destroy = 0;
+
+    for (uint32_t k = 0; k < 3; k++)
+    {
+        uint32_t n = sizes[k];
+        TestObject** objects = calloc(n, sizeof(TestObject*));
+        DvzContainer container =
+            dvz_container(DVZ_CONTAINER_DEFAULT_COUNT, sizeof(TestObject), 0);
+
+        // Allocation.
+        _clock_init(&clock);
+        for (uint32_t i = 0; i < n; i++)
+        {
+            objects[i] = dvz_container_alloc(&container);
+            objects[i]->x = i;
+            dvz_obj_created(&objects[i]->obj);
+        }
+        t_alloc = _clock_get(&clock);
+        AT(container.count == n);
+
+        // Iteration.
+        _clock_init(&clock);
+        double sum = 0;
+        TestObject* obj = NULL;
+        DvzContainerIterator iter = dvz_container_iterator(&container);
+        while (iter.item != NULL)
+        {
+            obj = iter.item;
+            sum += obj->x;
+            dvz_container_iter(&iter);
+        }
+        t_iter = _clock_get(&clock);
+        AT(sum == .5 * n * (n - 1.0));
+
+        // Destroy every other object and allocate them again: the slots are reused.
+        uint32_t capacity = container.capacity;
+        _clock_init(&clock);
+        for (uint32_t i = 0; i < n; i += 2)
+            dvz_obj_destroyed(&objects[i]->obj);
+        for (uint32_t i = 0; i < n; i += 2)
+        {
+            objects[i] = dvz_container_alloc(&container);
+            dvz_obj_created(&objects[i]->obj);
+        }
+        t_realloc = _clock_get(&clock);
+        AT(container.capacity == capacity);
+
+        // The destroyed slots that were not reused are reclaimed during the iteration.
+        uint32_t count = 0;
+        iter = dvz_container_iterator(&container);
+        while (iter.item != NULL)
+        {
+            count++;
+            dvz_container_iter(&iter);
+        }
+        AT(count == n);
+        AT(container.count == n);
+
+        // Destruction.
+        _clock_init(&clock);
+        for (uint32_t i = 0; i < n; i++)
+            dvz_obj_destroyed(&objects[i]->obj);
+        dvz_container_destroy(&container);
+        t_destroy = _clock_get(&clock);
+
+        log_info(
+            "%8d items: alloc %.2f ms, iter %.2f ms, destroy/alloc half %.2f ms, destroy %.2f ms",
+            n, t_alloc * 1000, t_iter * 1000, t_realloc * 1000, t_destroy * 1000);
+        FREE(objects);
+    }
+    return 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  Colormap tests                                                                               */
+/*************************************************************************************************/
+
+// Compare the batch colormap functions with dvz_colormap_scale().
+static bool _check_colormap_batch(
+    DvzColormap cmap, DvzDataType dtype, uint32_t count, const void* values, const double* dvalues,
+    double vmin, double vmax)
+{
+    cvec4* expected = calloc(count, sizeof(cvec4));
+    cvec4* colors = calloc(count, sizeof(cvec4));
+    vec2* uvs = calloc(count, sizeof(vec2));
+    for (uint32_t i = 0; i < count; i++)
+        dvz_colormap_scale(cmap, dvalues[i], vmin, vmax, expected[i]);
+    dvz_colormap_batch(cmap, dtype, count, values, vmin, vmax, colors);
+    dvz_colormap_batch_uv(cmap, dtype, count, values, vmin, vmax, uvs);
+
+    bool ok = memcmp(expected, colors, count * sizeof(cvec4)) == 0;
+    vec2 uv = {0};
+    for (uint32_t i = 0; i < count && ok; i++)
+    {
+        dvz_colormap_packuv(expected[i], uv);
+        ok = uv[0] == uvs[i][0] && uv[1] == uvs[i][1];
+    }
+    FREE(expected);
+    FREE(colors);
+    FREE(uvs);
+    return ok;
+}
+
+int test_colormap_batch(TestContext* context)
+{
+    // Enough values for several threads.
+    const uint32_t n = 3 * DVZ_COLORMAP_MIN_CHUNK + 17;
+    double* dvalues = calloc(n, sizeof(double));
+    float* fvalues = calloc(n, sizeof(float));
+    uint8_t* cvalues = calloc(n, sizeof(uint8_t));
+    uint16_t* svalues = calloc(n, sizeof(uint16_t));
+
+    // Values out of range, on the bounds, and NaN.
+    for (uint32_t i = 0; i < n; i++)
+    {
+        fvalues[i] = -.25 + 1.5 * dvz_rand_float();
+        if (i % 101 == 0)
+            fvalues[i] = 0;
+        if (i % 103 == 0)
+            fvalues[i] = 1;
+        if (i % 1009 == 0)
+            fvalues[i] = NAN;
+        dvalues[i] = fvalues[i];
+    }
+    DvzColormap cmaps[] = {DVZ_CMAP_VIRIDIS, DVZ_CPAL256_GLASBEY, DVZ_CPAL032_COLORBLIND8};
+    for (uint32_t k = 0; k < 3; k++)
+    {
+        AT(_check_colormap_batch(cmaps[k], DVZ_DTYPE_DOUBLE, n, dvalues, dvalues, 0, 1));
+        AT(_check_colormap_batch(cmaps[k], DVZ_DTYPE_FLOAT, n, fvalues, dvalues, .1, .7));
+        AT(_check_colormap_batch(cmaps[k], DVZ_DTYPE_DOUBLE, n, dvalues, dvalues, 1, 0));
+    }
+
+    // Integer values.
+    for (uint32_t i = 0; i < n; i++)
+    {
+        cvalues[i] = i % 256;
+        svalues[i] = (i * 7919) % 65536;
+    }
+    for (uint32_t i = 0; i < n; i++)
+        dvalues[i] = cvalues[i];
+    AT(_check_colormap_batch(DVZ_CMAP_HSV, DVZ_DTYPE_CHAR, n, cvalues, dvalues, 10, 200));
+    for (uint32_t i = 0; i < n; i++)
+        dvalues[i] = svalues[i];
+    AT(_check_colormap_batch(DVZ_CMAP_HSV, DVZ_DTYPE_USHORT, n, svalues, dvalues, 0, 65535));
+
+    // Invalid colormap: the colors are not modified.
+    cvec4 colors[4] = {0};
+    dvz_colormap_batch((DvzColormap)CMAP_COUNT, DVZ_DTYPE_DOUBLE, 4, dvalues, 0, 1, colors);
+    for (uint32_t i = 0; i < 4; i++)
+        AT(colors[i][0] == 0 && colors[i][3] == 0);
+
+    FREE(dvalues);
+    FREE(fvalues);
+    FREE(cvalues);
+    FREE(svalues);
+    return 0;
+}
+
+int test_colormap_bench(TestContext* context)
+{
+    const uint32_t sizes[] = {1000000, 10000000};
+    DvzClock clock = {0};
+    double t_scale = 0, t_batch = 0, t_batch_float = 0;
+
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        uint32_t n = sizes[k];
+        double* values = calloc(n, sizeof(double));
+        float* fvalues = calloc(n, sizeof(float));
+        cvec4* colors = calloc(n, sizeof(cvec4));
+        for (uint32_t i = 0; i < n; i++)
+        {
+            fvalues[i] = dvz_rand_float();
+            values[i] = fvalues[i];
+        }
+
+        // Current per-value path.
+        _clock_init(&clock);
+        for (uint32_t i = 0; i < n; i++)
+            dvz_colormap_scale(DVZ_CMAP_VIRIDIS, values[i], .1, .9, colors[i]);
+        t_scale = _clock_get(&clock);
+
+        _clock_init(&clock);
+        dvz_colormap_batch(DVZ_CMAP_VIRIDIS, DVZ_DTYPE_DOUBLE, n, values, .1, .9, colors);
+        t_batch = _clock_get(&clock);
+
+        _clock_init(&clock);
+        dvz_colormap_batch(DVZ_CMAP_VIRIDIS, DVZ_DTYPE_FLOAT, n, fvalues, .1, .9, colors);
+        t_batch_float = _clock_get(&clock);
+
+        log_info(
+            "%8d values: per value %.1f ms, batch %.1f ms (float %.1f ms)", n, t_scale * 1000,
+            t_batch * 1000, t_batch_float * 1000);
+        FREE(values);
+        FREE(fvalues);
+        FREE(colors);
+    }
+    return 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  Image encoding tests                                                                         */
+/*************************************************************************************************/
+
+static long _file_size(const char* path)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return 0;
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    return size;
+}
+
+static bool _check_png(const char* path, uint32_t width, uint32_t height, uint8_t* image)
+{
+    int w = 0, h = 0, c = 0;
+    uint8_t* decoded = stbi_load(path, &w, &h, &c, STBI_rgb);
+    if (decoded == NULL)
+        return false;
+    bool ok = (uint32_t)w == width && (uint32_t)h == height &&
+              memcmp(decoded, image, width * height * 3) == 0;
+    stbi_image_free(decoded);
+    return ok;
+}
+
+int test_png_fast(TestContext* context)
+{
+    const uint32_t width = 1920, height = 1080;
+    uint8_t* image = calloc(width * height, 3);
+
+    // Mock a screenshot: flat background, stripes, and some noise.
+    uint8_t* px = NULL;
+    for (uint32_t i = 0; i < height; i++)
+    {
+        for (uint32_t j = 0; j < width; j++)
+        {
+            px = &image[3 * (i * width + j)];
+            px[0] = (j / 40) % 2 == 0 ? 255 : (uint8_t)j;
+            px[1] = (uint8_t)(i / 4);
+            px[2] = (i * j) % 11 == 0 ? dvz_rand_byte() : 64;
+        }
+    }
+
+    char path[1024];
+    DvzClock clock = {0};
+    double t = 0;
+
+    // Reference libpng encoder.
+    snprintf(path, sizeof(path), "%s/encode_ref.png", ARTIFACTS_DIR);
+    _clock_init(&clock);
+    AT(dvz_write_png(path, width, height, image) == 0);
+    t = _clock_get(&clock);
+    log_info("libpng:       %.1f ms, %ld bytes", t * 1000, _file_size(path));
+    AT(_check_png(path, width, height, image));
+
+    // Fast encoder with different levels.
+    int levels[] = {0, 1, 6};
+    for (uint32_t k = 0; k < 3; k++)
+    {
+        snprintf(path, sizeof(path), "%s/encode_fast_%d.png", ARTIFACTS_DIR, levels[k]);
+        _clock_init(&clock);
+        AT(dvz_write_png_fast(path, width, height, image, levels[k], 0) == 0);
+        t = _clock_get(&clock);
+        log_info("fast level %d: %.1f ms, %ld bytes", levels[k], t * 1000, _file_size(path));
+        AT(_check_png(path, width, height, image));
+    }
+
+    // QOI.
+    snprintf(path, sizeof(path), "%s/encode.qoi", ARTIFACTS_DIR);
+    _clock_init(&clock);
+    AT(dvz_write_qoi(path, width, height, image) == 0);
+    t = _clock_get(&clock);
+    log_info("QOI:          %.1f ms, %ld bytes", t * 1000, _file_size(path));
+    int w = 0, h = 0;
+    uint8_t* decoded = dvz_read_qoi(path, &w, &h);
+    AT(decoded != NULL);
+    AT((uint32_t)w == width && (uint32_t)h == height);
+    AT(memcmp(decoded, image, width * height * 3) == 0);
+    FREE(decoded);
+
+    FREE(image);
+    return 0;
+}
+
+
+
+static void* _log_producer(void* user_data)
+{
+    for (uint32_t i = 0; i < 1000; i++)
+        log_info("producer %d, message %d", *(int*)user_data, i);
+    return NULL;
+}
+
+int test_log_async(TestContext* context)
+{
+    const int n = 4;
+    log_set_level(LOG_INFO);
+    FILE* fp = tmpfile();
+    AT(fp != NULL);
+    log_flush();
+    log_Stats stats_init = log_stats();
+    log_set_fp(fp);
+    log_set_quiet(1);
+    log_set_async(1);
+
+    // Several producers log concurrently, the messages that do not fit in the ring are dropped.
+    DvzThread threads[4] = {0};
+    int ids[4] = {0};
+    for (int i = 0; i < n; i++)
+    {
+        ids[i] = i;
+        threads[i] = dvz_thread(_log_producer, &ids[i]);
+    }
+    for (int i = 0; i < n; i++)
+        dvz_thread_join(&threads[i]);
+    log_flush();
+    log_Stats stats0 = log_stats();
+
+    // Errors are written before log_log() returns.
+    log_error("error in asynchronous mode");
+    log_Stats stats = log_stats();
+    char line[1024];
+    bool error = false;
+    long offset = ftell(fp);
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp) != NULL)
+        error |= strstr(line, "error in asynchronous mode") != NULL;
+    fseek(fp, offset, SEEK_SET);
+    AT(error);
+    log_set_async(0);
+    log_set_quiet(0);
+    log_set_fp(NULL);
+    log_set_level_env();
+
+    AT(stats.logged + stats.dropped == stats_init.logged + stats_init.dropped + n * 1000 + 1);
+    AT(stats.logged > stats0.logged);
+
+    // Every accepted record has been written.
+    uint64_t count = 0;
+    error = false;
+    rewind(fp);
+    while (fgets(line, sizeof(line), fp) != NULL)
+    {
+        count++;
+        error |= strstr(line, "error in asynchronous mode") != NULL;
+    }
+    fclose(fp);
+    log_info(
+        "%d messages logged asynchronously, %d dropped", (int)stats.logged, (int)stats.dropped);
+    AT(error);
+    AT(count == stats.logged - stats_init.logged);
+    return 0;
+}
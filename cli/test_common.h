@@ -11,6 +11,11 @@
 /*************************************************************************************************/
 
 int test_container(TestContext* context);
+int test_container_bench(TestContext* context);
+int test_colormap_batch(TestContext* context);
+int test_colormap_bench(TestContext* context);
+int test_png_fast(TestContext* context);
+int test_log_async(TestContext* context);
 
 
 
@@ -1,3 +1,6 @@
+#include <sys/stat.h>
+#include <utime.h>
+
 #include "test_graphics.h"
 #include "../include/datoviz/colormaps.h"
 #include "../include/datoviz/graphics.h"
@@ -1251,3 +1254,325 @@ int test_graphics_mesh(TestContext* context)
     SCREENSHOT("mesh")
     TEST_END
 }
+
+
+
+static void _mesh_wave(uint32_t row_count, uint32_t col_count, float* heights)
+{
+    float x, y;
+    for (uint32_t i = 0; i < row_count; i++)
+    {
+        x = -1.5 + 3 * (float)i / (row_count - 1);
+        for (uint32_t j = 0; j < col_count; j++)
+        {
+            y = -1.5 + 3 * (float)j / (col_count - 1);
+            heights[col_count * i + j] = .5 * sin(10 * x) * cos(10 * y) * exp(-(x * x + y * y));
+        }
+    }
+}
+
+// Serial reference: sum of the normals of the adjacent faces.
+static void _mesh_normals_serial(DvzMesh* mesh, vec3* normals)
+{
+    DvzIndex* indices = (DvzIndex*)mesh->indices.data;
+    DvzGraphicsMeshVertex* vertices = (DvzGraphicsMeshVertex*)mesh->vertices.data;
+    vec3 u, v, n;
+    for (uint32_t i = 0; i < mesh->indices.item_count / 3; i++)
+    {
+        glm_vec3_sub(vertices[indices[3 * i + 1]].pos, vertices[indices[3 * i + 0]].pos, u);
+        glm_vec3_sub(vertices[indices[3 * i + 2]].pos, vertices[indices[3 * i + 0]].pos, v);
+        glm_vec3_crossn(u, v, n);
+        for (uint32_t k = 0; k < 3; k++)
+            glm_vec3_add(normals[indices[3 * i + k]], n, normals[indices[3 * i + k]]);
+    }
+    for (uint32_t i = 0; i < mesh->vertices.item_count; i++)
+        glm_vec3_normalize(normals[i]);
+}
+
+int test_graphics_mesh_normals(TestContext* context)
+{
+    // Large enough to be split across threads.
+    const uint32_t row_count = 301, col_count = 501;
+    const uint32_t nv = row_count * col_count;
+    float* heights = calloc(nv, sizeof(float));
+    _mesh_wave(row_count, col_count, heights);
+    DvzMesh mesh = dvz_mesh_surface(row_count, col_count, heights);
+    AT(mesh.vertices.item_count == nv);
+    AT(mesh.indices.item_count == 6 * (row_count - 1) * (col_count - 1));
+
+    DvzGraphicsMeshVertex* vertices = (DvzGraphicsMeshVertex*)mesh.vertices.data;
+    DvzIndex* indices = (DvzIndex*)mesh.indices.data;
+
+    // Grid topology and edge normals.
+    AT(indices[0] == 0 && indices[1] == col_count && indices[2] == 1);
+    AT(indices[6 * (col_count - 1)] == col_count);
+    AT(glm_vec3_eqv(vertices[nv - 1].normal, vertices[nv - col_count - 2].normal));
+    AT(glm_vec3_eqv(vertices[col_count - 1].normal, vertices[col_count - 2].normal));
+    AT(vertices[nv - 1].uv[0] == 1 && vertices[nv - 1].uv[1] == 1);
+
+    // Normals from the faces, compared to the serial reference.
+    vec3* expected = calloc(nv, sizeof(vec3));
+    _mesh_normals_serial(&mesh, expected);
+    for (uint32_t i = 0; i < nv; i++)
+        memset(vertices[i].normal, 0, sizeof(vec3));
+    dvz_mesh_normals(&mesh);
+    for (uint32_t i = 0; i < nv; i++)
+        AT(glm_vec3_dot(vertices[i].normal, expected[i]) > .9999);
+
+    // Faces referencing the vertices in a random order.
+    for (uint32_t i = 0; i < mesh.indices.item_count / 3; i++)
+    {
+        uint32_t j = (uint32_t)rand() % (mesh.indices.item_count / 3);
+        for (uint32_t k = 0; k < 3; k++)
+        {
+            DvzIndex tmp = indices[3 * i + k];
+            indices[3 * i + k] = indices[3 * j + k];
+            indices[3 * j + k] = tmp;
+        }
+    }
+    for (uint32_t i = 0; i < nv; i++)
+        memset(vertices[i].normal, 0, sizeof(vec3));
+    dvz_mesh_normals(&mesh);
+    for (uint32_t i = 0; i < nv; i++)
+        AT(glm_vec3_dot(vertices[i].normal, expected[i]) > .9999);
+
+    FREE(expected);
+    FREE(heights);
+    dvz_mesh_destroy(&mesh);
+    return 0;
+}
+
+int test_graphics_mesh_bench(TestContext* context)
+{
+    // 2M and 10M triangles, set DVZ_BENCH_LARGE for 50M triangles.
+    const uint32_t sizes[] = {1000, 2237, 5000};
+    uint32_t n_sizes = getenv("DVZ_BENCH_LARGE") != NULL ? 3 : 2;
+
+    DvzClock clock = {0};
+    double t_grid = 0, t_normals = 0, t_serial = 0;
+    for (uint32_t k = 0; k < n_sizes; k++)
+    {
+        uint32_t n = sizes[k];
+        float* heights = calloc(n * n, sizeof(float));
+        AT(heights != NULL);
+        _mesh_wave(n, n, heights);
+
+        _clock_init(&clock);
+        DvzMesh mesh = dvz_mesh_surface(n, n, heights);
+        t_grid = _clock_get(&clock);
+
+        _clock_init(&clock);
+        dvz_mesh_normals(&mesh);
+        t_normals = _clock_get(&clock);
+
+        vec3* normals = calloc(n * n, sizeof(vec3));
+        _clock_init(&clock);
+        _mesh_normals_serial(&mesh, normals);
+        t_serial = _clock_get(&clock);
+
+        log_info(
+            "%10d triangles: surface in %.1f ms, normals in %.1f ms (serial %.1f ms)",
+            mesh.indices.item_count / 3, t_grid * 1000, t_normals * 1000, t_serial * 1000);
+
+        FREE(normals);
+        FREE(heights);
+        dvz_mesh_destroy(&mesh);
+    }
+    return 0;
+}
+
+
+
+static void _mesh_write_obj(const char* path, DvzMesh* mesh)
+{
+    FILE* f = fopen(path, "w");
+    DvzGraphicsMeshVertex* vertices = (DvzGraphicsMeshVertex*)mesh->vertices.data;
+    DvzIndex* indices = (DvzIndex*)mesh->indices.data;
+    fprintf(f, "# test mesh\r\no surface\r\n");
+    for (uint32_t i = 0; i < mesh->vertices.item_count; i++)
+        fprintf(
+            f, "v %.6f %.6f %.6f\r\nvn %.6f %.6f %.6f\r\n", //
+            vertices[i].pos[0], vertices[i].pos[1], vertices[i].pos[2], vertices[i].normal[0],
+            vertices[i].normal[1], vertices[i].normal[2]);
+    // Faces with absolute, then relative indices.
+    uint32_t nv = mesh->vertices.item_count;
+    for (uint32_t i = 0; i < mesh->indices.item_count / 3; i++)
+        if (i % 2 == 0)
+            fprintf(
+                f, "f %d//%d %d//%d %d//%d\r\n", indices[3 * i] + 1, indices[3 * i] + 1,
+                indices[3 * i + 1] + 1, indices[3 * i + 1] + 1, indices[3 * i + 2] + 1,
+                indices[3 * i + 2] + 1);
+        else
+            fprintf(
+                f, "f %d %d %d\r\n", (int)indices[3 * i] - (int)nv,
+                (int)indices[3 * i + 1] - (int)nv, (int)indices[3 * i + 2] - (int)nv);
+    // A quad, triangulated as a fan.
+    fprintf(f, "f 1 2 3 4\r\n");
+    fclose(f);
+}
+
+int test_graphics_mesh_obj(TestContext* context)
+{
+    // OBJ file large enough to be parsed by several threads.
+    const uint32_t n = 300;
+    float* heights = calloc(n * n, sizeof(float));
+    _mesh_wave(n, n, heights);
+    DvzMesh expected = dvz_mesh_surface(n, n, heights);
+    dvz_mesh_normalize(&expected);
+    FREE(heights);
+    uint32_t nv = expected.vertices.item_count;
+    uint32_t ni = expected.indices.item_count;
+
+    char path[1024], cache_path[1024];
+    snprintf(path, sizeof(path), "%s/mesh.obj", ARTIFACTS_DIR);
+    snprintf(cache_path, sizeof(cache_path), "%s/mesh.obj.dvzmesh", ARTIFACTS_DIR);
+    _mesh_write_obj(path, &expected);
+    remove(cache_path);
+
+    // Parsing and conversion.
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    DvzMesh mesh = dvz_mesh_obj(path);
+    log_info("parsed OBJ file in %.1f ms", _clock_get(&clock) * 1000);
+    AT(mesh.vertices.item_count == nv);
+    AT(mesh.indices.item_count == ni + 6);
+    AT(mesh.vertices.mapping == NULL);
+
+    DvzGraphicsMeshVertex* v0 = (DvzGraphicsMeshVertex*)expected.vertices.data;
+    DvzGraphicsMeshVertex* v1 = (DvzGraphicsMeshVertex*)mesh.vertices.data;
+    for (uint32_t i = 0; i < nv; i++)
+    {
+        AT(glm_vec3_distance(v0[i].pos, v1[i].pos) < 1e-3);
+        AT(glm_vec3_distance(v0[i].normal, v1[i].normal) < 1e-5);
+        AT(v1[i].alpha == 255);
+    }
+    AT(memcmp(expected.indices.data, mesh.indices.data, ni * sizeof(DvzIndex)) == 0);
+    DvzIndex* quad = &((DvzIndex*)mesh.indices.data)[ni];
+    AT(quad[0] == 0 && quad[1] == 1 && quad[2] == 2);
+    AT(quad[3] == 0 && quad[4] == 2 && quad[5] == 3);
+
+    // Second load: the binary cache is mapped in memory.
+    _clock_init(&clock);
+    DvzMesh cached = dvz_mesh_obj(path);
+    log_info("loaded cached mesh in %.1f ms", _clock_get(&clock) * 1000);
+    AT(cached.vertices.mapping != NULL);
+    AT(cached.vertices.item_count == nv);
+    AT(cached.indices.item_count == ni + 6);
+    AT(memcmp(cached.vertices.data, mesh.vertices.data, mesh.vertices.buffer_size) == 0);
+    AT(memcmp(cached.indices.data, mesh.indices.data, mesh.indices.buffer_size) == 0);
+    dvz_mesh_destroy(&cached);
+
+    // Touched OBJ file with the same contents: still cached.
+    struct stat st;
+    stat(cache_path, &st);
+    struct utimbuf times = {st.st_atime, st.st_mtime + 10};
+    utime(path, &times);
+    cached = dvz_mesh_obj(path);
+    AT(cached.vertices.mapping != NULL);
+    dvz_mesh_destroy(&cached);
+
+    // Modified OBJ file: parsed again.
+    FILE* f = fopen(path, "a");
+    fprintf(f, "f 4 3 2\n");
+    fclose(f);
+    cached = dvz_mesh_obj(path);
+    AT(cached.vertices.mapping == NULL);
+    AT(cached.indices.item_count == ni + 9);
+    dvz_mesh_destroy(&cached);
+
+    // Same-size modification shortly after the conversion: parsed again, as the modification
+    // time is compared with a nanosecond resolution.
+    dvz_sleep(20);
+    f = fopen(path, "r+b");
+    fseek(f, -8, SEEK_END);
+    fprintf(f, "f 2 3 4\n");
+    fclose(f);
+    cached = dvz_mesh_obj(path);
+    AT(cached.vertices.mapping == NULL);
+    AT(cached.indices.item_count == ni + 9);
+    AT(((DvzIndex*)cached.indices.data)[ni + 6] == 1);
+    dvz_mesh_destroy(&cached);
+
+    // Binary mesh files.
+    snprintf(path, sizeof(path), "%s/mesh.dvzmesh", ARTIFACTS_DIR);
+    AT(dvz_mesh_save(&expected, path) == 0);
+    cached = dvz_mesh_load(path);
+    AT(cached.vertices.item_count == nv);
+    AT(memcmp(cached.vertices.data, expected.vertices.data, expected.vertices.buffer_size) == 0);
+    dvz_mesh_destroy(&cached);
+
+    dvz_mesh_destroy(&mesh);
+    dvz_mesh_destroy(&expected);
+    return 0;
+}
+
+
+
+int test_graphics_mesh_lod(TestContext* context)
+{
+    const uint32_t n = 201;
+    float* heights = calloc(n * n, sizeof(float));
+
+    // A flat surface is simplified without error.
+    DvzMesh mesh = dvz_mesh_surface(n, n, heights);
+    DvzMeshLod lod = dvz_mesh_lod(&mesh, 4, 0);
+    AT(lod.level_count == 4);
+    for (uint32_t l = 0; l < lod.level_count; l++)
+        AT(lod.error[l] == 0);
+    dvz_mesh_destroy(&mesh);
+
+    _mesh_wave(n, n, heights);
+    mesh = dvz_mesh_surface(n, n, heights);
+    FREE(heights);
+    uint32_t nv = mesh.vertices.item_count;
+    uint32_t ni = mesh.indices.item_count;
+
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    lod = dvz_mesh_lod(&mesh, 6, 0);
+    log_debug(
+        "simplify %d faces into %d levels in %.1f ms", ni / 3, lod.level_count,
+        _clock_get(&clock) * 1000);
+    AT(lod.level_count == 6);
+    AT(lod.first_index[0] == 0);
+    AT(lod.index_count[0] == ni);
+    AT(lod.error[0] == 0);
+    AT(lod.radius > 0);
+
+    // The levels follow each other in the index array, with about half the faces of the previous
+    // one, and an increasing error.
+    DvzIndex* indices = (DvzIndex*)mesh.indices.data;
+    DvzIndex* face = NULL;
+    for (uint32_t l = 1; l < lod.level_count; l++)
+    {
+        log_debug(
+            "level %d: %d faces, error %.5f", l, lod.index_count[l] / 3, (double)lod.error[l]);
+        AT(lod.first_index[l] == lod.first_index[l - 1] + lod.index_count[l - 1]);
+        AT(lod.index_count[l] % 3 == 0);
+        AT(lod.index_count[l] < .6 * lod.index_count[l - 1]);
+        AT(lod.error[l] >= lod.error[l - 1]);
+        for (uint32_t i = 0; i < lod.index_count[l]; i += 3)
+        {
+            face = &indices[lod.first_index[l] + i];
+            AT(face[0] < nv && face[1] < nv && face[2] < nv);
+            AT(face[0] != face[1] && face[1] != face[2] && face[2] != face[0]);
+        }
+    }
+    uint32_t last = lod.level_count - 1;
+    AT(mesh.indices.item_count == lod.first_index[last] + lod.index_count[last]);
+    AT(lod.error[last] < .05);
+
+    // The vertices on the border of the surface are kept in the coarsest level.
+    uint8_t* used = calloc(nv, sizeof(uint8_t));
+    for (uint32_t i = 0; i < lod.index_count[last]; i++)
+        used[indices[lod.first_index[last] + i]] = 1;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        AT(used[i] && used[n * (n - 1) + i]);
+        AT(used[n * i] && used[n * i + n - 1]);
+    }
+    FREE(used);
+
+    dvz_mesh_destroy(&mesh);
+    return 0;
+}
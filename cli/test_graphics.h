@@ -34,6 +34,10 @@ int test_graphics_image_cmap(TestContext* context);
 int test_graphics_volume_slice(TestContext* context);
 int test_graphics_volume_1(TestContext* context);
 int test_graphics_mesh(TestContext* context);
+int test_graphics_mesh_normals(TestContext* context);
+int test_graphics_mesh_bench(TestContext* context);
+int test_graphics_mesh_obj(TestContext* context);
+int test_graphics_mesh_lod(TestContext* context);
 
 
 
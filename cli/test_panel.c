@@ -126,3 +126,108 @@ int test_panel_1(TestContext* context)
     FREE(color);
     TEST_END
 }
+
+
+
+int test_panel_pick(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzGrid grid = dvz_grid(canvas, 1, 1);
+    DvzPanel* panel = dvz_panel(&grid, 0, 0);
+    dvz_app_run(app, 3);
+
+    panel->data_coords.box = (DvzBox){{0, 0, -1}, {10, 20, 1}};
+
+    DvzVisual visual = dvz_visual(canvas);
+    dvz_visual_builtin(&visual, DVZ_VISUAL_POINT, 0);
+    dvz_panel_visual(panel, &visual);
+
+    // Random positions in the data box.
+    const uint32_t N = 100000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    for (uint32_t i = 0; i < N; i++)
+    {
+        pos[i][0] = 10 * dvz_rand_float();
+        pos[i][1] = 20 * dvz_rand_float();
+    }
+    dvz_visual_data(&visual, DVZ_PROP_POS, 0, N, pos);
+
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    dvz_visual_spatial_index(&visual, 0, true);
+    log_info("spatial index built on %d items in %.3f ms", N, 1000 * _clock_get(&clock));
+
+    // Window coordinates of all items, for the brute force search.
+    dvec2* win = calloc(N, sizeof(dvec2));
+    dvec3 out = {0};
+    for (uint32_t i = 0; i < N; i++)
+    {
+        dvz_transform(panel, DVZ_CDS_DATA, pos[i], DVZ_CDS_WINDOW, out);
+        win[i][0] = out[0];
+        win[i][1] = out[1];
+    }
+
+    const float radius = 10;
+    vec2 screen_pos = {0};
+    DvzPick pick = {0};
+    uint32_t imin = 0, n_close = 0;
+    double d = 0, dmin = 0;
+    for (uint32_t k = 0; k < 20; k++)
+    {
+        screen_pos[0] = TEST_WIDTH * dvz_rand_float();
+        screen_pos[1] = TEST_HEIGHT * dvz_rand_float();
+        pick = dvz_panel_pick(panel, screen_pos, radius);
+
+        n_close = 0;
+        dmin = radius;
+        for (uint32_t i = 0; i < N; i++)
+        {
+            d = hypot(win[i][0] - screen_pos[0], win[i][1] - screen_pos[1]);
+            if (d > radius)
+                continue;
+            n_close++;
+            if (d < dmin)
+            {
+                dmin = d;
+                imin = i;
+            }
+        }
+        AT(pick.count == MIN(n_close, DVZ_PICK_MAX_ITEMS));
+        if (n_close > 0)
+        {
+            AT(pick.visuals[0] == &visual);
+            AT(pick.items[0] == imin);
+            AC(pick.distances[0], dmin, 1e-3);
+        }
+    }
+
+    // Move an item with a partial update: the index is updated incrementally.
+    uint32_t item = N / 2;
+    dvz_transform(panel, DVZ_CDS_DATA, pos[item], DVZ_CDS_WINDOW, out);
+    screen_pos[0] = out[0];
+    screen_pos[1] = out[1];
+    pick = dvz_panel_pick(panel, screen_pos, 1);
+    AT(pick.count >= 1);
+    AT(pick.items[0] == item);
+
+    dvec3 moved = {-5, 25, 0}; // outside of the data box
+    dvz_visual_data_partial(&visual, DVZ_PROP_POS, 0, item, 1, 1, moved);
+    AT(!dvz_prop_get(&visual, DVZ_PROP_POS, 0)->spatial->dirty);
+    pick = dvz_panel_pick(panel, screen_pos, 1);
+    for (uint32_t i = 0; i < pick.count; i++)
+        AT(pick.items[i] != item);
+
+    dvz_transform(panel, DVZ_CDS_DATA, moved, DVZ_CDS_WINDOW, out);
+    screen_pos[0] = out[0];
+    screen_pos[1] = out[1];
+    pick = dvz_panel_pick(panel, screen_pos, 1);
+    AT(pick.count == 1);
+    AT(pick.items[0] == item);
+
+    dvz_visual_destroy(&visual);
+    FREE(pos);
+    FREE(win);
+    TEST_END
+}
@@ -10,6 +10,7 @@
 /*************************************************************************************************/
 
 int test_panel_1(TestContext* context);
+int test_panel_pick(TestContext* context);
 
 
 
@@ -2,6 +2,12 @@
 #include "../external/video.h"
 #include "../include/datoviz/builtin_visuals.h"
 #include "../include/datoviz/scene.h"
+#include "../src/interact_utils.h"
+#include "../src/bricks.h"
+#include "../src/depth_sort.h"
+#include "../src/lod.h"
+#include "../src/mesh_levels.h"
+#include "../src/tiles.h"
 #include "../src/ticks.h"
 #include "utils.h"
 
@@ -461,3 +467,990 @@ int test_scene_logistic(TestContext* context)
     dvz_scene_destroy(scene);
     TEST_END
 }
+
+
+
+/*************************************************************************************************/
+/*  Level of detail                                                                              */
+/*************************************************************************************************/
+
+static void _time_series(uint32_t n, dvec3* pos)
+{
+    for (uint32_t i = 0; i < n; i++)
+    {
+        pos[i][0] = -1 + 2 * i / (double)(n - 1);
+        pos[i][1] = .5 * sin(i * 1e-4) + .2 * (dvz_rand_float() - .5);
+    }
+}
+
+static void _set_zoom(DvzPanel* panel, float zoom)
+{
+    DvzInteract* interact = &panel->controller->interacts[0];
+    interact->u.p.zoom[0] = zoom;
+    interact->u.p.zoom[1] = zoom;
+    _panzoom_update_mvp(panel->viewport, &interact->u.p, &interact->mvp);
+}
+
+static void _set_pan(DvzPanel* panel, float x)
+{
+    DvzInteract* interact = &panel->controller->interacts[0];
+    interact->u.p.camera_pos[0] = x;
+    _panzoom_update_mvp(panel->viewport, &interact->u.p, &interact->mvp);
+}
+
+int test_scene_lod(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_LINE_STRIP, 0);
+
+    const uint32_t N = 1000000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    _time_series(N, pos);
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+    dvz_visual_data(visual, DVZ_PROP_COLOR, 0, 1, (cvec4[]){{255, 255, 255, 255}});
+    dvz_visual_lod(visual, true);
+    DvzLod* lod = visual->lod;
+
+    // Full view: the whole time series is decimated.
+    dvz_app_run(app, 5);
+    AT(lod->level >= 0);
+    AT(lod->first == 0 && lod->last == N);
+    AT(lod->vertex_count < N / 10);
+    int32_t level = lod->level;
+    uint8_t* rgb_lod = dvz_screenshot(canvas, false);
+
+    // Zoom in: a finer level on a smaller slice.
+    _set_zoom(panel, 100);
+    dvz_app_run(app, 5);
+    AT(lod->level < level);
+    AT(lod->last - lod->first < N / 10);
+    _set_zoom(panel, 1);
+    dvz_app_run(app, 5);
+    AT(lod->level == level);
+
+    // Same-size data update while panning: the pyramid must be rebuilt from the new data.
+    _time_series(N, pos);
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+    _set_zoom(panel, 10);
+    _set_pan(panel, .5);
+    dvz_app_run(app, 5);
+    DvzLod expected = {0};
+    _lod_build(&expected, N, pos);
+    AT(lod->level_count == expected.level_count);
+    AT(lod->bucket_count[0] == expected.bucket_count[0]);
+    size_t size = 2 * expected.bucket_count[0] * sizeof(uint32_t);
+    AT(memcmp(lod->extrema[0], expected.extrema[0], size) == 0);
+    _lod_destroy(&expected);
+    _set_pan(panel, 0);
+    _set_zoom(panel, 1);
+    dvz_app_run(app, 5);
+
+    // Reference rendering with all samples.
+    dvz_visual_lod(visual, false);
+    dvz_app_run(app, 5);
+    uint8_t* rgb = dvz_screenshot(canvas, false);
+
+    // The decimated line must cover the same pixels, up to the pixel columns shared by two
+    // buckets.
+    uint32_t n_pixels = canvas->swapchain.images->width * canvas->swapchain.images->height;
+    uint32_t n_diff = 0;
+    for (uint32_t i = 0; i < n_pixels; i++)
+        n_diff += memcmp(&rgb[3 * i], &rgb_lod[3 * i], 3) != 0;
+    log_debug("%d/%d pixels differ with the level of detail", n_diff, n_pixels);
+    AT(n_diff < n_pixels / 1000);
+
+    FREE(rgb);
+    FREE(rgb_lod);
+    FREE(pos);
+    dvz_scene_destroy(scene);
+    TEST_END
+}
+
+
+
+// Benchmark of the pyramid construction and of the slices at different zoom levels. The 1B
+// samples case requires 24 GB of memory and only runs when DVZ_BENCH_LARGE is set.
+int test_scene_lod_bench(TestContext* context)
+{
+    const uint32_t sizes[] = {10000000, 100000000, 1000000000};
+    const float zooms[] = {1, 10, 100, 1000, 10000};
+    const uint32_t width = 2000;
+    uint32_t n_sizes = getenv("DVZ_BENCH_LARGE") != NULL ? 3 : 2;
+
+    DvzClock clock = {0};
+    DvzLod lod = {0};
+    uint32_t* indices = NULL;
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n_sizes; i++)
+    {
+        dvec3* pos = calloc(sizes[i], sizeof(dvec3));
+        AT(pos != NULL);
+        _time_series(sizes[i], pos);
+
+        _clock_init(&clock);
+        _lod_build(&lod, sizes[i], pos);
+        log_info(
+            "%10d samples: pyramid with %d levels built in %.1f ms", sizes[i], lod.level_count,
+            _clock_get(&clock) * 1000);
+        AT(lod.level_count > 0);
+
+        lod.width = width;
+        for (uint32_t k = 0; k < 5; k++)
+        {
+            lod.xlim[0] = -1. / zooms[k];
+            lod.xlim[1] = +1. / zooms[k];
+
+            _clock_init(&clock);
+            _lod_slice(&lod, pos);
+            indices = calloc(_lod_max_count(&lod), sizeof(uint32_t));
+            count = _lod_indices(&lod, indices);
+            log_info(
+                "    zoom %6.0f: level %2d, %8d vertices in %.3f ms", zooms[k], lod.level, count,
+                _clock_get(&clock) * 1000);
+            AT(count <= 4 * (12 * width + 2) || lod.level < 0);
+            FREE(indices);
+        }
+
+        _lod_destroy(&lod);
+        FREE(pos);
+    }
+    return 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  GPU picking                                                                                  */
+/*************************************************************************************************/
+
+typedef struct
+{
+    uint32_t count;
+    DvzPickEvent ev;
+} PickResult;
+
+static void _on_pick(DvzCanvas* canvas, DvzEvent ev)
+{
+    PickResult* res = (PickResult*)ev.user_data;
+    ASSERT(res != NULL);
+    res->ev = ev.u.p;
+    res->count++;
+}
+
+int test_scene_pick(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, DVZ_CANVAS_FLAGS_PICK);
+    AT(canvas->pick != NULL);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_MARKER, 0);
+    AT(visual->pick_id > 0);
+
+    const uint32_t N = 3;
+    dvec3 pos[] = {{-.5, -.5, 0}, {0, 0, 0}, {.5, .5, 0}};
+    float ms[] = {40, 40, 40};
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+    dvz_visual_data(visual, DVZ_PROP_COLOR, 0, 1, (cvec4[]){{255, 255, 255, 255}});
+    dvz_visual_data(visual, DVZ_PROP_MARKER_SIZE, 0, N, ms);
+
+    PickResult res = {0};
+    dvz_event_callback(canvas, DVZ_EVENT_PICK, 0, DVZ_EVENT_MODE_SYNC, _on_pick, &res);
+    dvz_app_run(app, 5);
+
+    // Pick a small rectangle around every marker.
+    dvec3 out = {0};
+    for (uint32_t i = 0; i < N; i++)
+    {
+        dvz_transform(panel, DVZ_CDS_DATA, pos[i], DVZ_CDS_FRAMEBUFFER, out);
+        dvz_canvas_pick(canvas, (uint32_t)out[0] - 2, (uint32_t)out[1] - 2, 5, 5);
+        // The result comes asynchronously, after a few frames.
+        for (uint32_t k = 0; k < 10 && res.count == i; k++)
+            dvz_app_run(app, 1);
+        AT(res.count == i + 1);
+        AT(res.ev.size[0] == 5 && res.ev.size[1] == 5);
+        AT(res.ev.visual_id == visual->pick_id);
+        AT(res.ev.item_id == i);
+    }
+
+    // Empty area.
+    dvz_canvas_pick(canvas, 0, 0, 4, 4);
+    for (uint32_t k = 0; k < 10 && res.count == N; k++)
+        dvz_app_run(app, 1);
+    AT(res.count == N + 1);
+    AT(res.ev.visual_id == 0);
+
+    dvz_scene_destroy(scene);
+    TEST_END
+}
+
+
+
+/*************************************************************************************************/
+/*  Waiting for background work                                                                  */
+/*************************************************************************************************/
+
+#define WAIT_TIMEOUT 10 // maximum duration of _wait_until(), in seconds
+
+typedef bool (*WaitPredicate)(DvzVisual* visual, uint64_t param);
+
+// Run frames until a predicate on a visual is true, or until the timeout, and run one more frame
+// so that the data uploaded by the last frame is rendered.
+static void _wait_until(DvzApp* app, WaitPredicate predicate, DvzVisual* visual, uint64_t param)
+{
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    dvz_app_run(app, 1);
+    while (!predicate(visual, param) && _clock_get(&clock) < WAIT_TIMEOUT)
+    {
+        dvz_sleep(1);
+        dvz_app_run(app, 1);
+    }
+    if (!predicate(visual, param))
+        log_warn("timeout after %d seconds", WAIT_TIMEOUT);
+    dvz_app_run(app, 1);
+}
+
+
+
+/*************************************************************************************************/
+/*  Tiled image                                                                                  */
+/*************************************************************************************************/
+
+// Whether all requested tiles have been uploaded.
+static bool _tiles_done(DvzVisual* visual, uint64_t param)
+{
+    return dvz_visual_tiles_stats(visual).pending == 0;
+}
+
+int test_scene_tiles(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_IMAGE, 0);
+
+    // Top left, top right, bottom right, bottom left
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, 1, (dvec3[]){{-1, +1, 0}});
+    dvz_visual_data(visual, DVZ_PROP_POS, 1, 1, (dvec3[]){{+1, +1, 0}});
+    dvz_visual_data(visual, DVZ_PROP_POS, 2, 1, (dvec3[]){{+1, -1, 0}});
+    dvz_visual_data(visual, DVZ_PROP_POS, 3, 1, (dvec3[]){{-1, -1, 0}});
+
+    // Full resolution image, sampled by the default tile decoder.
+    const uint32_t S = 2048, T = 256;
+    cvec4* image = calloc(S * S, sizeof(cvec4));
+    for (uint32_t i = 0; i < S; i++)
+        for (uint32_t j = 0; j < S; j++)
+            memcpy(image[i * S + j], (cvec4){j / 8, i / 8, 128, 255}, sizeof(cvec4));
+
+    // Budget of 20 tiles: 4 levels, the whole image at level 1 requires 16 + 1 tiles.
+    dvz_visual_tiles(
+        visual, (uvec2){S, S}, T, VK_FORMAT_R8G8B8A8_UNORM, 20 * T * T * 4, NULL, image);
+    DvzTiles* tiles = visual->tiles;
+    AT(tiles != NULL);
+    AT(tiles->level_count == 4);
+    AT(tiles->slot_count == 20);
+
+    // Full view: the missing tiles are decoded in the background.
+    _wait_until(app, _tiles_done, visual, 0);
+    DvzTileStats stats = dvz_visual_tiles_stats(visual);
+    log_debug(
+        "tiles: %d hits, %d misses, %d uploads, %d resident", (uint32_t)stats.hits,
+        (uint32_t)stats.misses, (uint32_t)stats.uploads, stats.resident);
+    AT(tiles->level >= 1);
+    AT(stats.misses > 0);
+    AT(stats.pending == 0);
+    AT(stats.resident == stats.uploads);
+    AT(tiles->quad_count == _tiles_max_quads(tiles));
+    uint64_t hits = stats.hits;
+    dvz_app_run(app, 5);
+    AT(dvz_visual_tiles_stats(visual).hits > hits);
+    AT(dvz_visual_tiles_stats(visual).uploads == stats.uploads);
+
+    // The whole panel is covered by the image.
+    uint8_t* rgb = dvz_screenshot(canvas, false);
+    uint32_t n_pixels = canvas->swapchain.images->width * canvas->swapchain.images->height;
+    uint32_t n_blank = 0;
+    for (uint32_t i = 0; i < n_pixels; i++)
+        n_blank += rgb[3 * i + 2] == 0;
+    AT(n_blank < n_pixels / 100);
+    FREE(rgb);
+
+    // Zoom in: the full resolution tiles evict the least recently used ones.
+    uint32_t level = tiles->level;
+    _set_zoom(panel, 8);
+    _wait_until(app, _tiles_done, visual, 0);
+    stats = dvz_visual_tiles_stats(visual);
+    AT(tiles->level == 0 && level > 0);
+    AT(stats.evictions > 0);
+    AT(stats.resident <= tiles->slot_count);
+    AT(tiles->quad_count == _tiles_max_quads(tiles));
+
+    dvz_scene_destroy(scene);
+    FREE(image);
+    TEST_END
+}
+
+
+
+/*************************************************************************************************/
+/*  Bricked volume                                                                               */
+/*************************************************************************************************/
+
+// Whether all requested bricks have been uploaded.
+static bool _bricks_done(DvzVisual* visual, uint64_t param)
+{
+    return dvz_visual_bricks_stats(visual).pending == 0;
+}
+
+int test_scene_bricks(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_ARCBALL, 0);
+    DvzVisual* visual =
+        dvz_scene_visual(panel, DVZ_VISUAL_VOLUME, DVZ_GRAPHICS_FLAGS_VOLUME_BRICKED);
+
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, 1, (dvec3[]){{-1, -1, -1}});
+    dvz_visual_data(visual, DVZ_PROP_POS, 1, 1, (dvec3[]){{+1, +1, +1}});
+    dvz_visual_texture(
+        visual, DVZ_SOURCE_TYPE_COLOR_TEXTURE, 0, gpu->context->color_texture.texture);
+    DvzColormap cmap = DVZ_CMAP_BONE;
+    dvz_visual_data(visual, DVZ_PROP_COLORMAP, 0, 1, &cmap);
+
+    // Ball in the middle of the volume, the corners being empty.
+    const uint32_t S = 128, B = 16;
+    uint8_t* volume = calloc(S * S * S, sizeof(uint8_t));
+    double x = 0, y = 0, z = 0;
+    for (uint32_t k = 0; k < S; k++)
+    {
+        for (uint32_t j = 0; j < S; j++)
+        {
+            for (uint32_t i = 0; i < S; i++)
+            {
+                x = i / (double)S - .5;
+                y = j / (double)S - .5;
+                z = k / (double)S - .5;
+                volume[(k * S + j) * S + i] = x * x + y * y + z * z < .35 * .35 ? 200 : 0;
+            }
+        }
+    }
+
+    // Budget of all the bricks of the finest level: 4 levels, 512 + 64 + 8 + 1 bricks.
+    dvz_visual_bricks(visual, (uvec3){S, S, S}, B, VK_FORMAT_R8_UNORM, 512 * B * B * B, volume);
+    DvzBricks* bricks = visual->bricks;
+    AT(bricks != NULL);
+    AT(bricks->level_count == 4);
+    AT(bricks->brick_count == 585);
+    AT(bricks->slot_count == 512);
+
+    // Empty corner brick, full brick in the middle, and coarsest brick.
+    AT(bricks->minmax[2 * _bricks_index(bricks, 0, 0, 0, 0) + 1] == 0);
+    AT(bricks->minmax[2 * _bricks_index(bricks, 0, 4, 4, 4) + 0] == 200);
+    AT(bricks->minmax[2 * (bricks->brick_count - 1) + 1] > 0);
+
+    // The visible bricks are prepared in the background.
+    _wait_until(app, _bricks_done, visual, 0);
+    DvzBrickStats stats = dvz_visual_bricks_stats(visual);
+    log_debug(
+        "bricks: level %d, %d visible, %d empty, %d culled, %d uploads, %d resident",
+        bricks->level, stats.visible, stats.empty, stats.culled, (uint32_t)stats.uploads,
+        stats.resident);
+    const uint32_t* g = bricks->grid[bricks->level];
+    AT(stats.visible + stats.empty + stats.culled == g[0] * g[1] * g[2]);
+    AT(stats.visible > 0);
+    AT(stats.empty > 0);
+    AT(stats.pending == 0);
+    AT(stats.resident == stats.uploads);
+    AT(stats.resident <= stats.visible + 1);
+    AT(stats.evictions == 0);
+
+    // The empty corner pages are skipped, the others point to a resident brick.
+    AT(bricks->pages[0][3] == -1);
+    AT(bricks->pages[(4 * 8 + 4) * 8 + 4][3] == bricks->level);
+
+    // The ball is visible in the middle of the panel.
+    uint64_t hits = stats.hits;
+    dvz_app_run(app, 5);
+    AT(dvz_visual_bricks_stats(visual).hits > hits);
+    AT(dvz_visual_bricks_stats(visual).uploads == stats.uploads);
+    uint8_t* rgb = dvz_screenshot(canvas, false);
+    uint32_t w = canvas->swapchain.images->width, h = canvas->swapchain.images->height;
+    uint8_t* center = &rgb[3 * ((h / 2) * w + w / 2)];
+    AT(center[0] + center[1] + center[2] > 0);
+    FREE(rgb);
+
+    dvz_scene_destroy(scene);
+    FREE(volume);
+    TEST_END
+}
+
+
+
+/*************************************************************************************************/
+/*  Mesh levels of detail                                                                        */
+/*************************************************************************************************/
+
+// Whether the levels of detail of a mesh visual have been uploaded.
+static bool _mesh_levels_done(DvzVisual* visual, uint64_t param)
+{
+    return visual->mesh_levels->ready;
+}
+
+static void _set_distance(DvzPanel* panel, float distance)
+{
+    DvzInteract* interact = &panel->controller->interacts[0];
+    interact->u.a.camera.eye[2] = distance;
+    _arcball_update_mvp(panel->viewport, &interact->u.a, &interact->mvp);
+}
+
+int test_scene_mesh_lod(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    // The same mesh in two panels, with the camera inside its bounding sphere and far from it.
+    DvzScene* scene = dvz_scene(canvas, 1, 2);
+    DvzPanel* panels[2] = {0};
+    panels[0] = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_ARCBALL, 0);
+    panels[1] = dvz_scene_panel(scene, 0, 1, DVZ_CONTROLLER_ARCBALL, 0);
+
+    const uint32_t n = 301;
+    float* heights = calloc(n * n, sizeof(float));
+    double x = 0, y = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        for (uint32_t j = 0; j < n; j++)
+        {
+            x = -1.5 + 3 * i / (double)(n - 1);
+            y = -1.5 + 3 * j / (double)(n - 1);
+            heights[n * i + j] = .5 * sin(10 * x) * cos(10 * y) * exp(-(x * x + y * y));
+        }
+    }
+    DvzMesh mesh = dvz_mesh_surface(n, n, heights);
+    FREE(heights);
+    dvz_mesh_rotate(&mesh, M_PI / 2, (vec3){1, 0, 0});
+    dvz_mesh_transform(&mesh);
+    uint32_t ni = mesh.indices.item_count;
+
+    DvzVisual* visuals[2] = {0};
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        visuals[k] = dvz_scene_visual(panels[k], DVZ_VISUAL_MESH, 0);
+        dvz_visual_texture(
+            visuals[k], DVZ_SOURCE_TYPE_IMAGE, 0, gpu->context->color_texture.texture);
+        dvz_visual_mesh_lod(visuals[k], &mesh, 6);
+        AT(dvz_visual_mesh_lod_stats(visuals[k]).face_count == ni / 3);
+    }
+    // The mesh has been copied.
+    dvz_mesh_destroy(&mesh);
+    _set_distance(panels[0], 1.2);
+    _set_distance(panels[1], 50);
+
+    // The levels are computed in the background.
+    _wait_until(app, _mesh_levels_done, visuals[0], 0);
+    _wait_until(app, _mesh_levels_done, visuals[1], 0);
+    DvzMeshLevelStats stats[2] = {0};
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        stats[k] = dvz_visual_mesh_lod_stats(visuals[k]);
+        log_debug(
+            "panel %d: level %d/%d, %d faces, radius %.1f px, error %.3f px", k, stats[k].level,
+            stats[k].level_count, stats[k].face_count, (double)stats[k].pixel_radius,
+            (double)stats[k].pixel_error);
+        AT(stats[k].level_count == 6);
+        AT(stats[k].pixel_error <= DVZ_MESH_LOD_PIXEL_ERROR);
+    }
+
+    // The far panel draws a coarser level.
+    AT(stats[0].level == 0);
+    AT(stats[0].face_count == ni / 3);
+    AT(stats[1].level > 0);
+    AT(stats[1].face_count < stats[0].face_count);
+    AT(stats[1].pixel_radius < stats[0].pixel_radius);
+
+    // Moving the camera of the far panel closer selects the original mesh.
+    _set_distance(panels[1], 1.2);
+    dvz_app_run(app, 3);
+    DvzMeshLevelStats closer = dvz_visual_mesh_lod_stats(visuals[1]);
+    AT(closer.level == 0);
+    AT(closer.switches > stats[1].switches);
+
+    // The mesh is visible in the near panel.
+    uint8_t* rgb = dvz_screenshot(canvas, false);
+    uint32_t w = canvas->swapchain.images->width, h = canvas->swapchain.images->height;
+    uint8_t* center = &rgb[3 * ((h / 2) * w + w / 4)];
+    AT(center[0] + center[1] + center[2] > 0);
+    FREE(rgb);
+
+    dvz_scene_destroy(scene);
+    TEST_END
+}
+
+
+
+/*************************************************************************************************/
+/*  Instancing                                                                                   */
+/*************************************************************************************************/
+
+// Compare the left and right halves of a screenshot, return the number of differing pixels.
+static uint32_t _halves_diff(DvzCanvas* canvas, uint8_t background, uint32_t* n_lit)
+{
+    uint8_t* rgb = dvz_screenshot(canvas, false);
+    uint32_t w = canvas->swapchain.images->width, h = canvas->swapchain.images->height;
+    uint32_t n_diff = 0;
+    *n_lit = 0;
+    for (uint32_t i = 0; i < h; i++)
+    {
+        for (uint32_t j = 0; j < w / 2; j++)
+        {
+            *n_lit += rgb[3 * (i * w + j)] != background;
+            n_diff += memcmp(&rgb[3 * (i * w + j)], &rgb[3 * (i * w + j + w / 2)], 3) != 0;
+        }
+    }
+    FREE(rgb);
+    return n_diff;
+}
+
+int test_scene_instanced(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    // The same path in two panels, with and without instancing.
+    DvzScene* scene = dvz_scene(canvas, 1, 2);
+    DvzPanel* panels[2] = {0};
+    panels[0] = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    panels[1] = dvz_scene_panel(scene, 0, 1, DVZ_CONTROLLER_PANZOOM, 0);
+
+    const uint32_t N = 10000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    _time_series(N, pos);
+
+    DvzVisual* visuals[2] = {0};
+    visuals[0] = dvz_scene_visual(panels[0], DVZ_VISUAL_PATH, 0);
+    visuals[1] = dvz_scene_visual(panels[1], DVZ_VISUAL_PATH, DVZ_GRAPHICS_FLAGS_INSTANCED);
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        dvz_visual_data(visuals[k], DVZ_PROP_POS, 0, N, pos);
+        dvz_visual_data(visuals[k], DVZ_PROP_COLOR, 0, 1, (cvec4[]){{255, 255, 255, 255}});
+    }
+    AT(visuals[0]->graphics[0]->instance_vertex_count == 0);
+    AT(visuals[1]->graphics[0]->instance_vertex_count == 4);
+    dvz_app_run(app, 5);
+
+    // Instancing uploads one vertex per segment instead of 4.
+    DvzSource* sources[2] = {0};
+    VkDeviceSize sizes[2] = {0};
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        sources[k] = dvz_source_get(visuals[k], DVZ_SOURCE_TYPE_VERTEX, 0);
+        sizes[k] = sources[k]->arr.item_count * sources[k]->arr.item_size;
+    }
+    log_info(
+        "path with %d points: %d bytes of vertices, %d with instancing", N, (int)sizes[0],
+        (int)sizes[1]);
+    AT(sizes[1] > 0);
+    AT(sizes[0] == 4 * sizes[1]);
+    AT(sources[1]->u.br.size >= sizes[1]);
+
+    // Both panels must look the same, up to the antialiasing of a few pixels.
+    uint32_t n_lit = 0;
+    uint32_t n_diff = _halves_diff(canvas, 0, &n_lit);
+    log_debug("%d/%d pixels differ with instancing", n_diff, n_lit);
+    AT(n_lit > 0);
+    AT(n_diff < n_lit / 100 + 1);
+    FREE(pos);
+
+    // The same 2D axes in two panels of another canvas, with and without instanced segments:
+    // indexed instanced draw of the quad shared by all segments.
+    DvzCanvas* canvas_axes = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+    DvzScene* scene_axes = dvz_scene(canvas_axes, 1, 2);
+    panels[0] = dvz_scene_panel(scene_axes, 0, 0, DVZ_CONTROLLER_AXES_2D, 0);
+    panels[1] =
+        dvz_scene_panel(scene_axes, 0, 1, DVZ_CONTROLLER_AXES_2D, DVZ_GRAPHICS_FLAGS_INSTANCED);
+    for (uint32_t k = 0; k < 2; k++)
+        visuals[k] = panels[k]->controller->visuals[0];
+    AT(visuals[0]->graphics[0]->instance_vertex_count == 0);
+    AT(visuals[1]->graphics[0]->instance_vertex_count == 4);
+    dvz_app_run(app, 5);
+
+    // One vertex per segment instead of 4, and 6 indices instead of 6 per segment.
+    DvzSource* indices[2] = {0};
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        sources[k] = dvz_source_get(visuals[k], DVZ_SOURCE_TYPE_VERTEX, 0);
+        indices[k] = dvz_source_get(visuals[k], DVZ_SOURCE_TYPE_INDEX, 0);
+        sizes[k] = sources[k]->arr.item_count * sources[k]->arr.item_size;
+    }
+    log_info(
+        "axes with %d segments: %d bytes of vertices, %d with instancing",
+        indices[0]->arr.item_count / 6, (int)sizes[0], (int)sizes[1]);
+    AT(sizes[1] > 0);
+    AT(sizes[0] == 4 * sizes[1]);
+    AT(indices[1]->arr.item_count == 6);
+    AT(indices[0]->arr.item_count == 6 * sources[1]->arr.item_count);
+
+    // The axes are drawn in black on a white background.
+    n_diff = _halves_diff(canvas_axes, 255, &n_lit);
+    log_debug("%d/%d pixels differ with instanced axes", n_diff, n_lit);
+    AT(n_lit > 0);
+    AT(n_diff < n_lit / 100 + 1);
+
+    dvz_scene_destroy(scene_axes);
+    dvz_scene_destroy(scene);
+    TEST_END
+}
+
+
+
+/*************************************************************************************************/
+/*  Viewport culling                                                                             */
+/*************************************************************************************************/
+
+int test_scene_culling(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    dvz_panel_culling(panel, true);
+
+    // A long time series, and small clusters of points in the corners.
+    const uint32_t N = 1000000;
+    dvec3* pos = calloc(N, sizeof(dvec3));
+    _time_series(N, pos);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, N, pos);
+    dvz_visual_data(visual, DVZ_PROP_COLOR, 0, 1, (cvec4[]){{255, 255, 255, 255}});
+    DvzVisual* series = visual;
+
+    const uint32_t n = 1000;
+    for (uint32_t k = 0; k < 4; k++)
+    {
+        for (uint32_t i = 0; i < n; i++)
+        {
+            pos[i][0] = (k % 2 == 0 ? -.9 : +.9) + .05 * dvz_rand_normal();
+            pos[i][1] = (k / 2 == 0 ? -.9 : +.9) + .05 * dvz_rand_normal();
+            pos[i][2] = 0;
+        }
+        visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+        dvz_visual_data(visual, DVZ_PROP_POS, 0, n, pos);
+        dvz_visual_data(visual, DVZ_PROP_COLOR, 0, 1, (cvec4[]){{255, 0, 0, 255}});
+    }
+
+    // Full view: everything is drawn.
+    dvz_app_run(app, 5);
+    DvzCullStats stats = dvz_panel_cull_stats(panel);
+    AT(stats.visual_count == 5);
+    AT(stats.vertex_count == N + 4 * n);
+    AT(stats.culled_visuals == 0);
+    AT(stats.draw_count == 5);
+    AT(stats.culled_count == 0);
+
+    // Zoom in the center: the clusters are culled, and only a slice of the time series is drawn.
+    _set_zoom(panel, 100);
+    dvz_app_run(app, 5);
+    stats = dvz_panel_cull_stats(panel);
+    log_info(
+        "culling at zoom 100: %d/%d draws, %d/%d vertices culled", stats.draw_count,
+        stats.visual_count, (int)stats.culled_count, (int)stats.vertex_count);
+    AT(stats.culled_visuals == 4);
+    AT(stats.draw_count == 1);
+    AT(stats.culled_count > stats.vertex_count * 9 / 10);
+    AT(stats.refills > 0);
+    uint8_t* rgb_culled = dvz_screenshot(canvas, false);
+
+    // With a depth sort, the time series is drawn entirely, and only the clusters are culled.
+    dvz_visual_depth_sort(series, true);
+    dvz_app_run(app, 5);
+    stats = dvz_panel_cull_stats(panel);
+    AT(stats.culled_visuals == 4);
+    AT(stats.draw_count == 1);
+    AT(stats.culled_count == 4 * n);
+    dvz_visual_depth_sort(series, false);
+
+    // The rendering is the same without culling.
+    dvz_panel_culling(panel, false);
+    dvz_app_run(app, 5);
+    stats = dvz_panel_cull_stats(panel);
+    AT(stats.visual_count == 0);
+    AT(stats.culled_count == 0);
+    uint8_t* rgb = dvz_screenshot(canvas, false);
+    uint32_t n_pixels = canvas->swapchain.images->width * canvas->swapchain.images->height;
+    AT(memcmp(rgb, rgb_culled, 3 * n_pixels) == 0);
+
+    FREE(rgb);
+    FREE(rgb_culled);
+    FREE(pos);
+    dvz_scene_destroy(scene);
+    TEST_END
+}
+
+
+
+int test_scene_culling_margin(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_PANZOOM, 0);
+    dvz_panel_culling(panel, true);
+
+    // Two points in the corners, so that the data is normalized in [-1, +1].
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_POINT, 0);
+    dvz_visual_data(visual, DVZ_PROP_POS, 0, 2, (dvec3[]){{-1, -1, 0}, {+1, +1, 0}});
+
+    // At zoom 2, the markers are 40 pixels to the right of the viewport, beyond the minimum
+    // margin: only the largest one, with a radius of 60 pixels, is partly visible.
+    float width = panel->viewport.viewport.width;
+    double x = .5 + 40 / width;
+    DvzVisual* visual_large = dvz_scene_visual(panel, DVZ_VISUAL_MARKER, 0);
+    dvz_visual_data(visual_large, DVZ_PROP_POS, 0, 2, (dvec3[]){{x, -.1, 0}, {x, +.1, 0}});
+    dvz_visual_data(visual_large, DVZ_PROP_MARKER_SIZE, 0, 2, (float[]){10, 120});
+    dvz_visual_data(visual_large, DVZ_PROP_COLOR, 0, 1, (cvec4[]){{255, 0, 0, 255}});
+
+    DvzVisual* visual_small = dvz_scene_visual(panel, DVZ_VISUAL_MARKER, 0);
+    dvz_visual_data(visual_small, DVZ_PROP_POS, 0, 1, (dvec3[]){{x, 0, 0}});
+    dvz_visual_data(visual_small, DVZ_PROP_MARKER_SIZE, 0, 1, (float[]){10});
+
+    _set_zoom(panel, 2);
+    dvz_app_run(app, 5);
+    AT(visual_large->culling != NULL && visual_small->culling != NULL);
+    AT(visual_large->culling->margin == 60);
+    AT(visual_small->culling->margin == DVZ_CULL_MARGIN);
+
+    DvzCullStats stats = dvz_panel_cull_stats(panel);
+    AT(stats.visual_count == 3);
+    AT(stats.culled_visuals == 1);
+    AT(!visual_small->culling->visible);
+    AT(visual_large->culling->visible);
+    uint8_t* rgb_culled = dvz_screenshot(canvas, false);
+
+    // The rendering is the same without culling.
+    dvz_panel_culling(panel, false);
+    dvz_app_run(app, 5);
+    uint8_t* rgb = dvz_screenshot(canvas, false);
+    uint32_t n_pixels = canvas->swapchain.images->width * canvas->swapchain.images->height;
+    AT(memcmp(rgb, rgb_culled, 3 * n_pixels) == 0);
+
+    FREE(rgb);
+    FREE(rgb_culled);
+    dvz_scene_destroy(scene);
+    TEST_END
+}
+
+
+
+/*************************************************************************************************/
+/*  Depth sort                                                                                   */
+/*************************************************************************************************/
+
+// Whether the visual has been sorted more than a given number of times.
+static bool _depth_sorted_more(DvzVisual* visual, uint64_t param)
+{
+    return visual->depth_sort != NULL && visual->depth_sort->stats.sort_count > param;
+}
+
+// Whether the primitives of the uploaded index buffer are sorted back to front.
+static bool _depth_sorted(DvzDepthSort* sort)
+{
+    uint32_t p = sort->primitive_size;
+    float z = -INFINITY, zk = 0;
+    float* c = NULL;
+    mat4 mv;
+    glm_mat4_copy(sort->mv, mv);
+    for (uint32_t k = 0; k < sort->primitive_count; k++)
+    {
+        c = sort->centers[sort->indices[p * k] / p];
+        zk = mv[0][2] * c[0] + mv[1][2] * c[1] + mv[2][2] * c[2] + mv[3][2];
+        if (zk < z)
+            return false;
+        z = zk;
+    }
+    return true;
+}
+
+int test_scene_depth_sort(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    DvzScene* scene = dvz_scene(canvas, 1, 1);
+    DvzPanel* panel = dvz_scene_panel(scene, 0, 0, DVZ_CONTROLLER_ARCBALL, 0);
+    DvzVisual* visual = dvz_scene_visual(panel, DVZ_VISUAL_MESH, 0);
+
+    // Triangles in two layers.
+    const uint32_t N = 1000;
+    uint32_t nv = 3 * N;
+    DvzGraphicsMeshVertex* vertices = calloc(nv, sizeof(DvzGraphicsMeshVertex));
+    _depth_vertices(N, vertices, true);
+    dvz_visual_data_source(visual, DVZ_SOURCE_TYPE_VERTEX, 0, 0, nv, nv, vertices);
+    dvz_visual_texture(visual, DVZ_SOURCE_TYPE_IMAGE, 0, gpu->context->color_texture.texture);
+    dvz_visual_depth_sort(visual, true);
+    AT(visual->depth_sort != NULL);
+
+    // The first sort is done from scratch, and replaces the index buffer once uploaded.
+    _wait_until(app, _depth_sorted_more, visual, 0);
+    DvzDepthSort* sort = visual->depth_sort;
+    DvzDepthSortStats stats = dvz_visual_depth_sort_stats(visual);
+    AT(sort->ready);
+    AT(sort->primitive_size == 3);
+    AT(stats.primitive_count == N);
+    AT(stats.sort_count >= 1);
+    AT(stats.full_count == 1);
+    AT(_depth_sorted(sort));
+
+    // The primitives are sorted again after a rotation.
+    dvz_arcball_rotate(panel, M_PI / 2, (vec3){0, 1, 0});
+    _wait_until(app, _depth_sorted_more, visual, stats.sort_count);
+    DvzDepthSortStats stats_rot = dvz_visual_depth_sort_stats(visual);
+    log_debug(
+        "%d sorts, %d full sorts, %d moves in %.3f ms", (int)stats_rot.sort_count,
+        (int)stats_rot.full_count, (int)stats_rot.moves, stats_rot.duration * 1000);
+    AT(stats_rot.sort_count > stats.sort_count);
+    AT(_depth_sorted(sort));
+
+    // The original index buffer is used again without the depth sort.
+    dvz_visual_depth_sort(visual, false);
+    AT(visual->depth_sort == NULL);
+    dvz_app_run(app, 5);
+
+    FREE(vertices);
+    dvz_scene_destroy(scene);
+    TEST_END
+}
+
+
+
+int test_scene_depth_sort_bench(TestContext* context)
+{
+    const uint32_t sizes[] = {10000, 100000, 1000000, 10000000};
+    const float angles[] = {.001, .01, .1, 1};
+    uint32_t n_sizes = getenv("DVZ_BENCH_LARGE") != NULL ? 4 : 3;
+
+    mat4 mv;
+    for (uint32_t i = 0; i < n_sizes; i++)
+    {
+        uint32_t n = sizes[i];
+        DvzDepthSort sort = {0};
+        sort.primitive_count = n;
+        sort.primitive_size = 1;
+        sort.centers = calloc(n, sizeof(vec3));
+        sort.order = calloc(n, sizeof(uint32_t));
+        sort.keys = calloc(n, sizeof(uint32_t));
+        sort.tmp_order = calloc(n, sizeof(uint32_t));
+        sort.tmp_keys = calloc(n, sizeof(uint32_t));
+        sort.sorted = calloc(n, sizeof(DvzIndex));
+        sort.indices = sort.sorted;
+        for (uint32_t k = 0; k < n; k++)
+        {
+            sort.centers[k][0] = dvz_rand_normal();
+            sort.centers[k][1] = dvz_rand_normal();
+            sort.centers[k][2] = dvz_rand_normal();
+            sort.order[k] = k;
+        }
+
+        // Sort from scratch.
+        glm_mat4_identity(mv);
+        glm_mat4_copy(mv, sort.mv);
+        _depth_sort_run(&sort, mv);
+        AT(sort.run_stats.full_count == 1);
+        AT(_depth_sorted(&sort));
+        log_info("%10d primitives: full sort in %.3f ms", n, sort.run_stats.duration * 1000);
+
+        // Sort again after rotations of increasing angles.
+        for (uint32_t k = 0; k < 4; k++)
+        {
+            glm_rotate_make(mv, angles[k], (vec3){0, 1, 0});
+            glm_mat4_copy(mv, sort.mv);
+            uint64_t full_count = sort.run_stats.full_count;
+            _depth_sort_run(&sort, mv);
+            AT(_depth_sorted(&sort));
+            log_info(
+                "    rotation %5.3f rad: %s sort, %d moves in %.3f ms", angles[k],
+                sort.run_stats.full_count > full_count ? "full" : "incremental",
+                (int)sort.run_stats.moves, sort.run_stats.duration * 1000);
+        }
+
+        FREE(sort.centers);
+        FREE(sort.order);
+        FREE(sort.keys);
+        FREE(sort.tmp_order);
+        FREE(sort.tmp_keys);
+        FREE(sort.sorted);
+    }
+    return 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  MVP uploads                                                                                  */
+/*************************************************************************************************/
+
+int test_scene_mvp(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    DvzCanvas* canvas = dvz_canvas(gpu, TEST_WIDTH, TEST_HEIGHT, 0);
+
+    // Grid of panels with a few points each.
+    const uint32_t n = 10;
+    DvzScene* scene = dvz_scene(canvas, n, n);
+    DvzPanel* panels[100] = {0};
+    DvzVisual* visual = NULL;
+    for (uint32_t i = 0; i < n * n; i++)
+    {
+        panels[i] = dvz_scene_panel(scene, i / n, i % n, DVZ_CONTROLLER_PANZOOM, 0);
+        visual = dvz_scene_visual(panels[i], DVZ_VISUAL_POINT, 0);
+        dvz_visual_data(visual, DVZ_PROP_POS, 0, 1, (dvec3[]){{0, 0, 0}});
+    }
+
+    // The MVP of every panel is uploaded once per swapchain image.
+    uint32_t img_count = canvas->swapchain.img_count;
+    dvz_app_run(app, img_count + 1);
+    DvzMVPStats stats = dvz_scene_mvp_stats(scene);
+    AT(stats.panel_count == n * n);
+    AT(stats.total_uploads == n * n * img_count);
+    AT(stats.total_bytes == n * n * img_count * panels[0]->br_mvp.size);
+
+    // Nothing is uploaded while the panels do not move.
+    uint64_t total = stats.total_uploads;
+    dvz_app_run(app, 10);
+    stats = dvz_scene_mvp_stats(scene);
+    AT(stats.uploads == 0);
+    AT(stats.bytes == 0);
+    AT(stats.total_uploads == total);
+
+    // Only the MVP of a zoomed panel is uploaded again.
+    _set_zoom(panels[0], 2);
+    dvz_app_run(app, img_count + 5);
+    stats = dvz_scene_mvp_stats(scene);
+    log_debug("%d MVP uploads, %d bytes", (int)stats.total_uploads, (int)stats.total_bytes);
+    AT(stats.uploads == 0);
+    AT(stats.total_uploads == total + img_count);
+
+    dvz_scene_destroy(scene);
+    TEST_END
+}
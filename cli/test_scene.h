@@ -18,6 +18,18 @@ int test_scene_1(TestContext* context);
 int test_scene_mesh(TestContext* context);
 int test_scene_axes(TestContext* context);
 int test_scene_logistic(TestContext* context);
+int test_scene_lod(TestContext* context);
+int test_scene_lod_bench(TestContext* context);
+int test_scene_pick(TestContext* context);
+int test_scene_tiles(TestContext* context);
+int test_scene_bricks(TestContext* context);
+int test_scene_mesh_lod(TestContext* context);
+int test_scene_instanced(TestContext* context);
+int test_scene_culling(TestContext* context);
+int test_scene_culling_margin(TestContext* context);
+int test_scene_depth_sort(TestContext* context);
+int test_scene_depth_sort_bench(TestContext* context);
+int test_scene_mvp(TestContext* context);
 
 
 
@@ -330,6 +330,92 @@ int test_vklite_push(TestContext* context)
 
 
 
+int test_vklite_bindings(TestContext* context)
+{
+    DvzApp* app = dvz_app(DVZ_BACKEND_OFFSCREEN);
+    DvzGpu* gpu = dvz_gpu(app, 0);
+    dvz_gpu_queue(gpu, 0, DVZ_QUEUE_RENDER);
+    dvz_gpu_create(gpu, 0);
+
+    DvzBuffer buffer = dvz_buffer(gpu);
+    const VkDeviceSize size = 256;
+    dvz_buffer_size(&buffer, 2 * size);
+    dvz_buffer_usage(&buffer, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+    dvz_buffer_memory(
+        &buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    dvz_buffer_queue_access(&buffer, 0);
+    dvz_buffer_create(&buffer);
+    DvzBufferRegions br0 = {.buffer = &buffer, .size = size, .count = 1};
+    DvzBufferRegions br1 = {.buffer = &buffer, .size = size, .count = 1, .offsets = {size}};
+
+    // Two slots, three descriptor sets.
+    DvzSlots slots = dvz_slots(gpu);
+    dvz_slots_binding(&slots, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    dvz_slots_binding(&slots, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    dvz_slots_create(&slots);
+    DvzBindingsStats s0 = dvz_bindings_stats(gpu);
+
+    // First update: all descriptors are written.
+    DvzBindings bindings1 = dvz_bindings(&slots, 3);
+    dvz_bindings_buffer(&bindings1, 0, br0);
+    dvz_bindings_buffer(&bindings1, 1, br1);
+    dvz_bindings_update(&bindings1);
+    DvzBindingsStats stats = dvz_bindings_stats(gpu);
+    AT(stats.writes - s0.writes == 6);
+    AT(stats.misses - s0.misses == 1);
+
+    // Nothing is written again when the resources have not changed.
+    dvz_bindings_update(&bindings1);
+    stats = dvz_bindings_stats(gpu);
+    AT(stats.writes - s0.writes == 6);
+    AT(stats.skipped - s0.skipped == 6);
+
+    // Bindings with the same resources share the descriptor sets.
+    DvzBindings bindings2 = dvz_bindings(&slots, 3);
+    dvz_bindings_buffer(&bindings2, 0, br0);
+    dvz_bindings_buffer(&bindings2, 1, br1);
+    dvz_bindings_update(&bindings2);
+    stats = dvz_bindings_stats(gpu);
+    AT(stats.hits - s0.hits == 1);
+    AT(stats.writes - s0.writes == 6);
+    AT(bindings2.dsets[0] == bindings1.dsets[0]);
+    AT(bindings1.entry->ref_count == 2);
+
+    // Changing a slot of shared bindings gives them their own descriptor sets again.
+    dvz_bindings_buffer(&bindings2, 1, br0);
+    dvz_bindings_update(&bindings2);
+    stats = dvz_bindings_stats(gpu);
+    AT(bindings2.dsets[0] != bindings1.dsets[0]);
+    AT(bindings1.entry->ref_count == 1);
+    AT(stats.writes - s0.writes == 12);
+
+    // Only the changed slot is written, on every descriptor set.
+    dvz_bindings_buffer(&bindings1, 0, br1);
+    dvz_bindings_update(&bindings1);
+    stats = dvz_bindings_stats(gpu);
+    AT(stats.writes - s0.writes == 15);
+    AT(stats.misses - s0.misses == 3);
+
+    // The descriptor sets of destroyed bindings are reused once no command buffer uses them.
+    uint32_t dset_count = stats.dset_count;
+    dvz_bindings_destroy(&bindings2);
+    dvz_bindings_retire(gpu, gpu->bindings_cache.serial);
+    DvzBindings bindings3 = dvz_bindings(&slots, 3);
+    AT(dvz_bindings_stats(gpu).dset_count == dset_count);
+    log_debug(
+        "%d descriptor writes, %d skipped, %d cache hits", (int)stats.writes, (int)stats.skipped,
+        (int)stats.hits);
+
+    dvz_bindings_destroy(&bindings1);
+    dvz_bindings_destroy(&bindings3);
+    dvz_slots_destroy(&slots);
+    dvz_buffer_destroy(&buffer);
+
+    TEST_END
+}
+
+
+
 int test_vklite_images(TestContext* context)
 {
     DvzApp* app = dvz_app(DVZ_BACKEND_GLFW);
@@ -676,6 +762,71 @@ int test_shader_compile(TestContext* context)
 
 
 
+int test_spirv_cache(TestContext* context)
+{
+    const char* code = "#version 450\n"
+                       "layout (location = 0) in vec3 pos;\n"
+                       "void main() {\n"
+                       "    gl_Position = vec4(pos, 1.0);\n"
+                       "}";
+
+    // Disk cache in the artifacts directory, which may already contain the shader.
+    char dir[1024];
+    snprintf(dir, sizeof(dir), "%s/spirv_cache", ARTIFACTS_DIR);
+    dvz_spirv_cache_dir(dir);
+    dvz_spirv_cache_clear();
+
+    size_t size = 0;
+    const uint32_t* spirv = dvz_spirv_compile(code, VK_SHADER_STAGE_VERTEX_BIT, &size);
+    DvzSpirvStats stats = dvz_spirv_stats();
+
+#if HAS_GLSLANG
+    AT(spirv != NULL);
+    AT(size > 0 && size % 4 == 0);
+    AT(spirv[0] == 0x07230203);
+    AT(stats.entry_count == 1);
+    AT(stats.compile_count + stats.disk_hit_count == 1);
+    uint32_t* expected = calloc(size, 1);
+    memcpy(expected, spirv, size);
+
+    // The second compilation is found in the memory cache.
+    size_t size_hit = 0;
+    AT(dvz_spirv_compile(code, VK_SHADER_STAGE_VERTEX_BIT, &size_hit) == spirv);
+    AT(size_hit == size);
+    stats = dvz_spirv_stats();
+    AT(stats.hit_count == 1);
+    AT(stats.entry_count == 1);
+
+    // The compiled shader is then found in the disk cache.
+    dvz_spirv_cache_clear();
+    spirv = dvz_spirv_compile(code, VK_SHADER_STAGE_VERTEX_BIT, &size_hit);
+    stats = dvz_spirv_stats();
+    AT(stats.disk_hit_count == 1);
+    AT(stats.compile_count == 0);
+    AT(size_hit == size);
+    AT(memcmp(spirv, expected, size) == 0);
+    FREE(expected);
+
+    // Failed compilations are not cached.
+    AT(dvz_spirv_compile("void main() {", VK_SHADER_STAGE_VERTEX_BIT, &size) == NULL);
+    AT(size == 0);
+    stats = dvz_spirv_stats();
+    AT(stats.failure_count == 1);
+    AT(stats.entry_count == 1);
+#else
+    AT(spirv == NULL);
+    AT(size == 0);
+    AT(stats.failure_count == 1);
+    AT(stats.entry_count == 0);
+#endif
+
+    dvz_spirv_cache_dir(NULL);
+    dvz_spirv_cache_clear();
+    return 0;
+}
+
+
+
 /*************************************************************************************************/
 /*  FIFO queue                                                                                   */
 /*************************************************************************************************/
@@ -773,6 +924,26 @@ int test_fifo_2(TestContext* context)
     }
     AT(fifo.is_empty);
     dvz_fifo_destroy(&fifo);
+
+    // Enlarge the queue when it wraps around: the order of the items is kept.
+    fifo = dvz_fifo(8);
+    for (uint32_t i = 0; i < 4; i++)
+        dvz_fifo_enqueue(&fifo, &numbers[0]);
+    for (uint32_t i = 0; i < 4; i++)
+        dvz_fifo_dequeue(&fifo, false);
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        dvz_fifo_enqueue(&fifo, &numbers[i]);
+        AT(dvz_fifo_size(&fifo) == (int)i + 1);
+    }
+    AT(fifo.capacity > 8);
+    for (uint32_t i = 0; i < 32; i++)
+    {
+        res = dvz_fifo_dequeue(&fifo, false);
+        AT(res != NULL && *res == i);
+    }
+    AT(dvz_fifo_dequeue(&fifo, false) == NULL);
+    dvz_fifo_destroy(&fifo);
     return 0;
 }
 
@@ -19,6 +19,7 @@ int test_vklite_buffer_1(TestContext* context);
 int test_vklite_buffer_resize(TestContext* context);
 int test_vklite_compute(TestContext* context);
 int test_vklite_push(TestContext* context);
+int test_vklite_bindings(TestContext* context);
 int test_vklite_images(TestContext* context);
 int test_vklite_sampler(TestContext* context);
 int test_vklite_barrier(TestContext* context);
@@ -29,6 +30,7 @@ int test_vklite_graphics(TestContext* context);
 int test_basic_canvas_1(TestContext* context);
 int test_basic_canvas_triangle(TestContext* context);
 int test_shader_compile(TestContext* context);
+int test_spirv_cache(TestContext* context);
 
 
 /*************************************************************************************************/
@@ -104,6 +104,9 @@ struct DvzApp
     DvzClock clock;
     bool is_running;
 
+    // Whether offscreen canvases prepare and submit their frames in parallel worker threads.
+    bool parallel;
+
     // Vulkan objects.
     VkInstance instance;
     VkDebugUtilsMessengerEXT debug_messenger;
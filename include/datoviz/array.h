@@ -98,6 +98,14 @@ struct DvzArray
     // 3D arrays
     uint32_t ndims; // 1, 2, or 3
     uvec3 shape;    // only for 3D arrays
+
+    // Memory-mapped file holding the data, if any
+    void* mapping;
+    size_t mapping_size;
+
+    // Whether the data buffer belongs to the caller: it is never freed, and it is copied before
+    // the array is modified
+    bool borrowed;
 };
 
 
@@ -287,6 +295,9 @@ static DvzArray dvz_array_copy(DvzArray* arr)
     DvzArray arr_new = *arr; // struct copy
     arr_new.data = malloc(arr->buffer_size);
     memcpy(arr_new.data, arr->data, arr->buffer_size);
+    arr_new.mapping = NULL;
+    arr_new.mapping_size = 0;
+    arr_new.borrowed = false;
     return arr_new;
 }
 
@@ -331,6 +342,170 @@ static DvzArray dvz_array_wrap(uint32_t item_count, DvzDataType dtype, void* dat
 
 
 
+// Forget a borrowed buffer that is about to be entirely overwritten.
+static void _array_release(DvzArray* array)
+{
+    ASSERT(array != NULL);
+    if (!array->borrowed)
+        return;
+    array->data = NULL;
+    array->item_count = 0;
+    array->buffer_size = 0;
+    array->borrowed = false;
+}
+
+
+
+// Copy a borrowed buffer to the heap before the array is modified.
+static void _array_own(DvzArray* array)
+{
+    ASSERT(array != NULL);
+    if (!array->borrowed)
+        return;
+    log_trace("copy borrowed array before modifying it");
+    void* data = malloc(array->buffer_size);
+    ASSERT(data != NULL);
+    memcpy(data, array->data, array->buffer_size);
+    array->data = data;
+    array->borrowed = false;
+}
+
+
+
+// Scalar dtype corresponding to a NumPy dtype. There is no scalar dtype for int8, int64 and
+// uint64, these NumPy dtypes are not supported.
+static DvzDataType _npy_dtype(DvzNpyHeader* header)
+{
+    ASSERT(header != NULL);
+    switch (header->kind)
+    {
+    case 'b':
+    case 'u':
+        return header->item_size == 1   ? DVZ_DTYPE_CHAR
+               : header->item_size == 2 ? DVZ_DTYPE_USHORT
+               : header->item_size == 4 ? DVZ_DTYPE_UINT
+                                        : DVZ_DTYPE_NONE;
+    case 'i':
+        return header->item_size == 2   ? DVZ_DTYPE_SHORT
+               : header->item_size == 4 ? DVZ_DTYPE_INT
+                                        : DVZ_DTYPE_NONE;
+    case 'f':
+        return header->item_size == 4   ? DVZ_DTYPE_FLOAT
+               : header->item_size == 8 ? DVZ_DTYPE_DOUBLE
+                                        : DVZ_DTYPE_NONE;
+    default:
+        break;
+    }
+    return DVZ_DTYPE_NONE;
+}
+
+
+
+/**
+ * Load a NumPy NPY file into an array, without copy.
+ *
+ * The file is mapped in memory and the array wraps the mapped data buffer, so that even very
+ * large files can be passed to `dvz_visual_data()` or uploaded to the GPU without loading them
+ * entirely in memory. The data type is inferred from the NPY header:
+ *
+ * * `(N,)`: 1D array of N scalars,
+ * * `(N, k)` with `k <= 4`: 1D array of N vectors (for example `vec3` for float32),
+ * * `(H, W)` with `W > 4`: 2D array of scalars,
+ * * `(H, W, k)` with `k <= 4`: 2D array of vectors (for example an RGBA image),
+ * * `(D, H, W)`: 3D array of scalars (volume).
+ *
+ * The supported NumPy dtypes are bool, uint8, uint16, uint32, int16, int32, float32 and float64,
+ * in little-endian order. Other dtypes (int8, int64, uint64...) are rejected with an error and
+ * must be converted before saving the file.
+ *
+ * Destroying the array unmaps the file.
+ *
+ * @param filename path to the NPY file
+ * @returns the array, or an empty array if the file could not be loaded
+ */
+static DvzArray dvz_array_npy(const char* filename)
+{
+    ASSERT(filename != NULL);
+    DvzArray arr = {0};
+
+    size_t size = 0;
+    void* mapping = dvz_file_map(filename, &size);
+    if (mapping == NULL)
+        return arr;
+
+    DvzNpyHeader header = {0};
+    if (dvz_npy_header(mapping, size, &header) != 0)
+        goto error;
+    if (header.data_offset + header.item_count * header.item_size > size)
+    {
+        log_error("NPY file is shorter than the size declared in its header");
+        goto error;
+    }
+    if (header.fortran_order && header.ndims > 1)
+    {
+        log_error("Fortran-ordered NPY arrays are not supported");
+        goto error;
+    }
+
+    DvzDataType dtype = _npy_dtype(&header);
+    if (dtype == DVZ_DTYPE_NONE)
+    {
+        log_error(
+            "unsupported NPY dtype '%s' in %s, supported dtypes are bool, uint8, uint16, uint32, "
+            "int16, int32, float32 and float64",
+            header.descr, filename);
+        goto error;
+    }
+
+    // Vector dtype when the last dimension is small.
+    uint32_t ndims = header.ndims;
+    uint64_t* shape = header.shape;
+    uint32_t components = 1;
+    if (ndims >= 2 && shape[ndims - 1] >= 1 && shape[ndims - 1] <= 4)
+    {
+        components = (uint32_t)shape[ndims - 1];
+        ndims--;
+    }
+    if (ndims > 3)
+    {
+        log_error("NPY arrays with more than 3 dimensions are not supported");
+        goto error;
+    }
+    // NOTE: the vector dtypes follow the scalar dtype in the DvzDataType enum.
+    dtype = (DvzDataType)(dtype + components - 1);
+
+    uint64_t item_count = header.item_count / components;
+    if (item_count > UINT32_MAX)
+    {
+        log_error("too many items in NPY array");
+        goto error;
+    }
+
+    arr = dvz_array_wrap((uint32_t)item_count, dtype, (char*)mapping + header.data_offset);
+    ASSERT(arr.buffer_size == header.item_count * header.item_size);
+    arr.mapping = mapping;
+    arr.mapping_size = size;
+
+    // Shape of 2D and 3D arrays, in the (width, height, depth) order.
+    if (ndims >= 2)
+    {
+        arr.ndims = ndims;
+        for (uint32_t i = 0; i < 3; i++)
+            arr.shape[i] = i < ndims ? (uint32_t)shape[ndims - 1 - i] : 1;
+    }
+    log_debug(
+        "loaded NPY file %s with %d items of dtype %s (%s)", filename, arr.item_count,
+        header.descr, pretty_size(arr.buffer_size));
+    return arr;
+
+error:
+    log_error("unable to load the NPY file %s", filename);
+    dvz_file_unmap(mapping, size);
+    return arr;
+}
+
+
+
 /**
  * Create a 1D record array with heterogeneous data type.
  *
@@ -441,6 +616,21 @@ static void dvz_array_resize(DvzArray* array, uint32_t item_count)
     VkDeviceSize new_size = item_count * array->item_size;
     ASSERT(array->data != NULL);
 
+    // A borrowed or memory-mapped array cannot be reallocated, its data is first copied to the
+    // heap.
+    if (new_size > old_size)
+        _array_own(array);
+    if (new_size > old_size && array->mapping != NULL)
+    {
+        log_debug("copy memory-mapped array before resizing it");
+        void* data = malloc(old_size);
+        memcpy(data, array->data, old_size);
+        dvz_file_unmap(array->mapping, array->mapping_size);
+        array->mapping = NULL;
+        array->mapping_size = 0;
+        array->data = data;
+    }
+
     // Only reallocate if the existing buffer is not large enough for the new item_count.
     if (new_size > old_size)
     {
@@ -470,6 +660,7 @@ static void dvz_array_resize(DvzArray* array, uint32_t item_count)
 static void dvz_array_clear(DvzArray* array)
 {
     ASSERT(array != NULL);
+    _array_own(array);
     memset(array->data, 0, array->buffer_size);
 }
 
@@ -617,6 +808,9 @@ static void dvz_array_data(
     ASSERT(item_count > 0);
 
     // Resize if necessary.
+    if (first_item == 0 && item_count >= array->item_count)
+        _array_release(array);
+    _array_own(array);
     if (first_item + item_count > array->item_count)
     {
         dvz_array_resize(array, first_item + item_count);
@@ -727,6 +921,7 @@ static void dvz_array_column(
     ASSERT(data != NULL);
     ASSERT(item_count > 0);
     ASSERT(first_item + item_count <= array->item_count);
+    _array_own(array);
 
     VkDeviceSize src_offset = 0;
     VkDeviceSize src_stride = col_size;
@@ -808,7 +1003,8 @@ static void dvz_array_print(DvzArray* array)
 /**
  * Destroy an array.
  *
- * This function frees the allocated underlying data buffer.
+ * This function frees the allocated underlying data buffer, or unmaps the file for memory-mapped
+ * arrays.
  *
  * @param array the array to destroy
  */
@@ -818,9 +1014,164 @@ static void dvz_array_destroy(DvzArray* array)
     if (!dvz_obj_is_created(&array->obj))
         return;
     dvz_obj_destroyed(&array->obj);
+    if (array->mapping != NULL)
+    {
+        dvz_file_unmap(array->mapping, array->mapping_size);
+        array->mapping = NULL;
+        array->data = NULL;
+    }
+    if (array->borrowed)
+    {
+        array->borrowed = false;
+        array->data = NULL;
+    }
     FREE(array->data) //
 }
 
 
 
+/**
+ * Make an array reference a buffer owned by the caller, without copying it.
+ *
+ * The previous data of the array is freed. The buffer must remain valid until the array is
+ * destroyed or modified: the array copies it before any modification, and never frees it.
+ *
+ * @param array the array
+ * @param item_count number of elements in the passed buffer
+ * @param data the buffer
+ */
+static void dvz_array_borrow(DvzArray* array, uint32_t item_count, void* data)
+{
+    ASSERT(array != NULL);
+    ASSERT(data != NULL || item_count == 0);
+    DvzDataType dtype = array->dtype;
+    VkDeviceSize item_size = array->item_size;
+    ASSERT(item_size > 0);
+
+    dvz_array_destroy(array);
+    *array = _create_array(0, dtype, item_size);
+    array->item_count = item_count;
+    array->buffer_size = item_count * item_size;
+    array->data = data;
+    array->borrowed = data != NULL;
+}
+
+
+
+// Scalar dtype of the components of a dtype, for example DVZ_DTYPE_FLOAT for DVZ_DTYPE_VEC3.
+static DvzDataType _get_scalar_dtype(DvzDataType dtype)
+{
+    if (dtype < DVZ_DTYPE_CHAR || dtype > DVZ_DTYPE_DVEC4)
+        return DVZ_DTYPE_NONE;
+    return (DvzDataType)(DVZ_DTYPE_CHAR + 4 * ((dtype - DVZ_DTYPE_CHAR) / 4));
+}
+
+
+
+#define _SCALARS_READ(T)                                                                          \
+    for (uint32_t i = 0; i < count; i++)                                                          \
+        out[i] = (double)((const T*)src)[i];
+
+#define _SCALARS_WRITE(T)                                                                         \
+    for (uint32_t i = 0; i < count; i++)                                                          \
+        ((T*)dst)[i] = (T)values[i];
+
+static void _scalars_read(DvzDataType scalar, uint32_t count, const void* src, double* out)
+{
+    switch (scalar)
+    {
+    case DVZ_DTYPE_CHAR:
+        _SCALARS_READ(uint8_t) break;
+    case DVZ_DTYPE_USHORT:
+        _SCALARS_READ(uint16_t) break;
+    case DVZ_DTYPE_SHORT:
+        _SCALARS_READ(int16_t) break;
+    case DVZ_DTYPE_UINT:
+        _SCALARS_READ(uint32_t) break;
+    case DVZ_DTYPE_INT:
+        _SCALARS_READ(int32_t) break;
+    case DVZ_DTYPE_FLOAT:
+        _SCALARS_READ(float) break;
+    case DVZ_DTYPE_DOUBLE:
+        _SCALARS_READ(double) break;
+    default:
+        break;
+    }
+}
+
+static void _scalars_write(DvzDataType scalar, uint32_t count, const double* values, void* dst)
+{
+    switch (scalar)
+    {
+    case DVZ_DTYPE_CHAR:
+        _SCALARS_WRITE(uint8_t) break;
+    case DVZ_DTYPE_USHORT:
+        _SCALARS_WRITE(uint16_t) break;
+    case DVZ_DTYPE_SHORT:
+        _SCALARS_WRITE(int16_t) break;
+    case DVZ_DTYPE_UINT:
+        _SCALARS_WRITE(uint32_t) break;
+    case DVZ_DTYPE_INT:
+        _SCALARS_WRITE(int32_t) break;
+    case DVZ_DTYPE_FLOAT:
+        _SCALARS_WRITE(float) break;
+    case DVZ_DTYPE_DOUBLE:
+        _SCALARS_WRITE(double) break;
+    default:
+        break;
+    }
+}
+
+
+
+/**
+ * Set the data of an array from a buffer of another dtype, converting every component.
+ *
+ * Both dtypes must have the same number of components, for example `DVZ_DTYPE_DVEC3` and
+ * `DVZ_DTYPE_VEC3`. The values must be representable in the dtype of the array.
+ *
+ * @param array the array
+ * @param item_count the number of elements in the buffer
+ * @param source_dtype the dtype of the buffer
+ * @param data the buffer
+ * @returns 0 on success, 1 if the dtypes are incompatible
+ */
+static int dvz_array_convert(
+    DvzArray* array, uint32_t item_count, DvzDataType source_dtype, const void* data)
+{
+    ASSERT(array != NULL);
+    ASSERT(item_count > 0);
+    ASSERT(data != NULL);
+
+    DvzDataType src_scalar = _get_scalar_dtype(source_dtype);
+    DvzDataType dst_scalar = _get_scalar_dtype(array->dtype);
+    uint32_t components = _get_components(array->dtype);
+    if (src_scalar == DVZ_DTYPE_NONE || dst_scalar == DVZ_DTYPE_NONE ||
+        components != _get_components(source_dtype))
+    {
+        log_error("cannot convert an array from dtype %d to %d", source_dtype, array->dtype);
+        return 1;
+    }
+
+    // The whole array is overwritten.
+    _array_release(array);
+    dvz_array_resize(array, item_count);
+
+    // Convert the components by blocks, through doubles.
+    uint64_t count = (uint64_t)item_count * components;
+    VkDeviceSize src_size = _get_dtype_size(src_scalar);
+    VkDeviceSize dst_size = _get_dtype_size(dst_scalar);
+    double values[256];
+    uint32_t n = 0;
+    for (uint64_t i = 0; i < count; i += 256)
+    {
+        n = (uint32_t)MIN(256, count - i);
+        _scalars_read(src_scalar, n, (const char*)data + i * src_size, values);
+        _scalars_write(dst_scalar, n, values, (char*)array->data + i * dst_size);
+    }
+    return 0;
+}
+
+
+
 #endif
@@ -107,6 +107,107 @@ typedef enum
  */
 DVZ_EXPORT void dvz_visual_builtin(DvzVisual* visual, DvzVisualType type, int flags);
 
+/**
+ * Enable or disable the level of detail of a line strip or path visual.
+ *
+ * When enabled, a min/max pyramid of the samples is built once per POS prop update, and only the
+ * slice of the samples visible in the panel is uploaded, decimated to at most a few vertices per
+ * pixel column. The slice is updated when panning and zooming. The x values must be increasing
+ * (time series), and the visual must have a single line strip or path.
+ *
+ * @param visual the visual
+ * @param enable whether to enable the level of detail
+ */
+DVZ_EXPORT void dvz_visual_lod(DvzVisual* visual, bool enable);
+
+/**
+ * Display a large image as a tiled multi-resolution pyramid in an image visual.
+ *
+ * Only the tiles that are visible in the panel, at the resolution matching the screen, are decoded
+ * on worker threads and uploaded to an atlas texture of the given memory budget, which keeps the
+ * most recently used tiles. The image covers the rectangle between the top left and bottom right
+ * corners of the first image of the visual (`DVZ_PROP_POS` #0 and #2), the other props are
+ * ignored.
+ *
+ * The callback is called on worker threads and must be thread-safe. If it is NULL, the user data
+ * must point to the full resolution image, which must remain valid while the visual exists.
+ *
+ * @param visual the image or image_cmap visual
+ * @param size the width and height of the full resolution image, in pixels
+ * @param tile_size the width and height of the tiles, in pixels
+ * @param format the format of the pixels
+ * @param budget the size of the atlas texture, in bytes (0 for the default)
+ * @param callback the function decoding a tile, or NULL
+ * @param user_data the user data passed to the callback
+ */
+DVZ_EXPORT void dvz_visual_tiles(
+    DvzVisual* visual, uvec2 size, uint32_t tile_size, VkFormat format, VkDeviceSize budget,
+    DvzTileCallback callback, void* user_data);
+
+/**
+ * Get the tile cache counters of a tiled image visual.
+ *
+ * @param visual the visual
+ * @returns the number of hits, misses, uploads, and evictions, and the number of resident tiles
+ */
+DVZ_EXPORT DvzTileStats dvz_visual_tiles_stats(DvzVisual* visual);
+
+/**
+ * Display a large 3D volume as a bricked multi-resolution pyramid in a volume visual.
+ *
+ * The visual must be created with the `DVZ_GRAPHICS_FLAGS_VOLUME_BRICKED` flag. The coarser levels
+ * and the minimum and maximum values of the bricks are computed in parallel when this function is
+ * called. The non-empty bricks in the view, at the resolution matching the screen, are then
+ * streamed to an atlas texture of the given memory budget, which keeps the most recently used
+ * bricks. Bricks whose voxels are all zero are never uploaded and are skipped by the ray marching.
+ *
+ * The volume may be a memory-mapped file; it must remain valid while the visual exists.
+ *
+ * @param visual the volume visual
+ * @param shape the number of voxels along the x, y, z axes
+ * @param brick_size the number of voxels along each axis of a brick
+ * @param format the format of the voxels, `VK_FORMAT_R8_UNORM` or `VK_FORMAT_R16_UNORM`
+ * @param budget the size of the atlas texture, in bytes (0 for the default)
+ * @param data the full resolution volume, x varying fastest
+ */
+DVZ_EXPORT void dvz_visual_bricks(
+    DvzVisual* visual, uvec3 shape, uint32_t brick_size, VkFormat format, VkDeviceSize budget,
+    const void* data);
+
+/**
+ * Get the brick cache counters of a bricked volume visual.
+ *
+ * @param visual the visual
+ * @returns the cache counters, and the number of visible, empty, and culled bricks in the view
+ */
+DVZ_EXPORT DvzBrickStats dvz_visual_bricks_stats(DvzVisual* visual);
+
+/**
+ * Display a mesh with levels of detail in a mesh visual.
+ *
+ * The mesh is uploaded right away, and simplified with quadric error metrics on a worker thread,
+ * which never blocks the frame loop. The simplified levels are then stored after the original
+ * faces in the index buffer of the visual, sharing its vertex buffer. At every frame, the
+ * coarsest level whose geometric error, projected with the MVP of the panel, is below a pixel is
+ * drawn.
+ *
+ * The mesh is copied and may be destroyed after this call.
+ *
+ * @param visual the mesh visual
+ * @param mesh the mesh
+ * @param level_count the maximum number of levels, including the original mesh (0 for the
+ *      default)
+ */
+DVZ_EXPORT void dvz_visual_mesh_lod(DvzVisual* visual, DvzMesh* mesh, uint32_t level_count);
+
+/**
+ * Get the level of detail counters of a mesh visual.
+ *
+ * @param visual the visual
+ * @returns the selected level, the number of levels and of faces drawn, and the projected size
+ */
+DVZ_EXPORT DvzMeshLevelStats dvz_visual_mesh_lod_stats(DvzVisual* visual);
+
 
 
 /*************************************************************************************************/
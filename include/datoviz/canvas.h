@@ -38,9 +38,14 @@ extern "C" {
 #define DVZ_SEMAPHORE_RENDER_FINISHED 1
 #define DVZ_FENCE_RENDER_FINISHED     0
 #define DVZ_FENCES_FLIGHT             1
+#define DVZ_BATCH_MAX_WORKERS         16
+#define DVZ_VIDEO_FRAME_COUNT         4
+#define DVZ_VIDEO_MAX_FRAMES          16
 #define DVZ_DEFAULT_COMMANDS_TRANSFER 0
 #define DVZ_DEFAULT_COMMANDS_RENDER   1
 #define DVZ_MAX_FRAMES_IN_FLIGHT      2
+#define DVZ_PICK_FORMAT               VK_FORMAT_R32G32_UINT
+#define DVZ_PICK_MAX_SIZE             64
 
 
 
@@ -54,6 +59,7 @@ typedef enum
     DVZ_CANVAS_FLAGS_NONE = 0x0000,
     DVZ_CANVAS_FLAGS_IMGUI = 0x0001,
     DVZ_CANVAS_FLAGS_FPS = 0x0003, // NOTE: 1 bit for ImGUI, 1 bit for FPS
+    DVZ_CANVAS_FLAGS_PICK = 0x0010, // ID buffer for GPU picking
 
     DVZ_CANVAS_FLAGS_DPI_SCALE_050 = 0x1000,
     DVZ_CANVAS_FLAGS_DPI_SCALE_100 = 0x2000,
@@ -156,6 +162,27 @@ typedef enum
 
 
 
+// Video encoding policy when all frames of the pool are waiting to be encoded.
+typedef enum
+{
+    DVZ_VIDEO_POLICY_BLOCK,     // the render thread waits for a free frame
+    DVZ_VIDEO_POLICY_DROP,      // the frame is dropped
+    DVZ_VIDEO_POLICY_DOWNSCALE, // the frame is queued at half resolution, or dropped
+} DvzVideoPolicy;
+
+
+
+// GPU picking status.
+typedef enum
+{
+    DVZ_PICK_NONE,
+    DVZ_PICK_IDLE,
+    DVZ_PICK_REQUESTED,
+    DVZ_PICK_AWAIT_TRANSFER,
+} DvzPickStatus;
+
+
+
 /*************************************************************************************************/
 /*  Event system                                                                                 */
 /*************************************************************************************************/
@@ -192,6 +219,7 @@ typedef enum
     DVZ_EVENT_PRE_SEND,           // called before sending the commands buffers
     DVZ_EVENT_POST_SEND,          // called after sending the commands buffers
     DVZ_EVENT_DESTROY,            // called before destruction
+    DVZ_EVENT_PICK,               // called when a GPU picking rectangle has been downloaded
 } DvzEventType;
 
 
@@ -205,6 +233,15 @@ typedef enum
 
 
 
+// Coalescing policy of the mouse move and wheel events
+typedef enum
+{
+    DVZ_EVENT_COALESCE_NONE,  // every event is emitted right away
+    DVZ_EVENT_COALESCE_FRAME, // consecutive events are merged until the next frame or other event
+} DvzEventCoalesce;
+
+
+
 // Key modifiers
 // NOTE: must match GLFW values! no mapping is done for now
 typedef enum
@@ -247,6 +284,7 @@ typedef struct DvzMouseClickEvent DvzMouseClickEvent;
 typedef struct DvzMouseDragEvent DvzMouseDragEvent;
 typedef struct DvzMouseMoveEvent DvzMouseMoveEvent;
 typedef struct DvzMouseWheelEvent DvzMouseWheelEvent;
+typedef struct DvzPickEvent DvzPickEvent;
 typedef struct DvzRefillEvent DvzRefillEvent;
 typedef struct DvzResizeEvent DvzResizeEvent;
 typedef struct DvzScreencastEvent DvzScreencastEvent;
@@ -258,9 +296,21 @@ typedef union DvzEventUnion DvzEventUnion;
 
 typedef void (*DvzEventCallback)(DvzCanvas*, DvzEvent);
 typedef struct DvzEventCallbackRegister DvzEventCallbackRegister;
+typedef struct DvzEventCoalescer DvzEventCoalescer;
 
 typedef struct DvzScreencast DvzScreencast;
+typedef struct DvzPickBuffer DvzPickBuffer;
+typedef struct DvzBatch DvzBatch;
+typedef struct DvzBatchJob DvzBatchJob;
+typedef struct DvzBatchTask DvzBatchTask;
+typedef struct DvzBatchStats DvzBatchStats;
+typedef void (*DvzBatchCallback)(DvzCanvas*, uint32_t job_idx, void* user_data);
 typedef struct DvzPendingRefill DvzPendingRefill;
+typedef struct DvzVideoEncoder DvzVideoEncoder;
+typedef struct DvzVideoFrame DvzVideoFrame;
+typedef struct DvzVideoStats DvzVideoStats;
+typedef void (*DvzVideoCallback)(
+    DvzCanvas*, uint64_t idx, uint32_t width, uint32_t height, uint8_t* rgba, void* user_data);
 
 // Forward declarations.
 typedef struct DvzGui DvzGui;
@@ -341,6 +391,9 @@ struct DvzViewport
     // Used to discard transform on one axis
     int32_t interact_axis;
 
+    // Visual id written in the ID buffer for GPU picking
+    uint32_t pick_id;
+
     // TODO: aspect ratio
 };
 
@@ -431,6 +484,17 @@ struct DvzScreencastEvent
 
 
 
+struct DvzPickEvent
+{
+    uvec2 pos;          // top-left corner of the rectangle, in framebuffer pixels
+    uvec2 size;         // size of the rectangle, in framebuffer pixels
+    uint32_t visual_id; // visual id of the hit closest to the center (0 if none)
+    uint32_t item_id;   // item id of the hit closest to the center
+    const uvec2* ids;   // (visual id, item id) of every pixel, valid until the next PICK event
+};
+
+
+
 struct DvzRefillEvent
 {
     uint32_t img_idx;
@@ -478,6 +542,7 @@ union DvzEventUnion
     DvzRefillEvent rf;     // for REFILL events
     DvzResizeEvent r;      // for RESIZE events
     DvzScreencastEvent sc; // for SCREENCAST events
+    DvzPickEvent p;        // for PICK events
     DvzSubmitEvent s;      // for SUBMIT events
     DvzGuiEvent g;         // for GUI events
 };
@@ -505,6 +570,17 @@ struct DvzEventCallbackRegister
 
 
 
+struct DvzEventCoalescer
+{
+    DvzEventCoalesce policy;
+    DvzEvent move;      // pending mouse move event with the last position, if any
+    DvzEvent wheel;     // pending mouse wheel event with the accumulated deltas, if any
+    bool wheel_first;   // whether the pending wheel event started before the pending move event
+    uint64_t coalesced; // number of events merged into a pending event
+};
+
+
+
 /*************************************************************************************************/
 /*  Misc structs                                                                                 */
 /*************************************************************************************************/
@@ -529,10 +605,139 @@ struct DvzScreencast
 
 
 
+struct DvzPickBuffer
+{
+    DvzImages image;     // ID buffer, second color attachment of the default renderpass
+    DvzBuffer staging;   // host-visible buffer receiving the picking rectangle
+    DvzCommands cmds;    // copy commands
+    DvzFences fence;     // signaled when the copy has completed
+    DvzPickStatus status;
+    uvec2 pos;
+    uvec2 size;
+    uvec2* ids;
+};
+
+
+
+struct DvzBatchJob
+{
+    DvzBatchCallback callback;
+    void* user_data;
+    char path[1024];
+    uint8_t* rgb;
+};
+
+
+
+struct DvzBatchTask
+{
+    DvzBatch* batch;
+    DvzBatchJob* job; // NULL job = stop the worker
+    uint8_t* rgb;
+};
+
+
+
+struct DvzBatchStats
+{
+    uint32_t job_count;
+    double elapsed;     // total duration, in seconds
+    double render_time; // time spent rendering and downloading on the main thread, in seconds
+    double images_per_second;
+};
+
+
+
+struct DvzBatch
+{
+    DvzObject obj;
+    DvzCanvas* canvas;
+
+    uint32_t job_count;
+    uint32_t job_capacity;
+    DvzBatchJob* jobs;
+
+    // Reused staging resources.
+    DvzImages staging;
+    DvzCommands cmds;
+
+    // Encoding workers and bounded pool of RGB buffers.
+    uint32_t worker_count;
+    DvzThread workers[DVZ_BATCH_MAX_WORKERS];
+    DvzBatchTask tasks[DVZ_BATCH_MAX_WORKERS + 1];
+    DvzFifo task_queue;
+    DvzFifo free_queue;
+
+    DvzBatchStats stats;
+};
+
+
+
+struct DvzVideoFrame
+{
+    DvzVideoEncoder* encoder;
+    uint64_t idx;
+    bool downscaled; // half-resolution frame
+    bool stop;       // stop frame = stop the worker
+    double time;     // time when the frame was queued
+    uint8_t* rgba;
+};
+
+
+
+struct DvzVideoStats
+{
+    uint64_t frame_count;      // frames received by the encoder
+    uint64_t encoded_count;    // frames passed to the encoding callback
+    uint64_t dropped_count;    // frames dropped because no frame of the pool was free
+    uint64_t downscaled_count; // frames queued at half resolution
+    uint32_t queue_max;        // maximum number of frames waiting to be encoded
+    double block_time;         // time spent by the render thread waiting for a free frame
+    double encode_mean;        // mean duration of the encoding callback, in seconds
+    double latency_mean;       // mean duration between queueing and end of encoding, in seconds
+    double latency_max;        // maximum duration between queueing and end of encoding
+};
+
+
+
+struct DvzVideoEncoder
+{
+    DvzObject obj;
+    DvzCanvas* canvas;
+    uint32_t width, height;
+    DvzVideoPolicy policy;
+    DvzVideoCallback callback;
+    void* user_data;
+
+    // Bounded pool of RGBA frames, and as many half-resolution frames used by the downscale
+    // policy.
+    uint32_t frame_count;
+    DvzVideoFrame frames[2 * DVZ_VIDEO_MAX_FRAMES];
+    DvzFifo free_queue;
+    DvzFifo small_queue;
+    DvzFifo frame_queue;
+    DvzVideoFrame stop;
+
+    // Encoding worker, with the full-resolution image of the downscaled frames.
+    DvzThread worker;
+    uint8_t* upscaled;
+
+    // The statistics are updated by both threads.
+    pthread_mutex_t lock;
+    DvzClock clock;
+    double encode_time;
+    double latency_time;
+    DvzVideoStats stats;
+};
+
+
+
 struct DvzPendingRefill
 {
     bool completed[DVZ_MAX_SWAPCHAIN_IMAGES];
     atomic(DvzRefillStatus, status);
+    uint64_t serial;  // serial of the bindings cache of the GPU when the ongoing refill started
+    uint64_t retired; // serial of the bindings cache when the last complete refill started
 };
 
 
@@ -607,6 +812,13 @@ struct DvzCanvas
     DvzThread event_thread;
     bool enable_lock;
     atomic(DvzEventType, event_processing);
+    DvzEventCoalescer coalescer;
+
+    // Persistent worker thread used to prepare the frames when the app runs in parallel mode.
+    DvzThread frame_thread;
+    DvzFifo frame_queue; // frames to prepare in the worker thread, NULL stops the thread
+    DvzFifo frame_done;  // frames prepared by the worker thread
+    bool frame_pending;
 
     bool captured; // if true, mouse and keyboard should not be processed
     DvzMouse mouse;
@@ -617,8 +829,12 @@ struct DvzCanvas
     DvzContainer guis;
 
     DvzScreencast* screencast;
+    DvzVideoEncoder* video;
     DvzPendingRefill refills;
 
+    DvzPickBuffer* pick;
+    uint32_t last_visual_id; // used to assign a picking id to every visual
+
     DvzViewport viewport;
     DvzScene* scene;
 };
@@ -853,6 +1069,83 @@ DVZ_EXPORT void dvz_screenshot_file(DvzCanvas* canvas, const char* png_path);
 
 
 
+/*************************************************************************************************/
+/*  GPU picking                                                                                  */
+/*************************************************************************************************/
+
+/**
+ * Request the visual and item ids of a rectangle of the canvas.
+ *
+ * The canvas must have been created with the `DVZ_CANVAS_FLAGS_PICK` flag. The builtin point,
+ * marker, path, and mesh graphics write the (visual id, item id) pair of every fragment into an
+ * extra color attachment. This function does not block: the rectangle is copied after the next
+ * frame submission, and a `DVZ_EVENT_PICK` event is raised once the copy has completed. A new
+ * request replaces a pending one that has not been submitted yet, and is ignored while a copy is
+ * in flight. The rectangle is at most `DVZ_PICK_MAX_SIZE` pixels wide and high.
+ *
+ * @param canvas the canvas
+ * @param x the left coordinate of the rectangle, in framebuffer pixels
+ * @param y the top coordinate of the rectangle, in framebuffer pixels
+ * @param w the width of the rectangle, in framebuffer pixels
+ * @param h the height of the rectangle, in framebuffer pixels
+ */
+DVZ_EXPORT void dvz_canvas_pick(DvzCanvas* canvas, uint32_t x, uint32_t y, uint32_t w, uint32_t h);
+
+
+
+/*************************************************************************************************/
+/*  Batch rendering                                                                              */
+/*************************************************************************************************/
+
+/**
+ * Create a batch renderer for headless image generation.
+ *
+ * A **batch** is a queue of jobs, each job updating the scene and rendering a single frame to a
+ * file or a CPU buffer. The canvas, its framebuffers and the staging image are reused across
+ * jobs. The image of job N is encoded to PNG/PPM on worker threads while job N+1 is being
+ * rendered.
+ *
+ * @param canvas the canvas, typically created with the offscreen backend
+ * @param worker_count number of encoding threads
+ * @returns the batch
+ */
+DVZ_EXPORT DvzBatch* dvz_batch(DvzCanvas* canvas, uint32_t worker_count);
+
+/**
+ * Add a job to a batch.
+ *
+ * The callback is called on the main thread just before rendering the job's frame, it should be
+ * used to update the scene (visual data, panzoom, etc.).
+ *
+ * @param batch the batch
+ * @param callback the scene update callback (may be NULL)
+ * @param user_data pointer passed to the callback
+ * @param path output file path (PPM, QOI or PNG depending on the extension, may be NULL)
+ * @param rgb output buffer with width*height*3 bytes, filled with the RGB image (may be NULL)
+ */
+DVZ_EXPORT void dvz_batch_job(
+    DvzBatch* batch, DvzBatchCallback callback, void* user_data, const char* path, uint8_t* rgb);
+
+/**
+ * Render all pending jobs of a batch and wait until all images have been written.
+ *
+ * !!! note
+ *     This function must not be called while the app is running.
+ *
+ * @param batch the batch
+ * @returns the batch statistics
+ */
+DVZ_EXPORT DvzBatchStats dvz_batch_run(DvzBatch* batch);
+
+/**
+ * Destroy a batch and its worker threads.
+ *
+ * @param batch the batch
+ */
+DVZ_EXPORT void dvz_batch_destroy(DvzBatch* batch);
+
+
+
 /*************************************************************************************************/
 /*  Video                                                                                        */
 /*************************************************************************************************/
@@ -886,6 +1179,49 @@ DVZ_EXPORT void dvz_canvas_pause(DvzCanvas* canvas, bool record);
  */
 DVZ_EXPORT void dvz_canvas_stop(DvzCanvas* canvas);
 
+/**
+ * Create the video encoder of a canvas, which encodes the screencast frames in a worker thread.
+ *
+ * The screencast callback only copies the downloaded image to a frame of a bounded pool, and the
+ * worker thread passes the frames to the encoding callback, in order. The policy determines what
+ * happens when all frames of the pool are waiting to be encoded. The canvas must have a
+ * screencast with an alpha channel, and there is at most one encoder per canvas, destroyed with
+ * the canvas.
+ *
+ * @param canvas the canvas
+ * @param frame_count the number of frames of the pool (at most DVZ_VIDEO_MAX_FRAMES)
+ * @param policy the policy when no frame of the pool is free
+ * @param callback the encoding callback, called in the worker thread with RGBA images
+ * @param user_data pointer passed to the callback
+ * @returns the video encoder, or NULL if the canvas has no screencast with an alpha channel
+ */
+DVZ_EXPORT DvzVideoEncoder* dvz_video_encoder(
+    DvzCanvas* canvas, uint32_t frame_count, DvzVideoPolicy policy, DvzVideoCallback callback,
+    void* user_data);
+
+/**
+ * Change the policy of a video encoder.
+ *
+ * @param encoder the video encoder
+ * @param policy the policy when no frame of the pool is free
+ */
+DVZ_EXPORT void dvz_video_encoder_policy(DvzVideoEncoder* encoder, DvzVideoPolicy policy);
+
+/**
+ * Wait until all queued frames have been encoded.
+ *
+ * @param encoder the video encoder
+ */
+DVZ_EXPORT void dvz_video_encoder_flush(DvzVideoEncoder* encoder);
+
+/**
+ * Get the statistics of a video encoder.
+ *
+ * @param encoder the video encoder
+ * @returns the encoder statistics
+ */
+DVZ_EXPORT DvzVideoStats dvz_video_encoder_stats(DvzVideoEncoder* encoder);
+
 
 
 /*************************************************************************************************/
@@ -1091,6 +1427,28 @@ DVZ_EXPORT void dvz_event_timer(DvzCanvas* canvas, uint64_t idx, double time, do
  */
 DVZ_EXPORT int dvz_event_pending(DvzCanvas* canvas, DvzEventType type);
 
+/**
+ * Set the coalescing policy of the mouse move and wheel events.
+ *
+ * With `DVZ_EVENT_COALESCE_FRAME` (the default), consecutive mouse move events are merged into a
+ * single event with the last position, and the deltas of consecutive wheel events are summed,
+ * until the next frame or until another event is emitted, so that press and release events
+ * are never reordered with the moves. The mouse state and the callbacks only see the merged
+ * events, at most one of each type per frame.
+ *
+ * @param canvas the canvas
+ * @param policy the coalescing policy
+ */
+DVZ_EXPORT void dvz_event_coalesce(DvzCanvas* canvas, DvzEventCoalesce policy);
+
+/**
+ * Return the number of mouse move and wheel events that were merged into another event.
+ *
+ * @param canvas the canvas
+ * @returns the number of coalesced events since the canvas creation
+ */
+DVZ_EXPORT uint64_t dvz_event_coalesced(DvzCanvas* canvas);
+
 /**
  * Stop the background event loop.
  *
@@ -1132,6 +1490,25 @@ DVZ_EXPORT void dvz_canvas_frame_submit(DvzCanvas* canvas);
  */
 DVZ_EXPORT void dvz_app_run(DvzApp* app, uint64_t frame_count);
 
+/**
+ * Enable or disable parallel frame preparation.
+ *
+ * When enabled, at every iteration of the main loop, the frame of every offscreen canvas
+ * (events, scene updates, transfers, command buffer refill, and submission) is prepared in a
+ * dedicated worker thread, so that the canvases are processed concurrently. The worker threads
+ * are started once and stopped when the mode is disabled or the canvas is destroyed. Submissions
+ * to a given Vulkan queue are serialized. Canvases with a window or a GUI overlay are always
+ * processed in the main thread.
+ *
+ * !!! warning
+ *     Sync event callbacks of offscreen canvases run in worker threads in this mode, and should
+ *     not share mutable state between canvases.
+ *
+ * @param app the app
+ * @param value whether to enable parallel frame preparation
+ */
+DVZ_EXPORT void dvz_app_parallel(DvzApp* app, bool value);
+
 
 
 #ifdef __cplusplus
@@ -39,6 +39,7 @@ We need to generate different types of data structures for colors:
 #include <math.h>
 #include <stdint.h>
 
+#include "array.h"
 #include "common.h"
 
 #ifdef __cplusplus
@@ -79,6 +80,10 @@ extern "C" {
 
 #define CMAP_COUNT 256
 
+// Batch colormap functions.
+#define DVZ_COLORMAP_MAX_THREADS 16
+#define DVZ_COLORMAP_MIN_CHUNK   262144 // minimum number of values per thread
+
 #pragma GCC visibility push(default)
 static const unsigned char* DVZ_COLORMAP_ARRAY;
 #pragma GCC visibility pop
@@ -296,6 +301,48 @@ typedef enum
 
 
 
+/*************************************************************************************************/
+/*  Batch functions                                                                              */
+/*************************************************************************************************/
+
+/**
+ * Fetch colors from a colormap and an array of values of any numerical type.
+ *
+ * The colors are identical to those of `dvz_colormap_scale()`, but the values are mapped in
+ * blocks through a lookup table of the colormap, on several threads for large arrays.
+ *
+ * @param cmap the colormap
+ * @param dtype the type of the values: `DVZ_DTYPE_FLOAT`, `DVZ_DTYPE_DOUBLE`, `DVZ_DTYPE_CHAR`
+ *     (uint8), or `DVZ_DTYPE_USHORT` (uint16)
+ * @param count the number of values
+ * @param values pointer to the array of values
+ * @param vmin the minimum value
+ * @param vmax the maximum value
+ * @param[out] out the fetched colors
+ */
+DVZ_EXPORT void dvz_colormap_batch(
+    DvzColormap cmap, DvzDataType dtype, uint32_t count, const void* values, double vmin,
+    double vmax, cvec4* out);
+
+/**
+ * Fetch colors from a colormap and an array of values, packed into texture coordinates.
+ *
+ * Every color is packed as with `dvz_colormap_packuv()`, for the mesh visual.
+ *
+ * @param cmap the colormap
+ * @param dtype the type of the values, see `dvz_colormap_batch()`
+ * @param count the number of values
+ * @param values pointer to the array of values
+ * @param vmin the minimum value
+ * @param vmax the maximum value
+ * @param[out] out the packed texture coordinates
+ */
+DVZ_EXPORT void dvz_colormap_batch_uv(
+    DvzColormap cmap, DvzDataType dtype, uint32_t count, const void* values, double vmin,
+    double vmax, vec2* out);
+
+
+
 /*************************************************************************************************/
 /*  Color utils                                                                                  */
 /*************************************************************************************************/
@@ -446,8 +493,7 @@ static void dvz_colormap_array(
 {
     ASSERT(values != NULL);
     ASSERT(out != NULL);
-    for (uint32_t i = 0; i < count; i++)
-        dvz_colormap_scale(cmap, values[i], vmin, vmax, out[i]);
+    dvz_colormap_batch(cmap, DVZ_DTYPE_DOUBLE, count, values, vmin, vmax, out);
 }
 
 /**
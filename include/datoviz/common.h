@@ -101,6 +101,8 @@ END_INCL_NO_WARN
 
 #define DVZ_MAX_FRAMES_IN_FLIGHT    2
 #define DVZ_CONTAINER_DEFAULT_COUNT 64
+#define DVZ_CONTAINER_MAX_SLABS     32
+#define DVZ_NPY_MAX_DIMS            8
 
 
 /*************************************************************************************************/
@@ -239,8 +241,10 @@ typedef struct DvzObject DvzObject;
 typedef struct DvzContainer DvzContainer;
 typedef struct DvzContainerIterator DvzContainerIterator;
 typedef struct DvzThread DvzThread;
+typedef struct DvzNpyHeader DvzNpyHeader;
 
 typedef void* (*DvzThreadCallback)(void*);
+typedef void (*DvzParallelCallback)(void* item, uint32_t phase);
 
 
 
@@ -265,8 +269,17 @@ struct DvzContainer
     uint32_t count;
     uint32_t capacity;
     DvzObjectType type;
-    void** items;
+    void** items; // object in each slot, NULL if the slot is free
     size_t item_size;
+
+    // The objects are stored in slabs that are never moved: the first slab has the initial
+    // capacity, every reallocation adds a slab with as many slots as the container already has.
+    uint32_t slab_count;
+    void* slabs[DVZ_CONTAINER_MAX_SLABS];
+
+    uint32_t* free_slots; // stack of free slots, the top is the next slot to be allocated
+    uint32_t free_count;
+    uint32_t end; // one past the last slot ever allocated
 };
 
 
@@ -290,6 +303,21 @@ struct DvzThread
 
 
 
+struct DvzNpyHeader
+{
+    uint8_t version;
+    char descr[16];     // NumPy dtype descriptor, e.g. "<f4"
+    char kind;          // 'f', 'i', 'u', 'b'
+    uint32_t item_size; // size of a scalar, in bytes
+    bool fortran_order;
+    uint32_t ndims;
+    uint64_t shape[DVZ_NPY_MAX_DIMS];
+    uint64_t item_count; // product of the shape
+    size_t data_offset;  // offset of the data buffer in the file, in bytes
+};
+
+
+
 struct DvzMVP
 {
     mat4 model;
@@ -380,12 +408,43 @@ static DvzContainer dvz_container(uint32_t count, size_t item_size, DvzObjectTyp
     {
         container.items[i] = NULL;
     }
+
+    container.slabs[0] = calloc(container.capacity, item_size);
+    container.slab_count = 1;
+    ASSERT(container.slabs[0] != NULL);
+
+    // The lowest slots are allocated first.
+    container.free_slots = (uint32_t*)calloc(container.capacity, sizeof(uint32_t));
+    ASSERT(container.free_slots != NULL);
+    for (uint32_t i = 0; i < container.capacity; i++)
+        container.free_slots[i] = container.capacity - 1 - i;
+    container.free_count = container.capacity;
     return container;
 }
 
+// Address of a slot in the slabs: slab 0 has the slots [0, c), slab 1 [c, 2c), slab 2 [2c, 4c)...
+static void* _container_slot(DvzContainer* container, uint32_t idx)
+{
+    ASSERT(container != NULL);
+    ASSERT(container->slab_count > 0);
+    uint32_t slab = 0;
+    uint32_t first = 0;
+    uint32_t size = container->capacity >> (container->slab_count - 1);
+    while (idx >= first + size)
+    {
+        first += size;
+        size = first;
+        slab++;
+    }
+    ASSERT(slab < container->slab_count);
+    return (char*)container->slabs[slab] + (idx - first) * container->item_size;
+}
+
 /**
  * Free a given object in the constainer if it was previously destroyed.
  *
+ * The slot is put back in the free list, the memory of the object stays in its slab.
+ *
  * @param container the container
  * @param idx the index of the object within the container
  */
@@ -401,17 +460,62 @@ static void dvz_container_delete_if_destroyed(DvzContainer* container, uint32_t
     if (object->status == DVZ_OBJECT_STATUS_DESTROYED)
     {
         // log_trace("delete container item #%d", idx);
-        FREE(container->items[idx]);
         container->items[idx] = NULL;
         container->count--;
         ASSERT(container->count < UINT32_MAX);
+        ASSERT(container->free_count < container->capacity);
+        container->free_slots[container->free_count++] = idx;
     }
 }
 
+// Put the slots of the destroyed objects back in the free list, return the number of slots.
+static uint32_t _container_reclaim(DvzContainer* container)
+{
+    ASSERT(container != NULL);
+    uint32_t free_count = container->free_count;
+    // Backward, so that the lowest slots are on top of the free list.
+    for (uint32_t i = container->end; i > 0; i--)
+        dvz_container_delete_if_destroyed(container, i - 1);
+    return container->free_count - free_count;
+}
+
+// Double the capacity with a new slab, whose slots go to the bottom of the free list.
+static void _container_grow(DvzContainer* container)
+{
+    ASSERT(container != NULL);
+    uint32_t capacity = container->capacity;
+    ASSERT(container->slab_count < DVZ_CONTAINER_MAX_SLABS);
+    log_trace("reallocate container up to %d items", 2 * capacity);
+
+    void** items = (void**)realloc(container->items, 2 * capacity * sizeof(void*));
+    uint32_t* free_slots =
+        (uint32_t*)realloc(container->free_slots, 2 * capacity * sizeof(uint32_t));
+    void* slab = calloc(capacity, container->item_size);
+    ASSERT(items != NULL);
+    ASSERT(free_slots != NULL);
+    ASSERT(slab != NULL);
+    container->items = items;
+    container->free_slots = free_slots;
+    container->slabs[container->slab_count++] = slab;
+
+    // Initialize newly-allocated pointers to NULL.
+    for (uint32_t i = capacity; i < 2 * capacity; i++)
+        container->items[i] = NULL;
+    memmove(
+        &container->free_slots[capacity], container->free_slots,
+        container->free_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < capacity; i++)
+        container->free_slots[i] = 2 * capacity - 1 - i;
+    container->free_count += capacity;
+    container->capacity = 2 * capacity;
+}
+
 /**
  * Get a pointer to a new object in the container.
  *
- * If the container is full, it will be automatically resized.
+ * The slot is taken from the free list in constant time. When it is empty, the slots of the
+ * destroyed objects are reclaimed, and the container is resized if there are too few of them.
+ * The objects are never moved.
  *
  * @param container the container
  * @returns a pointer to an allocated object
@@ -421,54 +525,33 @@ static void* dvz_container_alloc(DvzContainer* container)
     ASSERT(container != NULL);
     ASSERT(container->capacity > 0);
     ASSERT(container->items != NULL);
-    uint32_t available_slot = UINT32_MAX;
 
-    // Free the memory of destroyed objects and find the first available slot.
-    for (uint32_t i = 0; i < container->capacity; i++)
+    // Growing when less than 1/8 of the slots could be reclaimed bounds the amortized cost of
+    // the scans.
+    if (container->free_count == 0)
     {
-        dvz_container_delete_if_destroyed(container, i);
-        // Find first slot with empty pointer, to use for new allocation.
-        if (container->items[i] == NULL && available_slot == UINT32_MAX)
-            available_slot = i;
+        uint32_t reclaimed = _container_reclaim(container);
+        if (reclaimed == 0 || reclaimed < container->capacity / 8)
+            _container_grow(container);
     }
+    ASSERT(container->free_count > 0);
+    uint32_t idx = container->free_slots[--container->free_count];
+    ASSERT(idx < container->capacity);
+    ASSERT(container->items[idx] == NULL);
 
-    // If no slot, need to reallocate container.
-    if (available_slot == UINT32_MAX)
-    {
-        log_trace("reallocate container up to %d items", 2 * container->capacity);
-        void** _new =
-            (void**)realloc(container->items, 2 * container->capacity * container->item_size);
-        ASSERT(_new != NULL);
-        container->items = _new;
-
-        ASSERT(container->items != NULL);
-        // Initialize newly-allocated pointers to NULL.
-        for (uint32_t i = container->capacity; i < 2 * container->capacity; i++)
-        {
-            container->items[i] = NULL;
-        }
-        ASSERT(container->items[container->capacity] == NULL);
-        ASSERT(container->items[2 * container->capacity - 1] == NULL);
-        // Return the first empty slot of the newly-allocated container.
-        available_slot = container->capacity;
-        // Update the container capacity.
-        container->capacity *= 2;
-    }
-    ASSERT(available_slot < UINT32_MAX);
-    ASSERT(container->items[available_slot] == NULL);
-
-    // Memory allocation on the heap and store the pointer in the container.
-    // log_trace("container allocates new item #%d", available_slot);
-    container->items[available_slot] = calloc(1, container->item_size);
+    // log_trace("container allocates new item #%d", idx);
+    void* item = _container_slot(container, idx);
+    memset(item, 0, container->item_size);
+    container->items[idx] = item;
     container->count++;
-    ASSERT(container->items[available_slot] != NULL);
+    container->end = MAX(container->end, idx + 1);
 
     // Initialize the DvzObject field.
-    DvzObject* obj = (DvzObject*)container->items[available_slot];
+    DvzObject* obj = (DvzObject*)item;
     obj->status = DVZ_OBJECT_STATUS_ALLOC;
     obj->type = container->type;
 
-    return container->items[available_slot];
+    return item;
 }
 
 /**
@@ -489,6 +572,8 @@ static void* dvz_container_get(DvzContainer* container, uint32_t idx)
 /**
  * Continue an already-started loop iteration on a container.
  *
+ * The objects are visited in the order of their slots, up to the last allocated slot.
+ *
  * @param container the container
  * @returns a pointer to the next object in the container, or NULL at the end
  */
@@ -499,10 +584,8 @@ static void dvz_container_iter(DvzContainerIterator* iterator)
     ASSERT(container != NULL);
     if (container->items == NULL || container->capacity == 0 || container->count == 0)
         return;
-    if (iterator->idx >= container->capacity)
-        return;
-    ASSERT(iterator->idx <= container->capacity - 1);
-    for (uint32_t i = iterator->idx; i < container->capacity; i++)
+    ASSERT(container->end <= container->capacity);
+    for (uint32_t i = iterator->idx; i < container->end; i++)
     {
         dvz_container_delete_if_destroyed(container, i);
         if (container->items[i] != NULL)
@@ -552,9 +635,9 @@ static void dvz_container_destroy(DvzContainer* container)
         return;
     ASSERT(container->items != NULL);
     // log_trace("container destroy");
-    // Check all elements have been destroyed, and free them if necessary.
+    // Check all elements have been destroyed.
     DvzObject* item = NULL;
-    for (uint32_t i = 0; i < container->capacity; i++)
+    for (uint32_t i = 0; i < container->end; i++)
     {
         if (container->items[i] != NULL)
         {
@@ -568,7 +651,6 @@ static void dvz_container_destroy(DvzContainer* container)
             {
                 ASSERT(item->status <= DVZ_OBJECT_STATUS_INIT);
                 ASSERT(item->status != DVZ_OBJECT_STATUS_DESTROYED);
-                FREE(container->items[i]);
                 container->items[i] = NULL;
                 container->count--;
                 ASSERT(container->count < UINT32_MAX);
@@ -578,7 +660,13 @@ static void dvz_container_destroy(DvzContainer* container)
     }
     ASSERT(container->count == 0);
     // log_trace("free container items");
+    for (uint32_t i = 0; i < container->slab_count; i++)
+        FREE(container->slabs[i]);
     FREE(container->items);
+    FREE(container->free_slots);
+    container->slab_count = 0;
+    container->free_count = 0;
+    container->end = 0;
     container->capacity = 0;
 }
 
@@ -622,6 +710,48 @@ dvz_write_png(const char* filename, uint32_t width, uint32_t height, const uint8
 DVZ_EXPORT int
 dvz_write_ppm(const char* filename, uint32_t width, uint32_t height, const uint8_t* image);
 
+/**
+ * Save an image to a PNG file with a fast multithreaded encoder.
+ *
+ * The rows are split into chunks that are filtered and compressed independently on several
+ * threads, and concatenated into a single PNG stream. This is much faster than `dvz_write_png()`
+ * on large images, at the cost of a slightly larger file.
+ *
+ * @param filename path to the PNG file to create
+ * @param width width of the image
+ * @param height height of the image
+ * @param image pointer to an array of 24-bit RGB values
+ * @param level compression level, from 0 (store, no compression) to 9 (best), 1 for fast mode
+ * @param thread_count number of threads, 0 for the number of CPU cores
+ */
+DVZ_EXPORT int dvz_write_png_fast(
+    const char* filename, uint32_t width, uint32_t height, const uint8_t* image, int level,
+    uint32_t thread_count);
+
+/**
+ * Save an image to a QOI file (fast lossless format, suitable for intermediate images).
+ *
+ * @param filename path to the QOI file to create
+ * @param width width of the image
+ * @param height height of the image
+ * @param image pointer to an array of 24-bit RGB values
+ */
+DVZ_EXPORT int
+dvz_write_qoi(const char* filename, uint32_t width, uint32_t height, const uint8_t* image);
+
+/**
+ * Read a QOI file.
+ *
+ * !!! important
+ *     The caller MUST free the output pointer.
+ *
+ * @param filename path to the QOI file
+ * @param[out] width width of the image
+ * @param[out] height height of the image
+ * @returns pointer to an array of 24-bit RGB values
+ */
+DVZ_EXPORT uint8_t* dvz_read_qoi(const char* filename, int* width, int* height);
+
 /**
  * Read a binary file.
  *
@@ -631,11 +761,41 @@ dvz_write_ppm(const char* filename, uint32_t width, uint32_t height, const uint8
  */
 DVZ_EXPORT uint32_t* dvz_read_file(const char* filename, size_t* size);
 
+/**
+ * Map a file in memory (read-only data, copy-on-write pages).
+ *
+ * @param filename path of the file to map
+ * @param[out] size of the file
+ * @returns pointer to the mapped memory, or NULL if the file could not be mapped
+ */
+DVZ_EXPORT void* dvz_file_map(const char* filename, size_t* size);
+
+/**
+ * Unmap a file mapped with `dvz_file_map()`.
+ *
+ * @param ptr pointer returned by `dvz_file_map()`
+ * @param size size of the mapping
+ */
+DVZ_EXPORT void dvz_file_unmap(void* ptr, size_t size);
+
+/**
+ * Parse and validate the header of a NumPy NPY file (format versions 1, 2 and 3).
+ *
+ * @param buffer pointer to the beginning of the file contents
+ * @param size size of the buffer, in bytes (at least the size of the header)
+ * @param[out] header the parsed header
+ * @returns 0 if the header is valid, a non-zero value otherwise
+ */
+DVZ_EXPORT int dvz_npy_header(const void* buffer, size_t size, DvzNpyHeader* header);
+
 /**
  * Read a NumPy NPY file.
  *
+ * The header is validated but the caller must know the data type of the array. Use
+ * `dvz_array_npy()` to load large files without copy.
+ *
  * @param filename path of the file to open
- * @param[out] size of the file
+ * @param[out] size of the data buffer
  * @returns pointer to a buffer containing the array elements
  */
 DVZ_EXPORT char* dvz_read_npy(const char* filename, size_t* size);
@@ -694,6 +854,39 @@ DVZ_EXPORT void dvz_thread_unlock(DvzThread* thread);
  */
 DVZ_EXPORT void dvz_thread_join(DvzThread* thread);
 
+/**
+ * Get the number of hardware threads.
+ *
+ * @returns the number of logical processors, at least 1
+ */
+DVZ_EXPORT uint32_t dvz_num_threads(void);
+
+/**
+ * Get the number of threads to process items in parallel.
+ *
+ * @param count the number of items
+ * @param min_size the minimum number of items per thread
+ * @param max_threads the maximum number of threads
+ * @returns the number of threads, between 1 and the number of hardware threads
+ */
+DVZ_EXPORT uint32_t dvz_parallel_threads(uint64_t count, uint64_t min_size, uint32_t max_threads);
+
+/**
+ * Call a function on every item of an array, in parallel, and wait until all calls have returned.
+ *
+ * There is one thread per item, the first item is processed on the calling thread. The phase is
+ * passed to every call, so that the successive phases of a multi-pass algorithm can reuse the
+ * same items.
+ *
+ * @param count the number of items
+ * @param items the array of items, typically one chunk of work per item
+ * @param item_size the size of an item, in bytes
+ * @param phase the phase passed to the callback
+ * @param callback the function called with a pointer to an item and the phase
+ */
+DVZ_EXPORT void dvz_parallel(
+    uint32_t count, void* items, size_t item_size, uint32_t phase, DvzParallelCallback callback);
+
 
 
 /*************************************************************************************************/
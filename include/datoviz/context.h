@@ -30,6 +30,10 @@ extern "C" {
 #define DVZ_BUFFER_TYPE_STORAGE_SIZE (16 * 1024 * 1024)
 #define DVZ_BUFFER_TYPE_UNIFORM_SIZE (4 * 1024 * 1024)
 
+// Uploads larger than the chunk size are streamed through a ring of staging buffer slots.
+#define DVZ_STAGING_CHUNK_SIZE (32 * 1024 * 1024)
+#define DVZ_STAGING_RING_SLOTS 2
+
 #define DVZ_ZERO_OFFSET                                                                           \
     (uvec3) { 0, 0, 0 }
 
@@ -101,6 +105,11 @@ struct DvzContext
 
     DvzCommands transfer_cmd;
 
+    // Chunked uploads.
+    VkDeviceSize staging_chunk;
+    DvzCommands stream_cmds;
+    DvzFences stream_fences;
+
     DvzContainer buffers;
     DvzContainer images;
     DvzContainer samplers;
@@ -347,6 +356,182 @@ static void _copy_texture_to_staging(
 
 
 
+// Whether an upload should be streamed in chunks through the staging buffer.
+static bool _stream_upload(DvzContext* context, VkDeviceSize size)
+{
+    ASSERT(context != NULL);
+    return context->staging_chunk > 0 && size > context->staging_chunk;
+}
+
+
+
+// Copy a chunk into a slot of the staging ring, waiting for the slot to be free first.
+static void _stream_chunk(
+    DvzContext* context, DvzBuffer* staging, uint32_t slot, VkDeviceSize slot_size,
+    VkDeviceSize size, const void* data)
+{
+    ASSERT(slot < DVZ_STAGING_RING_SLOTS);
+    ASSERT(size <= slot_size);
+
+    // Wait until the GPU has finished copying the previous chunk in this slot.
+    dvz_fences_wait(&context->stream_fences, slot);
+    dvz_buffer_upload(staging, slot * slot_size, size, data);
+
+    DvzCommands* cmds = &context->stream_cmds;
+    dvz_cmd_reset(cmds, slot);
+    dvz_cmd_begin(cmds, slot);
+}
+
+
+
+// Submit the copy of a chunk, without waiting, so that the next chunk can be copied to the
+// staging buffer while the GPU is copying this one.
+static void _stream_submit(DvzContext* context, uint32_t slot)
+{
+    DvzCommands* cmds = &context->stream_cmds;
+    dvz_cmd_end(cmds, slot);
+
+    DvzSubmit submit = dvz_submit(context->gpu);
+    dvz_submit_commands(&submit, cmds);
+    dvz_submit_send(&submit, slot, &context->stream_fences, slot);
+}
+
+
+
+static void _stream_wait(DvzContext* context)
+{
+    for (uint32_t i = 0; i < DVZ_STAGING_RING_SLOTS; i++)
+        dvz_fences_wait(&context->stream_fences, i);
+}
+
+
+
+static void _stream_buffer_upload(
+    DvzContext* context, DvzBufferRegions br, VkDeviceSize offset, VkDeviceSize size,
+    const void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(br.count == 1);
+    ASSERT(size > 0);
+    ASSERT(data != NULL);
+
+    VkDeviceSize slot_size = context->staging_chunk;
+    DvzBuffer* staging = staging_buffer(context, DVZ_STAGING_RING_SLOTS * slot_size);
+    log_debug(
+        "stream %s to buffer in chunks of %s", pretty_size(size), pretty_size(slot_size));
+
+    // Wait for the render queue to be idle.
+    dvz_queue_wait(context->gpu, DVZ_DEFAULT_QUEUE_RENDER);
+
+    VkDeviceSize pos = 0, chunk = 0;
+    uint32_t slot = 0;
+    for (uint32_t k = 0; pos < size; k++)
+    {
+        slot = k % DVZ_STAGING_RING_SLOTS;
+        chunk = MIN(slot_size, size - pos);
+        _stream_chunk(context, staging, slot, slot_size, chunk, (const char*)data + pos);
+        dvz_cmd_copy_buffer(
+            &context->stream_cmds, slot, staging, slot * slot_size, //
+            br.buffer, br.offsets[0] + offset + pos, chunk);
+        _stream_submit(context, slot);
+        pos += chunk;
+    }
+    _stream_wait(context);
+}
+
+
+
+static void _stream_texture_upload(
+    DvzContext* context, DvzTexture* texture, uvec3 offset, uvec3 shape, VkDeviceSize size,
+    const void* data)
+{
+    ASSERT(context != NULL);
+    ASSERT(texture != NULL);
+    ASSERT(texture->image != NULL);
+    ASSERT(size > 0);
+    ASSERT(data != NULL);
+
+    DvzImages* image = texture->image;
+    uint32_t width = shape[0], height = shape[1], depth = shape[2];
+    ASSERT(width > 0 && height > 0 && depth > 0);
+    VkDeviceSize row = size / (height * depth);
+    VkDeviceSize slice = row * height;
+    ASSERT(slice * depth == size);
+
+    // Each chunk is a box made of whole slices, or of whole rows within a slice if a single slice
+    // is larger than the chunk size.
+    VkDeviceSize chunk_size = context->staging_chunk;
+    uint32_t slices = slice <= chunk_size ? (uint32_t)(chunk_size / slice) : 1;
+    uint32_t rows = slice <= chunk_size ? height : (uint32_t)MAX(1, chunk_size / row);
+    VkDeviceSize slot_size = slice <= chunk_size ? slices * slice : rows * row;
+    // NOTE: the buffer offsets of the copy regions must be aligned to 4 bytes and the texel size.
+    slot_size = (slot_size + 15) & ~(VkDeviceSize)15;
+    DvzBuffer* staging = staging_buffer(context, DVZ_STAGING_RING_SLOTS * slot_size);
+    log_debug(
+        "stream %s to texture in chunks of %s", pretty_size(size), pretty_size(slot_size));
+
+    // The previous contents may be discarded if the whole texture is overwritten.
+    bool full = offset[0] == 0 && offset[1] == 0 && offset[2] == 0 && width == image->width &&
+                height == image->height && depth == image->depth;
+
+    DvzBarrier barrier = dvz_barrier(context->gpu);
+    dvz_barrier_stages(&barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    dvz_barrier_images(&barrier, image);
+
+    // Wait for the render queue to be idle.
+    dvz_queue_wait(context->gpu, DVZ_DEFAULT_QUEUE_RENDER);
+
+    uint32_t z = 0, y = 0, nz = 0, ny = 0, slot = 0;
+    VkDeviceSize chunk = 0;
+    DvzCommands* cmds = &context->stream_cmds;
+    for (uint32_t k = 0; z < depth; k++)
+    {
+        slot = k % DVZ_STAGING_RING_SLOTS;
+        nz = rows == height ? MIN(slices, depth - z) : 1;
+        ny = MIN(rows, height - y);
+        chunk = nz * ny * row;
+        _stream_chunk(
+            context, staging, slot, slot_size, chunk, (const char*)data + z * slice + y * row);
+
+        // Transition the image to the transfer layout before the first chunk.
+        if (k == 0)
+        {
+            dvz_barrier_images_layout(
+                &barrier, full ? VK_IMAGE_LAYOUT_UNDEFINED : image->layout,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+            dvz_barrier_images_access(&barrier, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+            dvz_cmd_barrier(cmds, slot, &barrier);
+        }
+
+        dvz_cmd_copy_buffer_to_image_region(
+            cmds, slot, staging, slot * slot_size, image,
+            (uvec3){offset[0], offset[1] + y, offset[2] + z}, (uvec3){width, ny, nz});
+
+        // Next chunk.
+        y += ny;
+        if (y >= height)
+        {
+            y = 0;
+            z += nz;
+        }
+
+        // Transition the image back to its layout after the last chunk.
+        if (z >= depth)
+        {
+            dvz_barrier_images_layout(
+                &barrier, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, image->layout);
+            dvz_barrier_images_access(
+                &barrier, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT);
+            dvz_cmd_barrier(cmds, slot, &barrier);
+        }
+
+        _stream_submit(context, slot);
+    }
+    _stream_wait(context);
+}
+
+
+
 /*************************************************************************************************/
 /*  Context                                                                                      */
 /*************************************************************************************************/
@@ -366,6 +551,18 @@ DVZ_EXPORT DvzContext* dvz_context(DvzGpu* gpu, DvzWindow* window);
  */
 DVZ_EXPORT void dvz_context_reset(DvzContext* context);
 
+/**
+ * Set the chunk size of large uploads.
+ *
+ * Buffer and texture uploads larger than the chunk size are split into chunks streamed through a
+ * ring of staging buffer slots, so that the staging buffer never exceeds
+ * `DVZ_STAGING_RING_SLOTS` times the chunk size, regardless of the size of the data.
+ *
+ * @param context the context
+ * @param chunk_size the chunk size in bytes, or 0 to disable chunked uploads
+ */
+DVZ_EXPORT void dvz_context_staging_chunk(DvzContext* context, VkDeviceSize chunk_size);
+
 
 
 /*************************************************************************************************/
@@ -81,6 +81,8 @@ layout (std140, binding = 1) uniform Viewport {
     // Options
     int clip;               // viewport clipping
     int interact_axis;
+
+    uint pick_id;           // visual id written in the ID buffer for GPU picking
 } viewport;
 
 
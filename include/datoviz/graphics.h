@@ -32,6 +32,8 @@ typedef enum
 {
     DVZ_GRAPHICS_FLAGS_DEPTH_TEST_DISABLE = 0x0000,
     DVZ_GRAPHICS_FLAGS_DEPTH_TEST_ENABLE = 0x0100,
+    DVZ_GRAPHICS_FLAGS_VOLUME_BRICKED = 0x0200, // volume stored as bricks in an atlas
+    DVZ_GRAPHICS_FLAGS_INSTANCED = 0x0400,      // one vertex per item, drawn as instances of a quad
 } DvzGraphicsFlags;
 
 
@@ -365,6 +367,7 @@ struct DvzGraphicsVolumeParams
 {
     // vec4 view_pos; /* camera position */
     vec4 box_size; /* size of the box containing the volume, in NDC */
+    uvec4 shape;   /* shape of a bricked volume, in voxels, and brick size */
     int32_t cmap;  /* colormap */
 };
 
@@ -13,6 +13,7 @@ extern "C" {
 #endif
 
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #define LOG_VERSION "0.1.0"
@@ -38,12 +39,60 @@ enum
 #define DVZ_DEFAULT_LOG_LEVEL LOG_INFO
 #endif
 
-#define log_trace(...) log_log(LOG_TRACE, __FILENAME__, __LINE__, __VA_ARGS__)
-#define log_debug(...) log_log(LOG_DEBUG, __FILENAME__, __LINE__, __VA_ARGS__)
-#define log_info(...)  log_log(LOG_INFO, __FILENAME__, __LINE__, __VA_ARGS__)
-#define log_warn(...)  log_log(LOG_WARN, __FILENAME__, __LINE__, __VA_ARGS__)
-#define log_error(...) log_log(LOG_ERROR, __FILENAME__, __LINE__, __VA_ARGS__)
-#define log_fatal(...) log_log(LOG_FATAL, __FILENAME__, __LINE__, __VA_ARGS__)
+// Log calls below this level are removed by the preprocessor (0=trace, 1=debug, 2=info), so that
+// they cost nothing in release builds. It must be a number as it is used in #if directives.
+#ifndef DVZ_LOG_MIN_LEVEL
+#if defined(DEBUG) || !defined(NDEBUG)
+#define DVZ_LOG_MIN_LEVEL 0
+#else
+#define DVZ_LOG_MIN_LEVEL 2
+#endif
+#endif
+
+// Asynchronous logging: number of records in the ring (power of two) and maximum message size.
+#define LOG_ASYNC_CAPACITY 1024
+#define LOG_MESSAGE_SIZE   256
+
+typedef struct log_Stats log_Stats;
+
+struct log_Stats
+{
+    uint64_t logged;  // number of records accepted in the ring
+    uint64_t dropped; // number of records dropped because the ring was full
+};
+
+// The runtime level is checked inline, so that filtered messages do not pay for a function call.
+extern int log_level_current;
+
+#define _log_at(level, ...)                                                                       \
+    ((level) >= log_level_current ? log_log(level, __FILENAME__, __LINE__, __VA_ARGS__) : (void)0)
+
+#if DVZ_LOG_MIN_LEVEL <= 0
+#define log_trace(...) _log_at(LOG_TRACE, __VA_ARGS__)
+#else
+#define log_trace(...)                                                                            \
+    do                                                                                            \
+    {                                                                                             \
+        if (0)                                                                                    \
+            log_log(LOG_TRACE, __FILENAME__, __LINE__, __VA_ARGS__);                              \
+    } while (0)
+#endif
+
+#if DVZ_LOG_MIN_LEVEL <= 1
+#define log_debug(...) _log_at(LOG_DEBUG, __VA_ARGS__)
+#else
+#define log_debug(...)                                                                            \
+    do                                                                                            \
+    {                                                                                             \
+        if (0)                                                                                    \
+            log_log(LOG_DEBUG, __FILENAME__, __LINE__, __VA_ARGS__);                              \
+    } while (0)
+#endif
+
+#define log_info(...)  _log_at(LOG_INFO, __VA_ARGS__)
+#define log_warn(...)  _log_at(LOG_WARN, __VA_ARGS__)
+#define log_error(...) _log_at(LOG_ERROR, __VA_ARGS__)
+#define log_fatal(...) _log_at(LOG_FATAL, __VA_ARGS__)
 
 void log_set_udata(void* udata);
 void log_set_lock(log_LockFn fn);
@@ -55,6 +104,16 @@ void log_log(int level, const char* file, int line, const char* fmt, ...);
 
 void log_set_level_env(void);
 
+// In asynchronous mode, the callers format their message in a lock-free ring and return, and a
+// background thread formats the records and writes them. The messages are dropped when the ring
+// is full. Errors are flushed before log_log() returns.
+void log_set_async(int enable);
+
+// Wait until all records in the ring have been written.
+void log_flush(void);
+
+log_Stats log_stats(void);
+
 #ifdef __cplusplus
 }
 #endif
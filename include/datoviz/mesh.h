@@ -14,6 +14,19 @@ extern "C" {
 
 
 
+/*************************************************************************************************/
+/*  Constants                                                                                    */
+/*************************************************************************************************/
+
+#define DVZ_MESH_MAX_THREADS 16
+#define DVZ_MESH_MIN_CHUNK   65536 // minimum number of faces or grid vertices per thread
+
+#define DVZ_MESH_LOD_MAX_LEVELS 8
+#define DVZ_MESH_LOD_MAX_ROUNDS 64  // maximum number of collapse rounds per level
+#define DVZ_MESH_LOD_RATIO      0.5 // default ratio between the faces of successive levels
+
+
+
 /*************************************************************************************************/
 /*  Enums                                                                                     */
 /*************************************************************************************************/
@@ -39,6 +52,7 @@ typedef enum
 /*************************************************************************************************/
 
 typedef struct DvzMesh DvzMesh;
+typedef struct DvzMeshLod DvzMeshLod;
 
 
 
@@ -55,6 +69,22 @@ struct DvzMesh
 
 
 
+// Levels of detail of a mesh, stored one after the other in its index array and sharing its
+// vertices. Level 0 is the original mesh.
+struct DvzMeshLod
+{
+    uint32_t level_count;
+    uint32_t first_index[DVZ_MESH_LOD_MAX_LEVELS];
+    uint32_t index_count[DVZ_MESH_LOD_MAX_LEVELS];
+    float error[DVZ_MESH_LOD_MAX_LEVELS]; // geometric error of each level, in mesh units
+
+    // Bounding sphere of the vertices.
+    vec3 center;
+    float radius;
+};
+
+
+
 /*************************************************************************************************/
 /*  Mesh transformation                                                                          */
 /*************************************************************************************************/
@@ -109,12 +139,28 @@ DVZ_EXPORT void dvz_mesh_transform(DvzMesh* mesh);
 /**
  * Compute the normals of a mesh from the vertices and faces, with cross-products.
  *
- * Useful when a mesh has no normal data, just vertex positions and face indices.
+ * Useful when a mesh has no normal data, just vertex positions and face indices. The faces are
+ * split across threads for large meshes.
  *
  * @param mesh the mesh
  */
 DVZ_EXPORT void dvz_mesh_normals(DvzMesh* mesh);
 
+/**
+ * Simplify a mesh into a chain of levels of detail, with quadric error metrics.
+ *
+ * The simplified levels are appended to the index array of the mesh, every level having about
+ * `ratio` times the faces of the previous one. They reuse the vertices of the mesh, so that all
+ * levels can be drawn from the same vertex and index buffers. Fewer levels are produced if the
+ * mesh cannot be simplified further, the borders and seams of the mesh being preserved.
+ *
+ * @param mesh the mesh
+ * @param level_count the maximum number of levels, including the original mesh
+ * @param ratio the ratio between the number of faces of successive levels (0 for the default)
+ * @returns the index range and the error of every level
+ */
+DVZ_EXPORT DvzMeshLod dvz_mesh_lod(DvzMesh* mesh, uint32_t level_count, float ratio);
+
 
 
 /*************************************************************************************************/
@@ -134,7 +180,9 @@ DVZ_EXPORT DvzMesh dvz_mesh(void);
 /**
  * Create a grid mesh.
  *
- * The `positions` buffer should contain row_count * col_count vec3 positions (C order).
+ * The `positions` buffer should contain row_count * col_count vec3 positions (C order). The
+ * vertices, normals, and faces are generated in a single pass, split across threads by rows for
+ * large grids.
  *
  * @param row_count number of rows
  * @param col_count number of columns
@@ -221,11 +269,36 @@ DVZ_EXPORT void dvz_mesh_destroy(DvzMesh* mesh);
 /**
  * Load an OBJ mesh.
  *
+ * The OBJ file is parsed in parallel, and converted once to a binary mesh file next to it, with
+ * the `.dvzmesh` extension. The next calls load the binary mesh file with `dvz_mesh_load()` as
+ * long as the OBJ file has the same size and modification time, or the same contents.
+ *
  * @param file_path the path to the .obj file
  * @returns the mesh
  */
 DVZ_EXPORT DvzMesh dvz_mesh_obj(const char* file_path);
 
+/**
+ * Load a binary mesh file, without copy.
+ *
+ * The file is mapped in memory, and the vertex and index arrays of the mesh wrap the mapped data,
+ * already laid out as `DvzGraphicsMeshVertex` and `DvzIndex`, so that they can be uploaded to the
+ * GPU as they are. Destroying the mesh unmaps the file.
+ *
+ * @param file_path the path to the binary mesh file
+ * @returns the mesh, empty if the file could not be loaded
+ */
+DVZ_EXPORT DvzMesh dvz_mesh_load(const char* file_path);
+
+/**
+ * Save a mesh to a binary mesh file.
+ *
+ * @param mesh the mesh
+ * @param file_path the path to the binary mesh file
+ * @returns 0 on success, a non-zero value otherwise
+ */
+DVZ_EXPORT int dvz_mesh_save(DvzMesh* mesh, const char* file_path);
+
 
 #ifdef __cplusplus
 }
@@ -18,6 +18,7 @@
 #define DVZ_GRID_MAX_ROWS         64
 #define DVZ_MAX_PANELS            1024
 #define DVZ_MAX_VISUALS_PER_PANEL 64
+#define DVZ_PICK_MAX_ITEMS        16
 
 // Group index of the set of panel DvzCommands objects.
 #define DVZ_COMMANDS_GROUP_PANELS 1
@@ -64,6 +65,7 @@ typedef enum
 typedef struct DvzGrid DvzGrid;
 typedef struct DvzPanel DvzPanel;
 typedef struct DvzController DvzController;
+typedef struct DvzPick DvzPick;
 
 
 
@@ -100,9 +102,19 @@ struct DvzPanel
     // GPU objects
     DvzBufferRegions br_mvp; // for the uniform buffer containing the MVP
 
+    // Version of the MVP, incremented when it changes, and version uploaded to every region.
+    DvzMVP mvp_last;
+    uint64_t mvp_version;
+    uint64_t mvp_uploaded[DVZ_MAX_SWAPCHAIN_IMAGES];
+    uint32_t mvp_img_count;
+
     DvzController* controller;
     DvzCommands* cmds;
     int prority_max;
+
+    // Viewport culling of the visuals.
+    bool culling;
+    DvzCullStats cull_stats;
 };
 
 
@@ -123,6 +135,17 @@ struct DvzGrid
 
 
 
+// Result of a CPU picking query, sorted by increasing distance.
+struct DvzPick
+{
+    uint32_t count;
+    DvzVisual* visuals[DVZ_PICK_MAX_ITEMS];
+    uint32_t items[DVZ_PICK_MAX_ITEMS];   // item indices within the visuals' POS props
+    double distances[DVZ_PICK_MAX_ITEMS]; // in screen pixels
+};
+
+
+
 /*************************************************************************************************/
 /*  Functions                                                                                    */
 /*************************************************************************************************/
@@ -272,6 +295,41 @@ DVZ_EXPORT bool dvz_panel_contains(DvzPanel* panel, vec2 pos);
  */
 DVZ_EXPORT DvzPanel* dvz_panel_at(DvzGrid* grid, vec2 pos);
 
+/**
+ * Find the items closest to a position, among the visuals of a panel with a spatial index.
+ *
+ * The screen position is mapped to the data coordinates with the current panel transformations.
+ * Only the xy coordinates are taken into account, which is suitable for 2D panels.
+ *
+ * @param panel the panel
+ * @param screen_pos the position in screen coordinates (pixels)
+ * @param radius the maximum distance to the items, in pixels
+ * @returns the nearest items, at most `DVZ_PICK_MAX_ITEMS`
+ */
+DVZ_EXPORT DvzPick dvz_panel_pick(DvzPanel* panel, vec2 screen_pos, float radius);
+
+/**
+ * Enable or disable the viewport culling of the visuals of a panel.
+ *
+ * At every frame, the bounding boxes of chunks of vertices of the visuals are tested against the
+ * current view of the panel. The visuals outside of the view are not drawn, and only the range
+ * of visible chunks of the other ones is drawn. Only the visuals with a single graphics pipeline
+ * and the default fill callback, and that move with the panel view, are culled. The visuals with
+ * an index buffer or a depth sort are either drawn entirely or skipped.
+ *
+ * @param panel the panel
+ * @param enable whether to enable the culling
+ */
+DVZ_EXPORT void dvz_panel_culling(DvzPanel* panel, bool enable);
+
+/**
+ * Return the culling statistics of the last frame of a panel.
+ *
+ * @param panel the panel
+ * @returns the number of culled visuals and vertices
+ */
+DVZ_EXPORT DvzCullStats dvz_panel_cull_stats(DvzPanel* panel);
+
 /**
  * Destroy a panel and all visuals inside it.
  *
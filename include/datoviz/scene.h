@@ -99,6 +99,7 @@ typedef struct DvzSceneUpdate DvzSceneUpdate;
 typedef struct DvzController DvzController;
 typedef struct DvzTransformOLD DvzTransformOLD;
 typedef struct DvzAxes2D DvzAxes2D;
+typedef struct DvzMVPStats DvzMVPStats;
 typedef union DvzControllerUnion DvzControllerUnion;
 
 typedef void (*DvzControllerCallback)(DvzController* controller, DvzEvent ev);
@@ -162,6 +163,17 @@ struct DvzController
 
 
 
+struct DvzMVPStats
+{
+    uint32_t panel_count; // panels with a controller at the last frame
+    uint32_t uploads;     // MVP uploads at the last frame
+    uint64_t bytes;       // bytes uploaded at the last frame
+    uint64_t total_uploads;
+    uint64_t total_bytes;
+};
+
+
+
 struct DvzScene
 {
     DvzObject obj;
@@ -178,6 +190,9 @@ struct DvzScene
 
     // FIFO queue with the pending scene updates.
     DvzFifo update_fifo;
+
+    // Uploads of the MVP uniforms of the panels.
+    DvzMVPStats mvp_stats;
 };
 
 
@@ -291,7 +306,8 @@ dvz_controller_builtin(DvzPanel* panel, DvzControllerType type, int flags);
  * @param row the row index (0-based)
  * @param col the column index (0-based)
  * @param type the controller type
- * @param flags flags for the builtin controller
+ * @param flags flags for the builtin controller, `DVZ_GRAPHICS_FLAGS_INSTANCED` draws the 2D axes
+ *      segments with instancing
  * @returns the panel
  */
 DVZ_EXPORT DvzPanel*
@@ -375,6 +391,17 @@ DVZ_EXPORT void dvz_camera_look(DvzPanel* panel, vec3 center);
  */
 DVZ_EXPORT void dvz_arcball_rotate(DvzPanel* panel, float angle, vec3 axis);
 
+/**
+ * Return the statistics of the uploads of the MVP uniforms of the panels.
+ *
+ * The MVP of a panel is only uploaded when it has changed, once for every swapchain image. The
+ * MVP time is therefore only up to date after a change of the MVP.
+ *
+ * @param scene the scene
+ * @returns the number of uploads and of uploaded bytes at the last frame, and in total
+ */
+DVZ_EXPORT DvzMVPStats dvz_scene_mvp_stats(DvzScene* scene);
+
 // TODO: panzoom functions
 
 
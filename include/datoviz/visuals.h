@@ -8,6 +8,7 @@
 #include "array.h"
 #include "context.h"
 #include "graphics.h"
+#include "mesh.h"
 #include "transforms.h"
 #include "vklite.h"
 
@@ -22,6 +23,48 @@
 #define DVZ_MAX_VISUAL_PRIORITY     4
 #define DVZ_MAX_UNIFORM_SIZE        65536
 
+#define DVZ_LOD_MAX_LEVELS    16
+#define DVZ_LOD_BUCKET_BASE   16 // number of samples per bucket in the finest level
+#define DVZ_LOD_BUCKET_FACTOR 4  // ratio between the bucket sizes of successive levels
+
+#define DVZ_SPATIAL_ITEMS_PER_CELL 4         // average number of items per cell of the grid
+#define DVZ_SPATIAL_MAX_CELLS      (1 << 20) // maximum number of cells of the grid
+#define DVZ_SPATIAL_MAX_THREADS    16
+#define DVZ_SPATIAL_MIN_CHUNK      65536 // minimum number of items per thread when building
+
+#define DVZ_TILES_MAX_LEVELS   16
+#define DVZ_TILES_MAX_WORKERS  8
+#define DVZ_TILES_MIN_SLOTS    16                 // minimum number of tiles in the atlas
+#define DVZ_TILES_MAX_SIZE     8192               // maximum width and height of the atlas
+#define DVZ_TILES_MAX_REQUESTS 32                 // maximum number of tiles being decoded at once
+#define DVZ_TILES_BUDGET       (64 * 1024 * 1024) // default memory budget of the atlas, in bytes
+
+#define DVZ_BRICKS_MAX_LEVELS   12
+#define DVZ_BRICKS_MAX_WORKERS  8
+#define DVZ_BRICKS_MAX_THREADS  16                  // threads preparing the pyramid
+#define DVZ_BRICKS_MIN_SLOTS    8                   // minimum number of bricks in the atlas
+#define DVZ_BRICKS_MAX_SIZE     2048                // maximum size of the atlas along each axis
+#define DVZ_BRICKS_MAX_PAGES    256                 // maximum number of finest bricks per axis
+#define DVZ_BRICKS_MAX_REQUESTS 32                  // maximum number of bricks being prepared
+#define DVZ_BRICKS_BUDGET       (256 * 1024 * 1024) // default memory budget of the atlas, in bytes
+
+// A FIFO queue holds one item less than its capacity: the request queues also hold the stop
+// requests of the workers, and must never need to be enlarged beyond the maximum capacity.
+#if DVZ_TILES_MAX_REQUESTS + DVZ_TILES_MAX_WORKERS + 1 > DVZ_MAX_FIFO_CAPACITY
+#error "the tile request queue exceeds the maximum FIFO capacity"
+#endif
+#if DVZ_BRICKS_MAX_REQUESTS + DVZ_BRICKS_MAX_WORKERS + 1 > DVZ_MAX_FIFO_CAPACITY
+#error "the brick request queue exceeds the maximum FIFO capacity"
+#endif
+
+#define DVZ_MESH_LOD_LEVELS      6   // default number of levels of detail of a mesh visual
+#define DVZ_MESH_LOD_PIXEL_ERROR 1.0 // largest projected error of the selected level, in pixels
+
+#define DVZ_CULL_CHUNK_SIZE 6144 // vertices per chunk, a multiple of the primitive sizes
+#define DVZ_CULL_MARGIN     32   // minimum margin around the viewport, in pixels
+
+#define DVZ_DEPTH_SORT_MAX_MOVES 8 // moves per primitive of an incremental sort before a full sort
+
 
 /*************************************************************************************************/
 /*  Enums                                                                                        */
@@ -75,6 +118,7 @@ typedef enum
     DVZ_PROP_INDEX,
     DVZ_PROP_SCALE,
     DVZ_PROP_TRANSFORM,
+    DVZ_PROP_SHAPE,
 } DvzPropType;
 
 
@@ -159,6 +203,23 @@ typedef struct DvzProp DvzProp;
 typedef union DvzSourceUnion DvzSourceUnion;
 typedef struct DvzSource DvzSource;
 
+typedef struct DvzLod DvzLod;
+typedef struct DvzSpatialIndex DvzSpatialIndex;
+typedef struct DvzTiles DvzTiles;
+typedef struct DvzTileSlot DvzTileSlot;
+typedef struct DvzTileRequest DvzTileRequest;
+typedef struct DvzTileStats DvzTileStats;
+typedef struct DvzBricks DvzBricks;
+typedef struct DvzBrickSlot DvzBrickSlot;
+typedef struct DvzBrickRequest DvzBrickRequest;
+typedef struct DvzBrickStats DvzBrickStats;
+typedef struct DvzMeshLevels DvzMeshLevels;
+typedef struct DvzMeshLevelStats DvzMeshLevelStats;
+typedef struct DvzCulling DvzCulling;
+typedef struct DvzCullStats DvzCullStats;
+typedef struct DvzDepthSort DvzDepthSort;
+typedef struct DvzDepthSortStats DvzDepthSortStats;
+
 typedef struct DvzVisualFillEvent DvzVisualFillEvent;
 typedef struct DvzVisualDataEvent DvzVisualDataEvent;
 
@@ -171,6 +232,13 @@ typedef uint32_t DvzIndex;
 /*************************************************************************************************/
 
 typedef void (*DvzVisualFillCallback)(DvzVisual* visual, DvzVisualFillEvent ev);
+
+// Called on a worker thread to decode a tile of a tiled image. The tile has tile_size x tile_size
+// pixels (row-major, pixel_size bytes per pixel), only the first shape[0] x shape[1] ones are
+// within the image.
+typedef void (*DvzTileCallback)(
+    DvzTiles* tiles, uint32_t level, uint32_t col, uint32_t row, uvec2 shape, void* pixels,
+    void* user_data);
 /*
 called by the scene event callback in response to a REFILL event
 default fill callback: viewport, bind vbuf, ibuf, etc. bind the first graphics only and no
@@ -251,6 +319,394 @@ struct DvzProp
     DvzArrayCopyType copy_type;
     uint32_t reps; // number of repeats when copying
     // bool is_set; // whether the user has set this prop
+
+    DvzSpatialIndex* spatial; // optional spatial index, for POS props only
+};
+
+
+
+/*************************************************************************************************/
+/*  Level of detail                                                                              */
+/*************************************************************************************************/
+
+// Multi-resolution min/max pyramid of a line strip or path visual. At every level, the samples are
+// grouped into buckets, and the indices of the samples with the lowest and highest y values are
+// kept for each bucket. Only the buckets of the visible slice are uploaded, each bucket being
+// replaced by its first, min, max, and last samples (M4 aggregation).
+struct DvzLod
+{
+    uint32_t sample_count; // number of samples the pyramid was built from
+    uint32_t level_count;  // 0 if the pyramid could not be built (x values not increasing)
+    uint32_t bucket_size[DVZ_LOD_MAX_LEVELS];
+    uint32_t bucket_count[DVZ_LOD_MAX_LEVELS];
+    uint32_t* extrema[DVZ_LOD_MAX_LEVELS]; // indices of the min and max samples of each bucket
+
+    // Visible x range, in normalized coordinates, and viewport width, in pixels.
+    dvec2 xlim;
+    uint32_t width;
+
+    // Current slice: level (-1 for the full resolution) and range of samples.
+    int32_t level;
+    uint32_t first, last;
+    uint32_t vertex_count; // number of vertices in the uploaded slice
+    bool window_changed;   // the slice must be recomputed
+    bool data_changed;     // the POS prop has changed, the pyramid must be rebuilt
+};
+
+
+
+/*************************************************************************************************/
+/*  Spatial index                                                                                */
+/*************************************************************************************************/
+
+// Uniform 2D grid over the xy data coordinates of a POS prop, used for CPU picking. The items are
+// sorted by cell (counting sort). Items modified by a partial data update and leaving their cell
+// are flagged as moved and kept in an overflow list until the next full rebuild.
+struct DvzSpatialIndex
+{
+    uint32_t item_count;
+    dvec2 p0, p1;         // bounds of the grid, in data coordinates
+    uint32_t nx, ny;      // number of cells along each axis
+    dvec2 scale;          // inverse of the cell size
+    uint32_t* cell_start; // first item of each cell in items (nx * ny + 1 values)
+    uint32_t* items;      // item indices, sorted by cell
+    uint32_t* cell_of;    // cell of each item at build time
+    uint8_t* moved;       // whether each item has left its cell since the last build
+
+    uint32_t overflow_count, overflow_capacity;
+    uint32_t* overflow; // moved items, tested individually
+    bool dirty;         // the index must be rebuilt before the next query
+};
+
+
+
+/*************************************************************************************************/
+/*  Tiled image                                                                                  */
+/*************************************************************************************************/
+
+// Tile slot states.
+typedef enum
+{
+    DVZ_TILE_SLOT_FREE,
+    DVZ_TILE_SLOT_PENDING,  // the tile is being decoded by a worker
+    DVZ_TILE_SLOT_RESIDENT, // the tile has been uploaded to the atlas
+} DvzTileSlotState;
+
+
+
+struct DvzTileSlot
+{
+    uint64_t key; // level, column, and row of the tile in the slot
+    uint64_t last_used;
+    DvzTileSlotState state;
+};
+
+
+
+struct DvzTileRequest
+{
+    DvzTiles* tiles; // NULL = stop the worker
+    uint64_t key;
+    uint32_t slot;
+    uint32_t level, col, row;
+    uvec2 shape;
+    void* pixels;
+};
+
+
+
+struct DvzTileStats
+{
+    uint64_t hits;      // visible tiles found in the atlas
+    uint64_t misses;    // visible tiles drawn with a coarser tile while being decoded
+    uint64_t uploads;   // tiles uploaded to the atlas
+    uint64_t evictions; // tiles evicted from the atlas to make room for new ones
+    uint32_t resident;  // number of tiles in the atlas
+    uint32_t pending;   // number of tiles being decoded
+};
+
+
+
+// Multi-resolution pyramid of fixed-size tiles of a large image, level 0 being the full
+// resolution and every level halving the previous one. The visible tiles of the level matching
+// the screen resolution are decoded on worker threads and uploaded to the slots of an atlas
+// texture, the least recently used tiles being evicted when the atlas is full. Missing tiles are
+// drawn with the part of their closest resident ancestor.
+struct DvzTiles
+{
+    DvzVisual* visual;
+
+    // Pyramid.
+    uvec2 size; // size of the full resolution image, in pixels
+    uint32_t tile_size;
+    uint32_t pixel_size; // in bytes
+    VkFormat format;
+    uint32_t level_count;
+    DvzTileCallback callback;
+    void* user_data;
+
+    // Atlas.
+    DvzTexture* atlas;
+    uint32_t slot_count;
+    uint32_t cols, rows; // number of slots along each axis of the atlas
+    DvzTileSlot* slots;
+    uint32_t map_capacity; // power of two, larger than twice the number of slots
+    uint64_t* map_keys;    // open addressing hash map from tile keys to slots
+    uint32_t* map_slots;
+
+    // Image bounds in normalized coordinates (top left and bottom right corners), visible
+    // rectangle, and viewport size, in pixels.
+    dvec2 p0, p1;
+    dvec2 xlim, ylim;
+    uvec2 viewport;
+
+    // Current view.
+    uint64_t frame;
+    uint32_t level;
+    uint32_t c0, c1, r0, r1; // range of visible tiles at the current level
+    uint32_t quad_count;
+
+    // Decoding workers.
+    uint32_t worker_count;
+    DvzThread workers[DVZ_TILES_MAX_WORKERS];
+    DvzFifo request_queue;
+    DvzFifo done_queue;
+    uint32_t uploaded_count, uploaded_capacity;
+    DvzTileRequest** uploaded; // freed once their transfer has been processed
+
+    DvzTileStats stats;
+};
+
+
+
+/*************************************************************************************************/
+/*  Bricked volume                                                                               */
+/*************************************************************************************************/
+
+struct DvzBrickSlot
+{
+    uint32_t brick; // index of the brick in the slot, over all levels
+    uint64_t last_used;
+    DvzTileSlotState state; // same states as the slots of a tiled image
+};
+
+
+
+struct DvzBrickRequest
+{
+    DvzBricks* bricks; // NULL = stop the worker
+    uint32_t brick;
+    uint32_t slot;
+    void* voxels;
+};
+
+
+
+struct DvzBrickStats
+{
+    uint64_t hits;      // visible bricks found in the atlas
+    uint64_t misses;    // visible bricks drawn with a coarser brick while being prepared
+    uint64_t uploads;   // bricks uploaded to the atlas
+    uint64_t evictions; // bricks evicted from the atlas to make room for new ones
+    uint32_t resident;  // number of bricks in the atlas
+    uint32_t pending;   // number of bricks being prepared
+    uint32_t visible;   // number of non-empty bricks in the view, at the current level
+    uint32_t empty;     // number of empty bricks in the view, never uploaded
+    uint32_t culled;    // number of bricks outside of the view
+};
+
+
+
+// Multi-resolution pyramid of a large 3D volume split into fixed-size bricks, level 0 being the
+// full resolution and every level halving the previous one. The coarser levels and the minimum
+// and maximum value of every brick are computed in parallel when the volume is set. The bricks
+// in the view, at the level matching the screen resolution, are streamed to the slots of a 3D
+// atlas texture, the least recently used ones being evicted when the atlas is full. A page table
+// texture gives, for every brick of the finest level, the atlas origin and the level of the brick
+// to sample, or whether it is empty and can be skipped by the ray marching.
+struct DvzBricks
+{
+    DvzVisual* visual;
+
+    // Pyramid.
+    uvec3 shape; // number of voxels along each axis of the full resolution volume
+    uint32_t brick_size;
+    uint32_t voxel_size; // in bytes
+    VkFormat format;
+    uint32_t level_count;
+    uvec3 level_shape[DVZ_BRICKS_MAX_LEVELS];
+    uvec3 grid[DVZ_BRICKS_MAX_LEVELS];           // number of bricks along each axis
+    uint32_t first_brick[DVZ_BRICKS_MAX_LEVELS]; // index of the first brick of each level
+    void* levels[DVZ_BRICKS_MAX_LEVELS];         // the first one is the user data, not owned
+    uint32_t brick_count;                        // over all levels
+    uint16_t* minmax;                            // minimum and maximum value of each brick
+    uint32_t* brick_slot;                        // atlas slot of each brick
+
+    // Atlas and page table.
+    DvzTexture* atlas;
+    uvec3 slots_shape; // number of slots along each axis of the atlas
+    uint32_t slot_count;
+    DvzBrickSlot* slots;
+    DvzTexture* page_table;
+    vec4* pages; // atlas origin, in voxels, and level of the brick sampled in each finest brick
+    bool pages_dirty;
+
+    // Current view.
+    DvzMVP mvp;
+    vec3 box_size;
+    uvec2 viewport;
+    uint64_t frame;
+    uint32_t level;
+    uint32_t visible_count, visible_capacity;
+    uint32_t* visible; // non-empty bricks in the view, at the current level
+
+    // Preparation workers.
+    uint32_t worker_count;
+    DvzThread workers[DVZ_BRICKS_MAX_WORKERS];
+    DvzFifo request_queue;
+    DvzFifo done_queue;
+    uint32_t uploaded_count, uploaded_capacity;
+    DvzBrickRequest** uploaded; // freed once their transfer has been processed
+
+    DvzBrickStats stats;
+};
+
+
+
+/*************************************************************************************************/
+/*  Mesh levels of detail                                                                        */
+/*************************************************************************************************/
+
+struct DvzMeshLevelStats
+{
+    uint32_t level;       // selected level, 0 being the original mesh
+    uint32_t level_count; // 1 until the simplification is done
+    uint32_t face_count;  // number of faces drawn
+    uint32_t switches;    // number of changes of the selected level
+    float pixel_radius;   // projected radius of the mesh, in pixels
+    float pixel_error;    // projected error of the selected level, in pixels
+};
+
+
+
+// Chain of simplified levels of a mesh visual, computed by a worker thread and stored after the
+// original faces in the index buffer. At every frame, the coarsest level whose geometric error,
+// projected with the MVP of the panel, is below a pixel is selected, and only its index range is
+// drawn.
+struct DvzMeshLevels
+{
+    DvzVisual* visual;
+
+    // Simplification worker, working on a copy of the mesh.
+    DvzMesh mesh;
+    uint32_t level_count; // requested number of levels
+    DvzThread worker;
+    atomic(bool, done);
+    atomic(bool, cancel);
+    bool ready; // whether the levels have been uploaded
+    DvzMeshLod lod;
+
+    // Current view.
+    uint32_t level;
+    uint32_t first_index, index_count; // index range drawn, all indices if the count is 0
+
+    DvzMeshLevelStats stats;
+};
+
+
+
+/*************************************************************************************************/
+/*  Viewport culling                                                                             */
+/*************************************************************************************************/
+
+// Bounding boxes, in normalized coordinates, of the chunks of DVZ_CULL_CHUNK_SIZE vertices (or
+// instances) of the vertex buffer of a visual. At every frame, the boxes are projected with the
+// MVP of the panel, only the range between the first and last visible chunks is drawn, and the
+// visual is skipped when no chunk is visible.
+struct DvzCulling
+{
+    uint32_t vertex_count; // number of vertices, or instances, the boxes were computed from
+    uint32_t chunk_count;  // 0 if the vertices have no 3D positions, in which case all are drawn
+    vec3* box_min;
+    vec3* box_max;
+    uint32_t overlap; // number of vertices shared with the next chunk, for strip topologies
+    bool indexed;     // the vertices are drawn with an index buffer: all or nothing is drawn
+    bool dirty;       // the boxes must be recomputed
+    float margin;     // margin around the viewport, in pixels, for the sizes and widths
+
+    // Current view.
+    bool visible;
+    uint32_t first, count; // range of vertices, or instances, drawn
+};
+
+
+
+struct DvzCullStats
+{
+    uint32_t visual_count;   // visuals with culling in the panel
+    uint32_t culled_visuals; // visuals entirely outside of the view
+    uint32_t draw_count;     // draw calls of these visuals
+    uint64_t vertex_count;   // vertices, or instances, of these visuals
+    uint64_t culled_count;   // vertices, or instances, not drawn
+    uint32_t refills;        // command buffer refills caused by changes of the drawn ranges
+};
+
+
+
+/*************************************************************************************************/
+/*  Depth sort                                                                                   */
+/*************************************************************************************************/
+
+struct DvzDepthSortStats
+{
+    uint32_t primitive_count; // number of sorted points or triangles
+    uint64_t sort_count;      // number of sorts
+    uint64_t full_count;      // sorts that could not start from the previous order
+    uint64_t moves;           // number of moves of the last incremental sort
+    double duration;          // duration of the last sort, in seconds
+};
+
+
+
+// Back-to-front order of the points or triangles of a translucent visual, drawn with a dedicated
+// index buffer. The primitives are sorted by the view depth of their centers on a worker thread
+// whenever the model-view matrix of the panel changes, starting from the previous order.
+struct DvzDepthSort
+{
+    DvzVisual* visual;
+
+    // Primitives, copied from the vertex and index arrays of the visual.
+    uint32_t vertex_count, index_count; // sizes of the arrays the primitives were built from
+    uint32_t primitive_size;            // 1 for points, 3 for triangles
+    uint32_t primitive_count;
+    vec3* centers;
+    DvzIndex* primitives; // vertex indices of every primitive, NULL without index array
+    bool dirty;           // the primitives must be copied again
+
+    // Sort, done by the worker.
+    uint32_t* order; // primitives sorted back to front
+    uint32_t* keys;  // depth of the primitives, in the current order
+    uint32_t* tmp_order;
+    uint32_t* tmp_keys;
+    bool has_order;     // whether the order comes from a previous sort
+    DvzIndex* sorted;   // vertex indices of the sorted primitives
+    mat4 mv;            // model-view matrix of the last sort
+    bool needs_sort;    // a sort is needed even if the view has not changed
+    bool pending;       // a sort has been requested and its result not uploaded yet
+    DvzDepthSortStats run_stats;
+
+    // Index buffer, uploaded by the main thread.
+    DvzIndex* indices;
+    DvzBufferRegions br;
+    bool ready; // whether the index buffer holds a sorted order of the current primitives
+
+    // Worker.
+    DvzThread worker;
+    DvzFifo queue;
+    atomic(bool, busy);
+    atomic(bool, cancel);
+
+    DvzDepthSortStats stats;
 };
 
 
@@ -302,10 +758,29 @@ struct DvzVisual
     DvzInteractAxis interact_axis[DVZ_MAX_GRAPHICS_PER_VISUAL];
     DvzViewportClip clip[DVZ_MAX_GRAPHICS_PER_VISUAL];
     DvzViewport viewport; // usually the visual's panel viewport, but may be customized
+    uint32_t pick_id;     // nonzero visual id written in the ID buffer for GPU picking
 
     // GPU data
     DvzContainer bindings;
     DvzContainer bindings_comp;
+
+    // Optional level of detail.
+    DvzLod* lod;
+
+    // Optional tiled image.
+    DvzTiles* tiles;
+
+    // Optional bricked volume.
+    DvzBricks* bricks;
+
+    // Optional levels of detail of a mesh.
+    DvzMeshLevels* mesh_levels;
+
+    // Viewport culling, when enabled in the panel.
+    DvzCulling* culling;
+
+    // Optional back-to-front order of translucent primitives.
+    DvzDepthSort* depth_sort;
 };
 
 
@@ -520,6 +995,73 @@ DVZ_EXPORT void dvz_visual_data_partial(
 DVZ_EXPORT void dvz_visual_data_append(
     DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count, const void* data);
 
+/**
+ * Set the data for a given visual prop without copying it.
+ *
+ * The visual references the buffer until the next update of the prop or until the visual is
+ * destroyed: the buffer must remain valid and unchanged until then, or be passed again after it
+ * has been modified. It is never freed by the visual.
+ *
+ * @param visual the visual
+ * @param prop_type the prop type
+ * @param prop_idx the prop index
+ * @param count the number of elements in the buffer
+ * @param data the data, that should be in the dtype of the prop
+ */
+DVZ_EXPORT void dvz_visual_data_borrow(
+    DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count, void* data);
+
+/**
+ * Set the data for a given visual prop from a buffer of another dtype.
+ *
+ * The buffer is converted to the dtype of the prop, which must have the same number of
+ * components, for example `DVZ_DTYPE_VEC3` data for a `DVZ_DTYPE_DVEC3` prop.
+ *
+ * @param visual the visual
+ * @param prop_type the prop type
+ * @param prop_idx the prop index
+ * @param count the number of elements in the buffer
+ * @param dtype the dtype of the buffer
+ * @param data the data
+ */
+DVZ_EXPORT void dvz_visual_data_convert(
+    DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count,
+    DvzDataType dtype, const void* data);
+
+/**
+ * Enable or disable the spatial index of a POS prop, used by `dvz_panel_pick()`.
+ *
+ * The index is a uniform grid over the xy data coordinates, built in parallel. It is updated
+ * incrementally by `dvz_visual_data_partial()`, and rebuilt lazily after a full data update.
+ *
+ * @param visual the visual
+ * @param prop_idx the index of the POS prop
+ * @param enable whether to enable the spatial index
+ */
+DVZ_EXPORT void dvz_visual_spatial_index(DvzVisual* visual, uint32_t prop_idx, bool enable);
+
+/**
+ * Enable or disable the depth sort of the points or triangles of a translucent visual.
+ *
+ * The primitives are drawn back to front, in the order of the depth of their centers in the view.
+ * They are sorted again on a worker thread whenever the model-view matrix of the panel changes,
+ * starting from the previous order. Only visuals with point or triangle lists and the default
+ * fill callback are supported. With viewport culling, the sorted visual is either drawn entirely
+ * or skipped.
+ *
+ * @param visual the visual
+ * @param enable whether to enable the depth sort
+ */
+DVZ_EXPORT void dvz_visual_depth_sort(DvzVisual* visual, bool enable);
+
+/**
+ * Return the statistics of the depth sort of a visual.
+ *
+ * @param visual the visual
+ * @returns the number of sorts and the duration of the last one
+ */
+DVZ_EXPORT DvzDepthSortStats dvz_visual_depth_sort_stats(DvzVisual* visual);
+
 /**
  * Set partial data for a given source.
  *
@@ -81,6 +81,10 @@ typedef struct DvzImages DvzImages;
 typedef struct DvzSampler DvzSampler;
 typedef struct DvzSlots DvzSlots;
 typedef struct DvzBindings DvzBindings;
+typedef struct DvzDescriptor DvzDescriptor;
+typedef struct DvzBindingsCacheEntry DvzBindingsCacheEntry;
+typedef struct DvzBindingsCache DvzBindingsCache;
+typedef struct DvzBindingsStats DvzBindingsStats;
 typedef struct DvzCompute DvzCompute;
 typedef struct DvzVertexBinding DvzVertexBinding;
 typedef struct DvzVertexAttr DvzVertexAttr;
@@ -314,6 +318,63 @@ struct DvzQueues
     uint32_t queue_indices[DVZ_MAX_QUEUES];  // for each requested queue, its # within its family
     VkQueue queues[DVZ_MAX_QUEUES];
     VkCommandPool cmd_pools[DVZ_MAX_QUEUE_FAMILIES];
+
+    // Vulkan requires external synchronization of the queues when several threads submit to them
+    pthread_mutex_t locks[DVZ_MAX_QUEUES];
+};
+
+
+
+// Resource written in a descriptor, either a buffer region or an image with its sampler.
+struct DvzDescriptor
+{
+    VkDescriptorBufferInfo buffer;
+    VkDescriptorImageInfo image;
+};
+
+
+
+// Descriptor sets shared by the bindings with the same slot types and the same resources.
+struct DvzBindingsCacheEntry
+{
+    uint32_t slot_count;
+    VkDescriptorType types[DVZ_MAX_BINDINGS_SIZE];
+    VkDescriptorSetLayout dset_layout; // owned by the entry, compatible with the slots layouts
+
+    uint32_t dset_count;
+    VkDescriptorSet dsets[DVZ_MAX_SWAPCHAIN_IMAGES];
+
+    bool written;               // whether the descriptors below have been written to the sets
+    uint64_t hash;              // hash of the descriptors
+    DvzDescriptor* descriptors; // dset_count * slot_count descriptors
+    uint32_t ref_count;         // number of bindings using the sets
+    uint64_t released;          // serial of the cache when the last bindings released the sets
+};
+
+
+
+struct DvzBindingsStats
+{
+    uint64_t updates; // number of calls to dvz_bindings_update()
+    uint64_t writes;  // number of descriptors written
+    uint64_t skipped; // number of unchanged descriptors that were not written again
+    uint64_t hits;    // updates that reused the descriptor sets of other bindings
+    uint64_t misses;  // updates that wrote their own descriptor sets
+    uint32_t entry_count;
+    uint32_t dset_count; // number of descriptor sets allocated by the cache
+};
+
+
+
+// The sets released by all their bindings may still be used by command buffers that have not
+// been refilled or have not completed: they are only reused once retired.
+struct DvzBindingsCache
+{
+    uint32_t entry_count;
+    DvzBindingsCacheEntry** entries;
+    uint64_t serial;  // number of releases of entries by all their bindings
+    uint64_t retired; // the entries released up to this serial are no longer used by the GPU
+    DvzBindingsStats stats;
 };
 
 
@@ -336,10 +397,15 @@ struct DvzGpu
 
     DvzQueues queues;
     VkDescriptorPool dset_pool;
+    DvzBindingsCache bindings_cache;
 
     VkPhysicalDeviceFeatures requested_features;
     VkDevice device;
 
+    // Recursive lock protecting the command pools and the context resources (staging buffer,
+    // transfer command buffer) when several canvases prepare their frames in parallel
+    pthread_mutex_t lock;
+
     DvzContext* context;
 };
 
@@ -502,6 +568,7 @@ struct DvzBindings
     // with the same layout, but possibly with the different idx in the DvzBuffer
     uint32_t dset_count;
     VkDescriptorSet dsets[DVZ_MAX_SWAPCHAIN_IMAGES];
+    DvzBindingsCacheEntry* entry; // cache entry owning the descriptor sets
 
     DvzBufferRegions br[DVZ_MAX_BINDINGS_SIZE];
     DvzImages* images[DVZ_MAX_BINDINGS_SIZE];
@@ -531,6 +598,7 @@ struct DvzVertexBinding
 {
     uint32_t binding;
     VkDeviceSize stride;
+    VkVertexInputRate input_rate;
 };
 
 
@@ -562,6 +630,7 @@ struct DvzGraphics
     VkPolygonMode polygon_mode;
     VkCullModeFlags cull_mode;
     VkFrontFace front_face;
+    bool pick; // whether the fragment shader writes to the extra color attachments (ID buffer)
 
     VkPipeline pipeline;
     DvzSlots slots;
@@ -572,6 +641,9 @@ struct DvzGraphics
     uint32_t vertex_attr_count;
     DvzVertexAttr vertex_attrs[DVZ_MAX_VERTEX_ATTRS];
 
+    // Number of vertices of the primitive drawn for every instance, 0 if not instanced
+    uint32_t instance_vertex_count;
+
     uint32_t shader_count;
     VkShaderStageFlagBits shader_stages[DVZ_MAX_SHADERS_PER_GRAPHICS];
     VkShaderModule shader_modules[DVZ_MAX_SHADERS_PER_GRAPHICS];
@@ -837,6 +909,23 @@ DVZ_EXPORT void dvz_gpu_create(DvzGpu* gpu, VkSurfaceKHR surface);
  */
 DVZ_EXPORT void dvz_queue_wait(DvzGpu* gpu, uint32_t queue_idx);
 
+/**
+ * Acquire the GPU lock.
+ *
+ * This lock must be held when recording command buffers or using the shared context resources
+ * from a thread other than the main thread. It is recursive.
+ *
+ * @param gpu the GPU
+ */
+DVZ_EXPORT void dvz_gpu_lock(DvzGpu* gpu);
+
+/**
+ * Release the GPU lock.
+ *
+ * @param gpu the GPU
+ */
+DVZ_EXPORT void dvz_gpu_unlock(DvzGpu* gpu);
+
 /**
  * Full synchronization on all GPUs.
  *
@@ -1506,6 +1595,10 @@ DVZ_EXPORT void dvz_bindings_texture(DvzBindings* bindings, uint32_t idx, DvzTex
 /**
  * Update the bindings after the buffers/textures have been set up.
  *
+ * Only the descriptors whose resources have changed since the last update are written. Bindings
+ * with the same slot types and the same resources share their descriptor sets, which may then
+ * change: the command buffers using the bindings must be refilled in that case.
+ *
  * @param bindings the bindings
  */
 DVZ_EXPORT void dvz_bindings_update(DvzBindings* bindings);
@@ -1517,6 +1610,27 @@ DVZ_EXPORT void dvz_bindings_update(DvzBindings* bindings);
  */
 DVZ_EXPORT void dvz_bindings_destroy(DvzBindings* bindings);
 
+/**
+ * Return the statistics of the descriptor set updates and of the descriptor set cache of a GPU.
+ *
+ * @param gpu the GPU
+ * @returns the numbers of written and skipped descriptors, and of cache hits and misses
+ */
+DVZ_EXPORT DvzBindingsStats dvz_bindings_stats(DvzGpu* gpu);
+
+/**
+ * Allow the reuse of the descriptor sets released by destroyed or updated bindings.
+ *
+ * The descriptor sets released by all their bindings are only reused by new bindings once no
+ * command buffer uses them anymore. The main loop calls this function once the command buffers
+ * of all canvases of the GPU have been refilled.
+ *
+ * @param gpu the GPU
+ * @param serial the serial of the bindings cache (`gpu->bindings_cache.serial`) before the
+ *      command buffers stopped using the released descriptor sets
+ */
+DVZ_EXPORT void dvz_bindings_retire(DvzGpu* gpu, uint64_t serial);
+
 
 
 /*************************************************************************************************/
@@ -1655,6 +1769,19 @@ dvz_graphics_shader(DvzGraphics* graphics, VkShaderStageFlagBits stage, const ch
 DVZ_EXPORT void
 dvz_graphics_vertex_binding(DvzGraphics* graphics, uint32_t binding, VkDeviceSize stride);
 
+/**
+ * Make the vertices of a binding per-instance attributes.
+ *
+ * Every item of the vertex buffer is then drawn as an instance of a shared primitive with
+ * `vertex_count` vertices, whose index is given by `gl_VertexIndex` in the vertex shader.
+ *
+ * @param graphics the graphics pipeline
+ * @param binding the binding index
+ * @param vertex_count the number of vertices of the primitive drawn for every instance
+ */
+DVZ_EXPORT void
+dvz_graphics_instanced(DvzGraphics* graphics, uint32_t binding, uint32_t vertex_count);
+
 /**
  * Add a vertex attribute.
  *
@@ -1676,6 +1803,18 @@ DVZ_EXPORT void dvz_graphics_vertex_attr(
  */
 DVZ_EXPORT void dvz_graphics_blend(DvzGraphics* graphics, DvzBlendType blend_type);
 
+/**
+ * Set whether the graphics fragment shader writes to the extra color attachments.
+ *
+ * The extra color attachments of the subpass, if any, follow the first one (for example, the ID
+ * buffer used for GPU picking). They are left untouched by graphics pipelines that do not write
+ * to them.
+ *
+ * @param graphics the graphics pipeline
+ * @param pick whether the fragment shader writes to the extra color attachments
+ */
+DVZ_EXPORT void dvz_graphics_pick(DvzGraphics* graphics, bool pick);
+
 /**
  * Set the graphics depth test.
  *
@@ -2186,6 +2325,21 @@ DVZ_EXPORT void dvz_cmd_barrier(DvzCommands* cmds, uint32_t idx, DvzBarrier* bar
 DVZ_EXPORT void dvz_cmd_copy_buffer_to_image(
     DvzCommands* cmds, uint32_t idx, DvzBuffer* buffer, DvzImages* images);
 
+/**
+ * Copy a part of a GPU buffer to a region of a GPU image.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param buffer the buffer
+ * @param buf_offset the offset of the tightly-packed region data in the buffer, in bytes
+ * @param images the image
+ * @param offset the offset of the region in the image
+ * @param shape the shape of the region in the image
+ */
+DVZ_EXPORT void dvz_cmd_copy_buffer_to_image_region(
+    DvzCommands* cmds, uint32_t idx, DvzBuffer* buffer, VkDeviceSize buf_offset,
+    DvzImages* images, uvec3 offset, uvec3 shape);
+
 /**
  * Copy a GPU image to a GPU buffer.
  *
@@ -2197,6 +2351,21 @@ DVZ_EXPORT void dvz_cmd_copy_buffer_to_image(
 DVZ_EXPORT void dvz_cmd_copy_image_to_buffer(
     DvzCommands* cmds, uint32_t idx, DvzImages* images, DvzBuffer* buffer);
 
+/**
+ * Copy a region of a GPU image to a part of a GPU buffer.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param images the image
+ * @param offset the offset of the region in the image
+ * @param shape the shape of the region in the image
+ * @param buffer the buffer
+ * @param buf_offset the offset of the tightly-packed region data in the buffer, in bytes
+ */
+DVZ_EXPORT void dvz_cmd_copy_image_to_buffer_region(
+    DvzCommands* cmds, uint32_t idx, DvzImages* images, uvec3 offset, uvec3 shape,
+    DvzBuffer* buffer, VkDeviceSize buf_offset);
+
 /**
  * Copy a GPU image to another.
  *
@@ -2276,6 +2445,32 @@ DVZ_EXPORT void dvz_cmd_draw_indexed(
     DvzCommands* cmds, uint32_t idx, uint32_t first_index, uint32_t vertex_offset,
     uint32_t index_count);
 
+/**
+ * Direct instanced draw.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param vertex_count number of vertices of every instance
+ * @param first_instance index of the first instance
+ * @param instance_count number of instances to draw
+ */
+DVZ_EXPORT void dvz_cmd_draw_instanced(
+    DvzCommands* cmds, uint32_t idx, uint32_t vertex_count, uint32_t first_instance,
+    uint32_t instance_count);
+
+/**
+ * Direct indexed instanced draw.
+ *
+ * @param cmds the set of command buffers to record
+ * @param idx the index of the command buffer to record
+ * @param index_count number of indices of every instance
+ * @param first_instance index of the first instance
+ * @param instance_count number of instances to draw
+ */
+DVZ_EXPORT void dvz_cmd_draw_indexed_instanced(
+    DvzCommands* cmds, uint32_t idx, uint32_t index_count, uint32_t first_instance,
+    uint32_t instance_count);
+
 /**
  * Indirect draw.
  *
@@ -373,9 +373,11 @@ static void _axes_visual(DvzController* controller, DvzAxisCoord coord)
     // Axes visual flags
     // 0x000X: coordinate
     // 0x00X0: no CPU pos normalization
+    // 0x0X00: instanced segments, forwarded from the controller flags
     // 0xX0000: interact fixed axis
     int flags = DVZ_VISUAL_FLAGS_TRANSFORM_NONE |
                 (coord == 0 ? DVZ_INTERACT_FIXED_AXIS_Y : DVZ_INTERACT_FIXED_AXIS_X) | //
+                (controller->flags & DVZ_GRAPHICS_FLAGS_INSTANCED) |                    //
                 (int)coord;
     ASSERT((flags & DVZ_VISUAL_FLAGS_TRANSFORM_NONE) != 0);
 
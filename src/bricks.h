@@ -0,0 +1,771 @@
+/*************************************************************************************************/
+/*  Bricked multi-resolution volume                                                              */
+/*************************************************************************************************/
+
+/*
+Pyramid of a large 3D volume split into fixed-size bricks, streamed on demand into the slots of a
+3D atlas texture. Level 0 is the full resolution volume, and every level averages 2x2x2 voxels of
+the previous one, until the volume fits in a single brick. The bricks of all levels are numbered
+consecutively, level by level, in x, y, z order within a level.
+
+When the volume is set, the coarser levels are computed slab by slab, and the minimum and maximum
+values of the bricks chunk by chunk, on all cores. A brick whose voxels are all zero is empty: it
+is never uploaded, and the ray marching skips it.
+
+At every frame, the level is selected from the size of the projected volume on the screen, and
+the non-empty bricks of that level intersecting the view frustum are requested. Missing bricks are
+copied from their level by worker threads into a contiguous buffer, and uploaded by the main
+thread to a free slot of the atlas, or to the least recently used slot not needed by the current
+frame. The page table has one entry per brick of the finest level, with the atlas origin and the
+level of the brick to sample: the visible brick if it is resident, otherwise its closest resident
+ancestor (the single brick of the coarsest level is always requested).
+
+The shader fetches the voxels with texelFetch(), so that adjacent slots never bleed into each
+other.
+
+*/
+
+#ifndef DVZ_BRICKS_HEADER
+#define DVZ_BRICKS_HEADER
+
+#include "../include/datoviz/visuals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+#define DVZ_BRICKS_NO_SLOT UINT32_MAX
+
+typedef struct DvzBrickChunk DvzBrickChunk;
+
+struct DvzBrickChunk
+{
+    DvzBricks* bricks;
+    uint32_t level;
+    uint32_t i0, i1; // range of z slices (phase 0) or of bricks (phase 1)
+};
+
+
+
+static uint32_t _bricks_voxel_size(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8_UNORM:
+        return 1;
+    case VK_FORMAT_R16_UNORM:
+        return 2;
+    default:
+        break;
+    }
+    return 0;
+}
+
+
+
+static inline uint32_t _bricks_value(const void* data, uint32_t voxel_size, uint64_t idx)
+{
+    return voxel_size == 1 ? ((const uint8_t*)data)[idx] : ((const uint16_t*)data)[idx];
+}
+
+
+
+static inline void _bricks_set(void* data, uint32_t voxel_size, uint64_t idx, uint32_t value)
+{
+    if (voxel_size == 1)
+        ((uint8_t*)data)[idx] = (uint8_t)value;
+    else
+        ((uint16_t*)data)[idx] = (uint16_t)value;
+}
+
+
+
+static inline uint32_t
+_bricks_index(DvzBricks* bricks, uint32_t level, uint32_t i, uint32_t j, uint32_t k)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(level < bricks->level_count);
+    const uint32_t* g = bricks->grid[level];
+    ASSERT(i < g[0] && j < g[1] && k < g[2]);
+    return bricks->first_brick[level] + (k * g[1] + j) * g[0] + i;
+}
+
+
+
+// Level of a brick, and position of the brick in the grid of its level.
+static uint32_t _bricks_locate(DvzBricks* bricks, uint32_t brick, uvec3 pos)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(brick < bricks->brick_count);
+    uint32_t level = bricks->level_count - 1;
+    while (level > 0 && bricks->first_brick[level] > brick)
+        level--;
+    const uint32_t* g = bricks->grid[level];
+    uint32_t local = brick - bricks->first_brick[level];
+    pos[0] = local % g[0];
+    pos[1] = (local / g[0]) % g[1];
+    pos[2] = local / (g[0] * g[1]);
+    return level;
+}
+
+
+
+// Origin of an atlas slot, in voxels.
+static inline void _bricks_slot_origin(DvzBricks* bricks, uint32_t slot, uvec3 origin)
+{
+    ASSERT(bricks != NULL);
+    const uint32_t* s = bricks->slots_shape;
+    uint32_t bs = bricks->brick_size;
+    origin[0] = (slot % s[0]) * bs;
+    origin[1] = ((slot / s[0]) % s[1]) * bs;
+    origin[2] = (slot / (s[0] * s[1])) * bs;
+}
+
+
+
+// Shape and brick grid of all levels, such that the coarsest one fits in a single brick.
+static void _bricks_levels(DvzBricks* bricks)
+{
+    ASSERT(bricks != NULL);
+    uint32_t bs = bricks->brick_size;
+    ASSERT(bs > 0);
+
+    uvec3 shape = {bricks->shape[0], bricks->shape[1], bricks->shape[2]};
+    uint32_t count = 0;
+    uint32_t level = 0;
+    for (level = 0; level < DVZ_BRICKS_MAX_LEVELS; level++)
+    {
+        bricks->first_brick[level] = count;
+        for (uint32_t a = 0; a < 3; a++)
+        {
+            bricks->level_shape[level][a] = shape[a];
+            bricks->grid[level][a] = (shape[a] + bs - 1) / bs;
+        }
+        count += bricks->grid[level][0] * bricks->grid[level][1] * bricks->grid[level][2];
+        if (shape[0] <= bs && shape[1] <= bs && shape[2] <= bs)
+            break;
+        for (uint32_t a = 0; a < 3; a++)
+            shape[a] = (shape[a] + 1) / 2;
+    }
+    bricks->level_count = MIN(level + 1, DVZ_BRICKS_MAX_LEVELS);
+    bricks->brick_count = count;
+}
+
+
+
+/*************************************************************************************************/
+/*  Preparation                                                                                  */
+/*************************************************************************************************/
+
+// Average of the 2x2x2 voxels of the previous level, clamped to its borders.
+static void _bricks_downsample(DvzBricks* bricks, uint32_t level, uint32_t z0, uint32_t z1)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(level > 0);
+
+    uint32_t vs = bricks->voxel_size;
+    const void* src = bricks->levels[level - 1];
+    void* dst = bricks->levels[level];
+    const uint32_t* s = bricks->level_shape[level - 1];
+    const uint32_t* d = bricks->level_shape[level];
+
+    uint32_t xs[2] = {0}, ys[2] = {0}, zs[2] = {0};
+    uint32_t sum = 0;
+    for (uint32_t z = z0; z < z1; z++)
+    {
+        zs[0] = MIN(2 * z, s[2] - 1);
+        zs[1] = MIN(2 * z + 1, s[2] - 1);
+        for (uint32_t y = 0; y < d[1]; y++)
+        {
+            ys[0] = MIN(2 * y, s[1] - 1);
+            ys[1] = MIN(2 * y + 1, s[1] - 1);
+            for (uint32_t x = 0; x < d[0]; x++)
+            {
+                xs[0] = MIN(2 * x, s[0] - 1);
+                xs[1] = MIN(2 * x + 1, s[0] - 1);
+                sum = 0;
+                for (uint32_t c = 0; c < 8; c++)
+                    sum += _bricks_value(
+                        src, vs,
+                        ((uint64_t)zs[c >> 2] * s[1] + ys[(c >> 1) & 1]) * s[0] + xs[c & 1]);
+                _bricks_set(dst, vs, ((uint64_t)z * d[1] + y) * d[0] + x, (sum + 4) / 8);
+            }
+        }
+    }
+}
+
+
+
+static void _bricks_minmax(DvzBricks* bricks, uint32_t brick)
+{
+    ASSERT(bricks != NULL);
+
+    uvec3 pos = {0};
+    uint32_t level = _bricks_locate(bricks, brick, pos);
+    uint32_t vs = bricks->voxel_size;
+    uint32_t bs = bricks->brick_size;
+    const void* data = bricks->levels[level];
+    const uint32_t* s = bricks->level_shape[level];
+
+    uint32_t vmin = UINT32_MAX, vmax = 0, v = 0;
+    for (uint32_t z = pos[2] * bs; z < MIN((pos[2] + 1) * bs, s[2]); z++)
+    {
+        for (uint32_t y = pos[1] * bs; y < MIN((pos[1] + 1) * bs, s[1]); y++)
+        {
+            for (uint32_t x = pos[0] * bs; x < MIN((pos[0] + 1) * bs, s[0]); x++)
+            {
+                v = _bricks_value(data, vs, ((uint64_t)z * s[1] + y) * s[0] + x);
+                vmin = MIN(vmin, v);
+                vmax = MAX(vmax, v);
+            }
+        }
+    }
+    bricks->minmax[2 * brick + 0] = (uint16_t)vmin;
+    bricks->minmax[2 * brick + 1] = (uint16_t)vmax;
+}
+
+
+
+// Phases: 0: downsampling of a level, 1: minimum and maximum of the bricks.
+static void _bricks_chunk(void* item, uint32_t phase)
+{
+    DvzBrickChunk* chunk = (DvzBrickChunk*)item;
+    ASSERT(chunk != NULL);
+    if (phase == 0)
+        _bricks_downsample(chunk->bricks, chunk->level, chunk->i0, chunk->i1);
+    else
+        for (uint32_t b = chunk->i0; b < chunk->i1; b++)
+            _bricks_minmax(chunk->bricks, b);
+}
+
+
+
+// Run a phase of the preparation on chunks of a range.
+static void _bricks_parallel(DvzBricks* bricks, uint32_t phase, uint32_t level, uint32_t count)
+{
+    ASSERT(bricks != NULL);
+    if (count == 0)
+        return;
+
+    uint32_t n_threads = dvz_parallel_threads(count, 1, DVZ_BRICKS_MAX_THREADS);
+    uint32_t size = (count + n_threads - 1) / n_threads;
+    n_threads = (count + size - 1) / size;
+
+    DvzBrickChunk chunks[DVZ_BRICKS_MAX_THREADS] = {0};
+    for (uint32_t t = 0; t < n_threads; t++)
+    {
+        chunks[t].bricks = bricks;
+        chunks[t].level = level;
+        chunks[t].i0 = t * size;
+        chunks[t].i1 = MIN((t + 1) * size, count);
+    }
+    dvz_parallel(n_threads, chunks, sizeof(DvzBrickChunk), phase, _bricks_chunk);
+}
+
+
+
+// Compute the coarser levels, one after the other, and the minimum and maximum of every brick.
+static void _bricks_build(DvzBricks* bricks)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(bricks->levels[0] != NULL);
+
+    const uint32_t* s = NULL;
+    for (uint32_t level = 1; level < bricks->level_count; level++)
+    {
+        s = bricks->level_shape[level];
+        bricks->levels[level] = calloc((uint64_t)s[0] * s[1] * s[2], bricks->voxel_size);
+        _bricks_parallel(bricks, 0, level, s[2]);
+    }
+
+    bricks->minmax = (uint16_t*)calloc(2 * bricks->brick_count, sizeof(uint16_t));
+    _bricks_parallel(bricks, 1, 0, bricks->brick_count);
+}
+
+
+
+static inline bool _bricks_empty(DvzBricks* bricks, uint32_t brick)
+{
+    ASSERT(bricks != NULL);
+    return bricks->minmax[2 * brick + 1] == 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  Workers                                                                                      */
+/*************************************************************************************************/
+
+// Copy a brick into a buffer of brick_size^3 voxels, clamping to the borders of its level.
+static void _bricks_copy(DvzBricks* bricks, uint32_t brick, void* voxels)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(voxels != NULL);
+
+    uvec3 pos = {0};
+    uint32_t level = _bricks_locate(bricks, brick, pos);
+    uint32_t vs = bricks->voxel_size;
+    uint32_t bs = bricks->brick_size;
+    const char* data = (const char*)bricks->levels[level];
+    const uint32_t* s = bricks->level_shape[level];
+
+    uint32_t x0 = pos[0] * bs;
+    uint32_t n = MIN(bs, s[0] - x0); // number of voxels within the level along x
+    uint32_t y = 0, z = 0;
+    char* dst = NULL;
+    for (uint32_t k = 0; k < bs; k++)
+    {
+        z = MIN(pos[2] * bs + k, s[2] - 1);
+        for (uint32_t j = 0; j < bs; j++)
+        {
+            y = MIN(pos[1] * bs + j, s[1] - 1);
+            dst = (char*)voxels + ((uint64_t)k * bs + j) * bs * vs;
+            memcpy(dst, data + (((uint64_t)z * s[1] + y) * s[0] + x0) * vs, (size_t)n * vs);
+            for (uint32_t i = n; i < bs; i++)
+                memcpy(dst + i * vs, dst + (n - 1) * vs, vs);
+        }
+    }
+}
+
+
+
+static void* _bricks_worker(void* user_data)
+{
+    DvzBricks* bricks = (DvzBricks*)user_data;
+    ASSERT(bricks != NULL);
+
+    DvzBrickRequest* req = NULL;
+    while (true)
+    {
+        req = (DvzBrickRequest*)dvz_fifo_dequeue(&bricks->request_queue, true);
+        ASSERT(req != NULL);
+        if (req->bricks == NULL)
+            break;
+
+        _bricks_copy(bricks, req->brick, req->voxels);
+        dvz_fifo_enqueue(&bricks->done_queue, req);
+    }
+    return NULL;
+}
+
+
+
+static void _bricks_request_free(DvzBrickRequest* req)
+{
+    ASSERT(req != NULL);
+    FREE(req->voxels);
+    FREE(req);
+}
+
+
+
+/*************************************************************************************************/
+/*  Streaming                                                                                    */
+/*************************************************************************************************/
+
+// Free slot, or least recently used resident slot that is not needed by the current frame.
+static uint32_t _bricks_lru_slot(DvzBricks* bricks)
+{
+    ASSERT(bricks != NULL);
+    uint32_t slot = DVZ_BRICKS_NO_SLOT;
+    uint64_t oldest = bricks->frame;
+    DvzBrickSlot* s = NULL;
+    for (uint32_t i = 0; i < bricks->slot_count; i++)
+    {
+        s = &bricks->slots[i];
+        if (s->state == DVZ_TILE_SLOT_FREE)
+            return i;
+        if (s->state == DVZ_TILE_SLOT_RESIDENT && s->last_used < oldest)
+        {
+            oldest = s->last_used;
+            slot = i;
+        }
+    }
+    return slot;
+}
+
+
+
+// Mark a brick as used by the current frame, and send it to the workers if it is not in the
+// atlas yet. Return whether the brick is resident.
+static bool _bricks_request(DvzBricks* bricks, uint32_t brick)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(brick < bricks->brick_count);
+    uint32_t slot = bricks->brick_slot[brick];
+    if (slot != DVZ_BRICKS_NO_SLOT)
+    {
+        bricks->slots[slot].last_used = bricks->frame;
+        return bricks->slots[slot].state == DVZ_TILE_SLOT_RESIDENT;
+    }
+
+    if (bricks->stats.pending >= DVZ_BRICKS_MAX_REQUESTS)
+        return false;
+    slot = _bricks_lru_slot(bricks);
+    if (slot == DVZ_BRICKS_NO_SLOT)
+    {
+        log_trace("brick atlas full, increase the memory budget");
+        return false;
+    }
+
+    // Evict the brick in the slot.
+    DvzBrickSlot* s = &bricks->slots[slot];
+    if (s->state == DVZ_TILE_SLOT_RESIDENT)
+    {
+        bricks->brick_slot[s->brick] = DVZ_BRICKS_NO_SLOT;
+        bricks->stats.evictions++;
+        bricks->stats.resident--;
+        bricks->pages_dirty = true;
+    }
+    s->brick = brick;
+    s->last_used = bricks->frame;
+    s->state = DVZ_TILE_SLOT_PENDING;
+    bricks->brick_slot[brick] = slot;
+    bricks->stats.pending++;
+
+    // Send the brick to the workers.
+    uint32_t bs = bricks->brick_size;
+    DvzBrickRequest* req = (DvzBrickRequest*)calloc(1, sizeof(DvzBrickRequest));
+    req->bricks = bricks;
+    req->brick = brick;
+    req->slot = slot;
+    req->voxels = calloc((size_t)bs * bs * bs, bricks->voxel_size);
+    dvz_fifo_enqueue(&bricks->request_queue, req);
+    return false;
+}
+
+
+
+// Upload the bricks copied by the workers to their slots. The voxels are kept until the transfers
+// have been processed, at the next frame. Return the number of uploaded bricks.
+static uint32_t _bricks_receive(DvzBricks* bricks, DvzCanvas* canvas)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(canvas != NULL);
+
+    uint32_t bs = bricks->brick_size;
+    VkDeviceSize size = (VkDeviceSize)bs * bs * bs * bricks->voxel_size;
+    uint32_t count = 0;
+    uvec3 origin = {0};
+    DvzBrickRequest* req = NULL;
+    DvzBrickSlot* s = NULL;
+    while ((req = (DvzBrickRequest*)dvz_fifo_dequeue(&bricks->done_queue, false)) != NULL)
+    {
+        s = &bricks->slots[req->slot];
+        ASSERT(s->state == DVZ_TILE_SLOT_PENDING);
+        ASSERT(s->brick == req->brick);
+
+        _bricks_slot_origin(bricks, req->slot, origin);
+        dvz_upload_texture(canvas, bricks->atlas, origin, (uvec3){bs, bs, bs}, size, req->voxels);
+        s->state = DVZ_TILE_SLOT_RESIDENT;
+        bricks->stats.pending--;
+        bricks->stats.resident++;
+        bricks->stats.uploads++;
+
+        if (bricks->uploaded_count >= bricks->uploaded_capacity)
+        {
+            bricks->uploaded_capacity =
+                bricks->uploaded_capacity == 0 ? 16 : 2 * bricks->uploaded_capacity;
+            REALLOC(bricks->uploaded, bricks->uploaded_capacity * sizeof(DvzBrickRequest*));
+        }
+        bricks->uploaded[bricks->uploaded_count++] = req;
+        count++;
+    }
+    if (count > 0)
+        bricks->pages_dirty = true;
+    return count;
+}
+
+
+
+static void _bricks_free_uploaded(DvzBricks* bricks)
+{
+    ASSERT(bricks != NULL);
+    for (uint32_t i = 0; i < bricks->uploaded_count; i++)
+        _bricks_request_free(bricks->uploaded[i]);
+    bricks->uploaded_count = 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  View                                                                                         */
+/*************************************************************************************************/
+
+// Whether a box of the model space, given by its uvw bounds in the volume, is entirely outside
+// of one of the planes of the view frustum.
+static bool _bricks_culled(DvzBricks* bricks, mat4 m, const vec3 uvw0, const vec3 uvw1)
+{
+    ASSERT(bricks != NULL);
+    vec4 p = {0}, c = {0};
+    uint32_t out[6] = {0};
+    for (uint32_t corner = 0; corner < 8; corner++)
+    {
+        for (uint32_t a = 0; a < 3; a++)
+            p[a] = (((corner >> a) & 1) ? uvw1[a] : uvw0[a]) * bricks->box_size[a] -
+                   bricks->box_size[a] / 2;
+        p[3] = 1;
+        glm_mat4_mulv(m, p, c);
+        out[0] += c[0] < -c[3];
+        out[1] += c[0] > +c[3];
+        out[2] += c[1] < -c[3];
+        out[3] += c[1] > +c[3];
+        out[4] += c[2] < 0;
+        out[5] += c[2] > +c[3];
+    }
+    for (uint32_t i = 0; i < 6; i++)
+        if (out[i] == 8)
+            return true;
+    return false;
+}
+
+
+
+// Level whose voxels best match the pixels covered by the projected volume.
+static uint32_t _bricks_select_level(DvzBricks* bricks, mat4 m)
+{
+    ASSERT(bricks != NULL);
+    vec4 p = {0}, c = {0};
+    vec2 p0 = {+INFINITY, +INFINITY}, p1 = {-INFINITY, -INFINITY};
+    for (uint32_t corner = 0; corner < 8; corner++)
+    {
+        for (uint32_t a = 0; a < 3; a++)
+            p[a] = (((corner >> a) & 1) ? .5 : -.5) * bricks->box_size[a];
+        p[3] = 1;
+        glm_mat4_mulv(m, p, c);
+        // The camera is within the volume: full resolution.
+        if (c[3] <= 0)
+            return 0;
+        for (uint32_t a = 0; a < 2; a++)
+        {
+            p0[a] = MIN(p0[a], c[a] / c[3]);
+            p1[a] = MAX(p1[a], c[a] / c[3]);
+        }
+    }
+    double px = MAX((p1[0] - p0[0]) * .5 * bricks->viewport[0], //
+                    (p1[1] - p0[1]) * .5 * bricks->viewport[1]);
+    double voxels = MAX(bricks->shape[0], MAX(bricks->shape[1], bricks->shape[2]));
+    double ratio = voxels / MAX(px, 1);
+    uint32_t level = ratio > 1 ? (uint32_t)floor(log2(ratio)) : 0;
+    return MIN(level, bricks->level_count - 1);
+}
+
+
+
+// Select the level and list the non-empty bricks of that level in the view frustum.
+static void _bricks_view(DvzBricks* bricks)
+{
+    ASSERT(bricks != NULL);
+
+    mat4 m;
+    glm_mat4_mul(bricks->mvp.proj, bricks->mvp.view, m);
+    glm_mat4_mul(m, bricks->mvp.model, m);
+    uint32_t level = _bricks_select_level(bricks, m);
+    if (level != bricks->level)
+        bricks->pages_dirty = true;
+    bricks->level = level;
+
+    const uint32_t* g = bricks->grid[level];
+    uint32_t bs = bricks->brick_size;
+    double d = (double)bs * (1u << level);
+    uint32_t n = g[0] * g[1] * g[2];
+    if (bricks->visible_capacity < n)
+    {
+        bricks->visible_capacity = n;
+        REALLOC(bricks->visible, n * sizeof(uint32_t));
+    }
+
+    bricks->visible_count = 0;
+    bricks->stats.empty = 0;
+    bricks->stats.culled = 0;
+    vec3 uvw0 = {0}, uvw1 = {0};
+    uint32_t b = 0;
+    for (uint32_t k = 0; k < g[2]; k++)
+    {
+        for (uint32_t j = 0; j < g[1]; j++)
+        {
+            for (uint32_t i = 0; i < g[0]; i++)
+            {
+                b = _bricks_index(bricks, level, i, j, k);
+                if (_bricks_empty(bricks, b))
+                {
+                    bricks->stats.empty++;
+                    continue;
+                }
+                uvw0[0] = i * d / bricks->shape[0];
+                uvw0[1] = j * d / bricks->shape[1];
+                uvw0[2] = k * d / bricks->shape[2];
+                uvw1[0] = MIN(1, (i + 1) * d / bricks->shape[0]);
+                uvw1[1] = MIN(1, (j + 1) * d / bricks->shape[1]);
+                uvw1[2] = MIN(1, (k + 1) * d / bricks->shape[2]);
+                if (_bricks_culled(bricks, m, uvw0, uvw1))
+                {
+                    bricks->stats.culled++;
+                    continue;
+                }
+                bricks->visible[bricks->visible_count++] = b;
+            }
+        }
+    }
+    bricks->stats.visible = bricks->visible_count;
+}
+
+
+
+// Fill the page table: for every brick of the finest level, the atlas origin and the level of
+// the brick to sample, -1 if the brick is empty, -2 if no brick covering it is resident.
+static void _bricks_pages(DvzBricks* bricks)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(bricks->pages != NULL);
+
+    uint32_t level = bricks->level;
+    const uint32_t* g = bricks->grid[0];
+    uint32_t b = 0, slot = 0;
+    uvec3 origin = {0};
+    vec4* page = NULL;
+    for (uint32_t k = 0; k < g[2]; k++)
+    {
+        for (uint32_t j = 0; j < g[1]; j++)
+        {
+            for (uint32_t i = 0; i < g[0]; i++)
+            {
+                page = &bricks->pages[(k * g[1] + j) * g[0] + i];
+                memset(page, 0, sizeof(vec4));
+                (*page)[3] = -2;
+                if (_bricks_empty(bricks, _bricks_index(bricks, level, i >> level, //
+                                                        j >> level, k >> level)))
+                {
+                    (*page)[3] = -1;
+                    continue;
+                }
+                for (uint32_t l = level; l < bricks->level_count; l++)
+                {
+                    b = _bricks_index(bricks, l, i >> l, j >> l, k >> l);
+                    slot = bricks->brick_slot[b];
+                    if (slot == DVZ_BRICKS_NO_SLOT ||
+                        bricks->slots[slot].state != DVZ_TILE_SLOT_RESIDENT)
+                        continue;
+                    _bricks_slot_origin(bricks, slot, origin);
+                    (*page)[0] = origin[0];
+                    (*page)[1] = origin[1];
+                    (*page)[2] = origin[2];
+                    (*page)[3] = l;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+
+
+// Per-frame update: request the visible bricks, upload the prepared ones, and upload the page
+// table if it has changed.
+static void _bricks_update(
+    DvzBricks* bricks, DvzCanvas* canvas, DvzMVP* mvp, vec3 box_size, uvec2 viewport)
+{
+    ASSERT(bricks != NULL);
+    ASSERT(canvas != NULL);
+    ASSERT(mvp != NULL);
+
+    // The transfers enqueued at the previous frame have been processed.
+    _bricks_free_uploaded(bricks);
+    bricks->frame++;
+
+    // Visible bricks, only recomputed when the view changes.
+    if (bricks->frame == 1 || memcmp(&bricks->mvp, mvp, offsetof(DvzMVP, time)) != 0 ||
+        memcmp(bricks->box_size, box_size, sizeof(vec3)) != 0 ||
+        memcmp(bricks->viewport, viewport, sizeof(uvec2)) != 0)
+    {
+        memcpy(&bricks->mvp, mvp, sizeof(DvzMVP));
+        memcpy(bricks->box_size, box_size, sizeof(vec3));
+        memcpy(bricks->viewport, viewport, sizeof(uvec2));
+        _bricks_view(bricks);
+    }
+
+    // Coarsest brick, used when a visible brick is missing.
+    uint32_t top = bricks->level_count - 1;
+    for (uint32_t b = bricks->first_brick[top]; b < bricks->brick_count; b++)
+        if (!_bricks_empty(bricks, b))
+            _bricks_request(bricks, b);
+
+    // Visible bricks.
+    for (uint32_t i = 0; i < bricks->visible_count; i++)
+    {
+        if (_bricks_request(bricks, bricks->visible[i]))
+            bricks->stats.hits++;
+        else
+            bricks->stats.misses++;
+    }
+
+    _bricks_receive(bricks, canvas);
+    if (bricks->pages_dirty)
+    {
+        _bricks_pages(bricks);
+        const uint32_t* g = bricks->grid[0];
+        dvz_upload_texture(
+            canvas, bricks->page_table, (uvec3){0, 0, 0}, (uvec3){g[0], g[1], g[2]},
+            (VkDeviceSize)g[0] * g[1] * g[2] * sizeof(vec4), bricks->pages);
+        bricks->pages_dirty = false;
+    }
+}
+
+
+
+/*************************************************************************************************/
+/*  Destruction                                                                                  */
+/*************************************************************************************************/
+
+static void _bricks_destroy(DvzBricks* bricks)
+{
+    ASSERT(bricks != NULL);
+
+    // Stop the workers with a NULL bricks pointer, once the pending requests have been copied.
+    DvzBrickRequest stop = {0};
+    for (uint32_t i = 0; i < bricks->worker_count; i++)
+        dvz_fifo_enqueue(&bricks->request_queue, &stop);
+    for (uint32_t i = 0; i < bricks->worker_count; i++)
+        dvz_thread_join(&bricks->workers[i]);
+
+    DvzBrickRequest* req = NULL;
+    while ((req = (DvzBrickRequest*)dvz_fifo_dequeue(&bricks->done_queue, false)) != NULL)
+        _bricks_request_free(req);
+    _bricks_free_uploaded(bricks);
+    FREE(bricks->uploaded);
+    dvz_fifo_destroy(&bricks->request_queue);
+    dvz_fifo_destroy(&bricks->done_queue);
+
+    // The first level is the user data.
+    for (uint32_t level = 1; level < bricks->level_count; level++)
+        FREE(bricks->levels[level]);
+    FREE(bricks->minmax);
+    FREE(bricks->brick_slot);
+    FREE(bricks->slots);
+    FREE(bricks->pages);
+    FREE(bricks->visible);
+
+    if (bricks->atlas != NULL)
+    {
+        DvzGpu* gpu = bricks->atlas->context->gpu;
+        dvz_gpu_wait(gpu);
+        dvz_texture_destroy(bricks->atlas);
+        dvz_texture_destroy(bricks->page_table);
+        bricks->atlas = NULL;
+        bricks->page_table = NULL;
+    }
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
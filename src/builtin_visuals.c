@@ -2,10 +2,94 @@
 #include "../include/datoviz/array.h"
 #include "../include/datoviz/interact.h"
 #include "../include/datoviz/mesh.h"
+#include "bricks.h"
+#include "lod.h"
+#include "mesh_levels.h"
+#include "tiles.h"
 #include "visuals_utils.h"
 
 
 
+/*************************************************************************************************/
+/*  Level of detail                                                                              */
+/*************************************************************************************************/
+
+static void _lod_clear(DvzProp* prop)
+{
+    ASSERT(prop != NULL);
+    dvz_array_destroy(&prop->arr_staging);
+    prop->arr_staging = (DvzArray){0};
+}
+
+
+
+// Replace the POS and COLOR props by the decimated slice of the samples visible in the panel.
+// Return whether the props have been decimated.
+static bool _lod_bake(DvzVisual* visual, DvzVisualDataEvent ev, uint32_t n_strips)
+{
+    ASSERT(visual != NULL);
+    DvzLod* lod = visual->lod;
+    if (lod == NULL)
+        return false;
+    if (n_strips > 1)
+    {
+        log_debug("the level of detail only supports a single line strip or path");
+        return false;
+    }
+
+    DvzProp* prop_pos = dvz_prop_get(visual, DVZ_PROP_POS, 0);
+    DvzProp* prop_color = dvz_prop_get(visual, DVZ_PROP_COLOR, 0);
+
+    // Keep the current slice if the vertex data does not need to be uploaded again.
+    DvzSource* source = dvz_source_get(visual, DVZ_SOURCE_TYPE_VERTEX, 0);
+    if (source->obj.request != DVZ_VISUAL_REQUEST_UPLOAD)
+        return prop_pos->arr_staging.item_count > 0;
+
+    DvzArray* arr_pos = &prop_pos->arr_trans;
+    if (arr_pos->item_count == 0)
+        arr_pos = &prop_pos->arr_orig;
+    DvzArray* arr_color = &prop_color->arr_trans;
+    if (arr_color->item_count == 0)
+        arr_color = &prop_color->arr_orig;
+
+    uint32_t n = arr_pos->item_count;
+    const dvec3* pos = (const dvec3*)arr_pos->data;
+    if (n == 0 || pos == NULL)
+        return false;
+
+    // The pyramid is only rebuilt when the data has changed, not when the slice has moved.
+    if (lod->data_changed || lod->sample_count != n)
+        _lod_build(lod, n, pos);
+    lod->data_changed = false;
+    lod->window_changed = false;
+    if (lod->width == 0)
+        lod->width = (uint32_t)ev.viewport.viewport.width;
+
+    if (lod->level_count == 0)
+    {
+        _lod_clear(prop_pos);
+        _lod_clear(prop_color);
+        return false;
+    }
+
+    // Gather the samples of the slice.
+    _lod_slice(lod, pos);
+    uint32_t* indices = (uint32_t*)calloc(_lod_max_count(lod), sizeof(uint32_t));
+    uint32_t count = _lod_indices(lod, indices);
+    _lod_gather(arr_pos, &prop_pos->arr_staging, count, indices);
+    if (arr_color->item_count == n)
+        _lod_gather(arr_color, &prop_color->arr_staging, count, indices);
+    FREE(indices);
+
+    lod->vertex_count = count;
+    log_debug(
+        "LOD level %d, samples %d-%d, %d vertices out of %d", //
+        lod->level, lod->first, lod->last, count, n);
+    return true;
+}
+
+
+
 /*************************************************************************************************/
 /*************************************************************************************************/
 /*  Basic visuals                                                                                */
@@ -133,6 +217,13 @@ static void _line_strip_bake(DvzVisual* visual, DvzVisualDataEvent ev)
     // Number of line strips.
     uint32_t n_strips = arr_length->item_count;
 
+    // Level of detail: only upload the decimated slice of the visible samples.
+    if (_lod_bake(visual, ev, n_strips))
+    {
+        _default_visual_bake(visual, ev);
+        return;
+    }
+
     if (n_strips >= 2)
     {
         // New number of vertices, with the extra points.
@@ -625,12 +716,20 @@ static void _path_bake(DvzVisual* visual, DvzVisualDataEvent ev)
         return;
     }
 
+    // Level of detail: only upload the decimated slice of the visible samples, as a single path.
+    bool lod = _lod_bake(visual, ev, arr_length->item_count);
+    if (lod)
+    {
+        arr_pos = _prop_array(prop_pos);
+        arr_color = _prop_array(prop_color);
+    }
+
     // Source arrays.
     DvzArray* arr_vertex = &src_vertex->arr;
 
     // Number of points and paths.
     uint32_t n_points = arr_pos->item_count;   // number of points
-    uint32_t n_paths = arr_length->item_count; // number of paths
+    uint32_t n_paths = lod ? 0 : arr_length->item_count; // number of paths
     if (n_paths == 0)
         n_paths = 1;
     // number of points, incl invisible join points
@@ -665,7 +764,7 @@ static void _path_bake(DvzVisual* visual, DvzVisualDataEvent ev)
         // log_info("path #%d", i);
 
         // Per-path data.
-        path_length = dvz_array_item(arr_length, i);
+        path_length = lod ? NULL : dvz_array_item(arr_length, i);
         path_size = path_length != NULL ? (int32_t)*path_length : (int32_t)n_points;
 
         is_closed = dvz_array_item(arr_topology, i);
@@ -757,7 +856,8 @@ static void _visual_path(DvzVisual* visual)
     DvzProp* prop = NULL;
 
     // Graphics.
-    dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_PATH, 0));
+    int flags = visual->flags & DVZ_GRAPHICS_FLAGS_INSTANCED;
+    dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_PATH, flags));
 
     // Sources
     dvz_visual_source(
@@ -861,6 +961,30 @@ static void _visual_image_bake(DvzVisual* visual, DvzVisualDataEvent ev)
 
     // Graphics data.
     DvzGraphicsData data = dvz_graphics_data(visual->graphics[0], &source->arr, NULL, NULL);
+
+    // Tiled image: one quad per visible tile, the image corners being given by the top left and
+    // bottom right corners of the first image.
+    DvzTiles* tiles = visual->tiles;
+    if (tiles != NULL)
+    {
+        if (img_count > 0)
+        {
+            memcpy(tiles->p0, dvz_prop_item(pos0, 0), sizeof(dvec2));
+            memcpy(tiles->p1, dvz_prop_item(pos2, 0), sizeof(dvec2));
+        }
+        DvzGraphicsImageItem* items = (DvzGraphicsImageItem*)calloc(
+            MAX(1, _tiles_max_quads(tiles)), sizeof(DvzGraphicsImageItem));
+        tiles->quad_count = _tiles_quads(tiles, items);
+
+        // Keep a degenerate quad while no tile is resident.
+        uint32_t count = MAX(1, tiles->quad_count);
+        dvz_graphics_alloc(&data, count);
+        for (uint32_t i = 0; i < count; i++)
+            dvz_graphics_append(&data, &items[i]);
+        FREE(items);
+        return;
+    }
+
     dvz_graphics_alloc(&data, img_count);
 
     DvzGraphicsImageItem item = {0};
@@ -1304,7 +1428,8 @@ static void _visual_axes_2D(DvzVisual* visual)
     DvzProp* prop = NULL;
 
     // Graphics.
-    dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_SEGMENT, 0));
+    int flags = visual->flags & DVZ_GRAPHICS_FLAGS_INSTANCED;
+    dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_SEGMENT, flags));
     dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_TEXT, 0));
 
     // Segment graphics.
@@ -1643,7 +1768,8 @@ static void _visual_volume(DvzVisual* visual)
     DvzProp* prop = NULL;
 
     // Graphics.
-    dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_VOLUME, 0));
+    int flags = visual->flags & DVZ_GRAPHICS_FLAGS_VOLUME_BRICKED;
+    dvz_visual_graphics(visual, dvz_graphics_builtin(canvas, DVZ_GRAPHICS_VOLUME, flags));
 
     // Sources
     dvz_visual_source(                                               // vertex buffer
@@ -1666,6 +1792,12 @@ static void _visual_volume(DvzVisual* visual)
         visual, DVZ_SOURCE_TYPE_VOLUME, 0, DVZ_PIPELINE_GRAPHICS, 0, //
         DVZ_USER_BINDING + 2, sizeof(uint16_t), 0);                  //
 
+    // Bricked volume: the volume source is the brick atlas, with a page table.
+    if (flags != 0)
+        dvz_visual_source(                                               // page table
+            visual, DVZ_SOURCE_TYPE_VOLUME, 1, DVZ_PIPELINE_GRAPHICS, 0, //
+            DVZ_USER_BINDING + 3, sizeof(vec4), 0);                      //
+
     // Props:
 
     // Point positions.
@@ -1699,10 +1831,16 @@ static void _visual_volume(DvzVisual* visual)
         prop, 1, offsetof(DvzGraphicsVolumeParams, box_size), DVZ_ARRAY_COPY_SINGLE, 1);
     dvz_visual_prop_default(prop, (vec3){2, 2, 2});
 
+    // Shape of the bricked volume, and brick size.
+    prop = dvz_visual_prop(visual, DVZ_PROP_SHAPE, 0, DVZ_DTYPE_UVEC4, DVZ_SOURCE_TYPE_PARAM, 0);
+    dvz_visual_prop_copy(
+        prop, 2, offsetof(DvzGraphicsVolumeParams, shape), DVZ_ARRAY_COPY_SINGLE, 1);
+    dvz_visual_prop_default(prop, (uvec4){1, 1, 1, 1});
+
     // Colormap value.
     prop = dvz_visual_prop(visual, DVZ_PROP_COLORMAP, 0, DVZ_DTYPE_INT, DVZ_SOURCE_TYPE_PARAM, 0);
     dvz_visual_prop_copy(
-        prop, 2, offsetof(DvzGraphicsVolumeParams, cmap), DVZ_ARRAY_COPY_SINGLE, 1);
+        prop, 3, offsetof(DvzGraphicsVolumeParams, cmap), DVZ_ARRAY_COPY_SINGLE, 1);
     DvzColormap cmap = DVZ_CMAP_BINARY;
     dvz_visual_prop_default(prop, &cmap);
 
@@ -1970,3 +2108,322 @@ void dvz_visual_builtin(DvzVisual* visual, DvzVisualType type, int flags)
         break;
     }
 }
+
+
+
+void dvz_visual_lod(DvzVisual* visual, bool enable)
+{
+    ASSERT(visual != NULL);
+    if (visual->callback_bake != _line_strip_bake && visual->callback_bake != _path_bake)
+    {
+        log_error("the level of detail is only supported by line strip and path visuals");
+        return;
+    }
+
+    if (enable && visual->lod == NULL)
+    {
+        visual->lod = (DvzLod*)calloc(1, sizeof(DvzLod));
+        visual->lod->xlim[0] = -1;
+        visual->lod->xlim[1] = +1;
+        visual->lod->level = -1;
+    }
+    else if (!enable && visual->lod != NULL)
+    {
+        _lod_destroy(visual->lod);
+        FREE(visual->lod);
+        _lod_clear(dvz_prop_get(visual, DVZ_PROP_POS, 0));
+        _lod_clear(dvz_prop_get(visual, DVZ_PROP_COLOR, 0));
+    }
+
+    // Bake the visual again if it has already been baked.
+    DvzSource* source = dvz_source_get(visual, DVZ_SOURCE_TYPE_VERTEX, 0);
+    if (source != NULL && _source_is_set(source))
+        _source_set_changed(source, true);
+}
+
+
+
+void dvz_visual_tiles(
+    DvzVisual* visual, uvec2 size, uint32_t tile_size, VkFormat format, VkDeviceSize budget,
+    DvzTileCallback callback, void* user_data)
+{
+    ASSERT(visual != NULL);
+    DvzCanvas* canvas = visual->canvas;
+    ASSERT(canvas != NULL);
+    if (visual->callback_bake != _visual_image_bake)
+    {
+        log_error("tiled images are only supported by image visuals");
+        return;
+    }
+    if (visual->tiles != NULL)
+    {
+        log_error("the visual already has a tiled image");
+        return;
+    }
+    if (size[0] == 0 || size[1] == 0 || tile_size == 0 ||
+        tile_size * (uint32_t)sqrt(DVZ_TILES_MIN_SLOTS) > DVZ_TILES_MAX_SIZE)
+    {
+        log_error("invalid tiled image size %dx%d or tile size %d", size[0], size[1], tile_size);
+        return;
+    }
+    uint32_t pixel_size = _tiles_pixel_size(format);
+    if (pixel_size == 0)
+    {
+        log_error("unsupported tiled image format %d", format);
+        return;
+    }
+    if (callback == NULL && user_data == NULL)
+    {
+        log_error("a tiled image requires a tile callback or the full resolution image");
+        return;
+    }
+
+    DvzTiles* tiles = (DvzTiles*)calloc(1, sizeof(DvzTiles));
+    tiles->visual = visual;
+    tiles->size[0] = size[0];
+    tiles->size[1] = size[1];
+    tiles->tile_size = tile_size;
+    tiles->pixel_size = pixel_size;
+    tiles->format = format;
+    tiles->level_count = _tiles_level_count(size, tile_size);
+    tiles->callback = callback != NULL ? callback : _tiles_array_callback;
+    tiles->user_data = user_data;
+
+    // Image bounds and view before the first frame.
+    tiles->p0[0] = -1;
+    tiles->p0[1] = +1;
+    tiles->p1[0] = +1;
+    tiles->p1[1] = -1;
+    tiles->xlim[0] = tiles->ylim[0] = -1;
+    tiles->xlim[1] = tiles->ylim[1] = +1;
+
+    // Number of slots in the memory budget, arranged in a square-ish atlas.
+    budget = budget > 0 ? budget : DVZ_TILES_BUDGET;
+    uint32_t max_axis = DVZ_TILES_MAX_SIZE / tile_size;
+    uint64_t n = budget / ((uint64_t)tile_size * tile_size * pixel_size);
+    n = CLIP(n, DVZ_TILES_MIN_SLOTS, (uint64_t)max_axis * max_axis);
+    tiles->cols = MIN((uint32_t)floor(sqrt((double)n)), max_axis);
+    tiles->rows = MIN((uint32_t)(n / tiles->cols), max_axis);
+    tiles->slot_count = tiles->cols * tiles->rows;
+    tiles->slots = (DvzTileSlot*)calloc(tiles->slot_count, sizeof(DvzTileSlot));
+
+    tiles->map_capacity = 1;
+    while (tiles->map_capacity < 2 * tiles->slot_count)
+        tiles->map_capacity *= 2;
+    tiles->map_keys = (uint64_t*)malloc(tiles->map_capacity * sizeof(uint64_t));
+    tiles->map_slots = (uint32_t*)calloc(tiles->map_capacity, sizeof(uint32_t));
+    for (uint32_t i = 0; i < tiles->map_capacity; i++)
+        tiles->map_keys[i] = DVZ_TILES_EMPTY_KEY;
+
+    log_debug(
+        "tiled image %dx%d with %d levels, atlas with %d tiles of %dx%d", size[0], size[1],
+        tiles->level_count, tiles->slot_count, tile_size, tile_size);
+    tiles->atlas = dvz_ctx_texture(
+        canvas->gpu->context, 2,
+        (uvec3){tiles->cols * tile_size, tiles->rows * tile_size, 1}, format);
+
+    // Decoding workers.
+    // The queues hold one item less than their capacity.
+    tiles->request_queue = dvz_fifo(DVZ_TILES_MAX_REQUESTS + DVZ_TILES_MAX_WORKERS + 1);
+    tiles->done_queue = dvz_fifo(DVZ_TILES_MAX_REQUESTS + 1);
+    tiles->worker_count = CLIP(dvz_num_threads() / 2, 1, DVZ_TILES_MAX_WORKERS);
+    for (uint32_t i = 0; i < tiles->worker_count; i++)
+        tiles->workers[i] = dvz_thread(_tiles_worker, tiles);
+
+    visual->tiles = tiles;
+    dvz_visual_texture(visual, DVZ_SOURCE_TYPE_IMAGE, 0, tiles->atlas);
+}
+
+
+
+DvzTileStats dvz_visual_tiles_stats(DvzVisual* visual)
+{
+    ASSERT(visual != NULL);
+    DvzTileStats stats = {0};
+    if (visual->tiles == NULL)
+    {
+        log_error("the visual has no tiled image");
+        return stats;
+    }
+    return visual->tiles->stats;
+}
+
+
+
+void dvz_visual_bricks(
+    DvzVisual* visual, uvec3 shape, uint32_t brick_size, VkFormat format, VkDeviceSize budget,
+    const void* data)
+{
+    ASSERT(visual != NULL);
+    DvzCanvas* canvas = visual->canvas;
+    ASSERT(canvas != NULL);
+    if (visual->callback_bake != _visual_volume_bake ||
+        (visual->flags & DVZ_GRAPHICS_FLAGS_VOLUME_BRICKED) == 0)
+    {
+        log_error("bricked volumes require a volume visual with the bricked flag");
+        return;
+    }
+    if (visual->bricks != NULL)
+    {
+        log_error("the visual already has a bricked volume");
+        return;
+    }
+    if (shape[0] == 0 || shape[1] == 0 || shape[2] == 0 || brick_size == 0 ||
+        brick_size * 2 > DVZ_BRICKS_MAX_SIZE)
+    {
+        log_error(
+            "invalid bricked volume shape %dx%dx%d or brick size %d", //
+            shape[0], shape[1], shape[2], brick_size);
+        return;
+    }
+    uint32_t voxel_size = _bricks_voxel_size(format);
+    if (voxel_size == 0)
+    {
+        log_error("unsupported bricked volume format %d", format);
+        return;
+    }
+    if (data == NULL)
+    {
+        log_error("a bricked volume requires the full resolution volume");
+        return;
+    }
+
+    DvzBricks* bricks = (DvzBricks*)calloc(1, sizeof(DvzBricks));
+    bricks->visual = visual;
+    memcpy(bricks->shape, shape, sizeof(uvec3));
+    bricks->brick_size = brick_size;
+    bricks->voxel_size = voxel_size;
+    bricks->format = format;
+    _bricks_levels(bricks);
+    const uint32_t* g = bricks->grid[0];
+    if (MAX(g[0], MAX(g[1], g[2])) > DVZ_BRICKS_MAX_PAGES)
+    {
+        log_error(
+            "too many bricks (%dx%dx%d), increase the brick size", //
+            g[0], g[1], g[2]);
+        FREE(bricks);
+        return;
+    }
+
+    // Coarser levels and minimum and maximum values of the bricks, computed in parallel.
+    bricks->levels[0] = (void*)data;
+    _bricks_build(bricks);
+    bricks->brick_slot = (uint32_t*)malloc(bricks->brick_count * sizeof(uint32_t));
+    for (uint32_t i = 0; i < bricks->brick_count; i++)
+        bricks->brick_slot[i] = DVZ_BRICKS_NO_SLOT;
+
+    // Number of slots in the memory budget, arranged in a cube-ish atlas.
+    budget = budget > 0 ? budget : DVZ_BRICKS_BUDGET;
+    uint32_t max_axis = DVZ_BRICKS_MAX_SIZE / brick_size;
+    uint64_t n = budget / ((uint64_t)brick_size * brick_size * brick_size * voxel_size);
+    n = CLIP(n, DVZ_BRICKS_MIN_SLOTS, (uint64_t)max_axis * max_axis * max_axis);
+    uint32_t* s = bricks->slots_shape;
+    s[0] = MIN((uint32_t)floor(cbrt((double)n)), max_axis);
+    s[1] = MIN((uint32_t)floor(sqrt((double)(n / s[0]))), max_axis);
+    s[2] = MIN((uint32_t)(n / (s[0] * s[1])), max_axis);
+    bricks->slot_count = s[0] * s[1] * s[2];
+    bricks->slots = (DvzBrickSlot*)calloc(bricks->slot_count, sizeof(DvzBrickSlot));
+
+    log_debug(
+        "bricked volume %dx%dx%d with %d levels and %d bricks, atlas with %d bricks of %d^3",
+        shape[0], shape[1], shape[2], bricks->level_count, bricks->brick_count,
+        bricks->slot_count, brick_size);
+    DvzContext* ctx = canvas->gpu->context;
+    bricks->atlas = dvz_ctx_texture(
+        ctx, 3, (uvec3){s[0] * brick_size, s[1] * brick_size, s[2] * brick_size}, format);
+    bricks->page_table = dvz_ctx_texture(
+        ctx, 3, (uvec3){g[0], g[1], g[2]}, VK_FORMAT_R32G32B32A32_SFLOAT);
+    bricks->pages = (vec4*)calloc(g[0] * g[1] * g[2], sizeof(vec4));
+    bricks->pages_dirty = true;
+
+    // Preparation workers.
+    // The queues hold one item less than their capacity.
+    bricks->request_queue = dvz_fifo(DVZ_BRICKS_MAX_REQUESTS + DVZ_BRICKS_MAX_WORKERS + 1);
+    bricks->done_queue = dvz_fifo(DVZ_BRICKS_MAX_REQUESTS + 1);
+    bricks->worker_count = CLIP(dvz_num_threads() / 2, 1, DVZ_BRICKS_MAX_WORKERS);
+    for (uint32_t i = 0; i < bricks->worker_count; i++)
+        bricks->workers[i] = dvz_thread(_bricks_worker, bricks);
+
+    visual->bricks = bricks;
+    dvz_visual_texture(visual, DVZ_SOURCE_TYPE_VOLUME, 0, bricks->atlas);
+    dvz_visual_texture(visual, DVZ_SOURCE_TYPE_VOLUME, 1, bricks->page_table);
+    dvz_visual_data(
+        visual, DVZ_PROP_SHAPE, 0, 1, (uvec4){shape[0], shape[1], shape[2], brick_size});
+}
+
+
+
+DvzBrickStats dvz_visual_bricks_stats(DvzVisual* visual)
+{
+    ASSERT(visual != NULL);
+    DvzBrickStats stats = {0};
+    if (visual->bricks == NULL)
+    {
+        log_error("the visual has no bricked volume");
+        return stats;
+    }
+    return visual->bricks->stats;
+}
+
+
+
+void dvz_visual_mesh_lod(DvzVisual* visual, DvzMesh* mesh, uint32_t level_count)
+{
+    ASSERT(visual != NULL);
+    ASSERT(mesh != NULL);
+    if (visual->callback_bake != _mesh_bake)
+    {
+        log_error("the levels of detail of a mesh require a mesh visual");
+        return;
+    }
+    uint32_t nv = mesh->vertices.item_count;
+    uint32_t ni = mesh->indices.item_count;
+    if (nv == 0 || ni < 3)
+    {
+        log_error("the mesh has no faces");
+        return;
+    }
+    if (visual->mesh_levels != NULL)
+    {
+        _mesh_levels_destroy(visual->mesh_levels);
+        FREE(visual->mesh_levels);
+    }
+
+    DvzMeshLevels* levels = (DvzMeshLevels*)calloc(1, sizeof(DvzMeshLevels));
+    levels->visual = visual;
+    levels->level_count = level_count > 0 ? level_count : DVZ_MESH_LOD_LEVELS;
+    levels->mesh = dvz_mesh();
+    levels->mesh.vertices = dvz_array_copy(&mesh->vertices);
+    levels->mesh.indices = dvz_array_copy(&mesh->indices);
+    atomic_init(&levels->done, false);
+    atomic_init(&levels->cancel, false);
+    levels->stats.level_count = 1;
+    levels->stats.face_count = ni / 3;
+
+    // The vertex source is not baked, the normals are computed here if needed.
+    DvzGraphicsMeshVertex* vertices = (DvzGraphicsMeshVertex*)levels->mesh.vertices.data;
+    if (vertices[0].normal[0] == 0 && vertices[0].normal[1] == 0 && vertices[0].normal[2] == 0)
+        dvz_mesh_normals(&levels->mesh);
+
+    // The original mesh is displayed while it is being simplified.
+    dvz_visual_data_source(visual, DVZ_SOURCE_TYPE_VERTEX, 0, 0, nv, nv, vertices);
+    dvz_visual_data_source(
+        visual, DVZ_SOURCE_TYPE_INDEX, 0, 0, ni, ni, levels->mesh.indices.data);
+
+    visual->mesh_levels = levels;
+    levels->worker = dvz_thread(_mesh_levels_worker, levels);
+}
+
+
+
+DvzMeshLevelStats dvz_visual_mesh_lod_stats(DvzVisual* visual)
+{
+    ASSERT(visual != NULL);
+    DvzMeshLevelStats stats = {0};
+    if (visual->mesh_levels == NULL)
+    {
+        log_error("the visual has no levels of detail");
+        return stats;
+    }
+    return visual->mesh_levels->stats;
+}
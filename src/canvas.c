@@ -84,6 +84,24 @@ depth_image(DvzImages* depth_images, DvzRenderpass* renderpass, uint32_t width,
 
 
 
+static void
+pick_image(DvzImages* pick_images, DvzRenderpass* renderpass, uint32_t width, uint32_t height)
+{
+    // ID buffer attachment
+    dvz_images_format(pick_images, renderpass->attachments[2].format);
+    dvz_images_size(pick_images, width, height, 1);
+    dvz_images_tiling(pick_images, VK_IMAGE_TILING_OPTIMAL);
+    dvz_images_usage(
+        pick_images, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+    dvz_images_memory(pick_images, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    dvz_images_layout(pick_images, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+    dvz_images_aspect(pick_images, VK_IMAGE_ASPECT_COLOR_BIT);
+    dvz_images_queue_access(pick_images, DVZ_DEFAULT_QUEUE_RENDER);
+    dvz_images_create(pick_images);
+}
+
+
+
 static void blank_commands(DvzCanvas* canvas, DvzCommands* cmds, uint32_t cmd_idx)
 {
     dvz_cmd_begin(cmds, cmd_idx);
@@ -451,7 +469,12 @@ static void _refill_frame(DvzCanvas* canvas)
         // If refill has just been requested, reset the ongoing refill by setting completed to
         // false for all swapchain images.
         if (atomic_load(&canvas->refills.status) == DVZ_REFILL_REQUESTED)
+        {
             memset(canvas->refills.completed, 0, DVZ_MAX_SWAPCHAIN_IMAGES);
+            dvz_gpu_lock(canvas->gpu);
+            canvas->refills.serial = canvas->gpu->bindings_cache.serial;
+            dvz_gpu_unlock(canvas->gpu);
+        }
 
         // Skip this step if the current swapchain image has already been processed.
         if (canvas->refills.completed[img_idx])
@@ -467,7 +490,10 @@ static void _refill_frame(DvzCanvas* canvas)
         canvas->clock.interval = 0;
 
         // Refill the command buffer for the current swapchain image.
+        // NOTE: the command pools are shared by all canvases on the same GPU.
+        dvz_gpu_lock(canvas->gpu);
         _refill_canvas(canvas, img_idx);
+        dvz_gpu_unlock(canvas->gpu);
 
         // Mark that command buffer as updated.
         canvas->refills.completed[img_idx] = true;
@@ -480,6 +506,10 @@ static void _refill_frame(DvzCanvas* canvas)
             atomic_store(&canvas->refills.status, status);
             // Reset the img_updated bool array.
             memset(canvas->refills.completed, 0, DVZ_MAX_SWAPCHAIN_IMAGES);
+
+            // The descriptor sets released before the start of the refill are no longer used
+            // by the command buffers of the canvas.
+            canvas->refills.retired = canvas->refills.serial;
         }
     }
 }
@@ -572,8 +602,9 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
     }
 
     // Create default renderpass.
+    bool pick = (flags & DVZ_CANVAS_FLAGS_PICK) != 0;
     canvas->renderpass =
-        default_renderpass(gpu, DVZ_DEFAULT_BACKGROUND, DVZ_DEFAULT_IMAGE_FORMAT, overlay);
+        default_renderpass(gpu, DVZ_DEFAULT_BACKGROUND, DVZ_DEFAULT_IMAGE_FORMAT, overlay, pick);
     if (overlay)
         canvas->renderpass_overlay =
             renderpass_overlay(gpu, DVZ_DEFAULT_IMAGE_FORMAT, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
@@ -618,6 +649,16 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
         depth_image(
             &canvas->depth_image, &canvas->renderpass, //
             canvas->swapchain.images->width, canvas->swapchain.images->height);
+
+        // ID buffer attachment for GPU picking.
+        if (pick)
+        {
+            canvas->pick = calloc(1, sizeof(DvzPickBuffer));
+            canvas->pick->image = dvz_images(gpu, VK_IMAGE_TYPE_2D, 1);
+            pick_image(
+                &canvas->pick->image, &canvas->renderpass, //
+                canvas->swapchain.images->width, canvas->swapchain.images->height);
+        }
     }
 
     // Create renderpass.
@@ -630,6 +671,8 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
         canvas->framebuffers = dvz_framebuffers(gpu);
         dvz_framebuffers_attachment(&canvas->framebuffers, 0, canvas->swapchain.images);
         dvz_framebuffers_attachment(&canvas->framebuffers, 1, &canvas->depth_image);
+        if (pick)
+            dvz_framebuffers_attachment(&canvas->framebuffers, 2, &canvas->pick->image);
         dvz_framebuffers_create(&canvas->framebuffers, &canvas->renderpass);
 
         if (overlay)
@@ -669,6 +712,28 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
     // Default submit instance.
     canvas->submit = dvz_submit(gpu);
 
+    // GPU picking: the requested rectangle of the ID buffer is copied to a host-visible buffer
+    // on the render queue, just after the frame submission.
+    if (pick)
+    {
+        DvzPickBuffer* pb = canvas->pick;
+        VkDeviceSize size = DVZ_PICK_MAX_SIZE * DVZ_PICK_MAX_SIZE * sizeof(uvec2);
+
+        pb->staging = dvz_buffer(gpu);
+        dvz_buffer_size(&pb->staging, size);
+        dvz_buffer_usage(&pb->staging, VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+        dvz_buffer_memory(
+            &pb->staging,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        dvz_buffer_queue_access(&pb->staging, DVZ_DEFAULT_QUEUE_RENDER);
+        dvz_buffer_create(&pb->staging);
+
+        pb->cmds = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_RENDER, 1);
+        pb->fence = dvz_fences(gpu, 1, true);
+        pb->ids = calloc(DVZ_PICK_MAX_SIZE * DVZ_PICK_MAX_SIZE, sizeof(uvec2));
+        pb->status = DVZ_PICK_IDLE;
+    }
+
     canvas->transfers = dvz_fifo(DVZ_MAX_FIFO_CAPACITY);
 
     // Event system.
@@ -678,6 +743,7 @@ _canvas(DvzGpu* gpu, uint32_t width, uint32_t height, bool offscreen, bool overl
 
         canvas->mouse = dvz_mouse();
         canvas->keyboard = dvz_keyboard();
+        canvas->coalescer.policy = DVZ_EVENT_COALESCE_FRAME;
 
         backend_event_callbacks(canvas);
     }
@@ -768,6 +834,8 @@ void dvz_canvas_recreate(DvzCanvas* canvas)
     if (canvas->overlay)
         dvz_framebuffers_destroy(&canvas->framebuffers_overlay);
     dvz_images_destroy(&canvas->depth_image);
+    if (canvas->pick != NULL)
+        dvz_images_destroy(&canvas->pick->image);
     dvz_images_destroy(canvas->swapchain.images);
 
     // Recreate the swapchain. This will automatically set the swapchain->images new size.
@@ -783,6 +851,11 @@ void dvz_canvas_recreate(DvzCanvas* canvas)
     // Need to recreate the depth image with the new size.
     dvz_images_size(&canvas->depth_image, width, height, 1);
     dvz_images_create(&canvas->depth_image);
+    if (canvas->pick != NULL)
+    {
+        dvz_images_size(&canvas->pick->image, width, height, 1);
+        dvz_images_create(&canvas->pick->image);
+    }
 
     // Recreate the framebuffers with the new size.
     ASSERT(framebuffers->attachments[0]->width == width);
@@ -813,7 +886,7 @@ DvzCommands* dvz_canvas_commands(DvzCanvas* canvas, uint32_t queue_idx, uint32_t
 DvzCanvas* dvz_canvas_offscreen(DvzGpu* gpu, uint32_t width, uint32_t height, int flags)
 {
     // NOTE: no overlay for now in offscreen canvas
-    return _canvas(gpu, width, height, true, false, 0);
+    return _canvas(gpu, width, height, true, false, flags & DVZ_CANVAS_FLAGS_PICK);
 }
 
 
@@ -1272,10 +1345,10 @@ void dvz_event_mouse_press(DvzCanvas* canvas, DvzMouseButton button, int modifie
     event.u.b.button = button;
     event.u.b.modifiers = modifiers;
 
-    // Update the mouse state.
-    dvz_mouse_event(&canvas->mouse, canvas, event);
+    // The pending moves update the mouse state before the button.
+    _event_flush(canvas);
 
-    _event_produce(canvas, event);
+    _event_mouse(canvas, event);
 }
 
 
@@ -1289,10 +1362,10 @@ void dvz_event_mouse_release(DvzCanvas* canvas, DvzMouseButton button, int modif
     event.u.b.button = button;
     event.u.b.modifiers = modifiers;
 
-    // Update the mouse state.
-    dvz_mouse_event(&canvas->mouse, canvas, event);
+    // The pending moves update the mouse state before the button.
+    _event_flush(canvas);
 
-    _event_produce(canvas, event);
+    _event_mouse(canvas, event);
 }
 
 
@@ -1307,10 +1380,11 @@ void dvz_event_mouse_move(DvzCanvas* canvas, vec2 pos, int modifiers)
     event.u.m.pos[1] = pos[1];
     event.u.m.modifiers = modifiers;
 
-    // Update the mouse state.
-    dvz_mouse_event(&canvas->mouse, canvas, event);
+    // The event may be merged with the next ones, see dvz_event_coalesce().
+    if (_event_coalesce(canvas, event))
+        return;
 
-    _event_produce(canvas, event);
+    _event_mouse(canvas, event);
 }
 
 
@@ -1325,10 +1399,11 @@ void dvz_event_mouse_wheel(DvzCanvas* canvas, vec2 dir, int modifiers)
     event.u.w.dir[1] = dir[1];
     event.u.w.modifiers = modifiers;
 
-    // Update the mouse state.
-    dvz_mouse_event(&canvas->mouse, canvas, event);
+    // The event may be merged with the next ones, see dvz_event_coalesce().
+    if (_event_coalesce(canvas, event))
+        return;
 
-    _event_produce(canvas, event);
+    _event_mouse(canvas, event);
 }
 
 
@@ -1441,6 +1516,24 @@ void dvz_event_frame(DvzCanvas* canvas, uint64_t idx, double time, double interv
 
 
 
+void dvz_event_coalesce(DvzCanvas* canvas, DvzEventCoalesce policy)
+{
+    ASSERT(canvas != NULL);
+    if (policy == DVZ_EVENT_COALESCE_NONE)
+        _event_flush(canvas);
+    canvas->coalescer.policy = policy;
+}
+
+
+
+uint64_t dvz_event_coalesced(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    return canvas->coalescer.coalesced;
+}
+
+
+
 int dvz_event_pending(DvzCanvas* canvas, DvzEventType type)
 {
     ASSERT(canvas != NULL);
@@ -1544,6 +1637,10 @@ static void _screencast_timer_callback(DvzCanvas* canvas, DvzEvent ev)
     if (!screencast->is_active)
         return;
 
+    // Do nothing if the previous screencast image has not been downloaded yet.
+    if (screencast->status > DVZ_SCREENCAST_IDLE)
+        return;
+
     log_trace("screencast timer frame #%d", screencast->frame_idx);
 
     dvz_fences_wait(&screencast->fence, 0);
@@ -1552,13 +1649,17 @@ static void _screencast_timer_callback(DvzCanvas* canvas, DvzEvent ev)
     dvz_submit_reset(submit);
     dvz_submit_commands(submit, &screencast->cmds);
 
-    // Wait for "image_ready" semaphore
-    dvz_submit_wait_semaphores(
-        submit, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, //
-        &canvas->sem_render_finished, canvas->cur_frame);
+    // An offscreen canvas has no render semaphores, the copy is sent after the render fence.
+    if (!canvas->offscreen)
+    {
+        // Wait for "image_ready" semaphore
+        dvz_submit_wait_semaphores(
+            submit, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, //
+            &canvas->sem_render_finished, canvas->cur_frame);
 
-    // Signal screencast_finished semaphore
-    dvz_submit_signal_semaphores(submit, &screencast->semaphore, 0);
+        // Signal screencast_finished semaphore
+        dvz_submit_signal_semaphores(submit, &screencast->semaphore, 0);
+    }
 
     // Send screencast cmd buf to transfer queue and signal screencast fence when submitting.
     screencast->status = DVZ_SCREENCAST_AWAIT_COPY;
@@ -1596,10 +1697,13 @@ static void _screencast_post_send(DvzCanvas* canvas, DvzEvent ev)
         // The present swapchain command must wait for the screencast semaphore rather than
         // the render_finished semaphore.
         // HACK: do not wait when submitting at the first frame.
+        if (canvas->offscreen)
+            dvz_fences_wait(&canvas->fences_render_finished, canvas->cur_frame);
         dvz_submit_send(&screencast->submit, img_idx, &screencast->fence, 0);
         // canvas->frame_idx == 0 ? NULL : &screencast->fence, 0);
 
-        canvas->present_semaphores = &screencast->semaphore;
+        if (!canvas->offscreen)
+            canvas->present_semaphores = &screencast->semaphore;
         screencast->status = DVZ_SCREENCAST_AWAIT_TRANSFER;
     }
 
@@ -1827,19 +1931,746 @@ uint8_t* dvz_screenshot(DvzCanvas* canvas, bool has_alpha)
 
 
 
+/*************************************************************************************************/
+/*  GPU picking                                                                                  */
+/*************************************************************************************************/
+
+static void _pick_cmds(DvzCanvas* canvas, uvec3 offset, uvec3 shape)
+{
+    ASSERT(canvas != NULL);
+    DvzPickBuffer* pb = canvas->pick;
+    ASSERT(pb != NULL);
+
+    DvzBarrier barrier = dvz_barrier(canvas->gpu);
+    dvz_barrier_images(&barrier, &pb->image);
+    dvz_barrier_images_layout(
+        &barrier, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+
+    dvz_cmd_reset(&pb->cmds, 0);
+    dvz_cmd_begin(&pb->cmds, 0);
+
+    // Wait for the ID buffer to be written by the frame that has just been submitted.
+    dvz_barrier_stages(
+        &barrier, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    dvz_barrier_images_access(
+        &barrier, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+    dvz_cmd_barrier(&pb->cmds, 0, &barrier);
+
+    // Copy the rectangle to the staging buffer.
+    dvz_cmd_copy_image_to_buffer_region(&pb->cmds, 0, &pb->image, offset, shape, &pb->staging, 0);
+
+    // Prevent the next frame from clearing the ID buffer before the copy has completed.
+    dvz_barrier_stages(
+        &barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+    dvz_barrier_images_access(
+        &barrier, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT);
+    dvz_cmd_barrier(&pb->cmds, 0, &barrier);
+
+    dvz_cmd_end(&pb->cmds, 0);
+}
+
+
+
+static void _pick_download(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    DvzPickBuffer* pb = canvas->pick;
+    ASSERT(pb != NULL);
+
+    uint32_t w = pb->size[0], h = pb->size[1];
+    dvz_buffer_download(&pb->staging, 0, w * h * sizeof(uvec2), pb->ids);
+
+    // Find the hit closest to the center of the rectangle.
+    DvzEvent ev = {0};
+    ev.type = DVZ_EVENT_PICK;
+    int64_t best = INT64_MAX, d = 0, dx = 0, dy = 0;
+    for (uint32_t y = 0; y < h; y++)
+    {
+        for (uint32_t x = 0; x < w; x++)
+        {
+            if (pb->ids[y * w + x][0] == 0)
+                continue;
+            dx = 2 * (int64_t)x + 1 - (int64_t)w;
+            dy = 2 * (int64_t)y + 1 - (int64_t)h;
+            d = dx * dx + dy * dy;
+            if (d < best)
+            {
+                best = d;
+                ev.u.p.visual_id = pb->ids[y * w + x][0];
+                ev.u.p.item_id = pb->ids[y * w + x][1];
+            }
+        }
+    }
+    ev.u.p.pos[0] = pb->pos[0];
+    ev.u.p.pos[1] = pb->pos[1];
+    ev.u.p.size[0] = w;
+    ev.u.p.size[1] = h;
+    ev.u.p.ids = (const uvec2*)pb->ids;
+    log_trace(
+        "pick event at (%d, %d), visual %d, item %d", //
+        pb->pos[0], pb->pos[1], ev.u.p.visual_id, ev.u.p.item_id);
+    _event_produce(canvas, ev);
+}
+
+
+
+// Called after every frame submission: send the copy of the requested rectangle, or download it
+// once the copy has completed. The fence is never waited upon so that the frame loop never
+// stalls.
+static void _pick_frame(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    DvzPickBuffer* pb = canvas->pick;
+    ASSERT(pb != NULL);
+
+    if (pb->status == DVZ_PICK_REQUESTED)
+    {
+        // Clip the rectangle to the framebuffer, whose size may have changed since the request.
+        DvzImages* image = &pb->image;
+        if (pb->pos[0] >= image->width || pb->pos[1] >= image->height)
+        {
+            log_warn("discard GPU picking request outside of the framebuffer");
+            pb->status = DVZ_PICK_IDLE;
+            return;
+        }
+        pb->size[0] = MIN(pb->size[0], image->width - pb->pos[0]);
+        pb->size[1] = MIN(pb->size[1], image->height - pb->pos[1]);
+
+        _pick_cmds(
+            canvas, (uvec3){pb->pos[0], pb->pos[1], 0}, (uvec3){pb->size[0], pb->size[1], 1});
+
+        DvzSubmit submit = dvz_submit(canvas->gpu);
+        dvz_submit_commands(&submit, &pb->cmds);
+        dvz_submit_send(&submit, 0, &pb->fence, 0);
+        pb->status = DVZ_PICK_AWAIT_TRANSFER;
+    }
+
+    else if (pb->status == DVZ_PICK_AWAIT_TRANSFER && dvz_fences_ready(&pb->fence, 0))
+    {
+        _pick_download(canvas);
+        pb->status = DVZ_PICK_IDLE;
+    }
+}
+
+
+
+void dvz_canvas_pick(DvzCanvas* canvas, uint32_t x, uint32_t y, uint32_t w, uint32_t h)
+{
+    ASSERT(canvas != NULL);
+    DvzPickBuffer* pb = canvas->pick;
+    if (pb == NULL)
+    {
+        log_error("GPU picking requires a canvas created with DVZ_CANVAS_FLAGS_PICK");
+        return;
+    }
+    if (pb->status == DVZ_PICK_AWAIT_TRANSFER)
+    {
+        log_debug("skip GPU picking request as the previous one is still pending");
+        return;
+    }
+    if (w > DVZ_PICK_MAX_SIZE || h > DVZ_PICK_MAX_SIZE)
+        log_warn(
+            "GPU picking rectangle %dx%d clipped to %dx%d", w, h, //
+            DVZ_PICK_MAX_SIZE, DVZ_PICK_MAX_SIZE);
+
+    pb->pos[0] = x;
+    pb->pos[1] = y;
+    pb->size[0] = CLIP(w, 1, DVZ_PICK_MAX_SIZE);
+    pb->size[1] = CLIP(h, 1, DVZ_PICK_MAX_SIZE);
+    pb->status = DVZ_PICK_REQUESTED;
+}
+
+
+
+/*************************************************************************************************/
+/*  Batch rendering                                                                              */
+/*************************************************************************************************/
+
+static bool _ends_with(const char* str, const char* suffix)
+{
+    ASSERT(str != NULL);
+    ASSERT(suffix != NULL);
+    size_t n = strlen(str);
+    size_t k = strlen(suffix);
+    return n >= k && strcmp(str + n - k, suffix) == 0;
+}
+
+
+
+static void _batch_cmds(DvzBatch* batch)
+{
+    ASSERT(batch != NULL);
+    ASSERT(batch->canvas != NULL);
+
+    DvzImages* images = batch->canvas->swapchain.images;
+    DvzCommands* cmds = &batch->cmds;
+
+    DvzBarrier barrier = dvz_barrier(batch->canvas->gpu);
+    dvz_barrier_stages(&barrier, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    dvz_barrier_images(&barrier, images);
+
+    // NOTE: one command buffer per swapchain image, recorded once and reused for all jobs.
+    for (uint32_t i = 0; i < images->count; i++)
+    {
+        dvz_cmd_reset(cmds, i);
+        dvz_cmd_begin(cmds, i);
+
+        dvz_barrier_images_layout(
+            &barrier, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        dvz_barrier_images_access(
+            &barrier, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+        dvz_cmd_barrier(cmds, i, &barrier);
+
+        dvz_cmd_copy_image(cmds, i, images, &batch->staging);
+
+        dvz_barrier_images_layout(
+            &barrier, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
+        dvz_barrier_images_access(
+            &barrier, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+        dvz_cmd_barrier(cmds, i, &barrier);
+
+        dvz_cmd_end(cmds, i);
+    }
+}
+
+
+
+static void* _batch_worker(void* user_data)
+{
+    DvzBatch* batch = (DvzBatch*)user_data;
+    ASSERT(batch != NULL);
+    uint32_t width = batch->staging.width;
+    uint32_t height = batch->staging.height;
+
+    DvzBatchTask* task = NULL;
+    while (true)
+    {
+        task = (DvzBatchTask*)dvz_fifo_dequeue(&batch->task_queue, true);
+        ASSERT(task != NULL);
+        if (task->job == NULL)
+            break;
+
+        DvzBatchJob* job = task->job;
+        ASSERT(task->rgb != NULL);
+
+        if (job->rgb != NULL)
+            memcpy(job->rgb, task->rgb, width * height * 3);
+
+        if (job->path[0] != 0)
+        {
+            log_debug("batch worker writing %s", job->path);
+            int res = 0;
+            if (_ends_with(job->path, ".ppm"))
+                res = dvz_write_ppm(job->path, width, height, task->rgb);
+            else if (_ends_with(job->path, ".qoi"))
+                res = dvz_write_qoi(job->path, width, height, task->rgb);
+            else
+                res = dvz_write_png(job->path, width, height, task->rgb);
+            if (res != 0)
+                log_error("failed writing batch image %s", job->path);
+        }
+
+        // Give the buffer back to the pool.
+        task->job = NULL;
+        dvz_fifo_enqueue(&batch->free_queue, task);
+    }
+    return NULL;
+}
+
+
+
+DvzBatch* dvz_batch(DvzCanvas* canvas, uint32_t worker_count)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(canvas->gpu != NULL);
+    if (!canvas->offscreen)
+        log_warn("batch rendering is designed for offscreen canvases");
+
+    worker_count = CLIP(worker_count, 1, DVZ_BATCH_MAX_WORKERS);
+    DvzImages* images = canvas->swapchain.images;
+
+    DvzBatch* batch = calloc(1, sizeof(DvzBatch));
+    batch->canvas = canvas;
+    batch->worker_count = worker_count;
+
+    // Staging image, created once for all jobs.
+    batch->staging = dvz_images(canvas->gpu, VK_IMAGE_TYPE_2D, 1);
+    DvzImages* staging = &batch->staging;
+    dvz_images_format(staging, images->format);
+    dvz_images_size(staging, images->width, images->height, images->depth);
+    dvz_images_tiling(staging, VK_IMAGE_TILING_LINEAR);
+    dvz_images_usage(staging, VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+    dvz_images_layout(staging, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+    dvz_images_memory(
+        staging, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    dvz_images_create(staging);
+    dvz_images_transition(staging);
+
+    // Copy command buffers.
+    batch->cmds = dvz_commands(canvas->gpu, DVZ_DEFAULT_QUEUE_TRANSFER, images->count);
+    _batch_cmds(batch);
+
+    // Bounded pool of RGB buffers: one per worker, plus one being filled by the main thread.
+    batch->free_queue = dvz_fifo(DVZ_BATCH_MAX_WORKERS + 1);
+    batch->task_queue = dvz_fifo(DVZ_BATCH_MAX_WORKERS + 1);
+    for (uint32_t i = 0; i < worker_count + 1; i++)
+    {
+        batch->tasks[i].batch = batch;
+        batch->tasks[i].rgb = calloc(images->width * images->height, 3 * sizeof(uint8_t));
+        dvz_fifo_enqueue(&batch->free_queue, &batch->tasks[i]);
+    }
+
+    // Encoding workers.
+    for (uint32_t i = 0; i < worker_count; i++)
+        batch->workers[i] = dvz_thread(_batch_worker, batch);
+
+    dvz_obj_created(&batch->obj);
+    return batch;
+}
+
+
+
+void dvz_batch_job(
+    DvzBatch* batch, DvzBatchCallback callback, void* user_data, const char* path, uint8_t* rgb)
+{
+    ASSERT(batch != NULL);
+    if (path == NULL && rgb == NULL)
+        log_warn("batch job without output path or buffer");
+
+    if (batch->job_count >= batch->job_capacity)
+    {
+        batch->job_capacity = batch->job_capacity == 0 ? 64 : 2 * batch->job_capacity;
+        REALLOC(batch->jobs, batch->job_capacity * sizeof(DvzBatchJob));
+    }
+    ASSERT(batch->job_count < batch->job_capacity);
+
+    DvzBatchJob* job = &batch->jobs[batch->job_count++];
+    memset(job, 0, sizeof(DvzBatchJob));
+    job->callback = callback;
+    job->user_data = user_data;
+    job->rgb = rgb;
+    if (path != NULL)
+        strncpy(job->path, path, sizeof(job->path) - 1);
+}
+
+
+
+DvzBatchStats dvz_batch_run(DvzBatch* batch)
+{
+    ASSERT(batch != NULL);
+    DvzCanvas* canvas = batch->canvas;
+    ASSERT(canvas != NULL);
+    DvzBatchStats stats = {0};
+
+    if (canvas->app->is_running)
+    {
+        log_error("cannot run a batch while the app is running");
+        return stats;
+    }
+    DvzImages* images = canvas->swapchain.images;
+    if (images->width != batch->staging.width || images->height != batch->staging.height)
+    {
+        log_error("the canvas has been resized since the batch creation");
+        return stats;
+    }
+
+    log_debug("run batch with %d jobs and %d workers", batch->job_count, batch->worker_count);
+    DvzClock clock = {0};
+    _clock_init(&clock);
+    double t0 = 0;
+
+    DvzBatchJob* job = NULL;
+    DvzBatchTask* task = NULL;
+    for (uint32_t i = 0; i < batch->job_count; i++)
+    {
+        job = &batch->jobs[i];
+        t0 = _clock_get(&clock);
+
+        // Update the scene.
+        if (job->callback != NULL)
+            job->callback(canvas, i, job->user_data);
+
+        // Render a single frame.
+        dvz_app_run(canvas->app, 1);
+
+        // Copy the framebuffer to the staging image.
+        dvz_cmd_submit_sync(&batch->cmds, canvas->swapchain.img_idx);
+
+        // Wait for a free buffer: this blocks if the encoding workers lag behind.
+        task = (DvzBatchTask*)dvz_fifo_dequeue(&batch->free_queue, true);
+        ASSERT(task != NULL);
+        dvz_images_download(&batch->staging, 0, true, false, task->rgb);
+
+        stats.render_time += _clock_get(&clock) - t0;
+
+        // Encode the image on a worker thread while the next job is being rendered.
+        task->job = job;
+        dvz_fifo_enqueue(&batch->task_queue, task);
+    }
+
+    // Wait until all buffers have been given back to the pool.
+    for (uint32_t i = 0; i < batch->worker_count + 1; i++)
+    {
+        task = (DvzBatchTask*)dvz_fifo_dequeue(&batch->free_queue, true);
+        ASSERT(task != NULL);
+        ASSERT(task->job == NULL);
+    }
+    for (uint32_t i = 0; i < batch->worker_count + 1; i++)
+        dvz_fifo_enqueue(&batch->free_queue, &batch->tasks[i]);
+
+    stats.job_count = batch->job_count;
+    stats.elapsed = _clock_get(&clock);
+    stats.images_per_second = stats.elapsed > 0 ? stats.job_count / stats.elapsed : 0;
+    log_info(
+        "batch rendered %d images in %.3f s (%.1f images/s, %.3f s on the render thread)",
+        stats.job_count, stats.elapsed, stats.images_per_second, stats.render_time);
+
+    // The jobs have been processed.
+    batch->job_count = 0;
+    batch->stats = stats;
+    return stats;
+}
+
+
+
+void dvz_batch_destroy(DvzBatch* batch)
+{
+    if (batch == NULL || !dvz_obj_is_created(&batch->obj))
+        return;
+    ASSERT(batch->canvas != NULL);
+
+    // Stop the workers with a NULL job.
+    DvzBatchTask stop = {0};
+    stop.batch = batch;
+    for (uint32_t i = 0; i < batch->worker_count; i++)
+        dvz_fifo_enqueue(&batch->task_queue, &stop);
+    for (uint32_t i = 0; i < batch->worker_count; i++)
+        dvz_thread_join(&batch->workers[i]);
+
+    dvz_fifo_destroy(&batch->task_queue);
+    dvz_fifo_destroy(&batch->free_queue);
+    for (uint32_t i = 0; i < batch->worker_count + 1; i++)
+        FREE(batch->tasks[i].rgb);
+
+    dvz_gpu_wait(batch->canvas->gpu);
+    dvz_images_destroy(&batch->staging);
+    FREE(batch->jobs);
+
+    dvz_obj_destroyed(&batch->obj);
+    FREE(batch);
+}
+
+
+
 /*************************************************************************************************/
 /*  Video screencast                                                                             */
 /*************************************************************************************************/
 
-static void _video_callback(DvzCanvas* canvas, DvzEvent ev)
+// Half-resolution RGBA image, each pixel is the mean of a 2x2 block.
+static void _video_downscale(uint32_t width, uint32_t height, const uint8_t* src, uint8_t* dst)
+{
+    ASSERT(src != NULL);
+    ASSERT(dst != NULL);
+    uint32_t w = MAX(1, width / 2), h = MAX(1, height / 2);
+    uint32_t x0 = 0, x1 = 0, y0 = 0, y1 = 0, sum = 0;
+    for (uint32_t y = 0; y < h; y++)
+    {
+        y0 = MIN(2 * y, height - 1);
+        y1 = MIN(2 * y + 1, height - 1);
+        for (uint32_t x = 0; x < w; x++)
+        {
+            x0 = MIN(2 * x, width - 1);
+            x1 = MIN(2 * x + 1, width - 1);
+            for (uint32_t c = 0; c < 4; c++)
+            {
+                sum = (uint32_t)src[4 * (y0 * width + x0) + c] + src[4 * (y0 * width + x1) + c] +
+                      src[4 * (y1 * width + x0) + c] + src[4 * (y1 * width + x1) + c];
+                dst[4 * (y * w + x) + c] = (uint8_t)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+
+
+// Full-resolution RGBA image of a half-resolution image, with the nearest pixels.
+static void _video_upscale(uint32_t width, uint32_t height, const uint8_t* src, uint8_t* dst)
+{
+    ASSERT(src != NULL);
+    ASSERT(dst != NULL);
+    uint32_t w = MAX(1, width / 2), h = MAX(1, height / 2);
+    const uint8_t* row = NULL;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        row = &src[4 * MIN(y / 2, h - 1) * w];
+        for (uint32_t x = 0; x < width; x++)
+            memcpy(&dst[4 * (y * width + x)], &row[4 * MIN(x / 2, w - 1)], 4);
+    }
+}
+
+
+
+static void* _video_worker(void* user_data)
+{
+    DvzVideoEncoder* encoder = (DvzVideoEncoder*)user_data;
+    ASSERT(encoder != NULL);
+    uint32_t width = encoder->width;
+    uint32_t height = encoder->height;
+
+    DvzVideoFrame* frame = NULL;
+    uint8_t* rgba = NULL;
+    double t0 = 0, t1 = 0;
+    while (true)
+    {
+        frame = (DvzVideoFrame*)dvz_fifo_dequeue(&encoder->frame_queue, true);
+        ASSERT(frame != NULL);
+        if (frame->stop)
+            break;
+
+        // The encoding callback always receives full-resolution images.
+        rgba = frame->rgba;
+        if (frame->downscaled)
+        {
+            _video_upscale(width, height, frame->rgba, encoder->upscaled);
+            rgba = encoder->upscaled;
+        }
+
+        t0 = _clock_get(&encoder->clock);
+        if (encoder->callback != NULL)
+            encoder->callback(
+                encoder->canvas, frame->idx, width, height, rgba, encoder->user_data);
+        t1 = _clock_get(&encoder->clock);
+
+        pthread_mutex_lock(&encoder->lock);
+        encoder->stats.encoded_count++;
+        encoder->encode_time += t1 - t0;
+        encoder->latency_time += t1 - frame->time;
+        encoder->stats.latency_max = MAX(encoder->stats.latency_max, t1 - frame->time);
+        pthread_mutex_unlock(&encoder->lock);
+
+        // Give the frame back to the pool.
+        dvz_fifo_enqueue(frame->downscaled ? &encoder->small_queue : &encoder->free_queue, frame);
+    }
+    return NULL;
+}
+
+
+
+// Queue a downloaded screencast image, this is the only work done by the render thread.
+static void _video_screencast(DvzCanvas* canvas, DvzEvent ev)
 {
     ASSERT(canvas != NULL);
-    log_debug("video frame #%d", ev.u.sc.idx);
+    DvzVideoEncoder* encoder = canvas->video;
+    uint8_t* rgba = ev.u.sc.rgba;
+    if (encoder == NULL || !dvz_obj_is_created(&encoder->obj))
+    {
+        FREE(rgba);
+        return;
+    }
+    log_trace("video frame #%d", ev.u.sc.idx);
+
+    DvzVideoStats* stats = &encoder->stats;
+    DvzVideoFrame* frame = NULL;
+    double t0 = 0;
+    if (ev.u.sc.width == encoder->width && ev.u.sc.height == encoder->height)
+    {
+        frame = (DvzVideoFrame*)dvz_fifo_dequeue(&encoder->free_queue, false);
+        if (frame == NULL && encoder->policy == DVZ_VIDEO_POLICY_BLOCK)
+        {
+            t0 = _clock_get(&encoder->clock);
+            frame = (DvzVideoFrame*)dvz_fifo_dequeue(&encoder->free_queue, true);
+            t0 = _clock_get(&encoder->clock) - t0;
+        }
+        else if (frame == NULL && encoder->policy == DVZ_VIDEO_POLICY_DOWNSCALE)
+            frame = (DvzVideoFrame*)dvz_fifo_dequeue(&encoder->small_queue, false);
+    }
+    else
+        log_warn("dropping video frame, the canvas has been resized during the recording");
+
+    pthread_mutex_lock(&encoder->lock);
+    stats->frame_count++;
+    stats->block_time += t0;
+    if (frame == NULL)
+        stats->dropped_count++;
+    else if (frame->downscaled)
+        stats->downscaled_count++;
+    pthread_mutex_unlock(&encoder->lock);
+    if (frame == NULL)
+    {
+        FREE(rgba);
+        return;
+    }
+
+    if (frame->downscaled)
+        _video_downscale(encoder->width, encoder->height, rgba, frame->rgba);
+    else
+        memcpy(frame->rgba, rgba, 4 * encoder->width * encoder->height);
+    FREE(rgba);
+
+    frame->idx = ev.u.sc.idx;
+    frame->time = _clock_get(&encoder->clock);
+    dvz_fifo_enqueue(&encoder->frame_queue, frame);
+    uint32_t queued = (uint32_t)dvz_fifo_size(&encoder->frame_queue);
+
+    pthread_mutex_lock(&encoder->lock);
+    stats->queue_max = MAX(stats->queue_max, queued);
+    pthread_mutex_unlock(&encoder->lock);
+}
+
+
+
+static void _video_encoder_destroy(DvzCanvas* canvas, DvzEvent ev)
+{
+    ASSERT(canvas != NULL);
+    DvzVideoEncoder* encoder = canvas->video;
+    if (encoder == NULL || !dvz_obj_is_created(&encoder->obj))
+        return;
+
+    // The worker encodes the queued frames before the stop frame.
+    dvz_fifo_enqueue(&encoder->frame_queue, &encoder->stop);
+    dvz_thread_join(&encoder->worker);
+
+    dvz_fifo_destroy(&encoder->frame_queue);
+    dvz_fifo_destroy(&encoder->small_queue);
+    dvz_fifo_destroy(&encoder->free_queue);
+    for (uint32_t i = 0; i < 2 * encoder->frame_count; i++)
+        FREE(encoder->frames[i].rgba);
+    FREE(encoder->upscaled);
+    pthread_mutex_destroy(&encoder->lock);
+
+    dvz_obj_destroyed(&encoder->obj);
+    FREE(encoder);
+    canvas->video = NULL;
+}
+
+
+
+DvzVideoEncoder* dvz_video_encoder(
+    DvzCanvas* canvas, uint32_t frame_count, DvzVideoPolicy policy, DvzVideoCallback callback,
+    void* user_data)
+{
+    ASSERT(canvas != NULL);
+    if (canvas->video != NULL)
+    {
+        log_error("the canvas already has a video encoder");
+        return canvas->video;
+    }
+    if (canvas->screencast == NULL || !canvas->screencast->has_alpha)
+    {
+        log_error("the video encoder requires a screencast with an alpha channel");
+        return NULL;
+    }
+
+    DvzVideoEncoder* encoder = calloc(1, sizeof(DvzVideoEncoder));
+    encoder->canvas = canvas;
+    encoder->policy = policy;
+    encoder->callback = callback;
+    encoder->user_data = user_data;
+    encoder->width = canvas->swapchain.images->width;
+    encoder->height = canvas->swapchain.images->height;
+    encoder->frame_count = CLIP(frame_count, 1, DVZ_VIDEO_MAX_FRAMES);
+    _clock_init(&encoder->clock);
+    pthread_mutex_init(&encoder->lock, NULL);
+
+    // Bounded pool of frames, the half-resolution frames are allocated with the downscale policy.
+    uint32_t n = encoder->frame_count;
+    encoder->free_queue = dvz_fifo(DVZ_VIDEO_MAX_FRAMES + 1);
+    encoder->small_queue = dvz_fifo(DVZ_VIDEO_MAX_FRAMES + 1);
+    encoder->frame_queue = dvz_fifo(2 * DVZ_VIDEO_MAX_FRAMES + 2);
+    for (uint32_t i = 0; i < 2 * n; i++)
+    {
+        encoder->frames[i].encoder = encoder;
+        encoder->frames[i].downscaled = i >= n;
+    }
+    for (uint32_t i = 0; i < n; i++)
+    {
+        encoder->frames[i].rgba = calloc(encoder->width * encoder->height, 4 * sizeof(uint8_t));
+        dvz_fifo_enqueue(&encoder->free_queue, &encoder->frames[i]);
+    }
+    encoder->stop.encoder = encoder;
+    encoder->stop.stop = true;
+
+    canvas->video = encoder;
+    dvz_obj_created(&encoder->obj);
+    dvz_video_encoder_policy(encoder, policy);
+
+    encoder->worker = dvz_thread(_video_worker, encoder);
+
+    dvz_event_callback(
+        canvas, DVZ_EVENT_SCREENCAST, 0, DVZ_EVENT_MODE_SYNC, _video_screencast, NULL);
+    // NOTE: a non-zero param so that the encoder is destroyed after the other DESTROY callbacks.
+    dvz_event_callback(
+        canvas, DVZ_EVENT_DESTROY, 1, DVZ_EVENT_MODE_SYNC, _video_encoder_destroy, NULL);
+
+    return encoder;
+}
+
+
+
+void dvz_video_encoder_policy(DvzVideoEncoder* encoder, DvzVideoPolicy policy)
+{
+    ASSERT(encoder != NULL);
+    encoder->policy = policy;
+    if (policy != DVZ_VIDEO_POLICY_DOWNSCALE || encoder->upscaled != NULL)
+        return;
+
+    // The half-resolution frames are only used by the render thread after this point.
+    uint32_t n = encoder->frame_count;
+    uint32_t w = MAX(1, encoder->width / 2), h = MAX(1, encoder->height / 2);
+    encoder->upscaled = calloc(encoder->width * encoder->height, 4 * sizeof(uint8_t));
+    for (uint32_t i = n; i < 2 * n; i++)
+    {
+        encoder->frames[i].rgba = calloc(w * h, 4 * sizeof(uint8_t));
+        dvz_fifo_enqueue(&encoder->small_queue, &encoder->frames[i]);
+    }
+}
+
+
+
+void dvz_video_encoder_flush(DvzVideoEncoder* encoder)
+{
+    ASSERT(encoder != NULL);
+    uint32_t n = encoder->frame_count;
+    uint32_t small_count = encoder->upscaled != NULL ? n : 0;
+
+    // Wait until all frames have been given back to the pool.
+    for (uint32_t i = 0; i < n; i++)
+        dvz_fifo_dequeue(&encoder->free_queue, true);
+    for (uint32_t i = 0; i < small_count; i++)
+        dvz_fifo_dequeue(&encoder->small_queue, true);
+    for (uint32_t i = 0; i < n; i++)
+        dvz_fifo_enqueue(&encoder->free_queue, &encoder->frames[i]);
+    for (uint32_t i = 0; i < small_count; i++)
+        dvz_fifo_enqueue(&encoder->small_queue, &encoder->frames[n + i]);
+}
+
+
+
+DvzVideoStats dvz_video_encoder_stats(DvzVideoEncoder* encoder)
+{
+    ASSERT(encoder != NULL);
+    pthread_mutex_lock(&encoder->lock);
+    DvzVideoStats stats = encoder->stats;
+    if (stats.encoded_count > 0)
+    {
+        stats.encode_mean = encoder->encode_time / stats.encoded_count;
+        stats.latency_mean = encoder->latency_time / stats.encoded_count;
+    }
+    pthread_mutex_unlock(&encoder->lock);
+    return stats;
+}
+
+
 
-    Video* video = (Video*)canvas->screencast->user_data;
+// Encoding callback of the live video, called in the worker thread of the video encoder.
+static void _video_encode(
+    DvzCanvas* canvas, uint64_t idx, uint32_t width, uint32_t height, uint8_t* rgba,
+    void* user_data)
+{
+    Video* video = (Video*)user_data;
     if (video == NULL)
         return;
-    ASSERT(video != NULL);
+    log_debug("video frame #%d", idx);
 
     // Create the video if needed.
     if (video->ost == NULL)
@@ -1848,15 +2679,17 @@ static void _video_callback(DvzCanvas* canvas, DvzEvent ev)
     }
     ASSERT(video->ost != NULL);
 
-    add_frame(video, ev.u.sc.rgba);
-    FREE(ev.u.sc.rgba);
+    add_frame(video, rgba);
 }
 
 static void _video_destroy(DvzCanvas* canvas, DvzEvent ev)
 {
     ASSERT(canvas != NULL);
-    if (canvas->screencast != NULL && canvas->screencast->user_data != NULL)
-        end_video((Video*)canvas->screencast->user_data);
+    if (canvas->video == NULL || canvas->video->user_data == NULL)
+        return;
+    dvz_video_encoder_flush(canvas->video);
+    end_video((Video*)canvas->video->user_data);
+    canvas->video->user_data = NULL;
 }
 
 
@@ -1864,20 +2697,28 @@ static void _video_destroy(DvzCanvas* canvas, DvzEvent ev)
 void dvz_canvas_video(DvzCanvas* canvas, int framerate, int bitrate, const char* path, bool record)
 {
     ASSERT(canvas != NULL);
+    if (canvas->video != NULL)
+    {
+        log_error("the canvas is already recording a video");
+        return;
+    }
     uvec2 size;
     dvz_canvas_size(canvas, DVZ_CANVAS_SIZE_FRAMEBUFFER, size);
     Video* video = init_video(path, (int)size[0], (int)size[1], framerate, bitrate);
     if (video == NULL)
         return;
 
-    dvz_event_callback(
-        canvas, DVZ_EVENT_SCREENCAST, 0, DVZ_EVENT_MODE_SYNC, _video_callback, NULL);
+    // The video is closed before the destruction of the encoder.
     dvz_event_callback(canvas, DVZ_EVENT_DESTROY, 0, DVZ_EVENT_MODE_SYNC, _video_destroy, NULL);
 
     dvz_screencast(canvas, 1. / framerate, true);
     ASSERT(canvas->screencast != NULL);
     canvas->screencast->is_active = record;
-    canvas->screencast->user_data = video;
+
+    // The render thread only copies the frames, which are encoded in a worker thread.
+    dvz_video_encoder(
+        canvas, DVZ_VIDEO_FRAME_COUNT, DVZ_VIDEO_POLICY_BLOCK, _video_encode, video);
+    ASSERT(canvas->video != NULL);
 }
 
 
@@ -1901,18 +2742,18 @@ void dvz_canvas_pause(DvzCanvas* canvas, bool record)
 void dvz_canvas_stop(DvzCanvas* canvas)
 {
     ASSERT(canvas != NULL);
-    if (canvas->screencast == NULL)
+    if (canvas->screencast == NULL || canvas->video == NULL)
     {
-        log_error("cannot pause, there is no screencast");
+        log_error("cannot stop, there is no video");
         return;
     }
     ASSERT(canvas->screencast != NULL);
     canvas->screencast->is_active = false;
-    ASSERT(canvas->screencast->user_data != NULL);
-    // This call frees the pointer.
+    if (canvas->video->user_data == NULL)
+        return;
+    // Encode the queued frames before closing the file, this call frees the pointer.
     log_info("stop screencast");
-    end_video((Video*)canvas->screencast->user_data);
-    canvas->screencast->user_data = NULL;
+    _video_destroy(canvas, (DvzEvent){0});
 }
 
 
@@ -1930,8 +2771,10 @@ void dvz_canvas_frame(DvzCanvas* canvas)
     // Update the global and local clocks.
     // These calls update canvas->clock.elapsed and canvas->clock.interval, the latter is
     // the delay since the last frame.
-    _clock_set(&canvas->app->clock); // global clock
-    _clock_set(&canvas->clock);      // canvas-local clock
+    // NOTE: in parallel mode, the global clock is updated once per iteration by dvz_app_run().
+    if (!canvas->app->parallel)
+        _clock_set(&canvas->app->clock); // global clock
+    _clock_set(&canvas->clock);          // canvas-local clock
 
     // Call INTERACT callbacks (for backends only), which may enqueue some events.
     _event_interact(canvas);
@@ -2019,6 +2862,10 @@ void dvz_canvas_frame_submit(DvzCanvas* canvas)
 
         // Call POST_SEND callbacks
         _event_postsend(canvas);
+
+        // Copy or download the GPU picking rectangle if needed.
+        if (canvas->pick != NULL)
+            _pick_frame(canvas);
     }
 
     // Once the image is rendered, we present the swapchain image.
@@ -2034,6 +2881,163 @@ void dvz_canvas_frame_submit(DvzCanvas* canvas)
 
 
 
+// Whether the frame of a canvas may be prepared in a worker thread.
+static bool _canvas_parallel(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(canvas->app != NULL);
+    // NOTE: the backend window functions and the GUI must be called from the main thread.
+    return canvas->app->parallel && canvas->offscreen && !canvas->overlay;
+}
+
+
+
+static void _canvas_frame_process(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+
+    // Frame logic.
+    dvz_canvas_frame(canvas);
+    canvas->resized = false;
+
+    // Submit the command buffers and swapchain logic.
+    dvz_canvas_frame_submit(canvas);
+    canvas->frame_idx++;
+}
+
+
+
+// Prepare the frames of a canvas in parallel mode, until NULL is enqueued.
+static void* _canvas_frame_worker(void* user_data)
+{
+    DvzCanvas* canvas = (DvzCanvas*)user_data;
+    ASSERT(canvas != NULL);
+    while (dvz_fifo_dequeue(&canvas->frame_queue, true) != NULL)
+    {
+        _canvas_frame_process(canvas);
+        dvz_fifo_enqueue(&canvas->frame_done, canvas);
+    }
+    return NULL;
+}
+
+
+
+static void _canvas_frame_worker_start(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    if (dvz_obj_is_created(&canvas->frame_thread.obj))
+        return;
+    log_trace("start the frame worker thread of the canvas");
+    canvas->frame_queue = dvz_fifo(2);
+    canvas->frame_done = dvz_fifo(2);
+    canvas->frame_thread = dvz_thread(_canvas_frame_worker, canvas);
+}
+
+
+
+static void _canvas_frame_worker_stop(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    if (!dvz_obj_is_created(&canvas->frame_thread.obj))
+        return;
+    log_trace("stop the frame worker thread of the canvas");
+    dvz_fifo_enqueue(&canvas->frame_queue, NULL);
+    dvz_thread_join(&canvas->frame_thread);
+    dvz_fifo_destroy(&canvas->frame_queue);
+    dvz_fifo_destroy(&canvas->frame_done);
+}
+
+
+
+// Process the frames that were marked as pending during the current main loop iteration.
+static void _app_pending_frames(DvzApp* app)
+{
+    ASSERT(app != NULL);
+    DvzContainerIterator iterator;
+    DvzCanvas* canvas = NULL;
+
+    _clock_set(&app->clock);
+
+    // Wake up the worker thread of every offscreen canvas.
+    iterator = dvz_container_iterator(&app->canvases);
+    while (iterator.item != NULL)
+    {
+        canvas = (DvzCanvas*)iterator.item;
+        if (canvas->frame_pending && _canvas_parallel(canvas))
+        {
+            // NOTE: the canvases created after enabling the parallel mode start their worker here.
+            _canvas_frame_worker_start(canvas);
+            dvz_fifo_enqueue(&canvas->frame_queue, canvas);
+        }
+        dvz_container_iter(&iterator);
+    }
+
+    // The other canvases are processed in the main thread in the meantime.
+    iterator = dvz_container_iterator(&app->canvases);
+    while (iterator.item != NULL)
+    {
+        canvas = (DvzCanvas*)iterator.item;
+        if (canvas->frame_pending && !_canvas_parallel(canvas))
+        {
+            _canvas_frame_process(canvas);
+            canvas->frame_pending = false;
+        }
+        dvz_container_iter(&iterator);
+    }
+
+    // Wait for all worker threads.
+    iterator = dvz_container_iterator(&app->canvases);
+    while (iterator.item != NULL)
+    {
+        canvas = (DvzCanvas*)iterator.item;
+        if (canvas->frame_pending)
+        {
+            dvz_fifo_dequeue(&canvas->frame_done, true);
+            canvas->frame_pending = false;
+        }
+        dvz_container_iter(&iterator);
+    }
+}
+
+
+
+// The descriptor sets released before the last complete refill of all canvases of a GPU may be
+// reused, in the main thread once the frames have been processed.
+static void _app_retire_bindings(DvzApp* app)
+{
+    ASSERT(app != NULL);
+    DvzContainerIterator iterator = dvz_container_iterator(&app->gpus);
+    DvzContainerIterator canvases;
+    DvzGpu* gpu = NULL;
+    DvzCanvas* canvas = NULL;
+    uint64_t serial = 0;
+    bool found = false;
+    while (iterator.item != NULL)
+    {
+        gpu = iterator.item;
+        if (!dvz_obj_is_created(&gpu->obj))
+            break;
+        serial = UINT64_MAX;
+        found = false;
+        canvases = dvz_container_iterator(&app->canvases);
+        while (canvases.item != NULL)
+        {
+            canvas = (DvzCanvas*)canvases.item;
+            if (canvas->gpu == gpu && dvz_obj_is_created(&canvas->obj))
+            {
+                serial = MIN(serial, canvas->refills.retired);
+                found = true;
+            }
+            dvz_container_iter(&canvases);
+        }
+        if (found)
+            dvz_bindings_retire(gpu, serial);
+        dvz_container_iter(&iterator);
+    }
+}
+
+
+
 void dvz_app_run(DvzApp* app, uint64_t frame_count)
 {
     if (frame_count > 1)
@@ -2150,20 +3154,23 @@ void dvz_app_run(DvzApp* app, uint64_t frame_count)
                 continue;
             }
 
-            // Frame logic.
-            dvz_canvas_frame(canvas);
-            canvas->resized = false;
-
-            // Submit the command buffers and swapchain logic.
-            // log_trace("submitting frame for canvas #%d", canvas_idx);
-            dvz_canvas_frame_submit(canvas);
-            canvas->frame_idx++;
+            // In parallel mode, the frames are processed once all canvases have been prepared.
+            if (app->parallel)
+                canvas->frame_pending = true;
+            else
+                _canvas_frame_process(canvas);
             n_canvas_active++;
 
-
             dvz_container_iter(&iterator);
         }
 
+        // Frame logic and submission in parallel, one worker thread per offscreen canvas.
+        if (app->parallel)
+            _app_pending_frames(app);
+
+        // Reuse the descriptor sets that are no longer used by any command buffer.
+        _app_retire_bindings(app);
+
         // IMPORTANT: we need to wait for the present queue to be idle, otherwise the GPU hangs
         // when waiting for fences (not sure why). The problem only arises when using different
         // queues for command buffer submission and swapchain present. There has be a better way
@@ -2203,6 +3210,33 @@ void dvz_app_run(DvzApp* app, uint64_t frame_count)
 
 
 
+void dvz_app_parallel(DvzApp* app, bool value)
+{
+    ASSERT(app != NULL);
+    if (app->is_running)
+    {
+        log_error("cannot change the parallel mode while the app is running");
+        return;
+    }
+    log_debug("%s parallel frame preparation", value ? "enable" : "disable");
+    app->parallel = value;
+
+    // Start or stop the frame worker threads of the offscreen canvases.
+    DvzCanvas* canvas = NULL;
+    DvzContainerIterator iterator = dvz_container_iterator(&app->canvases);
+    while (iterator.item != NULL)
+    {
+        canvas = (DvzCanvas*)iterator.item;
+        if (value && _canvas_parallel(canvas))
+            _canvas_frame_worker_start(canvas);
+        else if (!value)
+            _canvas_frame_worker_stop(canvas);
+        dvz_container_iter(&iterator);
+    }
+}
+
+
+
 /*************************************************************************************************/
 /*  Canvas destruction                                                                           */
 /*************************************************************************************************/
@@ -2223,9 +3257,10 @@ void dvz_canvas_destroy(DvzCanvas* canvas)
         ASSERT(canvas->window->app != NULL);
     }
 
-    // Stop the event thread.
+    // Stop the frame worker and event threads.
     ASSERT(canvas != NULL);
     ASSERT(canvas->gpu != NULL);
+    _canvas_frame_worker_stop(canvas);
     dvz_gpu_wait(canvas->gpu);
     dvz_event_stop(canvas);
     dvz_thread_join(&canvas->event_thread);
@@ -2245,6 +3280,17 @@ void dvz_canvas_destroy(DvzCanvas* canvas)
     // Destroy the depth image.
     dvz_images_destroy(&canvas->depth_image);
 
+    // Destroy the GPU picking objects.
+    if (canvas->pick != NULL)
+    {
+        dvz_images_destroy(&canvas->pick->image);
+        dvz_buffer_destroy(&canvas->pick->staging);
+        dvz_commands_destroy(&canvas->pick->cmds);
+        dvz_fences_destroy(&canvas->pick->fence);
+        FREE(canvas->pick->ids);
+        FREE(canvas->pick);
+    }
+
     // Destroy the renderpasses.
     log_trace("canvas destroy renderpass");
     dvz_renderpass_destroy(&canvas->renderpass);
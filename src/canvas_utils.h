@@ -114,12 +114,18 @@ static int _event_consume(DvzCanvas* canvas, DvzEvent ev, DvzEventMode mode)
 
 
 
+static void _event_flush(DvzCanvas* canvas);
+
 // Produce an event, call the sync callbacks, and enqueue the event if there is at least one async
 // callback.
 static int _event_produce(DvzCanvas* canvas, DvzEvent ev)
 {
     ASSERT(canvas != NULL);
 
+    // The pending mouse move and wheel events are emitted before any other event.
+    if (ev.type != DVZ_EVENT_MOUSE_MOVE && ev.type != DVZ_EVENT_MOUSE_WHEEL)
+        _event_flush(canvas);
+
     // Call the sync callbacks directly.
     int n_callbacks = _event_consume(canvas, ev, DVZ_EVENT_MODE_SYNC);
 
@@ -132,6 +138,80 @@ static int _event_produce(DvzCanvas* canvas, DvzEvent ev)
 
 
 
+/*************************************************************************************************/
+/*  Event coalescing                                                                             */
+/*************************************************************************************************/
+
+// Update the mouse state with a mouse event, and produce it.
+static void _event_mouse(DvzCanvas* canvas, DvzEvent ev)
+{
+    ASSERT(canvas != NULL);
+    dvz_mouse_event(&canvas->mouse, canvas, ev);
+    _event_produce(canvas, ev);
+}
+
+
+
+// Emit the pending mouse move and wheel events, in the order in which they started.
+static void _event_flush(DvzCanvas* canvas)
+{
+    ASSERT(canvas != NULL);
+    DvzEventCoalescer* coalescer = &canvas->coalescer;
+    if (coalescer->move.type == DVZ_EVENT_NONE && coalescer->wheel.type == DVZ_EVENT_NONE)
+        return;
+
+    // The pending events are cleared first, as they may produce other events.
+    DvzEvent first = coalescer->wheel_first ? coalescer->wheel : coalescer->move;
+    DvzEvent second = coalescer->wheel_first ? coalescer->move : coalescer->wheel;
+    coalescer->move.type = DVZ_EVENT_NONE;
+    coalescer->wheel.type = DVZ_EVENT_NONE;
+    coalescer->wheel_first = false;
+
+    if (first.type != DVZ_EVENT_NONE)
+        _event_mouse(canvas, first);
+    if (second.type != DVZ_EVENT_NONE)
+        _event_mouse(canvas, second);
+}
+
+
+
+// Merge a mouse move or wheel event into the pending event of the same type, return whether the
+// event was delayed.
+static bool _event_coalesce(DvzCanvas* canvas, DvzEvent ev)
+{
+    ASSERT(canvas != NULL);
+    ASSERT(ev.type == DVZ_EVENT_MOUSE_MOVE || ev.type == DVZ_EVENT_MOUSE_WHEEL);
+    DvzEventCoalescer* coalescer = &canvas->coalescer;
+    if (coalescer->policy == DVZ_EVENT_COALESCE_NONE)
+        return false;
+
+    bool is_move = ev.type == DVZ_EVENT_MOUSE_MOVE;
+    DvzEvent* pending = is_move ? &coalescer->move : &coalescer->wheel;
+
+    // Events with different modifiers are not merged.
+    if (pending->type != DVZ_EVENT_NONE &&
+        (is_move ? pending->u.m.modifiers != ev.u.m.modifiers
+                 : pending->u.w.modifiers != ev.u.w.modifiers))
+        _event_flush(canvas);
+
+    if (pending->type == DVZ_EVENT_NONE)
+    {
+        if (!is_move)
+            coalescer->wheel_first = coalescer->move.type == DVZ_EVENT_NONE;
+        *pending = ev;
+        return true;
+    }
+
+    if (is_move)
+        glm_vec2_copy(ev.u.m.pos, pending->u.m.pos);
+    else
+        glm_vec2_add(pending->u.w.dir, ev.u.w.dir, pending->u.w.dir);
+    coalescer->coalesced++;
+    return true;
+}
+
+
+
 // Event loop running in the background thread, waiting for events and dequeuing them.
 static void* _event_thread(void* p_canvas)
 {
@@ -203,8 +283,8 @@ static void* _event_thread(void* p_canvas)
 /*  Utils                                                                                        */
 /*************************************************************************************************/
 
-static DvzRenderpass
-default_renderpass(DvzGpu* gpu, VkClearColorValue clear_color_value, VkFormat format, bool overlay)
+static DvzRenderpass default_renderpass(
+    DvzGpu* gpu, VkClearColorValue clear_color_value, VkFormat format, bool overlay, bool pick)
 {
     DvzRenderpass renderpass = dvz_renderpass(gpu);
 
@@ -239,9 +319,28 @@ default_renderpass(DvzGpu* gpu, VkClearColorValue clear_color_value, VkFormat fo
     dvz_renderpass_attachment_ops(
         &renderpass, 1, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_DONT_CARE);
 
+    // ID buffer attachment for GPU picking, cleared to zero (no visual), and left in the transfer
+    // layout so that a rectangle can be copied after the frame.
+    if (pick)
+    {
+        VkClearValue clear_pick = {0};
+        dvz_renderpass_clear(&renderpass, clear_pick);
+
+        dvz_renderpass_attachment(
+            &renderpass, 2, //
+            DVZ_RENDERPASS_ATTACHMENT_COLOR, DVZ_PICK_FORMAT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+        dvz_renderpass_attachment_layout(
+            &renderpass, 2, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        dvz_renderpass_attachment_ops(
+            &renderpass, 2, VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE);
+    }
+
     // Subpass.
     dvz_renderpass_subpass_attachment(&renderpass, 0, 0);
     dvz_renderpass_subpass_attachment(&renderpass, 0, 1);
+    if (pick)
+        dvz_renderpass_subpass_attachment(&renderpass, 0, 2);
     dvz_renderpass_subpass_dependency(&renderpass, 0, VK_SUBPASS_EXTERNAL, 0);
     dvz_renderpass_subpass_dependency_stage(
         &renderpass, 0, //
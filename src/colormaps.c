@@ -0,0 +1,26 @@
+#include "../include/datoviz/colormaps.h"
+#include "colormaps_utils.h"
+
+
+
+/*************************************************************************************************/
+/*  Batch functions                                                                              */
+/*************************************************************************************************/
+
+void dvz_colormap_batch(
+    DvzColormap cmap, DvzDataType dtype, uint32_t count, const void* values, double vmin,
+    double vmax, cvec4* out)
+{
+    ASSERT(out != NULL);
+    _colormap_batch(cmap, dtype, count, values, vmin, vmax, out, NULL);
+}
+
+
+
+void dvz_colormap_batch_uv(
+    DvzColormap cmap, DvzDataType dtype, uint32_t count, const void* values, double vmin,
+    double vmax, vec2* out)
+{
+    ASSERT(out != NULL);
+    _colormap_batch(cmap, dtype, count, values, vmin, vmax, NULL, out);
+}
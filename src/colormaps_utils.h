@@ -0,0 +1,242 @@
+/*************************************************************************************************/
+/*  Batch colormap utils                                                                         */
+/*************************************************************************************************/
+
+/*
+The batch functions map the values through the lookup table of the colormap: its 256 colors, as
+returned by dvz_colormap(), stored as contiguous RGBA quadruplets, and the same colors packed into
+texture coordinates. The tables of all colormaps are built on the first call.
+
+The values are processed in blocks: a first loop, without branches, converts a block of values
+into 8-bit indices with the same arithmetic as _scale_uint8(), and is vectorized by the compiler;
+a second loop gathers the colors of the indices. 8-bit values are converted with a table of
+their 256 indices. Large arrays are split into chunks processed in parallel.
+
+*/
+
+#ifndef DVZ_COLORMAPS_UTILS_HEADER
+#define DVZ_COLORMAPS_UTILS_HEADER
+
+#include "../include/datoviz/colormaps.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Constants                                                                                    */
+/*************************************************************************************************/
+
+#define DVZ_COLORMAP_BLOCK 256 // number of values converted at once
+
+
+
+/*************************************************************************************************/
+/*  Typedefs                                                                                     */
+/*************************************************************************************************/
+
+typedef struct DvzColormapChunk DvzColormapChunk;
+
+
+
+/*************************************************************************************************/
+/*  Structs                                                                                      */
+/*************************************************************************************************/
+
+struct DvzColormapChunk
+{
+    DvzDataType dtype;
+    const void* values;
+    double vmin, vmax;
+    bool constant;   // vmin == vmax
+    uint32_t i0, i1; // range of values
+
+    const uint8_t* index_table; // index of every 8-bit value
+    const cvec4* lut;           // colors of the colormap
+    const float* lut_uv;        // packed colors of the colormap
+    cvec4* colors;              // either the colors or the packed colors are fetched
+    vec2* uvs;
+};
+
+
+
+/*************************************************************************************************/
+/*  Lookup tables                                                                                */
+/*************************************************************************************************/
+
+static cvec4 DVZ_COLORMAP_LUT[CMAP_COUNT][256];
+static float DVZ_COLORMAP_LUT_UV[CMAP_COUNT][256];
+static pthread_once_t DVZ_COLORMAP_LUT_ONCE = PTHREAD_ONCE_INIT;
+
+static void _colormap_luts_init(void)
+{
+    vec2 uv = {0};
+    for (uint32_t cmap = 0; cmap < CMAP_COUNT; cmap++)
+    {
+        for (uint32_t value = 0; value < 256; value++)
+        {
+            dvz_colormap((DvzColormap)cmap, (uint8_t)value, DVZ_COLORMAP_LUT[cmap][value]);
+            dvz_colormap_packuv(DVZ_COLORMAP_LUT[cmap][value], uv);
+            DVZ_COLORMAP_LUT_UV[cmap][value] = uv[0];
+        }
+    }
+}
+
+// Compute the lookup tables once, even if several threads map values at the same time.
+static void _colormap_luts(void) { pthread_once(&DVZ_COLORMAP_LUT_ONCE, _colormap_luts_init); }
+
+
+
+/*************************************************************************************************/
+/*  Kernels                                                                                      */
+/*************************************************************************************************/
+
+// Same arithmetic as _scale_uint8(), without branches so that the loops are vectorized.
+#define COLORMAP_INDICES(T)                                                                       \
+    {                                                                                             \
+        const T* v = (const T*)values;                                                            \
+        for (uint32_t i = 0; i < count; i++)                                                      \
+        {                                                                                         \
+            double x = CLIP((double)v[i], vmin, vmax);                                            \
+            x = (x - vmin) / (vmax - vmin) * 256;                                                 \
+            out[i] = (uint8_t)MIN(x, 255.0);                                                      \
+        }                                                                                         \
+    }
+
+static void _colormap_indices(
+    DvzDataType dtype, const void* values, uint32_t count, double vmin, double vmax,
+    const uint8_t* index_table, uint8_t* out)
+{
+    ASSERT(values != NULL);
+    ASSERT(out != NULL);
+    switch (dtype)
+    {
+    case DVZ_DTYPE_FLOAT:
+        COLORMAP_INDICES(float)
+        break;
+    case DVZ_DTYPE_DOUBLE:
+        COLORMAP_INDICES(double)
+        break;
+    case DVZ_DTYPE_USHORT:
+        COLORMAP_INDICES(uint16_t)
+        break;
+    case DVZ_DTYPE_CHAR:
+        ASSERT(index_table != NULL);
+        for (uint32_t i = 0; i < count; i++)
+            out[i] = index_table[((const uint8_t*)values)[i]];
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+static void _colormap_chunk(void* item, uint32_t phase)
+{
+    DvzColormapChunk* chunk = (DvzColormapChunk*)item;
+    ASSERT(chunk != NULL);
+
+    uint32_t item_size = (uint32_t)_get_dtype_size(chunk->dtype);
+    uint8_t indices[DVZ_COLORMAP_BLOCK];
+    uint32_t n = 0;
+    for (uint32_t i0 = chunk->i0; i0 < chunk->i1; i0 += DVZ_COLORMAP_BLOCK)
+    {
+        n = MIN(DVZ_COLORMAP_BLOCK, chunk->i1 - i0);
+        if (chunk->constant)
+            memset(indices, 0, sizeof(indices));
+        else
+            _colormap_indices(
+                chunk->dtype, (const char*)chunk->values + (uint64_t)i0 * item_size, n,
+                chunk->vmin, chunk->vmax, chunk->index_table, indices);
+
+        if (chunk->colors != NULL)
+        {
+            cvec4* colors = &chunk->colors[i0];
+            for (uint32_t i = 0; i < n; i++)
+                memcpy(colors[i], chunk->lut[indices[i]], sizeof(cvec4));
+        }
+        else
+        {
+            ASSERT(chunk->uvs != NULL);
+            vec2* uvs = &chunk->uvs[i0];
+            for (uint32_t i = 0; i < n; i++)
+            {
+                uvs[i][0] = chunk->lut_uv[indices[i]];
+                uvs[i][1] = -1;
+            }
+        }
+    }
+}
+
+
+
+// Map the values on several threads, with at least DVZ_COLORMAP_MIN_CHUNK values per thread.
+static void _colormap_batch(
+    DvzColormap cmap, DvzDataType dtype, uint32_t count, const void* values, double vmin,
+    double vmax, cvec4* colors, vec2* uvs)
+{
+    ASSERT(values != NULL || count == 0);
+    ASSERT(colors != NULL || uvs != NULL);
+    if (count == 0)
+        return;
+    if ((uint32_t)cmap >= CMAP_COUNT)
+    {
+        log_error("invalid colormap %d", cmap);
+        return;
+    }
+    if (dtype != DVZ_DTYPE_FLOAT && dtype != DVZ_DTYPE_DOUBLE && dtype != DVZ_DTYPE_CHAR &&
+        dtype != DVZ_DTYPE_USHORT)
+    {
+        log_error("unsupported data type %d for the colormap values", dtype);
+        return;
+    }
+    // All values map to the first color, like with _scale_uint8().
+    bool constant = vmin == vmax;
+    if (constant)
+        log_warn("error in colormap_value(): vmin=vmax");
+    _colormap_luts();
+
+    // Index of every 8-bit value.
+    uint8_t index_table[256] = {0};
+    if (dtype == DVZ_DTYPE_CHAR && !constant)
+    {
+        double all_values[256];
+        for (uint32_t i = 0; i < 256; i++)
+            all_values[i] = i;
+        _colormap_indices(DVZ_DTYPE_DOUBLE, all_values, 256, vmin, vmax, NULL, index_table);
+    }
+
+    uint32_t n_threads =
+        dvz_parallel_threads(count, DVZ_COLORMAP_MIN_CHUNK, DVZ_COLORMAP_MAX_THREADS);
+    uint32_t size = (count + n_threads - 1) / n_threads;
+
+    DvzColormapChunk chunks[DVZ_COLORMAP_MAX_THREADS] = {0};
+    for (uint32_t t = 0; t < n_threads; t++)
+    {
+        chunks[t].dtype = dtype;
+        chunks[t].values = values;
+        chunks[t].vmin = vmin;
+        chunks[t].vmax = vmax;
+        chunks[t].constant = constant;
+        chunks[t].i0 = MIN(t * size, count);
+        chunks[t].i1 = MIN((t + 1) * size, count);
+        chunks[t].index_table = index_table;
+        chunks[t].lut = DVZ_COLORMAP_LUT[cmap];
+        chunks[t].lut_uv = DVZ_COLORMAP_LUT_UV[cmap];
+        chunks[t].colors = colors;
+        chunks[t].uvs = uvs;
+    }
+
+    dvz_parallel(n_threads, chunks, sizeof(DvzColormapChunk), 0, _colormap_chunk);
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
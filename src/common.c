@@ -2,6 +2,12 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if !OS_WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
 // Optional PNG support
 #if HAS_PNG
 #include <png.h>
@@ -191,6 +197,194 @@ uint32_t* dvz_read_file(const char* filename, size_t* size)
     return buffer;
 }
 
+void* dvz_file_map(const char* filename, size_t* size)
+{
+    ASSERT(filename != NULL);
+#if OS_WIN32
+    // NOTE: no memory mapping on Windows for now, fall back to reading the whole file.
+    return dvz_read_file(filename, size);
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+    {
+        log_error("could not open %s", filename);
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0)
+    {
+        log_error("could not determine the size of %s", filename);
+        close(fd);
+        return NULL;
+    }
+    size_t length = (size_t)st.st_size;
+
+    // Private mapping: the pages may be modified in memory without changing the file.
+    void* ptr = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    // NOTE: the mapping remains valid after the file descriptor is closed.
+    close(fd);
+    if (ptr == MAP_FAILED)
+    {
+        log_error("could not map %s in memory", filename);
+        return NULL;
+    }
+    // The file is typically read sequentially, when uploading it to the GPU.
+    madvise(ptr, length, MADV_SEQUENTIAL);
+
+    log_trace("mapped %s in memory (%zu bytes)", filename, length);
+    if (size != NULL)
+        *size = length;
+    return ptr;
+#endif
+}
+
+void dvz_file_unmap(void* ptr, size_t size)
+{
+    if (ptr == NULL)
+        return;
+#if OS_WIN32
+    FREE(ptr);
+#else
+    munmap(ptr, size);
+#endif
+}
+
+static const char* _npy_key(const char* dict, const char* end, const char* key)
+{
+    // Return a pointer to the value following the given key in the header dictionary.
+    size_t n = strlen(key);
+    for (const char* c = dict; c + n + 2 < end; c++)
+    {
+        if ((*c == '\'' || *c == '"') && strncmp(c + 1, key, n) == 0 && c[n + 1] == *c)
+        {
+            c += n + 2;
+            while (c < end && (*c == ' ' || *c == ':'))
+                c++;
+            return c < end ? c : NULL;
+        }
+    }
+    return NULL;
+}
+
+int dvz_npy_header(const void* buffer, size_t size, DvzNpyHeader* header)
+{
+    ASSERT(buffer != NULL);
+    ASSERT(header != NULL);
+    memset(header, 0, sizeof(DvzNpyHeader));
+    const uint8_t* bytes = (const uint8_t*)buffer;
+
+    // Magic string and version.
+    if (size < 10 || memcmp(bytes, "\x93NUMPY", 6) != 0)
+    {
+        log_error("invalid NPY magic string");
+        return 1;
+    }
+    header->version = bytes[6];
+    size_t header_len = 0;
+    if (header->version == 1)
+    {
+        header_len = (size_t)bytes[8] | (size_t)bytes[9] << 8;
+        header->data_offset = 10 + header_len;
+    }
+    else if (header->version == 2 || header->version == 3)
+    {
+        if (size < 12)
+            return 1;
+        header_len = (size_t)bytes[8] | (size_t)bytes[9] << 8 | (size_t)bytes[10] << 16 |
+                     (size_t)bytes[11] << 24;
+        header->data_offset = 12 + header_len;
+    }
+    else
+    {
+        log_error("unsupported NPY format version %d", header->version);
+        return 1;
+    }
+    if (header->data_offset > size)
+    {
+        log_error("truncated NPY header");
+        return 1;
+    }
+
+    // NOTE: the header is an ASCII (v1, v2) or UTF-8 (v3) Python dictionary literal, for example
+    // {'descr': '<f4', 'fortran_order': False, 'shape': (100, 3), }
+    const char* dict = (const char*)bytes + header->data_offset - header_len;
+    const char* end = (const char*)bytes + header->data_offset;
+    const char* value = NULL;
+
+    // descr
+    value = _npy_key(dict, end, "descr");
+    if (value == NULL || (*value != '\'' && *value != '"'))
+    {
+        log_error("missing or unsupported dtype in NPY header");
+        return 1;
+    }
+    uint32_t n = 0;
+    for (value++; value < end && *value != '\'' && *value != '"'; value++)
+    {
+        if (n >= sizeof(header->descr) - 1)
+        {
+            log_error("unsupported NPY dtype");
+            return 1;
+        }
+        header->descr[n++] = *value;
+    }
+    char order = header->descr[0];
+    header->kind = header->descr[1];
+    header->item_size = (uint32_t)strtoul(&header->descr[2], NULL, 10);
+    if (strchr("<>|=", order) == NULL || strchr("fiub", header->kind) == NULL ||
+        header->item_size == 0 || header->item_size > 8)
+    {
+        log_error("unsupported NPY dtype %s", header->descr);
+        return 1;
+    }
+    if (order == '>' && header->item_size > 1)
+    {
+        log_error("big-endian NPY arrays are not supported");
+        return 1;
+    }
+
+    // fortran_order
+    value = _npy_key(dict, end, "fortran_order");
+    if (value == NULL)
+    {
+        log_error("missing fortran_order in NPY header");
+        return 1;
+    }
+    header->fortran_order = strncmp(value, "True", 4) == 0;
+
+    // shape
+    value = _npy_key(dict, end, "shape");
+    if (value == NULL || *value != '(')
+    {
+        log_error("missing shape in NPY header");
+        return 1;
+    }
+    header->item_count = 1;
+    char* next = NULL;
+    for (value++; value < end && *value != ')';)
+    {
+        if (*value == ' ' || *value == ',')
+        {
+            value++;
+            continue;
+        }
+        if (header->ndims >= DVZ_NPY_MAX_DIMS)
+        {
+            log_error("too many dimensions in NPY array");
+            return 1;
+        }
+        header->shape[header->ndims] = strtoull(value, &next, 10);
+        if (next == value)
+        {
+            log_error("invalid shape in NPY header");
+            return 1;
+        }
+        header->item_count *= header->shape[header->ndims++];
+        value = next;
+    }
+    return 0;
+}
+
 char* dvz_read_npy(const char* filename, size_t* size)
 {
     /* Tiny NPY reader that requires the user to know in advance the data type of the file. */
@@ -198,7 +392,7 @@ char* dvz_read_npy(const char* filename, size_t* size)
     /* The returned pointer must be freed by the caller. */
     char* buffer = NULL;
     size_t length = 0;
-    int nread = 0, err = 0;
+    int err = 0;
 
     FILE* f = fopen(filename, "rb");
     if (!f)
@@ -212,54 +406,573 @@ char* dvz_read_npy(const char* filename, size_t* size)
     length = (size_t)ftell(f);
     fseek(f, 0, SEEK_SET);
 
-    // const uint32_t MAGIC_SIZE = 6;
-    // char magic[MAGIC_SIZE];
-
-    // // Read NPY header.
-    // nread = fread(magic, sizeof(char), MAGIC_SIZE, f);
-    // if (!nread)
-    //     goto error;
-
-    // TODO: check the magic
-    // TODO: check the version numbers
+    // Read the magic string, the version and the header length.
+    uint8_t preamble[12] = {0};
+    if (length < 12 || fread(preamble, 1, 12, f) != 12)
+        goto error;
+    size_t header_len = preamble[6] == 1
+                            ? 10 + ((size_t)preamble[8] | (size_t)preamble[9] << 8)
+                            : 12 + ((size_t)preamble[8] | (size_t)preamble[9] << 8 |
+                                    (size_t)preamble[10] << 16 | (size_t)preamble[11] << 24);
+    if (header_len > length)
+        goto error;
 
-    // Determine the header size.
-    uint16_t header_len = 0;
-    err = fseek(f, 8, SEEK_SET);
+    // Parse and validate the header.
+    char* header_buf = calloc(header_len, 1);
+    fseek(f, 0, SEEK_SET);
+    if (fread(header_buf, 1, header_len, f) != header_len)
+        err = 1;
+    DvzNpyHeader header = {0};
+    if (err == 0)
+        err = dvz_npy_header(header_buf, header_len, &header);
+    FREE(header_buf);
     if (err)
         goto error;
-    nread = fread(&header_len, sizeof(uint16_t), 1, f);
-    if (!nread)
+    if (header.data_offset + header.item_count * header.item_size > length)
+    {
+        log_error("NPY file is shorter than the size declared in its header");
         goto error;
-    log_trace("npy file header size is %d bytes", header_len);
-    ASSERT(header_len > 0);
-    header_len += 10; // NOTE: the header len does NOT include the 10 bytes with the magic string,
-                      // the version, the header length
+    }
+    log_trace("npy file header size is %d bytes", (int)header.data_offset);
 
     // Jump to the beginning of the data buffer.
-    fseek(f, 0, header_len);
-    length -= header_len;
+    length = header.item_count * header.item_size;
     if (size != NULL)
         *size = length;
-    err = fseek(f, header_len, SEEK_SET);
+    err = fseek(f, (long)header.data_offset, SEEK_SET);
     if (err)
         goto error;
 
     // Read the data buffer.
-    buffer = calloc((uint32_t)length, 1);
+    buffer = calloc(length, 1);
     ASSERT(buffer != NULL);
-    fread(buffer, 1, (size_t)length, f);
+    if (fread(buffer, 1, length, f) != length)
+    {
+        FREE(buffer);
+        goto error;
+    }
     fclose(f);
 
     return buffer;
 
 error:
+    fclose(f);
     log_error("unable to read the NPY file %s", filename);
     return NULL;
 }
 
 
 
+/*************************************************************************************************/
+/*  Fast PNG encoder                                                                             */
+/*************************************************************************************************/
+
+#if HAS_PNG
+
+// Minimum number of rows compressed by a single thread.
+#define DVZ_PNG_MIN_CHUNK_ROWS 32
+
+typedef struct DvzPngChunk DvzPngChunk;
+struct DvzPngChunk
+{
+    const uint8_t* image;
+    uint32_t width;
+    uint32_t row_start, row_end;
+    int level;
+
+    uint8_t* out; // raw deflate stream, ending with a sync flush except for the last chunk
+    size_t out_size;
+    uLong adler; // adler32 checksum of the filtered rows
+    uLong in_size;
+    bool is_last;
+    int err;
+};
+
+
+
+static inline uint8_t _paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+    int p = (int)a + (int)b - (int)c;
+    int pa = abs(p - (int)a);
+    int pb = abs(p - (int)b);
+    int pc = abs(p - (int)c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    return pb <= pc ? b : c;
+}
+
+
+
+static uint32_t _png_filter(
+    uint8_t type, const uint8_t* row, const uint8_t* prev, uint32_t stride, uint8_t* out)
+{
+    // Filter a row with the given PNG filter type, and return the sum of the absolute values of
+    // the filtered bytes (used by the filter selection heuristic).
+    const uint32_t bpp = 3;
+    uint32_t sum = 0;
+    uint8_t a = 0, b = 0, c = 0;
+    for (uint32_t i = 0; i < stride; i++)
+    {
+        a = i >= bpp ? row[i - bpp] : 0;
+        b = prev != NULL ? prev[i] : 0;
+        c = (i >= bpp && prev != NULL) ? prev[i - bpp] : 0;
+        switch (type)
+        {
+        case 1:
+            out[i] = (uint8_t)(row[i] - a);
+            break;
+        case 2:
+            out[i] = (uint8_t)(row[i] - b);
+            break;
+        case 4:
+            out[i] = (uint8_t)(row[i] - _paeth(a, b, c));
+            break;
+        default:
+            out[i] = row[i];
+            break;
+        }
+        sum += (uint32_t)abs((int8_t)out[i]);
+    }
+    return sum;
+}
+
+
+
+static void _png_filter_rows(DvzPngChunk* chunk, uint8_t* filtered)
+{
+    ASSERT(chunk != NULL);
+    ASSERT(filtered != NULL);
+
+    const uint32_t stride = chunk->width * 3;
+    // Candidate filters: None (0), Sub (1), Up (2), Paeth (4).
+    const uint8_t filters[] = {0, 1, 2, 4};
+    uint8_t* tmp = NULL;
+    if (chunk->level >= 2)
+        tmp = calloc(stride, 1);
+
+    const uint8_t* row = NULL;
+    const uint8_t* prev = NULL;
+    uint8_t* out = filtered;
+    uint32_t best = 0, sum = 0;
+    for (uint32_t k = chunk->row_start; k < chunk->row_end; k++)
+    {
+        row = chunk->image + (size_t)k * stride;
+        // NOTE: the filters use the previous unfiltered row, which is available even when it
+        // belongs to another chunk.
+        prev = k > 0 ? row - stride : NULL;
+
+        // Store mode: no filter. Fast mode: Sub filter.
+        if (chunk->level <= 1)
+        {
+            out[0] = chunk->level == 0 ? 0 : 1;
+            _png_filter(out[0], row, prev, stride, out + 1);
+        }
+        // Otherwise, minimum sum of absolute differences heuristic, like libpng.
+        else
+        {
+            best = UINT32_MAX;
+            for (uint32_t f = 0; f < 4; f++)
+            {
+                sum = _png_filter(filters[f], row, prev, stride, tmp);
+                if (sum < best)
+                {
+                    best = sum;
+                    out[0] = filters[f];
+                    memcpy(out + 1, tmp, stride);
+                }
+            }
+        }
+        out += 1 + stride;
+    }
+    FREE(tmp);
+}
+
+
+
+static void _png_chunk_compress(void* item, uint32_t phase)
+{
+    DvzPngChunk* chunk = (DvzPngChunk*)item;
+    ASSERT(chunk != NULL);
+
+    uLong size = (uLong)(chunk->row_end - chunk->row_start) * (1 + chunk->width * 3);
+    uint8_t* filtered = malloc(size);
+    _png_filter_rows(chunk, filtered);
+    chunk->in_size = size;
+    chunk->adler = adler32(adler32(0L, Z_NULL, 0), filtered, (uInt)size);
+
+    // Raw deflate stream (no zlib header), the chunks are concatenated by the caller.
+    z_stream strm = {0};
+    chunk->err = deflateInit2(
+        &strm, chunk->level, Z_DEFLATED, -15, 8, chunk->level == 1 ? Z_RLE : Z_DEFAULT_STRATEGY);
+    if (chunk->err != Z_OK)
+    {
+        FREE(filtered);
+        return;
+    }
+
+    // NOTE: extra space for the sync flush marker.
+    size_t capacity = deflateBound(&strm, size) + 64;
+    chunk->out = malloc(capacity);
+    strm.next_in = filtered;
+    strm.avail_in = (uInt)size;
+    strm.next_out = chunk->out;
+    strm.avail_out = (uInt)capacity;
+
+    // The non-final chunks end on a byte boundary so that they can be concatenated.
+    chunk->err = deflate(&strm, chunk->is_last ? Z_FINISH : Z_SYNC_FLUSH);
+    if (chunk->err == Z_STREAM_END || chunk->err == Z_OK)
+        chunk->err = 0;
+    chunk->out_size = capacity - strm.avail_out;
+    deflateEnd(&strm);
+
+    FREE(filtered);
+}
+
+
+
+static void _png_write_u32(uint8_t* out, uint32_t value)
+{
+    // PNG integers are big-endian.
+    out[0] = (uint8_t)(value >> 24);
+    out[1] = (uint8_t)(value >> 16);
+    out[2] = (uint8_t)(value >> 8);
+    out[3] = (uint8_t)(value);
+}
+
+
+
+static void _png_write_chunk(FILE* fp, const char* type, const uint8_t* data, uint32_t size)
+{
+    uint8_t buf[4];
+    _png_write_u32(buf, size);
+    fwrite(buf, 1, 4, fp);
+    fwrite(type, 1, 4, fp);
+    if (size > 0)
+        fwrite(data, 1, size, fp);
+
+    uLong crc = crc32(0L, Z_NULL, 0);
+    crc = crc32(crc, (const Bytef*)type, 4);
+    if (size > 0)
+        crc = crc32(crc, data, size);
+    _png_write_u32(buf, (uint32_t)crc);
+    fwrite(buf, 1, 4, fp);
+}
+
+#endif
+
+
+
+int dvz_write_png_fast(
+    const char* filename, uint32_t width, uint32_t height, const uint8_t* image, int level,
+    uint32_t thread_count)
+{
+#if HAS_PNG
+    ASSERT(filename != NULL);
+    ASSERT(image != NULL);
+    ASSERT(width > 0);
+    ASSERT(height > 0);
+    level = CLIP(level, 0, 9);
+
+    // Number of chunks: one per thread, with a minimum number of rows per chunk.
+    uint32_t n_chunks = 0;
+    if (thread_count == 0)
+        n_chunks = dvz_parallel_threads(height, DVZ_PNG_MIN_CHUNK_ROWS, UINT32_MAX);
+    else
+        n_chunks = CLIP((height + DVZ_PNG_MIN_CHUNK_ROWS - 1) / DVZ_PNG_MIN_CHUNK_ROWS, 1,
+                        thread_count);
+    uint32_t rows = (height + n_chunks - 1) / n_chunks;
+    n_chunks = (height + rows - 1) / rows;
+    log_trace(
+        "fast PNG encoding of %dx%d image with level %d and %d chunks", width, height, level,
+        n_chunks);
+
+    DvzPngChunk* chunks = calloc(n_chunks, sizeof(DvzPngChunk));
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        chunks[i].image = image;
+        chunks[i].width = width;
+        chunks[i].row_start = i * rows;
+        chunks[i].row_end = MIN((i + 1) * rows, height);
+        chunks[i].level = level;
+        chunks[i].is_last = i == n_chunks - 1;
+    }
+
+    // Filter and compress the chunks in parallel.
+    dvz_parallel(n_chunks, chunks, sizeof(DvzPngChunk), 0, _png_chunk_compress);
+
+    int res = 0;
+    FILE* fp = NULL;
+    uint8_t* idat = NULL;
+
+    // Concatenate the chunks into a single zlib stream, combining the adler32 checksums.
+    size_t idat_size = 2 + 4;
+    uLong adler = adler32(0L, Z_NULL, 0);
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        if (chunks[i].err != 0 || chunks[i].out == NULL)
+        {
+            log_error("PNG compression failed with error %d", chunks[i].err);
+            res = 1;
+            goto cleanup;
+        }
+        idat_size += chunks[i].out_size;
+        adler = adler32_combine(adler, chunks[i].adler, (z_off_t)chunks[i].in_size);
+    }
+    if (idat_size > INT32_MAX)
+    {
+        log_error("PNG image too large");
+        res = 1;
+        goto cleanup;
+    }
+
+    idat = malloc(idat_size);
+    // zlib header: deflate with a 32K window, and the compression level hint.
+    uint32_t flevel = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    idat[0] = 0x78;
+    idat[1] = (uint8_t)(flevel << 6);
+    idat[1] = (uint8_t)(idat[1] + 31 - ((idat[0] * 256 + idat[1]) % 31));
+    size_t offset = 2;
+    for (uint32_t i = 0; i < n_chunks; i++)
+    {
+        memcpy(idat + offset, chunks[i].out, chunks[i].out_size);
+        offset += chunks[i].out_size;
+    }
+    _png_write_u32(idat + offset, (uint32_t)adler);
+    ASSERT(offset + 4 == idat_size);
+
+    fp = fopen(filename, "wb");
+    if (fp == NULL)
+    {
+        res = 1;
+        goto cleanup;
+    }
+
+    // PNG signature.
+    const uint8_t signature[] = {137, 80, 78, 71, 13, 10, 26, 10};
+    fwrite(signature, 1, 8, fp);
+
+    // IHDR: 8-bit RGB, no interlacing.
+    uint8_t ihdr[13] = {0};
+    _png_write_u32(ihdr, width);
+    _png_write_u32(ihdr + 4, height);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    _png_write_chunk(fp, "IHDR", ihdr, 13);
+
+    _png_write_chunk(fp, "IDAT", idat, (uint32_t)idat_size);
+    _png_write_chunk(fp, "IEND", NULL, 0);
+    fclose(fp);
+
+cleanup:
+    for (uint32_t i = 0; i < n_chunks; i++)
+        FREE(chunks[i].out);
+    FREE(chunks);
+    FREE(idat);
+    return res;
+#else
+    log_error("datoviz was not build with PNG support, please install libpng-dev");
+    return 1;
+#endif
+}
+
+
+
+/*************************************************************************************************/
+/*  QOI                                                                                          */
+/*************************************************************************************************/
+
+// Quite OK Image format, see https://qoiformat.org/qoi-specification.pdf
+
+#define DVZ_QOI_OP_INDEX 0x00
+#define DVZ_QOI_OP_DIFF  0x40
+#define DVZ_QOI_OP_LUMA  0x80
+#define DVZ_QOI_OP_RUN   0xc0
+#define DVZ_QOI_OP_RGB   0xfe
+#define DVZ_QOI_MASK_2   0xc0
+#define DVZ_QOI_HASH(px)      (((px)[0] * 3 + (px)[1] * 5 + (px)[2] * 7 + (px)[3] * 11) % 64)
+
+static const uint8_t DVZ_QOI_PADDING[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+int dvz_write_qoi(const char* filename, uint32_t width, uint32_t height, const uint8_t* image)
+{
+    ASSERT(filename != NULL);
+    ASSERT(image != NULL);
+
+    // Worst case: 4 bytes per pixel, plus the header and the end marker.
+    size_t n = (size_t)width * height;
+    uint8_t* out = malloc(14 + n * 4 + 8);
+    size_t p = 0;
+
+    // Header.
+    memcpy(out, "qoif", 4);
+    p = 4;
+    for (int32_t s = 24; s >= 0; s -= 8)
+        out[p++] = (uint8_t)(width >> s);
+    for (int32_t s = 24; s >= 0; s -= 8)
+        out[p++] = (uint8_t)(height >> s);
+    out[p++] = 3; // RGB
+    out[p++] = 0; // sRGB with linear alpha
+
+    // NOTE: the pixels are stored as RGBA with an opaque alpha channel, as required by the hash.
+    uint8_t index[64][4] = {0};
+    uint8_t px[4] = {0, 0, 0, 255};
+    uint8_t prev[4] = {0, 0, 0, 255};
+    uint32_t run = 0, h = 0;
+    int8_t vr = 0, vg = 0, vb = 0, vg_r = 0, vg_b = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        memcpy(px, &image[3 * i], 3);
+
+        if (memcmp(px, prev, 3) == 0)
+        {
+            run++;
+            if (run == 62 || i == n - 1)
+            {
+                out[p++] = (uint8_t)(DVZ_QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0)
+        {
+            out[p++] = (uint8_t)(DVZ_QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+
+        h = (uint32_t)DVZ_QOI_HASH(px);
+        if (memcmp(index[h], px, 4) == 0)
+        {
+            out[p++] = (uint8_t)(DVZ_QOI_OP_INDEX | h);
+        }
+        else
+        {
+            memcpy(index[h], px, 4);
+
+            vr = (int8_t)(px[0] - prev[0]);
+            vg = (int8_t)(px[1] - prev[1]);
+            vb = (int8_t)(px[2] - prev[2]);
+            vg_r = (int8_t)(vr - vg);
+            vg_b = (int8_t)(vb - vg);
+
+            if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                out[p++] = (uint8_t)(DVZ_QOI_OP_DIFF | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+            else if (vg_r > -9 && vg_r < 8 && vg > -33 && vg < 32 && vg_b > -9 && vg_b < 8)
+            {
+                out[p++] = (uint8_t)(DVZ_QOI_OP_LUMA | (vg + 32));
+                out[p++] = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+            }
+            else
+            {
+                out[p++] = DVZ_QOI_OP_RGB;
+                memcpy(&out[p], px, 3);
+                p += 3;
+            }
+        }
+        memcpy(prev, px, 3);
+    }
+    memcpy(&out[p], DVZ_QOI_PADDING, 8);
+    p += 8;
+
+    int res = 0;
+    FILE* fp = fopen(filename, "wb");
+    if (fp == NULL)
+        res = 1;
+    else
+    {
+        if (fwrite(out, 1, p, fp) != p)
+            res = 1;
+        fclose(fp);
+    }
+    FREE(out);
+    return res;
+}
+
+uint8_t* dvz_read_qoi(const char* filename, int* width, int* height)
+{
+    ASSERT(filename != NULL);
+    ASSERT(width != NULL);
+    ASSERT(height != NULL);
+
+    size_t size = 0;
+    uint8_t* data = (uint8_t*)dvz_read_file(filename, &size);
+    if (data == NULL)
+        return NULL;
+    if (size < 14 + 8 || memcmp(data, "qoif", 4) != 0)
+    {
+        log_error("invalid QOI file %s", filename);
+        FREE(data);
+        return NULL;
+    }
+
+    uint32_t w = (uint32_t)data[4] << 24 | (uint32_t)data[5] << 16 | (uint32_t)data[6] << 8 |
+                 (uint32_t)data[7];
+    uint32_t h = (uint32_t)data[8] << 24 | (uint32_t)data[9] << 16 | (uint32_t)data[10] << 8 |
+                 (uint32_t)data[11];
+    uint8_t channels = data[12];
+    if (w == 0 || h == 0 || (channels != 3 && channels != 4))
+    {
+        log_error("invalid QOI header in %s", filename);
+        FREE(data);
+        return NULL;
+    }
+    *width = (int)w;
+    *height = (int)h;
+
+    // NOTE: the output image is always RGB, the alpha channel is dropped.
+    size_t n = (size_t)w * h;
+    uint8_t* image = calloc(n, 3);
+    uint8_t index[64][4] = {0};
+    uint8_t px[4] = {0, 0, 0, 255};
+    size_t p = 14, end = size - 8;
+    uint32_t run = 0;
+    uint8_t b1 = 0, b2 = 0;
+    int8_t vg = 0;
+    for (size_t i = 0; i < n; i++)
+    {
+        if (run > 0)
+            run--;
+        else if (p < end)
+        {
+            b1 = data[p++];
+            if (b1 == DVZ_QOI_OP_RGB || b1 == 0xff)
+            {
+                px[0] = data[p++];
+                px[1] = data[p++];
+                px[2] = data[p++];
+                if (b1 == 0xff)
+                    px[3] = data[p++];
+            }
+            else if ((b1 & DVZ_QOI_MASK_2) == DVZ_QOI_OP_INDEX)
+                memcpy(px, index[b1], 4);
+            else if ((b1 & DVZ_QOI_MASK_2) == DVZ_QOI_OP_DIFF)
+            {
+                px[0] = (uint8_t)(px[0] + ((b1 >> 4) & 0x03) - 2);
+                px[1] = (uint8_t)(px[1] + ((b1 >> 2) & 0x03) - 2);
+                px[2] = (uint8_t)(px[2] + (b1 & 0x03) - 2);
+            }
+            else if ((b1 & DVZ_QOI_MASK_2) == DVZ_QOI_OP_LUMA)
+            {
+                b2 = data[p++];
+                vg = (int8_t)((b1 & 0x3f) - 32);
+                px[0] = (uint8_t)(px[0] + vg - 8 + ((b2 >> 4) & 0x0f));
+                px[1] = (uint8_t)(px[1] + vg);
+                px[2] = (uint8_t)(px[2] + vg - 8 + (b2 & 0x0f));
+            }
+            else if ((b1 & DVZ_QOI_MASK_2) == DVZ_QOI_OP_RUN)
+                run = (b1 & 0x3f);
+
+            memcpy(index[DVZ_QOI_HASH(px)], px, 4);
+        }
+        memcpy(&image[3 * i], px, 3);
+    }
+
+    FREE(data);
+    return image;
+}
+
+
+
 /*************************************************************************************************/
 /*  Thread                                                                                       */
 /*************************************************************************************************/
@@ -288,6 +1001,76 @@ void dvz_thread_join(DvzThread* thread)
 
 
 
+uint32_t dvz_num_threads(void)
+{
+#if OS_WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    long n = (long)info.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return (uint32_t)MAX(1, n);
+}
+
+
+
+uint32_t dvz_parallel_threads(uint64_t count, uint64_t min_size, uint32_t max_threads)
+{
+    uint64_t n = MIN((uint64_t)dvz_num_threads(), (uint64_t)MAX(1, max_threads));
+    min_size = MAX(1, min_size);
+    return (uint32_t)CLIP((count + min_size - 1) / min_size, 1, n);
+}
+
+
+
+typedef struct DvzParallelItem DvzParallelItem;
+
+struct DvzParallelItem
+{
+    DvzParallelCallback callback;
+    void* item;
+    uint32_t phase;
+};
+
+
+
+static void* _parallel_item(void* user_data)
+{
+    DvzParallelItem* item = (DvzParallelItem*)user_data;
+    ASSERT(item != NULL);
+    item->callback(item->item, item->phase);
+    return NULL;
+}
+
+
+
+void dvz_parallel(
+    uint32_t count, void* items, size_t item_size, uint32_t phase, DvzParallelCallback callback)
+{
+    ASSERT(items != NULL || count == 0);
+    ASSERT(callback != NULL);
+    if (count == 0)
+        return;
+
+    char* ptr = (char*)items;
+    DvzThread* threads = count > 1 ? (DvzThread*)calloc(count, sizeof(DvzThread)) : NULL;
+    DvzParallelItem* args =
+        count > 1 ? (DvzParallelItem*)calloc(count, sizeof(DvzParallelItem)) : NULL;
+    for (uint32_t i = 1; i < count; i++)
+    {
+        args[i] = (DvzParallelItem){callback, ptr + i * item_size, phase};
+        threads[i] = dvz_thread(_parallel_item, &args[i]);
+    }
+    callback(ptr, phase);
+    for (uint32_t i = 1; i < count; i++)
+        dvz_thread_join(&threads[i]);
+    FREE(threads);
+    FREE(args);
+}
+
+
+
 void dvz_thread_lock(DvzThread* thread)
 {
     ASSERT(thread != NULL);
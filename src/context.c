@@ -178,6 +178,9 @@ DvzContext* dvz_context(DvzGpu* gpu, DvzWindow* window)
         VkSurfaceKHR surface = VK_NULL_HANDLE;
         if (window != NULL)
             surface = window->surface;
+        // Required by the ID buffer used for GPU picking, whose integer attachment cannot be
+        // blended unlike the color attachment.
+        gpu->requested_features.independentBlend = gpu->device_features.independentBlend;
         dvz_gpu_create(gpu, surface);
     }
 
@@ -186,6 +189,11 @@ DvzContext* dvz_context(DvzGpu* gpu, DvzWindow* window)
 
     context->transfer_cmd = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_TRANSFER, 1);
 
+    // Chunked uploads.
+    context->staging_chunk = DVZ_STAGING_CHUNK_SIZE;
+    context->stream_cmds = dvz_commands(gpu, DVZ_DEFAULT_QUEUE_TRANSFER, DVZ_STAGING_RING_SLOTS);
+    context->stream_fences = dvz_fences(gpu, DVZ_STAGING_RING_SLOTS, true);
+
     gpu->context = context;
     dvz_obj_created(&context->obj);
 
@@ -221,6 +229,18 @@ void dvz_context_reset(DvzContext* context)
 
 
 
+void dvz_context_staging_chunk(DvzContext* context, VkDeviceSize chunk_size)
+{
+    ASSERT(context != NULL);
+    log_debug("set the staging chunk size to %s", pretty_size(chunk_size));
+    // Wait for the pending chunks before changing the slot size.
+    for (uint32_t i = 0; i < DVZ_STAGING_RING_SLOTS; i++)
+        dvz_fences_wait(&context->stream_fences, i);
+    context->staging_chunk = chunk_size;
+}
+
+
+
 void dvz_context_destroy(DvzContext* context)
 {
     if (context == NULL)
@@ -237,6 +257,7 @@ void dvz_context_destroy(DvzContext* context)
 
     // Destroy the buffers, images, samplers, textures, computes.
     _destroy_resources(context);
+    dvz_fences_destroy(&context->stream_fences);
 
     // Free the allocated memory.
     dvz_container_destroy(&context->buffers);
@@ -261,6 +282,9 @@ DvzBufferRegions dvz_ctx_buffers(
     ASSERT(size > 0);
     ASSERT(buffer_type < DVZ_BUFFER_TYPE_COUNT);
 
+    // NOTE: the context buffers may be allocated concurrently by several canvases.
+    dvz_gpu_lock(context->gpu);
+
     // Choose the first buffer with the requested type.
     DvzContainerIterator iter = dvz_container_iterator(&context->buffers);
     DvzBuffer* buffer = NULL;
@@ -274,6 +298,7 @@ DvzBufferRegions dvz_ctx_buffers(
     if (buffer == NULL)
     {
         log_error("could not find buffer with requested type %d", buffer_type);
+        dvz_gpu_unlock(context->gpu);
         return (DvzBufferRegions){0};
     }
     ASSERT(buffer != NULL);
@@ -299,6 +324,7 @@ DvzBufferRegions dvz_ctx_buffers(
     if (!dvz_obj_is_created(&buffer->obj))
     {
         log_error("invalid buffer %d", buffer_type);
+        dvz_gpu_unlock(context->gpu);
         return regions;
     }
 
@@ -326,6 +352,7 @@ DvzBufferRegions dvz_ctx_buffers(
     buffer->allocated_size += alsize * buffer_count;
 
     ASSERT(regions.offsets[buffer_count - 1] + alsize == buffer->allocated_size);
+    dvz_gpu_unlock(context->gpu);
     return regions;
 }
 
@@ -344,6 +371,7 @@ void dvz_ctx_buffers_resize(DvzContext* context, DvzBufferRegions* br, VkDeviceS
         return;
     }
     ASSERT(br->count == 1);
+    dvz_gpu_lock(context->gpu);
 
     // The region is the last allocated in the buffer, we can safely resize it.
     VkDeviceSize old_size = br->aligned_size > 0 ? br->aligned_size : br->size;
@@ -371,6 +399,7 @@ void dvz_ctx_buffers_resize(DvzContext* context, DvzBufferRegions* br, VkDeviceS
         log_debug("failed to resize the buffer region in-place, allocating a new region");
         *br = dvz_ctx_buffers(context, br->buffer->type, 1, new_size);
     }
+    dvz_gpu_unlock(context->gpu);
 }
 
 
@@ -425,6 +454,7 @@ DvzTexture* dvz_ctx_texture(DvzContext* context, uint32_t dims, uvec3 size, VkFo
         "creating %dD texture with shape %dx%dx%d and format %d", //
         dims, size[0], size[1], size[2], format);
 
+    dvz_gpu_lock(context->gpu);
     DvzTexture* texture = dvz_container_alloc(&context->textures);
     DvzImages* image = dvz_container_alloc(&context->images);
     DvzSampler* sampler = dvz_container_alloc(&context->samplers);
@@ -481,6 +511,7 @@ DvzTexture* dvz_ctx_texture(DvzContext* context, uint32_t dims, uvec3 size, VkFo
         dvz_cmd_submit_sync(cmds, 0);
     }
 
+    dvz_gpu_unlock(context->gpu);
     return texture;
 }
 
@@ -542,6 +573,17 @@ void dvz_texture_upload(
     ASSERT(size > 0);
     ASSERT(data != NULL);
 
+    // Large uploads are streamed in chunks to bound the size of the staging buffer.
+    if (_stream_upload(context, size))
+    {
+        uvec3 region = {0};
+        region[0] = shape[0] > 0 ? shape[0] : texture->image->width;
+        region[1] = shape[1] > 0 ? shape[1] : texture->image->height;
+        region[2] = shape[2] > 0 ? shape[2] : texture->image->depth;
+        _stream_texture_upload(context, texture, offset, region, size, data);
+        return;
+    }
+
     // Take the staging buffer.
     DvzBuffer* staging = staging_buffer(context, size);
 
@@ -0,0 +1,231 @@
+/*************************************************************************************************/
+/*  Viewport culling of the visuals of a panel                                                   */
+/*************************************************************************************************/
+
+/*
+The vertex buffer of a visual is split into chunks of DVZ_CULL_CHUNK_SIZE vertices, or instances
+for instanced graphics, and the bounding box of every chunk is computed from the 3D float vertex
+attributes: the positions, and other attributes such as normals, which only make the boxes larger.
+With strip topologies, a chunk also covers the first vertices of the next one, so that the
+primitives across two chunks are within a box.
+
+At every frame, the 8 corners of every box are projected with the MVP of the panel, and the box
+is visible if its projection overlaps the viewport, extended by a margin in pixels for the
+marker sizes and line widths: half the largest size or width of the visual, and at least
+DVZ_CULL_MARGIN pixels. A box with a corner behind the camera is always visible. The range
+between the first and the last visible chunks is drawn, and the command buffers are refilled when
+this range changes. The vertices drawn with an index buffer may come from any chunk, so these
+visuals are either drawn entirely or skipped. So are the visuals with a depth sort, as their
+sorted primitives may come from any chunk too.
+
+*/
+
+#ifndef DVZ_CULLING_HEADER
+#define DVZ_CULLING_HEADER
+
+#include "../include/datoviz/visuals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Bounding boxes                                                                               */
+/*************************************************************************************************/
+
+static void _culling_destroy(DvzCulling* culling)
+{
+    ASSERT(culling != NULL);
+    FREE(culling->box_min);
+    FREE(culling->box_max);
+    culling->chunk_count = 0;
+}
+
+
+
+// Margin around the viewport, in pixels, for the largest marker size or line width of a visual.
+static float _culling_margin(DvzVisual* visual)
+{
+    ASSERT(visual != NULL);
+
+    float size = 0;
+    float* value = NULL;
+    DvzProp* prop = NULL;
+    uint32_t n = 0;
+    DvzContainerIterator iter = dvz_container_iterator(&visual->props);
+    while (iter.item != NULL)
+    {
+        prop = iter.item;
+        dvz_container_iter(&iter);
+        if (prop->dtype != DVZ_DTYPE_FLOAT ||
+            (prop->prop_type != DVZ_PROP_MARKER_SIZE && prop->prop_type != DVZ_PROP_LINE_WIDTH))
+            continue;
+        // The default value is used when the prop has not been set.
+        n = MAX(1, dvz_prop_size(prop));
+        for (uint32_t i = 0; i < n; i++)
+        {
+            value = (float*)dvz_prop_item(prop, i);
+            if (value != NULL)
+                size = MAX(size, *value);
+        }
+    }
+    return MAX((float)DVZ_CULL_MARGIN, .5f * size);
+}
+
+
+
+static void
+_culling_build(DvzCulling* culling, DvzGraphics* graphics, DvzArray* vertices, bool indexed)
+{
+    ASSERT(culling != NULL);
+    ASSERT(graphics != NULL);
+    ASSERT(vertices != NULL);
+
+    _culling_destroy(culling);
+    culling->dirty = false;
+    culling->vertex_count = vertices->item_count;
+    culling->indexed = indexed && graphics->instance_vertex_count == 0;
+
+    // Number of vertices shared by successive primitives.
+    culling->overlap = 0;
+    if (graphics->instance_vertex_count == 0)
+    {
+        if (graphics->topology == VK_PRIMITIVE_TOPOLOGY_LINE_STRIP)
+            culling->overlap = 1;
+        else if (graphics->topology == VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP)
+            culling->overlap = 2;
+    }
+
+    // Offsets of the 3D float attributes of the vertex buffer.
+    uint32_t attr_count = 0;
+    VkDeviceSize offsets[DVZ_MAX_VERTEX_ATTRS] = {0};
+    for (uint32_t i = 0; i < graphics->vertex_attr_count; i++)
+    {
+        if (graphics->vertex_attrs[i].binding == 0 &&
+            graphics->vertex_attrs[i].format == VK_FORMAT_R32G32B32_SFLOAT)
+            offsets[attr_count++] = graphics->vertex_attrs[i].offset;
+    }
+
+    uint32_t n = vertices->item_count;
+    if (attr_count == 0 || n == 0 || vertices->data == NULL)
+        return;
+
+    uint32_t chunk_count = (n + DVZ_CULL_CHUNK_SIZE - 1) / DVZ_CULL_CHUNK_SIZE;
+    culling->box_min = (vec3*)calloc(chunk_count, sizeof(vec3));
+    culling->box_max = (vec3*)calloc(chunk_count, sizeof(vec3));
+    culling->chunk_count = chunk_count;
+
+    const char* data = (const char*)vertices->data;
+    VkDeviceSize item_size = vertices->item_size;
+    vec3 pos = {0};
+    float* p0 = NULL;
+    float* p1 = NULL;
+    uint32_t i0 = 0, i1 = 0;
+    for (uint32_t c = 0; c < chunk_count; c++)
+    {
+        i0 = c * DVZ_CULL_CHUNK_SIZE;
+        i1 = MIN(i0 + DVZ_CULL_CHUNK_SIZE + culling->overlap, n);
+        p0 = culling->box_min[c];
+        p1 = culling->box_max[c];
+        glm_vec3_fill(p0, +INFINITY);
+        glm_vec3_fill(p1, -INFINITY);
+        for (uint32_t i = i0; i < i1; i++)
+        {
+            for (uint32_t k = 0; k < attr_count; k++)
+            {
+                memcpy(pos, data + i * item_size + offsets[k], sizeof(vec3));
+                glm_vec3_minv(p0, pos, p0);
+                glm_vec3_maxv(p1, pos, p1);
+            }
+        }
+    }
+    log_trace("computed %d culling boxes over %d vertices", chunk_count, n);
+}
+
+
+
+/*************************************************************************************************/
+/*  View                                                                                         */
+/*************************************************************************************************/
+
+// Whether the projection of a box overlaps the viewport extended by a margin, in NDC.
+static bool _culling_box_visible(mat4 mvp, vec3 p0, vec3 p1, vec2 margin)
+{
+    vec4 corner = {0, 0, 0, 1}, clip = {0};
+    vec2 lo = {+INFINITY, +INFINITY}, hi = {-INFINITY, -INFINITY};
+    float x = 0, y = 0;
+    for (uint32_t k = 0; k < 8; k++)
+    {
+        corner[0] = (k & 1) ? p1[0] : p0[0];
+        corner[1] = (k & 2) ? p1[1] : p0[1];
+        corner[2] = (k & 4) ? p1[2] : p0[2];
+        glm_mat4_mulv(mvp, corner, clip);
+
+        // The projection of a box crossing the camera plane is unbounded.
+        if (clip[3] <= 0)
+            return true;
+        x = clip[0] / clip[3];
+        y = clip[1] / clip[3];
+        lo[0] = MIN(lo[0], x);
+        lo[1] = MIN(lo[1], y);
+        hi[0] = MAX(hi[0], x);
+        hi[1] = MAX(hi[1], y);
+    }
+    return lo[0] <= 1 + margin[0] && hi[0] >= -1 - margin[0] && //
+           lo[1] <= 1 + margin[1] && hi[1] >= -1 - margin[1];
+}
+
+
+
+// Select the range of vertices to draw, return whether it has changed.
+static bool _culling_update(DvzCulling* culling, DvzMVP* mvp, vec2 margin)
+{
+    ASSERT(culling != NULL);
+    ASSERT(mvp != NULL);
+
+    mat4 m;
+    glm_mat4_mul(mvp->view, mvp->model, m);
+    glm_mat4_mul(mvp->proj, m, m);
+
+    // First and last visible chunks.
+    uint32_t c0 = UINT32_MAX, c1 = 0;
+    for (uint32_t c = 0; c < culling->chunk_count; c++)
+    {
+        if (!_culling_box_visible(m, culling->box_min[c], culling->box_max[c], margin))
+            continue;
+        c0 = MIN(c0, c);
+        c1 = c;
+    }
+
+    bool visible = true;
+    uint32_t first = 0, count = culling->vertex_count;
+    if (culling->chunk_count > 0)
+    {
+        visible = c0 != UINT32_MAX;
+        if (visible)
+        {
+            first = c0 * DVZ_CULL_CHUNK_SIZE;
+            count = MIN((c1 + 1) * DVZ_CULL_CHUNK_SIZE + culling->overlap, culling->vertex_count);
+            count -= first;
+        }
+        else
+            count = 0;
+    }
+
+    bool changed =
+        visible != culling->visible || first != culling->first || count != culling->count;
+    culling->visible = visible;
+    culling->first = first;
+    culling->count = count;
+    return changed;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
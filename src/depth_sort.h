@@ -0,0 +1,350 @@
+/*************************************************************************************************/
+/*  Depth sort of translucent primitives                                                         */
+/*************************************************************************************************/
+
+/*
+The primitives of a visual (points, or triangles of a triangle list, possibly indexed) are copied
+with the position of their center, the average of the first 3D float attribute of their vertices.
+Their vertex indices are copied too, so that the worker thread never reads the arrays of the
+visual.
+
+When the model-view matrix of the panel changes, the worker computes the view depth of the
+centers in the previous order, mapped to unsigned integers with the same order as the floats.
+Small camera moves only swap a few neighbouring primitives, so the previous order is fixed with
+an insertion sort, which gives up after DVZ_DEPTH_SORT_MAX_MOVES moves per primitive, in which
+case a radix sort (4 passes of 8 bits) sorts the primitives from scratch. The farthest primitives
+come first, and the sorted vertex indices are uploaded by the main thread to the index buffer of
+the depth sort, which replaces the index buffer of the visual in the draw command.
+
+*/
+
+#ifndef DVZ_DEPTH_SORT_HEADER
+#define DVZ_DEPTH_SORT_HEADER
+
+#include "../include/datoviz/visuals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Sorting                                                                                      */
+/*************************************************************************************************/
+
+// Map a float to an unsigned integer, such that the order is preserved.
+static inline uint32_t _depth_sort_key(float z)
+{
+    uint32_t u = 0;
+    memcpy(&u, &z, sizeof(u));
+    return (u & 0x80000000) != 0 ? ~u : (u | 0x80000000);
+}
+
+
+
+// Insertion sort of the keys and the order, return false if more than max_moves moves are
+// needed, in which case the arrays are only partially sorted.
+static bool _depth_sort_insertion(
+    uint32_t n, uint32_t* keys, uint32_t* order, uint64_t max_moves, uint64_t* moves)
+{
+    ASSERT(keys != NULL || n == 0);
+    ASSERT(order != NULL || n == 0);
+    ASSERT(moves != NULL);
+
+    uint64_t m = 0;
+    uint32_t key = 0, o = 0, j = 0;
+    for (uint32_t i = 1; i < n; i++)
+    {
+        key = keys[i];
+        o = order[i];
+        for (j = i; j > 0 && keys[j - 1] > key; j--)
+        {
+            keys[j] = keys[j - 1];
+            order[j] = order[j - 1];
+        }
+        keys[j] = key;
+        order[j] = o;
+        m += i - j;
+        if (m > max_moves)
+            break;
+    }
+    *moves = m;
+    return m <= max_moves;
+}
+
+
+
+// Stable LSD radix sort of the keys and the order, with 4 passes of 8 bits.
+static void _depth_sort_radix(
+    uint32_t n, uint32_t* keys, uint32_t* order, uint32_t* tmp_keys, uint32_t* tmp_order)
+{
+    ASSERT(keys != NULL || n == 0);
+    ASSERT(tmp_keys != NULL || n == 0);
+
+    uint32_t offsets[256] = {0};
+    uint32_t *src_keys = keys, *src_order = order, *dst_keys = tmp_keys, *dst_order = tmp_order;
+    uint32_t* swap = NULL;
+    uint32_t digit = 0, total = 0, count = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8)
+    {
+        memset(offsets, 0, sizeof(offsets));
+        for (uint32_t i = 0; i < n; i++)
+            offsets[(src_keys[i] >> shift) & 0xFF]++;
+        total = 0;
+        for (uint32_t d = 0; d < 256; d++)
+        {
+            count = offsets[d];
+            offsets[d] = total;
+            total += count;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            digit = (src_keys[i] >> shift) & 0xFF;
+            dst_keys[offsets[digit]] = src_keys[i];
+            dst_order[offsets[digit]++] = src_order[i];
+        }
+        swap = src_keys, src_keys = dst_keys, dst_keys = swap;
+        swap = src_order, src_order = dst_order, dst_order = swap;
+    }
+    // After an even number of passes, the result is back in the input arrays.
+    ASSERT(src_keys == keys);
+}
+
+
+
+// Sort the primitives back to front for a model-view matrix, and write their vertex indices.
+static void _depth_sort_run(DvzDepthSort* sort, mat4 mv)
+{
+    ASSERT(sort != NULL);
+
+    DvzClock clock = {0};
+    _clock_init(&clock);
+
+    uint32_t n = sort->primitive_count;
+    uint32_t p = sort->primitive_size;
+    float* c = NULL;
+    for (uint32_t k = 0; k < n; k++)
+    {
+        c = sort->centers[sort->order[k]];
+        sort->keys[k] =
+            _depth_sort_key(mv[0][2] * c[0] + mv[1][2] * c[1] + mv[2][2] * c[2] + mv[3][2]);
+    }
+
+    // The camera looks towards -z: increasing view depths go from back to front.
+    uint64_t moves = 0, max_moves = DVZ_DEPTH_SORT_MAX_MOVES * (uint64_t)n;
+    bool incremental =
+        sort->has_order && _depth_sort_insertion(n, sort->keys, sort->order, max_moves, &moves);
+    if (!incremental)
+    {
+        _depth_sort_radix(n, sort->keys, sort->order, sort->tmp_keys, sort->tmp_order);
+        sort->run_stats.full_count++;
+    }
+    sort->has_order = true;
+
+    // Vertex indices of the sorted primitives.
+    const DvzIndex* prims = sort->primitives;
+    const uint32_t* order = sort->order;
+    for (uint32_t k = 0; k < n; k++)
+    {
+        for (uint32_t j = 0; j < p; j++)
+            sort->sorted[p * k + j] = prims != NULL ? prims[p * order[k] + j] : p * order[k] + j;
+    }
+
+    sort->run_stats.primitive_count = n;
+    sort->run_stats.sort_count++;
+    sort->run_stats.moves = incremental ? moves : 0;
+    sort->run_stats.duration = _clock_get(&clock);
+}
+
+
+
+static void* _depth_sort_worker(void* user_data)
+{
+    DvzDepthSort* sort = (DvzDepthSort*)user_data;
+    ASSERT(sort != NULL);
+    while (true)
+    {
+        dvz_fifo_dequeue(&sort->queue, true);
+        if (atomic_load(&sort->cancel))
+            break;
+        _depth_sort_run(sort, sort->mv);
+        atomic_store(&sort->busy, false);
+    }
+    return NULL;
+}
+
+
+
+/*************************************************************************************************/
+/*  Primitives                                                                                   */
+/*************************************************************************************************/
+
+// Copy the primitives of the vertex and index arrays of a visual. The worker must be idle.
+static void _depth_sort_build(
+    DvzDepthSort* sort, DvzGraphics* graphics, DvzArray* vertices, DvzArray* indices)
+{
+    ASSERT(sort != NULL);
+    ASSERT(graphics != NULL);
+    ASSERT(vertices != NULL);
+    ASSERT(!atomic_load(&sort->busy));
+
+    sort->dirty = false;
+    sort->ready = false;
+    sort->pending = false;
+    sort->has_order = false;
+    sort->needs_sort = true;
+    sort->vertex_count = vertices->item_count;
+    sort->index_count = indices != NULL ? indices->item_count : 0;
+    sort->primitive_size = graphics->topology == VK_PRIMITIVE_TOPOLOGY_POINT_LIST ? 1 : 3;
+    uint32_t p = sort->primitive_size;
+
+    // The position is the first 3D float attribute of the vertices.
+    int64_t offset = -1;
+    for (uint32_t i = 0; i < graphics->vertex_attr_count; i++)
+    {
+        if (graphics->vertex_attrs[i].binding == 0 &&
+            graphics->vertex_attrs[i].format == VK_FORMAT_R32G32B32_SFLOAT)
+        {
+            offset = (int64_t)graphics->vertex_attrs[i].offset;
+            break;
+        }
+    }
+
+    bool indexed = sort->index_count > 0;
+    uint32_t n = (indexed ? sort->index_count : sort->vertex_count) / p;
+    if (offset < 0 || vertices->data == NULL || (indexed && indices->data == NULL))
+        n = 0;
+    sort->primitive_count = n;
+    sort->stats.primitive_count = n;
+    if (n == 0)
+        return;
+
+    REALLOC(sort->centers, n * sizeof(vec3));
+    REALLOC(sort->order, n * sizeof(uint32_t));
+    REALLOC(sort->keys, n * sizeof(uint32_t));
+    REALLOC(sort->tmp_order, n * sizeof(uint32_t));
+    REALLOC(sort->tmp_keys, n * sizeof(uint32_t));
+    REALLOC(sort->sorted, n * p * sizeof(DvzIndex));
+    REALLOC(sort->indices, n * p * sizeof(DvzIndex));
+    if (indexed)
+    {
+        REALLOC(sort->primitives, n * p * sizeof(DvzIndex));
+        memcpy(sort->primitives, indices->data, n * p * sizeof(DvzIndex));
+    }
+    else
+        FREE(sort->primitives);
+
+    const char* data = (const char*)vertices->data;
+    vec3 pos = {0};
+    uint32_t v = 0;
+    for (uint32_t k = 0; k < n; k++)
+    {
+        glm_vec3_zero(sort->centers[k]);
+        for (uint32_t j = 0; j < p; j++)
+        {
+            v = indexed ? sort->primitives[p * k + j] : p * k + j;
+            if (v >= sort->vertex_count)
+                continue;
+            memcpy(pos, data + v * vertices->item_size + offset, sizeof(vec3));
+            glm_vec3_add(sort->centers[k], pos, sort->centers[k]);
+        }
+        glm_vec3_scale(sort->centers[k], 1.0f / p, sort->centers[k]);
+        sort->order[k] = k;
+    }
+    log_debug("depth sort of %d primitives of size %d", n, p);
+}
+
+
+
+/*************************************************************************************************/
+/*  View                                                                                         */
+/*************************************************************************************************/
+
+// Upload the result of the last sort, and request a new sort if the model-view matrix has
+// changed. Return whether the command buffers must be refilled.
+static bool _depth_sort_update(DvzDepthSort* sort, DvzCanvas* canvas, DvzMVP* mvp)
+{
+    ASSERT(sort != NULL);
+    ASSERT(canvas != NULL);
+    ASSERT(mvp != NULL);
+    if (atomic_load(&sort->busy))
+        return false;
+
+    bool refill = false;
+    uint32_t count = sort->primitive_count * sort->primitive_size;
+    VkDeviceSize size = count * sizeof(DvzIndex);
+    if (sort->pending)
+    {
+        sort->pending = false;
+
+        // (Re)allocate the index buffer, the command buffers must then be refilled.
+        DvzContext* ctx = canvas->gpu->context;
+        if (sort->br.buffer == VK_NULL_HANDLE)
+        {
+            sort->br = dvz_ctx_buffers(ctx, DVZ_BUFFER_TYPE_INDEX, 1, dvz_next_pow2(size));
+            sort->ready = false;
+        }
+        else if (sort->br.size < size)
+        {
+            dvz_ctx_buffers_resize(ctx, &sort->br, dvz_next_pow2(size));
+            sort->ready = false;
+        }
+
+        // The sorted indices are kept until the next sort, after the transfer has been done.
+        memcpy(sort->indices, sort->sorted, size);
+        dvz_upload_buffers(canvas, sort->br, 0, size, sort->indices);
+        sort->stats = sort->run_stats;
+        if (!sort->ready)
+        {
+            sort->ready = true;
+            refill = true;
+        }
+    }
+
+    mat4 mv;
+    glm_mat4_mul(mvp->view, mvp->model, mv);
+    if (count > 0 && (sort->needs_sort || memcmp(mv, sort->mv, sizeof(mat4)) != 0))
+    {
+        glm_mat4_copy(mv, sort->mv);
+        sort->needs_sort = false;
+        sort->pending = true;
+        atomic_store(&sort->busy, true);
+        dvz_fifo_enqueue(&sort->queue, sort);
+    }
+    return refill;
+}
+
+
+
+/*************************************************************************************************/
+/*  Destruction                                                                                  */
+/*************************************************************************************************/
+
+static void _depth_sort_destroy(DvzDepthSort* sort)
+{
+    ASSERT(sort != NULL);
+
+    // Stop the worker once the current sort is done.
+    atomic_store(&sort->cancel, true);
+    dvz_fifo_enqueue(&sort->queue, sort);
+    dvz_thread_join(&sort->worker);
+    dvz_fifo_destroy(&sort->queue);
+
+    FREE(sort->centers);
+    FREE(sort->primitives);
+    FREE(sort->order);
+    FREE(sort->keys);
+    FREE(sort->tmp_order);
+    FREE(sort->tmp_keys);
+    FREE(sort->sorted);
+    FREE(sort->indices);
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
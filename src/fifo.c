@@ -34,9 +34,17 @@ void dvz_fifo_enqueue(DvzFifo* fifo, void* item)
     if ((fifo->head + 1) % fifo->capacity == fifo->tail)
     {
         ASSERT(fifo->items != NULL);
+        int32_t capacity = fifo->capacity;
         fifo->capacity *= 2;
         log_debug("FIFO queue is full, enlarging it to %d", fifo->capacity);
         REALLOC(fifo->items, (uint32_t)fifo->capacity * sizeof(void*));
+
+        // Unwrap the ring: the items before the head go after the items from the tail.
+        if (fifo->head < fifo->tail)
+        {
+            memcpy(&fifo->items[capacity], fifo->items, (uint32_t)fifo->head * sizeof(void*));
+            fifo->head += capacity;
+        }
     }
 
     ASSERT((fifo->head + 1) % fifo->capacity != fifo->tail);
@@ -12,8 +12,10 @@ layout(location = 0) in vec4 color;
 layout(location = 1) in float size;
 layout(location = 2) in float marker;
 layout(location = 3) in float angle;
+layout(location = 4) flat in uint item;
 
 layout(location = 0) out vec4 out_color;
+layout(location = 1) out uvec2 out_pick;
 
 
 void main() {
@@ -29,4 +31,5 @@ void main() {
         out_color = filled(distance, params.edge_width, color);
     if (out_color.a < .05)
         discard;
+    out_pick = uvec2(viewport.pick_id, item);
 }
@@ -20,8 +20,10 @@ layout (location = 2) in vec2 in_uv;
 layout (location = 3) in vec3 in_color;
 layout (location = 4) in float in_clip;
 layout (location = 5) in float in_alpha;
+layout (location = 6) flat in uint in_item;
 
 layout (location = 0) out vec4 out_color;
+layout (location = 1) out uvec2 out_pick;
 
 const float eps = .00001;
 
@@ -30,6 +32,7 @@ void main() {
 
     if (in_clip < -eps)
         discard;
+    out_pick = uvec2(viewport.pick_id, in_item);
 
     vec3 normal, light_dir, ambient, diffuse, view_dir, reflect_dir, specular, color;
     vec4 lpar;
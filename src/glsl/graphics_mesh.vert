@@ -20,6 +20,7 @@ layout (location = 2) out vec2 out_uv;
 layout (location = 3) out vec3 out_color;
 layout (location = 4) out float out_clip;
 layout (location = 5) out float out_alpha;
+layout (location = 6) flat out uint out_item; // provoking vertex of the triangle
 
 void main() {
     gl_Position = transform(pos);
@@ -30,6 +31,7 @@ void main() {
     out_uv = uv;
     out_clip = dot(vec4(pos, 1.0), params.clip_coefs);
     out_alpha = alpha;
+    out_item = gl_VertexIndex;
     out_color = vec3(0);
 
     // NOTE: if uv.y is negative, we take uv.x and unpack the 3 first bytes and interpret them as
@@ -18,8 +18,10 @@ layout (location = 1) in vec2 in_caps;
 layout (location = 2) in float in_length;
 layout (location = 3) in vec2 in_texcoord;
 layout (location = 4) in vec2 in_bevel_distance;
+layout (location = 5) flat in uint in_item;
 
 layout (location = 0) out vec4 out_color;
+layout (location = 1) out uvec2 out_pick;
 
 
 // void discard_depth(vec4 color) {
@@ -31,6 +33,7 @@ layout (location = 0) out vec4 out_color;
 void main() {
     CLIP
 
+    out_pick = uvec2(viewport.pick_id, in_item);
     float distance = in_texcoord.y;
     vec4 color = in_color;
     float linewidth = params.linewidth;
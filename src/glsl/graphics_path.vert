@@ -25,6 +25,7 @@ layout (location = 1) out vec2 out_caps;
 layout (location = 2) out float out_length;
 layout (location = 3) out vec2 out_texcoord;
 layout (location = 4) out vec2 out_bevel_distance;
+layout (location = 5) flat out uint out_item;
 
 
 float compute_u(vec2 p0, vec2 p1, vec2 p) {
@@ -70,6 +71,8 @@ void main() {
     float z = p1_.z / p1_.w;
 
     out_color = color;
+    // 4 vertices per point, or 1 instance per point when instanced (gl_VertexIndex < 4)
+    out_item = gl_VertexIndex / 4 + gl_InstanceIndex;
 
     float linewidth = params.linewidth;
     float miter_limit = params.miter_limit;
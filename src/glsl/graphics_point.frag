@@ -2,11 +2,15 @@
 #include "common.glsl"
 
 layout (location = 0) in vec4 in_color;
+layout (location = 1) flat in uint in_item;
+
 layout (location = 0) out vec4 out_color;
+layout (location = 1) out uvec2 out_pick;
 
 void main()
 {
     CLIP
 
+    out_pick = uvec2(viewport.pick_id, in_item);
     out_color = in_color;
 }
@@ -8,6 +8,7 @@
 layout(std140, binding = USER_BINDING) uniform Params
 {
     vec4 box_size;
+    uvec4 shape;
     int cmap;
 }
 params;
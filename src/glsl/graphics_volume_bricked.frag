@@ -0,0 +1,139 @@
+#version 450
+#include "common.glsl"
+#include "colormaps.glsl"
+
+#define STEP_SIZE 0.005
+#define MAX_ITER 10 / STEP_SIZE
+
+layout(std140, binding = USER_BINDING) uniform Params
+{
+    vec4 box_size;
+    uvec4 shape; // volume shape in voxels (xyz), brick size (w)
+    int cmap;
+}
+params;
+
+layout(binding = (USER_BINDING + 1)) uniform sampler2D tex_cmap;    // colormap texture
+layout(binding = (USER_BINDING + 2)) uniform sampler3D tex;         // brick atlas
+layout(binding = (USER_BINDING + 3)) uniform sampler3D page_table;  // one entry per finest brick
+
+layout(location = 0) in vec3 in_pos;
+layout(location = 1) in vec3 in_uvw;
+layout(location = 2) in vec3 in_ray;
+
+layout(location = 0) out vec4 out_color;
+
+
+bool intersect_box(vec3 origin, vec3 dir, vec3 box_min, vec3 box_max, out float t0, out float t1)
+{
+    vec3 inv_r = 1.0 / dir;
+    vec3 tbot = inv_r * (box_min-origin);
+    vec3 ttop = inv_r * (box_max-origin);
+    vec3 tmin = min(ttop, tbot);
+    vec3 tmax = max(ttop, tbot);
+    vec2 t = max(tmin.xx, tmin.yz);
+    t0 = max(t.x, t.y);
+    t = min(tmax.xx, tmax.yz);
+    t1 = min(t.x, t.y);
+    return t0 <= t1;
+}
+
+
+
+// Number of pages per unit of uvw: the last page along an axis may be partly outside the volume.
+vec3 page_grid() {
+    return vec3(params.shape.xyz) / float(params.shape.w);
+}
+
+
+
+// Page table entry of a position: origin of the brick in the atlas, in voxels, and level of the
+// brick, negative if the brick is empty or not loaded yet.
+vec4 fetch_page(vec3 uvw) {
+    ivec3 size = textureSize(page_table, 0);
+    ivec3 page = clamp(ivec3(uvw * page_grid()), ivec3(0), size - 1);
+    return texelFetch(page_table, page, 0);
+}
+
+
+
+float fetch_value(vec3 uvw, vec4 page) {
+    // Voxel position within the brick, at the level of the brick.
+    float bs = float(params.shape.w);
+    vec3 voxel = uvw * vec3(params.shape.xyz) * exp2(-page.w);
+    vec3 local = clamp(voxel - floor(voxel / bs) * bs, vec3(0), vec3(bs - 1));
+    return texelFetch(tex, ivec3(page.xyz + local), 0).r;
+}
+
+
+
+vec4 fetch_color(float v) {
+    // Color component: colormap.
+    vec4 color = colormap(params.cmap, v);
+
+    // Alpha value: value. The color is premultiplied so that the empty bricks, which are skipped,
+    // would not have contributed.
+    color.a = v;
+    color.rgb *= color.a;
+    return color;
+}
+
+
+
+// Distance to travel along a direction, in uvw coordinates, to leave the page of a position.
+float page_exit(vec3 uvw, vec3 dir) {
+    vec3 grid = page_grid();
+    vec3 p0 = floor(uvw * grid) / grid;
+    vec3 p1 = p0 + 1.0 / grid;
+    // Avoid the divisions by zero (and the NaNs) on the axes parallel to the ray.
+    dir = mix(dir, vec3(1e-8), equal(dir, vec3(0)));
+    vec3 t = max((p0 - uvw) / dir, (p1 - uvw) / dir);
+    return min(t.x, min(t.y, t.z));
+}
+
+
+
+void main()
+{
+    CLIP
+
+    mat4 mi = inverse(mvp.model);
+    vec3 u = (mi * vec4(normalize(in_ray), 1)).xyz;
+    vec3 o = (mi * vec4(-mvp.view[3].xyz, 1)).xyz;
+
+    float t0, t1;
+    vec3 b0 = -params.box_size.xyz / 2;
+    vec3 b1 = +params.box_size.xyz / 2;
+    intersect_box(o, u, b0, b1, t0, t1);
+    if (t0 < 0 || t1 < 0) discard;
+
+    vec3 ray_start = o + u * t0;
+    vec3 ray_stop = o + u * t1;
+
+    vec3 pos = ray_stop;
+    vec3 dl = normalize(ray_start - ray_stop) * STEP_SIZE;
+    vec3 duvw = dl / (b1 - b0) / STEP_SIZE;
+    float travel = distance(ray_start, ray_stop);
+    vec3 uvw = vec3(0);
+    vec4 page = vec4(0);
+    vec4 s = vec4(0);
+    vec4 acc = vec4(0);
+    float skip = 0;
+    for (int i = 0; i < MAX_ITER && travel > 0.0; ++i, pos += dl, travel -= STEP_SIZE) {
+        uvw = (pos - b0) / (b1 - b0);
+        page = fetch_page(uvw);
+
+        // Empty space skipping: jump to the next page, on the grid of steps.
+        if (page.w < 0) {
+            skip = page_exit(uvw, duvw);
+            skip = max(floor(skip / STEP_SIZE), 0.0) * STEP_SIZE;
+            pos += skip * normalize(dl);
+            travel -= skip;
+            continue;
+        }
+
+        s = fetch_color(fetch_value(uvw, page));
+        acc = s + (1 - s.a) * acc;
+    }
+    out_color = acc;
+}
@@ -69,6 +69,34 @@ static void _common_slots(DvzGraphics* graphics)
 
 
 
+// Graphics callback of the instanced graphics: the vertex array holds one vertex per item, and
+// the index array, if any, holds the two triangles of the quad shared by all instances.
+static void
+_graphics_instanced_callback(DvzGraphicsData* data, uint32_t item_count, const void* item)
+{
+    ASSERT(data != NULL);
+    ASSERT(data->vertices != NULL);
+
+    ASSERT(item_count > 0);
+    dvz_array_resize(data->vertices, item_count);
+
+    if (item == NULL)
+    {
+        if (data->indices != NULL)
+        {
+            dvz_array_resize(data->indices, 6);
+            dvz_array_data(data->indices, 0, 6, 6, (DvzIndex[]){0, 1, 2, 0, 2, 3});
+        }
+        return;
+    }
+    ASSERT(data->current_idx < item_count);
+
+    dvz_array_data(data->vertices, data->current_idx, 1, 1, item);
+    data->current_idx++;
+}
+
+
+
 /*************************************************************************************************/
 /*  Basic graphics                                                                               */
 /*************************************************************************************************/
@@ -78,6 +106,7 @@ static void _graphics_point(DvzCanvas* canvas, DvzGraphics* graphics)
     SHADER(VERTEX, "graphics_point_vert")
     SHADER(FRAGMENT, "graphics_point_frag")
     PRIMITIVE(POINT_LIST)
+    dvz_graphics_pick(graphics, true);
 
     // Depth test flag.
     if ((graphics->flags & DVZ_GRAPHICS_FLAGS_DEPTH_TEST_ENABLE) != 0)
@@ -126,6 +155,7 @@ static void _graphics_marker(DvzCanvas* canvas, DvzGraphics* graphics)
     SHADER(VERTEX, "graphics_marker_vert")
     SHADER(FRAGMENT, "graphics_marker_frag")
     PRIMITIVE(POINT_LIST)
+    dvz_graphics_pick(graphics, true);
 
     // Depth test flag.
     if ((graphics->flags & DVZ_GRAPHICS_FLAGS_DEPTH_TEST_ENABLE) != 0)
@@ -201,7 +231,15 @@ static void _graphics_segment(DvzCanvas* canvas, DvzGraphics* graphics)
     ATTR(DvzGraphicsSegmentVertex, VK_FORMAT_R8_UINT, transform)
 
     _common_slots(graphics);
-    dvz_graphics_callback(graphics, _graphics_segment_callback);
+
+    // The 4 corners of every segment are drawn from a single vertex.
+    if ((graphics->flags & DVZ_GRAPHICS_FLAGS_INSTANCED) != 0)
+    {
+        dvz_graphics_instanced(graphics, 0, 4);
+        dvz_graphics_callback(graphics, _graphics_instanced_callback);
+    }
+    else
+        dvz_graphics_callback(graphics, _graphics_segment_callback);
 
     CREATE
 }
@@ -239,6 +277,7 @@ static void _graphics_path(DvzCanvas* canvas, DvzGraphics* graphics)
     SHADER(VERTEX, "graphics_path_vert")
     SHADER(FRAGMENT, "graphics_path_frag")
     PRIMITIVE(TRIANGLE_STRIP)
+    dvz_graphics_pick(graphics, true);
     // PRIMITIVE(POINT_LIST)
 
     ATTR_BEGIN(DvzGraphicsPathVertex)
@@ -251,7 +290,14 @@ static void _graphics_path(DvzCanvas* canvas, DvzGraphics* graphics)
     _common_slots(graphics);
     dvz_graphics_slot(graphics, DVZ_USER_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
 
-    dvz_graphics_callback(graphics, _graphics_path_callback);
+    // Every point is drawn as a triangle strip with 4 vertices.
+    if ((graphics->flags & DVZ_GRAPHICS_FLAGS_INSTANCED) != 0)
+    {
+        dvz_graphics_instanced(graphics, 0, 4);
+        dvz_graphics_callback(graphics, _graphics_instanced_callback);
+    }
+    else
+        dvz_graphics_callback(graphics, _graphics_path_callback);
 
     CREATE
 }
@@ -580,8 +626,16 @@ static void _graphics_volume_callback(DvzGraphicsData* data, uint32_t item_count
 
 static void _graphics_volume(DvzCanvas* canvas, DvzGraphics* graphics)
 {
+    bool bricked = (graphics->flags & DVZ_GRAPHICS_FLAGS_VOLUME_BRICKED) != 0;
     SHADER(VERTEX, "graphics_volume_vert")
-    SHADER(FRAGMENT, "graphics_volume_frag")
+    if (bricked)
+    {
+        SHADER(FRAGMENT, "graphics_volume_bricked_frag")
+    }
+    else
+    {
+        SHADER(FRAGMENT, "graphics_volume_frag")
+    }
     PRIMITIVE(TRIANGLE_LIST)
     dvz_graphics_depth_test(graphics, DVZ_DEPTH_TEST_ENABLE);
 
@@ -593,6 +647,9 @@ static void _graphics_volume(DvzCanvas* canvas, DvzGraphics* graphics)
     dvz_graphics_slot(graphics, DVZ_USER_BINDING, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
     dvz_graphics_slot(graphics, DVZ_USER_BINDING + 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
     dvz_graphics_slot(graphics, DVZ_USER_BINDING + 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    if (bricked)
+        dvz_graphics_slot(
+            graphics, DVZ_USER_BINDING + 3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 
     CREATE
 
@@ -610,6 +667,7 @@ static void _graphics_mesh(DvzCanvas* canvas, DvzGraphics* graphics)
     SHADER(VERTEX, "graphics_mesh_vert")
     SHADER(FRAGMENT, "graphics_mesh_frag")
     PRIMITIVE(TRIANGLE_LIST)
+    dvz_graphics_pick(graphics, true);
     dvz_graphics_depth_test(graphics, DVZ_DEPTH_TEST_ENABLE);
     // dvz_graphics_front_face(graphics, VK_FRONT_FACE_CLOCKWISE);
     // dvz_graphics_cull_mode(graphics, VK_CULL_MODE_FRONT_BIT);
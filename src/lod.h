@@ -0,0 +1,297 @@
+/*************************************************************************************************/
+/*  Level of detail for line strips and paths                                                    */
+/*************************************************************************************************/
+
+/*
+Multi-resolution min/max pyramid over the samples of a time series (increasing x values), in the
+spirit of the M4 aggregation, see
+
+https://doi.org/10.14778/2732951.2732953
+
+Every level groups the samples into buckets of DVZ_LOD_BUCKET_BASE * DVZ_LOD_BUCKET_FACTOR^k
+samples, and stores the indices of the samples with the lowest and highest y values. A bucket is
+drawn with its first, min, max, and last samples. The level is chosen such that a bucket is never
+wider than a pixel column, so that the decimated line covers the same pixels as the full one.
+
+*/
+
+#ifndef DVZ_LOD_HEADER
+#define DVZ_LOD_HEADER
+
+#include "../include/datoviz/visuals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Pyramid                                                                                      */
+/*************************************************************************************************/
+
+static void _lod_destroy(DvzLod* lod)
+{
+    ASSERT(lod != NULL);
+    for (uint32_t k = 0; k < lod->level_count; k++)
+    {
+        FREE(lod->extrema[k]);
+    }
+    lod->level_count = 0;
+    lod->sample_count = 0;
+}
+
+
+
+// Build the min/max pyramid of an array of positions. The pyramid is left empty if the x values
+// are not increasing.
+static void _lod_build(DvzLod* lod, uint32_t count, const dvec3* pos)
+{
+    ASSERT(lod != NULL);
+    _lod_destroy(lod);
+    lod->sample_count = count;
+    if (count == 0 || pos == NULL)
+        return;
+
+    uint32_t bs = DVZ_LOD_BUCKET_BASE;
+    uint32_t bc = 0, i0 = 0, i1 = 0, imin = 0, imax = 0;
+    uint32_t* ext = NULL;
+    uint32_t* prev = NULL;
+    for (uint32_t k = 0; k < DVZ_LOD_MAX_LEVELS; k++)
+    {
+        bc = (uint32_t)(((uint64_t)count + bs - 1) / bs);
+        ext = (uint32_t*)malloc(2 * (size_t)bc * sizeof(uint32_t));
+        ASSERT(ext != NULL);
+
+        for (uint32_t b = 0; b < bc; b++)
+        {
+            // Finest level: go through all samples of the bucket.
+            if (k == 0)
+            {
+                i0 = b * bs;
+                i1 = (uint32_t)MIN((uint64_t)i0 + bs, count);
+                imin = imax = i0;
+                for (uint32_t i = i0; i < i1; i++)
+                {
+                    if (i > 0 && pos[i][0] < pos[i - 1][0])
+                    {
+                        log_warn("disable the level of detail as the x values are not increasing");
+                        FREE(ext);
+                        _lod_destroy(lod);
+                        return;
+                    }
+                    if (pos[i][1] < pos[imin][1])
+                        imin = i;
+                    if (pos[i][1] > pos[imax][1])
+                        imax = i;
+                }
+            }
+            // Coarser levels: merge the extrema of the children buckets.
+            else
+            {
+                i0 = b * DVZ_LOD_BUCKET_FACTOR;
+                i1 = MIN(i0 + DVZ_LOD_BUCKET_FACTOR, lod->bucket_count[k - 1]);
+                imin = prev[2 * i0 + 0];
+                imax = prev[2 * i0 + 1];
+                for (uint32_t c = i0 + 1; c < i1; c++)
+                {
+                    if (pos[prev[2 * c + 0]][1] < pos[imin][1])
+                        imin = prev[2 * c + 0];
+                    if (pos[prev[2 * c + 1]][1] > pos[imax][1])
+                        imax = prev[2 * c + 1];
+                }
+            }
+            ext[2 * b + 0] = imin;
+            ext[2 * b + 1] = imax;
+        }
+
+        lod->extrema[k] = ext;
+        lod->bucket_size[k] = bs;
+        lod->bucket_count[k] = bc;
+        lod->level_count = k + 1;
+
+        if (bc <= 1 || bs > UINT32_MAX / DVZ_LOD_BUCKET_FACTOR)
+            break;
+        prev = ext;
+        bs *= DVZ_LOD_BUCKET_FACTOR;
+    }
+    log_debug(
+        "built LOD pyramid with %d levels on %d samples", lod->level_count, lod->sample_count);
+}
+
+
+
+/*************************************************************************************************/
+/*  Slice                                                                                        */
+/*************************************************************************************************/
+
+// Index of the first sample with an x value larger than or equal to x.
+static uint32_t _lod_search(uint32_t count, const dvec3* pos, double x)
+{
+    uint32_t lo = 0, hi = count, mid = 0;
+    while (lo < hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        if (pos[mid][0] < x)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+
+
+// Range of the visible samples, extended by one sample on each side to keep the segments crossing
+// the edges of the viewport.
+static void _lod_visible(DvzLod* lod, const dvec3* pos, uint32_t* i0, uint32_t* i1)
+{
+    ASSERT(lod != NULL);
+    ASSERT(lod->sample_count > 0);
+    uint32_t n = lod->sample_count;
+    uint32_t a = _lod_search(n, pos, lod->xlim[0]);
+    uint32_t b = _lod_search(n, pos, lod->xlim[1]);
+    *i0 = MIN(a > 0 ? a - 1 : 0, n - 1);
+    *i1 = MIN(b + 1, n);
+}
+
+
+
+// Coarsest level whose buckets are not wider than a pixel column, or -1 for the full resolution.
+static int32_t _lod_level(DvzLod* lod, uint32_t visible)
+{
+    ASSERT(lod != NULL);
+    int32_t level = -1;
+    if (lod->width == 0)
+        return level;
+    for (uint32_t k = 0; k < lod->level_count; k++)
+    {
+        if ((uint64_t)lod->bucket_size[k] * lod->width > visible)
+            break;
+        level = (int32_t)k;
+    }
+    return level;
+}
+
+
+
+// Whether the current slice no longer matches the visible range.
+static bool _lod_outdated(DvzLod* lod, const dvec3* pos)
+{
+    ASSERT(lod != NULL);
+    if (lod->level_count == 0)
+        return false;
+    uint32_t i0 = 0, i1 = 0;
+    _lod_visible(lod, pos, &i0, &i1);
+    return _lod_level(lod, i1 - i0) != lod->level || i0 < lod->first || i1 > lod->last;
+}
+
+
+
+// Compute the slice to upload: the visible range padded by its own length on both sides, so that
+// small pans do not require a new upload, and aligned on the buckets of the level.
+static void _lod_slice(DvzLod* lod, const dvec3* pos)
+{
+    ASSERT(lod != NULL);
+    ASSERT(lod->level_count > 0);
+
+    uint32_t n = lod->sample_count;
+    uint32_t i0 = 0, i1 = 0;
+    _lod_visible(lod, pos, &i0, &i1);
+    uint32_t visible = i1 - i0;
+
+    lod->level = _lod_level(lod, visible);
+    uint64_t first = i0 > visible ? i0 - visible : 0;
+    uint64_t last = MIN((uint64_t)i1 + visible, n);
+    if (lod->level >= 0)
+    {
+        uint32_t bs = lod->bucket_size[lod->level];
+        first = first / bs * bs;
+        last = MIN((last + bs - 1) / bs * bs, n);
+    }
+    lod->first = (uint32_t)first;
+    lod->last = (uint32_t)last;
+}
+
+
+
+// Maximum number of indices in the current slice.
+static uint32_t _lod_max_count(DvzLod* lod)
+{
+    ASSERT(lod != NULL);
+    ASSERT(lod->first < lod->last);
+    if (lod->level < 0)
+        return lod->last - lod->first;
+    uint32_t bs = lod->bucket_size[lod->level];
+    return 4 * ((lod->last - lod->first + bs - 1) / bs);
+}
+
+
+
+// Sample indices of the current slice, in increasing order: all samples at the full resolution,
+// otherwise the first, min, max, and last samples of every bucket. Return the number of indices.
+static uint32_t _lod_indices(DvzLod* lod, uint32_t* indices)
+{
+    ASSERT(lod != NULL);
+    ASSERT(indices != NULL);
+
+    uint32_t count = 0;
+    if (lod->level < 0)
+    {
+        for (uint32_t i = lod->first; i < lod->last; i++)
+            indices[count++] = i;
+        return count;
+    }
+
+    uint32_t bs = lod->bucket_size[lod->level];
+    const uint32_t* ext = lod->extrema[lod->level];
+    uint32_t b0 = lod->first / bs;
+    uint32_t b1 = (uint32_t)(((uint64_t)lod->last + bs - 1) / bs);
+    uint32_t item[4] = {0};
+    for (uint32_t b = b0; b < b1; b++)
+    {
+        item[0] = b * bs;
+        item[1] = MIN(ext[2 * b + 0], ext[2 * b + 1]);
+        item[2] = MAX(ext[2 * b + 0], ext[2 * b + 1]);
+        item[3] = (uint32_t)MIN((uint64_t)item[0] + bs, lod->sample_count) - 1;
+        for (uint32_t j = 0; j < 4; j++)
+        {
+            // Skip duplicates, the indices being sorted within a bucket.
+            if (count > 0 && indices[count - 1] == item[j])
+                continue;
+            indices[count++] = item[j];
+        }
+    }
+    ASSERT(count <= _lod_max_count(lod));
+    return count;
+}
+
+
+
+// Gather the items of an array at the given indices into another array.
+static void _lod_gather(DvzArray* src, DvzArray* dst, uint32_t count, const uint32_t* indices)
+{
+    ASSERT(src != NULL);
+    ASSERT(dst != NULL);
+    ASSERT(count > 0);
+
+    dvz_array_destroy(dst);
+    *dst = dvz_array(count, src->dtype);
+    VkDeviceSize item_size = src->item_size;
+    ASSERT(dst->item_size == item_size);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        ASSERT(indices[i] < src->item_count);
+        memcpy(
+            (char*)dst->data + i * item_size, (const char*)src->data + indices[i] * item_size,
+            item_size);
+    }
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,8 +26,9 @@
 #include <string.h>
 #include <time.h>
 
-#include <datoviz/macros.h>
+#include <datoviz/common.h>
 #include <datoviz/log.h>
+#include <datoviz/macros.h>
 
 #ifdef _WIN32
 BEGIN_INCL_NO_WARN
@@ -40,10 +41,38 @@ static struct
     void* udata;
     log_LockFn lock;
     FILE* fp;
-    int level;
     int quiet;
 } L;
 
+int log_level_current;
+
+/* Asynchronous logging: bounded multi-producer single-consumer ring. Every slot has a sequence
+ * number: a producer claims the slot at position pos when its sequence is pos, and publishes it
+ * with pos + 1; the consumer releases it with pos + LOG_ASYNC_CAPACITY once it has been written. */
+typedef struct
+{
+    atomic(uint64_t, seq);
+    int level;
+    int line;
+    const char* file;
+    time_t time;
+    char message[LOG_MESSAGE_SIZE];
+} LogRecord;
+
+static struct
+{
+    LogRecord records[LOG_ASYNC_CAPACITY];
+    atomic(uint64_t, head); // next position to be claimed by a producer
+    atomic(uint64_t, tail); // next position to be written by the consumer
+    atomic(uint64_t, dropped);
+    atomic(bool, running);
+    bool initialized;
+    DvzThread thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t ready;   // signaled when the ring goes from empty to non-empty
+    pthread_cond_t drained; // broadcast when the consumer has written all published records
+} A;
+
 static const char* level_names[] = {"T", "D", "I", "W", "E", "F"};
 
 #ifdef LOG_USE_COLOR
@@ -76,23 +105,14 @@ void log_set_fp(FILE* fp) { L.fp = fp; }
 void log_set_level(int level)
 {
     // log_debug("set log level to %d", level);
-    L.level = level;
+    log_level_current = level;
 }
 
 void log_set_quiet(int enable) { L.quiet = enable ? 1 : 0; }
 
-void log_log(int level, const char* file, int line, const char* fmt, ...)
+static void
+log_vwrite(int level, const char* file, int line, time_t t, const char* fmt, va_list fmt_args)
 {
-    if (level < L.level)
-    {
-        return;
-    }
-
-    /* Acquire lock */
-    lock();
-
-    /* Get current time */
-    time_t t = time(NULL);
     struct tm* lt = localtime(&t);
 
     /* Log to stderr */
@@ -108,7 +128,7 @@ void log_log(int level, const char* file, int line, const char* fmt, ...)
 #else
         fprintf(stderr, "%s %-5s %s:%d: ", buf, level_names[level], file, line);
 #endif
-        va_start(args, fmt);
+        va_copy(args, fmt_args);
         vfprintf(stderr, fmt, args);
         va_end(args);
 #ifdef LOG_USE_COLOR
@@ -125,12 +145,205 @@ void log_log(int level, const char* file, int line, const char* fmt, ...)
         char buf[32];
         buf[strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", lt)] = '\0';
         fprintf(L.fp, "%s %-5s %s:%d: ", buf, level_names[level], file, line);
-        va_start(args, fmt);
+        va_copy(args, fmt_args);
         vfprintf(L.fp, fmt, args);
         va_end(args);
         fprintf(L.fp, "\n");
         fflush(L.fp);
     }
+}
+
+static void log_write(int level, const char* file, int line, time_t t, const char* fmt, ...)
+{
+    va_list args;
+    va_start(args, fmt);
+    log_vwrite(level, file, line, t, fmt, args);
+    va_end(args);
+}
+
+/* Format a message in the next free slot, return 0 if the ring was full. */
+static int log_push(int level, const char* file, int line, const char* fmt, va_list args)
+{
+    uint64_t pos = atomic_load_explicit(&A.head, memory_order_relaxed);
+    LogRecord* rec = NULL;
+    for (;;)
+    {
+        rec = &A.records[pos & (LOG_ASYNC_CAPACITY - 1)];
+        uint64_t seq = atomic_load_explicit(&rec->seq, memory_order_acquire);
+        int64_t dif = (int64_t)(seq - pos);
+        if (dif == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(
+                    &A.head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (dif < 0)
+        {
+            atomic_fetch_add(&A.dropped, 1);
+            return 0;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&A.head, memory_order_relaxed);
+        }
+    }
+
+    rec->level = level;
+    rec->file = file;
+    rec->line = line;
+    rec->time = time(NULL);
+    vsnprintf(rec->message, LOG_MESSAGE_SIZE, fmt, args);
+    atomic_store(&rec->seq, pos + 1);
+
+    /* Wake up the consumer if it was waiting for this record. */
+    if (atomic_load(&A.tail) == pos)
+    {
+        pthread_mutex_lock(&A.mutex);
+        pthread_cond_signal(&A.ready);
+        pthread_mutex_unlock(&A.mutex);
+    }
+    return 1;
+}
+
+/* Whether the next record to be written has been published. */
+static bool log_ready(void)
+{
+    uint64_t pos = atomic_load(&A.tail);
+    return atomic_load(&A.records[pos & (LOG_ASYNC_CAPACITY - 1)].seq) == pos + 1;
+}
+
+/* Write the next record if it has been published, return 0 if there was none. There must be a
+ * single consumer at a time. */
+static int log_pop(void)
+{
+    uint64_t pos = atomic_load(&A.tail);
+    LogRecord* rec = &A.records[pos & (LOG_ASYNC_CAPACITY - 1)];
+    if (atomic_load_explicit(&rec->seq, memory_order_acquire) != pos + 1)
+        return 0;
+
+    lock();
+    log_write(rec->level, rec->file, rec->line, rec->time, "%s", rec->message);
+    unlock();
+
+    atomic_store_explicit(&rec->seq, pos + LOG_ASYNC_CAPACITY, memory_order_release);
+    atomic_store(&A.tail, pos + 1);
+    return 1;
+}
+
+/* The consumer writes the published records, and waits on a condition variable when the ring is
+ * empty. The readiness is checked with the mutex held, so that a producer publishing a record and
+ * signaling afterwards cannot be missed. */
+static void* log_consumer(void* user_data)
+{
+    (void)user_data;
+    pthread_mutex_lock(&A.mutex);
+    while (atomic_load(&A.running))
+    {
+        pthread_mutex_unlock(&A.mutex);
+        while (log_pop())
+            ;
+        pthread_mutex_lock(&A.mutex);
+        pthread_cond_broadcast(&A.drained);
+        while (atomic_load(&A.running) && !log_ready())
+            pthread_cond_wait(&A.ready, &A.mutex);
+    }
+    pthread_mutex_unlock(&A.mutex);
+    while (log_pop())
+        ;
+    return NULL;
+}
+
+static void log_async_exit(void) { log_set_async(0); }
+
+void log_set_async(int enable)
+{
+    if (!A.initialized)
+    {
+        for (uint64_t i = 0; i < LOG_ASYNC_CAPACITY; i++)
+            atomic_init(&A.records[i].seq, i);
+        atomic_init(&A.head, 0);
+        atomic_init(&A.tail, 0);
+        atomic_init(&A.dropped, 0);
+        atomic_init(&A.running, false);
+        pthread_mutex_init(&A.mutex, NULL);
+        pthread_cond_init(&A.ready, NULL);
+        pthread_cond_init(&A.drained, NULL);
+        A.initialized = true;
+        atexit(log_async_exit);
+    }
+
+    if (enable && !atomic_load(&A.running))
+    {
+        atomic_store(&A.running, true);
+        A.thread = dvz_thread(log_consumer, NULL);
+    }
+    else if (!enable && atomic_load(&A.running))
+    {
+        pthread_mutex_lock(&A.mutex);
+        atomic_store(&A.running, false);
+        pthread_cond_signal(&A.ready);
+        pthread_cond_broadcast(&A.drained);
+        pthread_mutex_unlock(&A.mutex);
+        dvz_thread_join(&A.thread);
+        /* Records published while the consumer was stopping. */
+        while (log_pop())
+            ;
+    }
+}
+
+void log_flush(void)
+{
+    if (!A.initialized)
+        return;
+    if (!atomic_load(&A.running))
+    {
+        while (log_pop())
+            ;
+        return;
+    }
+    uint64_t head = atomic_load(&A.head);
+    pthread_mutex_lock(&A.mutex);
+    while (atomic_load(&A.tail) < head && atomic_load(&A.running))
+        pthread_cond_wait(&A.drained, &A.mutex);
+    pthread_mutex_unlock(&A.mutex);
+}
+
+log_Stats log_stats(void)
+{
+    log_Stats stats = {0};
+    if (!A.initialized)
+        return stats;
+    stats.logged = atomic_load(&A.head);
+    stats.dropped = atomic_load(&A.dropped);
+    return stats;
+}
+
+void log_log(int level, const char* file, int line, const char* fmt, ...)
+{
+    if (level < log_level_current)
+    {
+        return;
+    }
+
+    /* Asynchronous mode: the background thread formats the record and writes it */
+    if (atomic_load(&A.running))
+    {
+        va_list args;
+        va_start(args, fmt);
+        log_push(level, file, line, fmt, args);
+        va_end(args);
+        if (level >= LOG_ERROR)
+            log_flush();
+        return;
+    }
+
+    /* Acquire lock */
+    lock();
+
+    va_list args;
+    va_start(args, fmt);
+    log_vwrite(level, file, line, time(NULL), fmt, args);
+    va_end(args);
 
     /* Release lock */
     unlock();
@@ -143,4 +356,8 @@ void log_set_level_env(void)
     if (level != NULL)
         level_int = strtol(level, NULL, 10);
     log_set_level(level_int);
+
+    const char* async = getenv("DVZ_LOG_ASYNC");
+    if (async != NULL && strtol(async, NULL, 10) != 0)
+        log_set_async(1);
 }
@@ -1,5 +1,7 @@
 #include "../include/datoviz/mesh.h"
 #include "../include/datoviz/common.h"
+#include "mesh_simplify.h"
+#include "mesh_utils.h"
 
 
 
@@ -86,12 +88,18 @@ void dvz_mesh_rotate(DvzMesh* mesh, float angle, vec3 axis)
 void dvz_mesh_transform(DvzMesh* mesh)
 {
     ASSERT(mesh != NULL);
+
+    // Normal matrix, computed once for all vertices.
+    mat4 tr;
+    glm_mat4_inv(mesh->transform, tr);
+    glm_mat4_transpose(tr);
+
     DvzGraphicsMeshVertex* vertex = NULL;
     for (uint32_t i = 0; i < mesh->vertices.item_count; i++)
     {
         vertex = dvz_array_item(&mesh->vertices, i);
         transform_pos(mesh, vertex->pos);
-        transform_normal(mesh, vertex->normal);
+        glm_mat4_mulv3(tr, vertex->normal, 1, vertex->normal);
     }
 }
 
@@ -150,42 +158,41 @@ void dvz_mesh_normals(DvzMesh* mesh)
     ASSERT(mesh != NULL);
     log_debug("recompute mesh normals");
 
-    DvzIndex i0, i1, i2;
-    DvzGraphicsMeshVertex *v0, *v1, *v2;
-    vec3 u, v, n;
-
     uint32_t vertex_count = mesh->vertices.item_count;
     uint32_t face_count = mesh->indices.item_count / 3;
-
-    // Go through all triangle faces.
-    for (uint32_t i = 0; i < face_count; i++)
+    if (vertex_count == 0)
+        return;
+
+    DvzMeshChunk faces[DVZ_MESH_MAX_THREADS] = {0};
+    DvzMeshChunk verts[DVZ_MESH_MAX_THREADS] = {0};
+    uint32_t n_threads = _mesh_threads(MAX(face_count, vertex_count));
+
+    // Face normals accumulated by every thread in the window of its vertices.
+    uint32_t n_faces = _mesh_chunks(face_count, n_threads, faces);
+    for (uint32_t t = 0; t < n_faces; t++)
+        faces[t].mesh = mesh;
+    dvz_parallel(n_faces, faces, sizeof(DvzMeshChunk), 0, _mesh_chunk);
+
+    // Sum of the face normals of every vertex, normalized.
+    uint32_t n_verts = _mesh_chunks(vertex_count, n_threads, verts);
+    for (uint32_t t = 0; t < n_verts; t++)
     {
-        i0 = ((DvzIndex*)mesh->indices.data)[3 * i + 0];
-        i1 = ((DvzIndex*)mesh->indices.data)[3 * i + 1];
-        i2 = ((DvzIndex*)mesh->indices.data)[3 * i + 2];
-
-        v0 = &((DvzGraphicsMeshVertex*)mesh->vertices.data)[i0];
-        v1 = &((DvzGraphicsMeshVertex*)mesh->vertices.data)[i1];
-        v2 = &((DvzGraphicsMeshVertex*)mesh->vertices.data)[i2];
-
-        glm_vec3_sub(v1->pos, v0->pos, u);
-        glm_vec3_sub(v2->pos, v0->pos, v);
-        // n is the normalized vector orthogonal to the current face
-        glm_vec3_crossn(u, v, n);
-
-        // Add the face normal to the current vertex normal.
-        glm_vec3_add(v0->normal, n, v0->normal);
-        glm_vec3_add(v1->normal, n, v1->normal);
-        glm_vec3_add(v2->normal, n, v2->normal);
+        verts[t].mesh = mesh;
+        verts[t].chunks = faces;
+        verts[t].chunk_count = n_faces;
     }
+    dvz_parallel(n_verts, verts, sizeof(DvzMeshChunk), 1, _mesh_chunk);
 
-    // Normalize all normals since every vertex might contain the sum of many normals.
-    vec3* normal = NULL;
-    for (uint32_t i = 0; i < vertex_count; i++)
-    {
-        normal = &((DvzGraphicsMeshVertex*)dvz_array_item(&mesh->vertices, i))->normal;
-        glm_vec3_normalize(*normal);
-    }
+    for (uint32_t t = 0; t < n_faces; t++)
+        FREE(faces[t].acc);
+}
+
+
+
+DvzMeshLod dvz_mesh_lod(DvzMesh* mesh, uint32_t level_count, float ratio)
+{
+    ASSERT(mesh != NULL);
+    return _mesh_simplify(mesh, level_count, ratio, NULL);
 }
 
 
@@ -208,6 +215,9 @@ DvzMesh dvz_mesh()
 DvzMesh
 dvz_mesh_grid(uint32_t row_count, uint32_t col_count, const vec3* positions, const vec2* texcoords)
 {
+    ASSERT(row_count > 0);
+    ASSERT(col_count > 0);
+
     DvzMesh mesh = dvz_mesh();
     const uint32_t nv = col_count * row_count;
     // 2 triangles = 6 vertices per point:
@@ -216,89 +226,19 @@ dvz_mesh_grid(uint32_t row_count, uint32_t col_count, const vec3* positions, con
     dvz_array_resize(&mesh.vertices, nv);
     dvz_array_resize(&mesh.indices, ni);
 
-    // Get vertices and indices pointers into the mesh arrays.
-    vec3 cur, next_j, next_i, u, v;
-    DvzGraphicsMeshVertex* vertices = (DvzGraphicsMeshVertex*)mesh.vertices.data;
-    DvzGraphicsMeshVertex* vertex = (DvzGraphicsMeshVertex*)mesh.vertices.data;
-    DvzIndex* index = (DvzIndex*)mesh.indices.data;
-    vec2 uv = {0};
-    uint32_t point_idx = 0;
-    uint32_t first_vertex = 0;
-    for (uint32_t i = 0; i < row_count; i++)
+    // Vertices, normals, and faces of the rows, in a single pass. The mesh transform is the
+    // identity at this point, so that the positions and normals are final.
+    DvzMeshChunk chunks[DVZ_MESH_MAX_THREADS] = {0};
+    uint32_t n_threads = _mesh_chunks(row_count, _mesh_threads(nv), chunks);
+    for (uint32_t t = 0; t < n_threads; t++)
     {
-        for (uint32_t j = 0; j < col_count; j++)
-        {
-            ASSERT(point_idx == col_count * i + j);
-
-            // Position.
-            ASSERT(point_idx < nv);
-            _vec3_copy(positions[point_idx], vertex->pos);
-
-            // Texture coordinates.
-            if (texcoords == NULL)
-            {
-                uv[1] = i / (float)(row_count - 1);
-                uv[0] = j / (float)(col_count - 1);
-            }
-            else
-            {
-                uv[0] = texcoords[i][0];
-                uv[1] = texcoords[i][1];
-            }
-            _vec3_copy(uv, vertex->uv);
-
-            // Alpha channel.
-            vertex->alpha = 255;
-
-            // Normals.
-            _vec3_copy(positions[point_idx], cur);
-            _vec3_copy(positions[col_count * i + (j + 1) % col_count], next_j);
-            _vec3_copy(positions[col_count * ((i + 1) % row_count) + j], next_i);
-            glm_vec3_sub(next_i, cur, u);
-            glm_vec3_sub(next_j, cur, v);
-            glm_vec3_crossn(u, v, vertex->normal);
-
-            // Normal vector on edges.
-            if (i == row_count - 1)
-            {
-                _vec3_copy(
-                    vertices[first_vertex + col_count * (i - 1) + j].normal, vertex->normal);
-            }
-            else if (j == col_count - 1)
-            {
-                _vec3_copy(vertices[first_vertex + col_count * i + j - 1].normal, vertex->normal);
-            }
-
-            // Vertex topology.
-            if ((i < row_count - 1) && (j < col_count - 1))
-            {
-                memcpy(
-                    index,
-                    (DvzIndex[]){
-                        first_vertex + col_count * (i + 0) + (j + 0),
-                        first_vertex + col_count * (i + 1) + (j + 0),
-                        first_vertex + col_count * (i + 0) + (j + 1),
-                        first_vertex + col_count * (i + 1) + (j + 1),
-                        first_vertex + col_count * (i + 0) + (j + 1),
-                        first_vertex + col_count * (i + 1) + (j + 0),
-                    },
-                    6 * sizeof(DvzIndex));
-                index += 6;
-            }
-
-            // Go to next vertex.
-            point_idx++;
-            vertex++; // remember this is a pointer to the mesh vertices array.
-        }
-    }
-
-    // Second pass for the transformation.
-    for (uint32_t i = 0; i < nv; i++)
-    {
-        vertex = &vertices[first_vertex + i];
-        transform_pos(&mesh, vertex->pos);
-        transform_normal(&mesh, vertex->normal);
+        chunks[t].mesh = &mesh;
+        chunks[t].row_count = row_count;
+        chunks[t].col_count = col_count;
+        chunks[t].positions = positions;
+        chunks[t].texcoords = texcoords;
     }
+    dvz_parallel(n_threads, chunks, sizeof(DvzMeshChunk), 2, _mesh_chunk);
 
     return mesh;
 }
@@ -0,0 +1,162 @@
+/*************************************************************************************************/
+/*  Levels of detail of mesh visuals                                                             */
+/*************************************************************************************************/
+
+/*
+When the levels of detail of a mesh visual are enabled, the original mesh is uploaded right away,
+and a worker thread simplifies a copy of it into a chain of levels that share its vertices (see
+mesh_simplify.h). Once the worker is done, the main thread uploads the index array with all
+levels, one after the other.
+
+At every frame, the geometric error of every level is projected on the screen with the MVP of
+the panel, at the depth of the center of the mesh: one mesh unit covers |proj[1][1]| * h / 2 / z
+pixels in perspective (without the division by z in orthographic projection), times the scaling
+of the model and view matrices. The coarsest level whose projected error is below
+DVZ_MESH_LOD_PIXEL_ERROR is selected, and the fill callback only draws its index range. The
+command buffers are refilled when the selected level changes.
+
+*/
+
+#ifndef DVZ_MESH_LEVELS_HEADER
+#define DVZ_MESH_LEVELS_HEADER
+
+#include "../include/datoviz/visuals.h"
+#include "mesh_simplify.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Worker                                                                                       */
+/*************************************************************************************************/
+
+static void* _mesh_levels_worker(void* user_data)
+{
+    DvzMeshLevels* levels = (DvzMeshLevels*)user_data;
+    ASSERT(levels != NULL);
+    levels->lod = _mesh_simplify(&levels->mesh, levels->level_count, 0, &levels->cancel);
+    atomic_store(&levels->done, true);
+    return NULL;
+}
+
+
+
+// Upload the index array with all levels once the worker is done, return whether it was done.
+static bool _mesh_levels_receive(DvzMeshLevels* levels)
+{
+    ASSERT(levels != NULL);
+    if (levels->ready)
+        return true;
+    if (!atomic_load(&levels->done))
+        return false;
+
+    dvz_thread_join(&levels->worker);
+    uint32_t ni = levels->mesh.indices.item_count;
+    dvz_visual_data_source(
+        levels->visual, DVZ_SOURCE_TYPE_INDEX, 0, 0, ni, ni, levels->mesh.indices.data);
+    log_debug(
+        "upload %d levels of detail of a mesh visual (%d indices)", levels->lod.level_count, ni);
+
+    // The copy of the mesh is no longer needed.
+    dvz_mesh_destroy(&levels->mesh);
+    levels->ready = true;
+    levels->stats.level_count = levels->lod.level_count;
+    return true;
+}
+
+
+
+/*************************************************************************************************/
+/*  Selection                                                                                    */
+/*************************************************************************************************/
+
+// Number of pixels covered by one mesh unit at the center of the mesh, or INFINITY if the camera
+// is inside the bounding sphere of the mesh.
+static float _mesh_levels_scale(DvzMeshLod* lod, DvzMVP* mvp, float height)
+{
+    ASSERT(lod != NULL);
+    ASSERT(mvp != NULL);
+
+    mat4 mv;
+    glm_mat4_mul(mvp->view, mvp->model, mv);
+    float scale = MAX(glm_vec3_norm(mv[0]), MAX(glm_vec3_norm(mv[1]), glm_vec3_norm(mv[2])));
+    vec4 center = {lod->center[0], lod->center[1], lod->center[2], 1};
+    glm_mat4_mulv(mv, center, center);
+
+    float pixels = fabsf(mvp->proj[1][1]) * .5f * height * scale;
+
+    // Perspective projection.
+    if (mvp->proj[2][3] != 0)
+    {
+        float depth = -center[2];
+        if (depth <= lod->radius * scale)
+            return INFINITY;
+        pixels /= depth;
+    }
+    return pixels;
+}
+
+
+
+// Select the level to draw, return whether the command buffers must be refilled.
+static bool _mesh_levels_update(DvzMeshLevels* levels, DvzMVP* mvp, uvec2 viewport)
+{
+    ASSERT(levels != NULL);
+    ASSERT(mvp != NULL);
+    if (!_mesh_levels_receive(levels))
+        return false;
+
+    DvzMeshLod* lod = &levels->lod;
+    DvzMeshLevelStats* stats = &levels->stats;
+    float pixels = _mesh_levels_scale(lod, mvp, viewport[1]);
+
+    // Coarsest level whose projected error is below the threshold.
+    uint32_t level = 0;
+    for (uint32_t l = lod->level_count - 1; l > 0; l--)
+    {
+        if (lod->error[l] * pixels <= DVZ_MESH_LOD_PIXEL_ERROR)
+        {
+            level = l;
+            break;
+        }
+    }
+
+    stats->level = level;
+    stats->face_count = lod->index_count[level] / 3;
+    stats->pixel_radius = lod->radius * pixels;
+    stats->pixel_error = lod->error[level] > 0 ? lod->error[level] * pixels : 0;
+
+    bool changed = level != levels->level || levels->index_count == 0;
+    if (level != levels->level)
+        stats->switches++;
+    levels->level = level;
+    levels->first_index = lod->first_index[level];
+    levels->index_count = lod->index_count[level];
+    return changed;
+}
+
+
+
+static void _mesh_levels_destroy(DvzMeshLevels* levels)
+{
+    ASSERT(levels != NULL);
+
+    // Interrupt the simplification if it is still running.
+    if (!levels->ready)
+    {
+        atomic_store(&levels->cancel, true);
+        dvz_thread_join(&levels->worker);
+    }
+    dvz_mesh_destroy(&levels->mesh);
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
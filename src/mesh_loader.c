@@ -0,0 +1,269 @@
+#include <sys/stat.h>
+
+#include "../include/datoviz/mesh.h"
+#include "mesh_loader.h"
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+// Size and modification time of a file, in nanoseconds, return 0 on success. The modification
+// time has a one second resolution on the platforms without nanosecond timestamps in stat.
+static int _file_stat(const char* file_path, uint64_t* size, int64_t* mtime)
+{
+    ASSERT(file_path != NULL);
+    struct stat st;
+    if (stat(file_path, &st) != 0)
+        return 1;
+    *size = (uint64_t)st.st_size;
+    // NOTE: st_mtime is a macro aliasing the seconds of the timespec when it exists.
+#if OS_MACOS && defined(st_mtime)
+    *mtime = (int64_t)st.st_mtimespec.tv_sec * 1000000000 + (int64_t)st.st_mtimespec.tv_nsec;
+#elif defined(st_mtime)
+    *mtime = (int64_t)st.st_mtim.tv_sec * 1000000000 + (int64_t)st.st_mtim.tv_nsec;
+#else
+    *mtime = (int64_t)st.st_mtime * 1000000000;
+#endif
+    return 0;
+}
+
+
+
+// Whether a header describes a valid mesh file of the given size.
+static bool _mesh_header_valid(DvzMeshFileHeader* header, uint64_t size)
+{
+    ASSERT(header != NULL);
+    return memcmp(header->magic, DVZ_MESH_FILE_MAGIC, sizeof(DVZ_MESH_FILE_MAGIC)) == 0 &&
+           header->version == DVZ_MESH_FILE_VERSION &&
+           header->vertex_size == sizeof(DvzGraphicsMeshVertex) &&
+           header->index_size == sizeof(DvzIndex) && header->vertex_count <= UINT32_MAX &&
+           header->index_count <= UINT32_MAX &&
+           sizeof(DvzMeshFileHeader) + header->vertex_count * header->vertex_size +
+                   header->index_count * header->index_size ==
+               size;
+}
+
+
+
+// Read the header of a mesh file, return 0 if it is valid.
+static int _mesh_read_header(const char* file_path, DvzMeshFileHeader* header)
+{
+    ASSERT(file_path != NULL);
+    ASSERT(header != NULL);
+
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    if (_file_stat(file_path, &size, &mtime) != 0)
+        return 1;
+    FILE* f = fopen(file_path, "rb");
+    if (f == NULL)
+        return 1;
+    size_t n = fread(header, sizeof(DvzMeshFileHeader), 1, f);
+    fclose(f);
+    return n == 1 && _mesh_header_valid(header, size) ? 0 : 1;
+}
+
+
+
+// Write a mesh file to a temporary file, then move it to its final path, so that a partially
+// written file is never read.
+static int _mesh_write(DvzMesh* mesh, const char* file_path, DvzMeshFileHeader* header)
+{
+    ASSERT(mesh != NULL);
+    ASSERT(file_path != NULL);
+    ASSERT(header != NULL);
+
+    memcpy(header->magic, DVZ_MESH_FILE_MAGIC, sizeof(DVZ_MESH_FILE_MAGIC));
+    header->version = DVZ_MESH_FILE_VERSION;
+    header->vertex_size = sizeof(DvzGraphicsMeshVertex);
+    header->index_size = sizeof(DvzIndex);
+    header->vertex_count = mesh->vertices.item_count;
+    header->index_count = mesh->indices.item_count;
+    ASSERT(mesh->vertices.item_size == sizeof(DvzGraphicsMeshVertex));
+    ASSERT(mesh->indices.item_size == sizeof(DvzIndex));
+
+    char tmp_path[1024];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", file_path);
+    FILE* f = fopen(tmp_path, "wb");
+    if (f == NULL)
+        return 1;
+    bool ok = fwrite(header, sizeof(DvzMeshFileHeader), 1, f) == 1;
+    if (header->vertex_count > 0)
+        ok &= fwrite(
+                  mesh->vertices.data, sizeof(DvzGraphicsMeshVertex), header->vertex_count, f) ==
+              header->vertex_count;
+    if (header->index_count > 0)
+        ok &= fwrite(mesh->indices.data, sizeof(DvzIndex), header->index_count, f) ==
+              header->index_count;
+    ok &= fclose(f) == 0;
+#if OS_WIN32
+    remove(file_path);
+#endif
+    if (!ok || rename(tmp_path, file_path) != 0)
+    {
+        remove(tmp_path);
+        return 1;
+    }
+    log_debug(
+        "wrote mesh file %s (%s)", file_path,
+        pretty_size(sizeof(DvzMeshFileHeader) + mesh->vertices.buffer_size +
+                    mesh->indices.buffer_size));
+    return 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  Binary mesh files                                                                            */
+/*************************************************************************************************/
+
+int dvz_mesh_save(DvzMesh* mesh, const char* file_path)
+{
+    ASSERT(mesh != NULL);
+    ASSERT(file_path != NULL);
+    DvzMeshFileHeader header = {0};
+    if (_mesh_write(mesh, file_path, &header) != 0)
+    {
+        log_error("could not write the mesh file %s", file_path);
+        return 1;
+    }
+    return 0;
+}
+
+
+
+DvzMesh dvz_mesh_load(const char* file_path)
+{
+    ASSERT(file_path != NULL);
+    DvzMesh mesh = dvz_mesh();
+
+    size_t size = 0;
+    void* vertices = dvz_file_map(file_path, &size);
+    if (vertices == NULL)
+        return mesh;
+    DvzMeshFileHeader header = {0};
+    if (size < sizeof(DvzMeshFileHeader))
+        goto error;
+    memcpy(&header, vertices, sizeof(DvzMeshFileHeader));
+    if (!_mesh_header_valid(&header, size))
+        goto error;
+
+    // The vertex and index arrays wrap two mappings of the file, as each array unmaps its own
+    // mapping when it is destroyed.
+    size_t size_indices = 0;
+    void* indices = dvz_file_map(file_path, &size_indices);
+    if (indices == NULL || size_indices != size)
+    {
+        dvz_file_unmap(indices, size_indices);
+        goto error;
+    }
+
+    dvz_array_destroy(&mesh.vertices);
+    dvz_array_destroy(&mesh.indices);
+    size_t offset = sizeof(DvzMeshFileHeader);
+    mesh.vertices = _mesh_array_mapped(
+        vertices, size, offset, header.vertex_count, sizeof(DvzGraphicsMeshVertex));
+    offset += header.vertex_count * sizeof(DvzGraphicsMeshVertex);
+    mesh.indices =
+        _mesh_array_mapped(indices, size, offset, header.index_count, sizeof(DvzIndex));
+    log_debug(
+        "loaded mesh file %s with %d vertices and %d indices", file_path,
+        mesh.vertices.item_count, mesh.indices.item_count);
+    return mesh;
+
+error:
+    log_error("invalid mesh file %s", file_path);
+    dvz_file_unmap(vertices, size);
+    return mesh;
+}
+
+
+
+/*************************************************************************************************/
+/*  OBJ files                                                                                    */
+/*************************************************************************************************/
+
+// Load the cache of an OBJ file if it is valid, otherwise return an empty mesh.
+static DvzMesh
+_mesh_obj_cached(const char* cache_path, const char* file_path, DvzMeshFileHeader* source)
+{
+    ASSERT(cache_path != NULL);
+    ASSERT(file_path != NULL);
+    ASSERT(source != NULL);
+
+    DvzMeshFileHeader header = {0};
+    if (_mesh_read_header(cache_path, &header) != 0 || header.source_size != source->source_size)
+        return dvz_mesh();
+
+    // The OBJ file has been touched or copied: check its contents.
+    if (header.source_mtime != source->source_mtime)
+    {
+        size_t size = 0;
+        void* data = dvz_file_map(file_path, &size);
+        if (data == NULL)
+            return dvz_mesh();
+        source->source_hash = _mesh_file_hash(data, size);
+        dvz_file_unmap(data, size);
+        if (source->source_hash != header.source_hash)
+            return dvz_mesh();
+
+        // Same contents: update the modification time in the cache, to skip the hash next time.
+        header.source_mtime = source->source_mtime;
+        FILE* f = fopen(cache_path, "r+b");
+        if (f != NULL)
+        {
+            fwrite(&header, sizeof(DvzMeshFileHeader), 1, f);
+            fclose(f);
+        }
+    }
+
+    log_debug("loading the cached mesh %s", cache_path);
+    return dvz_mesh_load(cache_path);
+}
+
+
+
+DvzMesh dvz_mesh_obj(const char* file_path)
+{
+    ASSERT(file_path != NULL);
+    log_trace("loading file %s", file_path);
+
+    DvzMeshFileHeader source = {0};
+    if (_file_stat(file_path, &source.source_size, &source.source_mtime) != 0)
+    {
+        log_error("could not open obj file %s", file_path);
+        return dvz_mesh();
+    }
+
+    // Binary cache of the OBJ file, next to it.
+    char cache_path[1024];
+    _mesh_cache_path(file_path, cache_path, sizeof(cache_path));
+    DvzMesh mesh = _mesh_obj_cached(cache_path, file_path, &source);
+    if (mesh.vertices.item_count > 0)
+        return mesh;
+
+    // Parse the OBJ file in parallel.
+    size_t size = 0;
+    char* data = (char*)dvz_file_map(file_path, &size);
+    if (data == NULL)
+        return mesh;
+    if (_obj_parse(data, size, &mesh) != 0)
+    {
+        log_error("error loading obj file %s", file_path);
+        dvz_file_unmap(data, size);
+        dvz_mesh_destroy(&mesh);
+        return dvz_mesh();
+    }
+    source.source_hash = _mesh_file_hash(data, size);
+    dvz_file_unmap(data, size);
+
+    // Mesh normalization.
+    dvz_mesh_normalize(&mesh);
+
+    // The conversion is done once, the next loads map the cache.
+    if (_mesh_write(&mesh, cache_path, &source) != 0)
+        log_warn("could not write the mesh cache %s", cache_path);
+    return mesh;
+}
@@ -0,0 +1,503 @@
+/*************************************************************************************************/
+/*  Mesh files: binary mesh format and parallel OBJ parser                                       */
+/*************************************************************************************************/
+
+/*
+Binary mesh format: a DvzMeshFileHeader, followed by the vertices as an array of
+DvzGraphicsMeshVertex and by the indices as an array of DvzIndex, in the native byte order. The
+file is memory-mapped and its vertex and index arrays can be uploaded to the GPU as they are.
+
+When it is the cache of an OBJ file, the header also holds the size, modification time, and hash
+of the OBJ file. The cache is valid if the size and modification time match, or, when only the
+modification time differs (for example after a copy), if the hash of the OBJ file matches. The
+hash combines the hashes of fixed-size blocks of the file, computed in parallel, so that it does
+not depend on the number of threads.
+
+OBJ parser: the memory-mapped OBJ file is split into chunks of whole lines, one per thread. In a
+first pass, every thread counts the vertices, normals, texture coordinates, and triangles of its
+chunk. A prefix sum over the chunks gives the index of the first item of every chunk, so that in
+the second pass every thread parses its chunk directly into the final vertex and index arrays,
+and resolves the relative (negative) face indices. Polygonal faces are triangulated as fans.
+
+*/
+
+#ifndef DVZ_MESH_LOADER_HEADER
+#define DVZ_MESH_LOADER_HEADER
+
+#include "../include/datoviz/colormaps.h"
+#include "../include/datoviz/common.h"
+#include "../include/datoviz/mesh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Constants                                                                                    */
+/*************************************************************************************************/
+
+#define DVZ_MESH_FILE_MAGIC      "DVZMESH"
+#define DVZ_MESH_FILE_VERSION    1
+#define DVZ_MESH_HASH_BLOCK      (4 * 1024 * 1024) // size of the blocks hashed in parallel
+#define DVZ_MESH_HASH_PRIME      0x9E3779B97F4A7C15ull
+#define DVZ_MESH_OBJ_MIN_CHUNK   (1024 * 1024) // minimum number of bytes per thread when parsing
+#define DVZ_MESH_CACHE_EXTENSION ".dvzmesh"
+
+
+
+/*************************************************************************************************/
+/*  Structs                                                                                      */
+/*************************************************************************************************/
+
+typedef struct DvzMeshFileHeader DvzMeshFileHeader;
+typedef struct DvzObjChunk DvzObjChunk;
+
+struct DvzMeshFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t vertex_size; // sizeof(DvzGraphicsMeshVertex)
+    uint32_t index_size;  // sizeof(DvzIndex)
+    uint32_t reserved;
+    uint64_t vertex_count;
+    uint64_t index_count;
+
+    // OBJ file the mesh was converted from, if any.
+    uint64_t source_size;
+    int64_t source_mtime; // modification time, in nanoseconds
+    uint64_t source_hash;
+};
+
+
+
+struct DvzObjChunk
+{
+    const char* begin;
+    const char* end;
+
+    // Number of items in the chunk (phase 0), then index of the first item (phase 1).
+    uint64_t v, vn, vt, tri;
+
+    // Output arrays, shared by all chunks.
+    DvzGraphicsMeshVertex* vertices;
+    uint32_t vertex_count;
+    DvzIndex* indices;
+    bool colors; // pack the vertex colors into the texture coordinates
+    uint64_t error_line;
+
+    // Hash of the blocks b0 to b1 of the file.
+    uint64_t* hashes;
+    uint64_t b0, b1;
+};
+
+
+
+/*************************************************************************************************/
+/*  Hash                                                                                         */
+/*************************************************************************************************/
+
+static inline uint64_t _mesh_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+
+
+// Non-cryptographic 64-bit hash of a buffer, 8 bytes at a time.
+static uint64_t _mesh_hash(const void* data, size_t size, uint64_t seed)
+{
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t h = seed ^ (size * DVZ_MESH_HASH_PRIME);
+    uint64_t w = 0;
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8)
+    {
+        memcpy(&w, bytes + i, 8);
+        h = (h ^ _mesh_mix(w)) * DVZ_MESH_HASH_PRIME;
+    }
+    w = 0;
+    memcpy(&w, bytes + i, size - i);
+    h = (h ^ _mesh_mix(w)) * DVZ_MESH_HASH_PRIME;
+    return _mesh_mix(h);
+}
+
+
+
+/*************************************************************************************************/
+/*  OBJ parsing                                                                                  */
+/*************************************************************************************************/
+
+static inline const char* _obj_skip_spaces(const char* c, const char* end)
+{
+    while (c < end && (*c == ' ' || *c == '\t'))
+        c++;
+    return c;
+}
+
+
+
+static inline const char* _obj_skip_line(const char* c, const char* end)
+{
+    const char* n = (const char*)memchr(c, '\n', (size_t)(end - c));
+    return n != NULL ? n + 1 : end;
+}
+
+
+
+static inline bool _obj_is_digit(char c) { return c >= '0' && c <= '9'; }
+
+
+
+// Parse a decimal number, return NULL if there is none.
+static const char* _obj_float(const char* c, const char* end, float* out)
+{
+    static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                                   1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                                   1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+    c = _obj_skip_spaces(c, end);
+    double sign = 1, mantissa = 0;
+    int32_t exponent = 0, e = 0, e_sign = 1;
+    bool digits = false;
+    if (c < end && (*c == '-' || *c == '+'))
+        sign = *c++ == '-' ? -1 : 1;
+    for (; c < end && _obj_is_digit(*c); c++, digits = true)
+        mantissa = 10 * mantissa + (*c - '0');
+    if (c < end && *c == '.')
+        for (c++; c < end && _obj_is_digit(*c); c++, digits = true, exponent--)
+            mantissa = 10 * mantissa + (*c - '0');
+    if (!digits)
+        return NULL;
+    if (c < end && (*c == 'e' || *c == 'E'))
+    {
+        c++;
+        if (c < end && (*c == '-' || *c == '+'))
+            e_sign = *c++ == '-' ? -1 : 1;
+        for (; c < end && _obj_is_digit(*c); c++)
+            e = MIN(10 * e + (*c - '0'), 1000);
+        exponent += e_sign * e;
+    }
+    if (exponent >= 0)
+        mantissa *= exponent <= 22 ? POW10[exponent] : pow(10, exponent);
+    else
+        mantissa /= -exponent <= 22 ? POW10[-exponent] : pow(10, -exponent);
+    *out = (float)(sign * mantissa);
+    return c;
+}
+
+
+
+// Parse the vertex index of a face vertex (v, v/vt, v//vn, or v/vt/vn), return NULL if there is
+// none.
+static const char* _obj_face_index(const char* c, const char* end, int64_t* out)
+{
+    c = _obj_skip_spaces(c, end);
+    int64_t sign = 1, value = 0;
+    bool digits = false;
+    if (c < end && *c == '-')
+    {
+        sign = -1;
+        c++;
+    }
+    for (; c < end && _obj_is_digit(*c); c++, digits = true)
+        value = 10 * value + (*c - '0');
+    if (!digits)
+        return NULL;
+    // Skip the texture coordinate and normal indices.
+    while (c < end && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n')
+        c++;
+    *out = sign * value;
+    return c;
+}
+
+
+
+// Count or parse the lines of a chunk.
+static void _obj_chunk(DvzObjChunk* chunk, bool parse)
+{
+    ASSERT(chunk != NULL);
+    const char* end = chunk->end;
+    const char* c = chunk->begin;
+    const char* next = NULL;
+    uint64_t v = chunk->v, vn = chunk->vn, vt = chunk->vt, tri = chunk->tri;
+    uint64_t line = 0;
+
+    DvzGraphicsMeshVertex* vertex = NULL;
+    float x[6] = {0};
+    uint32_t n = 0;
+    int64_t idx = 0;
+    DvzIndex first = 0, prev = 0, cur = 0;
+    cvec3 color = {0};
+    for (; c < end; c = next, line++)
+    {
+        next = _obj_skip_line(c, end);
+        c = _obj_skip_spaces(c, next);
+        if (next - c < 2 || c[0] == '#')
+            continue;
+
+        // Vertex position, and optional color.
+        if (c[0] == 'v' && (c[1] == ' ' || c[1] == '\t'))
+        {
+            if (parse && v < chunk->vertex_count)
+            {
+                vertex = &chunk->vertices[v];
+                c += 1;
+                for (n = 0; n < 6 && (c = _obj_float(c, next, &x[n])) != NULL; n++)
+                    ;
+                memcpy(vertex->pos, x, sizeof(vec3));
+                vertex->alpha = 255;
+                if (n == 6 && chunk->colors)
+                {
+                    color[0] = TO_BYTE(x[3]);
+                    color[1] = TO_BYTE(x[4]);
+                    color[2] = TO_BYTE(x[5]);
+                    dvz_colormap_packuv(color, vertex->uv);
+                }
+            }
+            v++;
+        }
+
+        // Vertex normal, with the same index as the vertex.
+        else if (c[0] == 'v' && c[1] == 'n')
+        {
+            if (parse && vn < chunk->vertex_count)
+            {
+                c += 2;
+                for (n = 0; n < 3 && (c = _obj_float(c, next, &x[n])) != NULL; n++)
+                    ;
+                memcpy(chunk->vertices[vn].normal, x, sizeof(vec3));
+            }
+            vn++;
+        }
+
+        // Texture coordinates, with the same index as the vertex.
+        else if (c[0] == 'v' && c[1] == 't')
+        {
+            if (parse && vt < chunk->vertex_count)
+            {
+                c += 2;
+                for (n = 0; n < 2 && (c = _obj_float(c, next, &x[n])) != NULL; n++)
+                    ;
+                memcpy(chunk->vertices[vt].uv, x, sizeof(vec2));
+            }
+            vt++;
+        }
+
+        // Face, triangulated as a fan.
+        else if (c[0] == 'f' && (c[1] == ' ' || c[1] == '\t'))
+        {
+            c += 1;
+            for (n = 0; (c = _obj_face_index(c, next, &idx)) != NULL; n++)
+            {
+                if (!parse)
+                    continue;
+                // 1-based indices, or relative to the last vertex defined so far.
+                idx = idx > 0 ? idx - 1 : (int64_t)v + idx;
+                if (idx < 0 || idx >= (int64_t)chunk->vertex_count)
+                {
+                    if (chunk->error_line == 0)
+                        chunk->error_line = line + 1;
+                    idx = 0;
+                }
+                cur = (DvzIndex)idx;
+                if (n == 0)
+                    first = cur;
+                if (n >= 2)
+                {
+                    chunk->indices[3 * tri + 0] = first;
+                    chunk->indices[3 * tri + 1] = prev;
+                    chunk->indices[3 * tri + 2] = cur;
+                    tri++;
+                }
+                prev = cur;
+            }
+            if (!parse && n >= 3)
+                tri += n - 2;
+        }
+    }
+
+    if (!parse)
+    {
+        chunk->v = v;
+        chunk->vn = vn;
+        chunk->vt = vt;
+        chunk->tri = tri;
+    }
+}
+
+
+
+/*************************************************************************************************/
+/*  Threads                                                                                      */
+/*************************************************************************************************/
+
+// Phases: 0: count, 1: parse, 2: hash.
+static void _obj_thread(void* item, uint32_t phase)
+{
+    DvzObjChunk* chunk = (DvzObjChunk*)item;
+    ASSERT(chunk != NULL);
+    switch (phase)
+    {
+    case 0:
+        _obj_chunk(chunk, false);
+        break;
+    case 1:
+        _obj_chunk(chunk, true);
+        break;
+    case 2:
+        for (uint64_t b = chunk->b0; b < chunk->b1; b++)
+            chunk->hashes[b] = _mesh_hash(
+                chunk->begin + b * DVZ_MESH_HASH_BLOCK,
+                (size_t)MIN((uint64_t)DVZ_MESH_HASH_BLOCK,
+                            (uint64_t)(chunk->end - chunk->begin) - b * DVZ_MESH_HASH_BLOCK),
+                b);
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+static uint32_t _obj_threads(size_t size)
+{
+    return dvz_parallel_threads(size, DVZ_MESH_OBJ_MIN_CHUNK, DVZ_MESH_MAX_THREADS);
+}
+
+
+
+// Hash of a file in memory, from the hashes of its blocks.
+static uint64_t _mesh_file_hash(const void* data, size_t size)
+{
+    ASSERT(data != NULL);
+    uint64_t n_blocks = MAX(1, (size + DVZ_MESH_HASH_BLOCK - 1) / DVZ_MESH_HASH_BLOCK);
+    uint64_t* hashes = (uint64_t*)calloc(n_blocks, sizeof(uint64_t));
+    uint32_t n_threads = (uint32_t)MIN((uint64_t)_obj_threads(size), n_blocks);
+    uint64_t per_thread = (n_blocks + n_threads - 1) / n_threads;
+    n_threads = (uint32_t)((n_blocks + per_thread - 1) / per_thread);
+
+    DvzObjChunk chunks[DVZ_MESH_MAX_THREADS] = {0};
+    for (uint32_t t = 0; t < n_threads; t++)
+    {
+        chunks[t].begin = (const char*)data;
+        chunks[t].end = (const char*)data + size;
+        chunks[t].hashes = hashes;
+        chunks[t].b0 = t * per_thread;
+        chunks[t].b1 = MIN((t + 1) * per_thread, n_blocks);
+    }
+    dvz_parallel(n_threads, chunks, sizeof(DvzObjChunk), 2, _obj_thread);
+
+    uint64_t hash = _mesh_hash(hashes, n_blocks * sizeof(uint64_t), size);
+    FREE(hashes);
+    return hash;
+}
+
+
+
+// Parse an OBJ file in memory into a mesh, return 0 on success.
+static int _obj_parse(const char* data, size_t size, DvzMesh* mesh)
+{
+    ASSERT(data != NULL);
+    ASSERT(mesh != NULL);
+
+    // Chunks of whole lines.
+    uint32_t n_threads = _obj_threads(size);
+    DvzObjChunk chunks[DVZ_MESH_MAX_THREADS] = {0};
+    const char* end = data + size;
+    const char* c = data;
+    uint32_t count = 0;
+    for (uint32_t t = 0; t < n_threads && c < end; t++)
+    {
+        chunks[count].begin = c;
+        c = t == n_threads - 1 ? end : _obj_skip_line(MIN(c + size / n_threads, end), end);
+        chunks[count].end = c;
+        count++;
+    }
+    if (count == 0)
+        return 1;
+
+    // Count the items of every chunk, and compute the index of the first item of every chunk.
+    dvz_parallel(count, chunks, sizeof(DvzObjChunk), 0, _obj_thread);
+    uint64_t v = 0, vn = 0, vt = 0, tri = 0, tmp = 0;
+    for (uint32_t t = 0; t < count; t++)
+    {
+        tmp = chunks[t].v, chunks[t].v = v, v += tmp;
+        tmp = chunks[t].vn, chunks[t].vn = vn, vn += tmp;
+        tmp = chunks[t].vt, chunks[t].vt = vt, vt += tmp;
+        tmp = chunks[t].tri, chunks[t].tri = tri, tri += tmp;
+    }
+    if (v == 0 || tri == 0 || v > UINT32_MAX || 3 * tri > UINT32_MAX)
+    {
+        log_error("unsupported number of vertices or faces in OBJ file");
+        return 1;
+    }
+    log_debug(
+        "OBJ file with %d vertices, %d normals, %d texture coordinates, %d triangles, parsed "
+        "with %d threads",
+        (uint32_t)v, (uint32_t)vn, (uint32_t)vt, (uint32_t)tri, count);
+    if (vn > 0 && vn != v)
+        log_warn("OBJ file with %d normals for %d vertices", (uint32_t)vn, (uint32_t)v);
+
+    // Parse the chunks directly into the mesh arrays.
+    dvz_array_resize(&mesh->vertices, (uint32_t)v);
+    dvz_array_resize(&mesh->indices, (uint32_t)(3 * tri));
+    for (uint32_t t = 0; t < count; t++)
+    {
+        chunks[t].vertices = (DvzGraphicsMeshVertex*)mesh->vertices.data;
+        chunks[t].vertex_count = (uint32_t)v;
+        chunks[t].indices = (DvzIndex*)mesh->indices.data;
+        chunks[t].colors = vt == 0;
+    }
+    dvz_parallel(count, chunks, sizeof(DvzObjChunk), 1, _obj_thread);
+    for (uint32_t t = 0; t < count; t++)
+    {
+        if (chunks[t].error_line > 0)
+        {
+            log_error("invalid face index in OBJ file (chunk %d, line %d)", t,
+                      (uint32_t)chunks[t].error_line);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+
+/*************************************************************************************************/
+/*  Mesh files                                                                                   */
+/*************************************************************************************************/
+
+// Array wrapping a region of a memory-mapped file, which is unmapped when the array is
+// destroyed.
+static DvzArray
+_mesh_array_mapped(void* mapping, size_t size, size_t offset, uint64_t count, uint32_t item_size)
+{
+    DvzArray arr = dvz_array_struct(0, item_size);
+    arr.item_count = (uint32_t)count;
+    arr.buffer_size = count * item_size;
+    arr.data = (char*)mapping + offset;
+    arr.mapping = mapping;
+    arr.mapping_size = size;
+    return arr;
+}
+
+
+
+static void _mesh_cache_path(const char* file_path, char* out, size_t size)
+{
+    snprintf(out, size, "%s%s", file_path, DVZ_MESH_CACHE_EXTENSION);
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
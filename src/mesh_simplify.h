@@ -0,0 +1,610 @@
+/*************************************************************************************************/
+/*  Mesh simplification with quadric error metrics                                               */
+/*************************************************************************************************/
+
+/*
+Every vertex has a quadric, the area-weighted sum of the squared distances to the planes of its
+faces. The mesh is simplified by half-edge collapses: a vertex is merged into one of its
+neighbours, whose position does not change, so that all levels of detail share the vertex buffer
+of the original mesh and only differ by their indices. The cost of collapsing a into b is the sum
+of the quadrics of a and b evaluated at the position of b, divided by the sum of their weights,
+that is, the mean squared distance of b to the planes of the faces merged into it.
+
+The collapses are done in rounds. In every round, the candidate edges are sorted by cost, and the
+cheapest ones are collapsed unless one of their vertices has been touched by a previous collapse
+of the round, so that the costs and the topology checks of a round remain valid. A collapse is
+rejected if it would create a non-manifold edge (link condition) or flip a face. The vertices on
+the borders, on non-manifold edges, and on the seams (distinct vertices with the same position)
+are never removed, so that the levels have no cracks.
+
+The levels are produced by a single simplification session: every time the number of faces
+reaches the target of the next level, the current indices are appended to the index array. The
+error of a level is the square root of the largest collapse cost so far.
+
+*/
+
+#ifndef DVZ_MESH_SIMPLIFY_HEADER
+#define DVZ_MESH_SIMPLIFY_HEADER
+
+#include "../include/datoviz/common.h"
+#include "../include/datoviz/mesh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Typedefs                                                                                     */
+/*************************************************************************************************/
+
+typedef struct DvzQuadric DvzQuadric;
+typedef struct DvzMeshCollapse DvzMeshCollapse;
+typedef struct DvzMeshSimplify DvzMeshSimplify;
+
+
+
+/*************************************************************************************************/
+/*  Structs                                                                                      */
+/*************************************************************************************************/
+
+struct DvzQuadric
+{
+    double a00, a11, a22, a01, a02, a12; // symmetric matrix
+    double b0, b1, b2;                   // vector
+    double c;                            // constant
+    double w;                            // sum of the face areas
+};
+
+
+
+struct DvzMeshCollapse
+{
+    uint32_t src, dst;
+    float cost;
+};
+
+
+
+struct DvzMeshSimplify
+{
+    uint32_t vertex_count;
+    const DvzGraphicsMeshVertex* vertices;
+
+    // Current faces.
+    uint32_t index_count;
+    DvzIndex* indices;
+
+    // Faces around every vertex.
+    uint32_t* adj_offsets;
+    uint32_t* adj;
+
+    // Vertex state.
+    DvzQuadric* quadrics;
+    uint8_t* locked;
+    uint8_t* touched;
+    uint32_t* remap;
+    uint32_t* marks;
+    uint32_t mark;
+
+    // Candidate collapses of the current round.
+    uint32_t collapse_count;
+    DvzMeshCollapse* collapses;
+    DvzMeshCollapse* collapses_tmp;
+
+    double error; // largest collapse cost so far
+};
+
+
+
+/*************************************************************************************************/
+/*  Quadrics                                                                                     */
+/*************************************************************************************************/
+
+static void _quadric_face(DvzQuadric* q, const vec3 p0, const vec3 p1, const vec3 p2)
+{
+    ASSERT(q != NULL);
+    vec3 u, v, n;
+    glm_vec3_sub((float*)p1, (float*)p0, u);
+    glm_vec3_sub((float*)p2, (float*)p0, v);
+    glm_vec3_cross(u, v, n);
+    double len = glm_vec3_norm(n);
+    memset(q, 0, sizeof(DvzQuadric));
+    if (len == 0)
+        return;
+
+    double a = n[0] / len, b = n[1] / len, c = n[2] / len;
+    double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+    double w = .5 * len;
+    q->a00 = w * a * a;
+    q->a11 = w * b * b;
+    q->a22 = w * c * c;
+    q->a01 = w * a * b;
+    q->a02 = w * a * c;
+    q->a12 = w * b * c;
+    q->b0 = w * a * d;
+    q->b1 = w * b * d;
+    q->b2 = w * c * d;
+    q->c = w * d * d;
+    q->w = w;
+}
+
+
+
+static void _quadric_add(DvzQuadric* q, const DvzQuadric* r)
+{
+    ASSERT(q != NULL);
+    ASSERT(r != NULL);
+    q->a00 += r->a00;
+    q->a11 += r->a11;
+    q->a22 += r->a22;
+    q->a01 += r->a01;
+    q->a02 += r->a02;
+    q->a12 += r->a12;
+    q->b0 += r->b0;
+    q->b1 += r->b1;
+    q->b2 += r->b2;
+    q->c += r->c;
+    q->w += r->w;
+}
+
+
+
+// Weighted sum of the squared distances of a point to the planes of a quadric.
+static double _quadric_eval(const DvzQuadric* q, const vec3 p)
+{
+    ASSERT(q != NULL);
+    double x = p[0], y = p[1], z = p[2];
+    return q->a00 * x * x + q->a11 * y * y + q->a22 * z * z +
+           2 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z) +
+           2 * (q->b0 * x + q->b1 * y + q->b2 * z) + q->c;
+}
+
+
+
+/*************************************************************************************************/
+/*  Topology                                                                                     */
+/*************************************************************************************************/
+
+// Faces around every vertex, in compressed rows.
+static void _simplify_adjacency(DvzMeshSimplify* s)
+{
+    ASSERT(s != NULL);
+    uint32_t nv = s->vertex_count;
+    memset(s->adj_offsets, 0, (nv + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < s->index_count; i++)
+        s->adj_offsets[s->indices[i] + 1]++;
+    for (uint32_t v = 0; v < nv; v++)
+        s->adj_offsets[v + 1] += s->adj_offsets[v];
+
+    // Fill the rows, using the offsets as cursors, and shift them back afterwards.
+    for (uint32_t i = 0; i < s->index_count; i++)
+        s->adj[s->adj_offsets[s->indices[i]]++] = i / 3;
+    for (uint32_t v = nv; v > 0; v--)
+        s->adj_offsets[v] = s->adj_offsets[v - 1];
+    s->adj_offsets[0] = 0;
+}
+
+
+
+static bool _simplify_has_vertex(DvzMeshSimplify* s, uint32_t face, uint32_t v)
+{
+    const DvzIndex* f = &s->indices[3 * face];
+    return f[0] == v || f[1] == v || f[2] == v;
+}
+
+
+
+// Number of faces containing the edge a-b.
+static uint32_t _simplify_edge_faces(DvzMeshSimplify* s, uint32_t a, uint32_t b)
+{
+    uint32_t count = 0;
+    for (uint32_t k = s->adj_offsets[a]; k < s->adj_offsets[a + 1]; k++)
+        count += _simplify_has_vertex(s, s->adj[k], b) ? 1 : 0;
+    return count;
+}
+
+
+
+// Lock the vertices that must never be removed: borders, non-manifold edges, and seams.
+static void _simplify_lock(DvzMeshSimplify* s)
+{
+    ASSERT(s != NULL);
+    uint32_t a = 0, b = 0;
+    for (uint32_t i = 0; i < s->index_count; i++)
+    {
+        a = s->indices[i];
+        b = s->indices[i % 3 == 2 ? i - 2 : i + 1];
+        if (_simplify_edge_faces(s, a, b) != 2)
+        {
+            s->locked[a] = 1;
+            s->locked[b] = 1;
+        }
+    }
+
+    // Seams: vertices sharing their position with another one, found with an open addressing
+    // hash table of the positions.
+    uint32_t nv = s->vertex_count;
+    uint32_t capacity = (uint32_t)dvz_next_pow2(2 * nv);
+    uint32_t mask = capacity - 1;
+    uint32_t* table = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+    memset(table, 0xff, capacity * sizeof(uint32_t));
+    uint32_t bits[3] = {0};
+    uint32_t h = 0, slot = 0;
+    for (uint32_t v = 0; v < nv; v++)
+    {
+        memcpy(bits, s->vertices[v].pos, sizeof(bits));
+        h = (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+        for (slot = h & mask; table[slot] != UINT32_MAX; slot = (slot + 1) & mask)
+        {
+            if (memcmp(s->vertices[table[slot]].pos, s->vertices[v].pos, sizeof(vec3)) == 0)
+            {
+                s->locked[v] = 1;
+                s->locked[table[slot]] = 1;
+                break;
+            }
+        }
+        if (table[slot] == UINT32_MAX)
+            table[slot] = v;
+    }
+    FREE(table);
+}
+
+
+
+// Whether collapsing a into b keeps the mesh manifold: the common neighbours of a and b must be
+// the opposite vertices of the faces of the edge.
+static bool _simplify_link(DvzMeshSimplify* s, uint32_t a, uint32_t b)
+{
+    ASSERT(s != NULL);
+    const DvzIndex* f = NULL;
+    s->mark += 2;
+    for (uint32_t k = s->adj_offsets[a]; k < s->adj_offsets[a + 1]; k++)
+    {
+        f = &s->indices[3 * s->adj[k]];
+        for (uint32_t j = 0; j < 3; j++)
+            s->marks[f[j]] = s->mark;
+    }
+
+    uint32_t common = 0;
+    uint32_t w = 0;
+    for (uint32_t k = s->adj_offsets[b]; k < s->adj_offsets[b + 1]; k++)
+    {
+        f = &s->indices[3 * s->adj[k]];
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            w = f[j];
+            if (w != a && w != b && s->marks[w] == s->mark)
+            {
+                s->marks[w] = s->mark + 1;
+                common++;
+            }
+        }
+    }
+    return common <= _simplify_edge_faces(s, a, b);
+}
+
+
+
+// Whether collapsing a into b flips one of the remaining faces around a.
+static bool _simplify_flips(DvzMeshSimplify* s, uint32_t a, uint32_t b)
+{
+    ASSERT(s != NULL);
+    const DvzIndex* f = NULL;
+    vec3 p[3], q[3], u, v, n0, n1;
+    for (uint32_t k = s->adj_offsets[a]; k < s->adj_offsets[a + 1]; k++)
+    {
+        f = &s->indices[3 * s->adj[k]];
+        if (f[0] == b || f[1] == b || f[2] == b)
+            continue;
+        for (uint32_t j = 0; j < 3; j++)
+        {
+            _vec3_copy(s->vertices[f[j]].pos, p[j]);
+            _vec3_copy(s->vertices[f[j] == a ? b : f[j]].pos, q[j]);
+        }
+        glm_vec3_sub(p[1], p[0], u);
+        glm_vec3_sub(p[2], p[0], v);
+        glm_vec3_cross(u, v, n0);
+        glm_vec3_sub(q[1], q[0], u);
+        glm_vec3_sub(q[2], q[0], v);
+        glm_vec3_cross(u, v, n1);
+        if (glm_vec3_dot(n0, n1) <= 0)
+            return true;
+    }
+    return false;
+}
+
+
+
+/*************************************************************************************************/
+/*  Collapses                                                                                    */
+/*************************************************************************************************/
+
+static double _simplify_cost(DvzMeshSimplify* s, uint32_t a, uint32_t b)
+{
+    ASSERT(s != NULL);
+    const float* p = s->vertices[b].pos;
+    double w = s->quadrics[a].w + s->quadrics[b].w;
+    double cost = _quadric_eval(&s->quadrics[a], p) + _quadric_eval(&s->quadrics[b], p);
+    return w > 0 ? MAX(0, cost) / w : 0;
+}
+
+
+
+// Radix sort of the candidate collapses by cost: the bits of non-negative floats are ordered like
+// the floats themselves.
+static void _simplify_sort(DvzMeshSimplify* s)
+{
+    ASSERT(s != NULL);
+    uint32_t n = s->collapse_count;
+    DvzMeshCollapse* src = s->collapses;
+    DvzMeshCollapse* dst = s->collapses_tmp;
+    DvzMeshCollapse* tmp = NULL;
+    uint32_t counts[256] = {0};
+    uint32_t key = 0, sum = 0, count = 0;
+    for (uint32_t shift = 0; shift < 32; shift += 8)
+    {
+        memset(counts, 0, sizeof(counts));
+        for (uint32_t i = 0; i < n; i++)
+        {
+            memcpy(&key, &src[i].cost, sizeof(uint32_t));
+            counts[(key >> shift) & 0xff]++;
+        }
+        sum = 0;
+        for (uint32_t k = 0; k < 256; k++)
+        {
+            count = counts[k];
+            counts[k] = sum;
+            sum += count;
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            memcpy(&key, &src[i].cost, sizeof(uint32_t));
+            dst[counts[(key >> shift) & 0xff]++] = src[i];
+        }
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    // After an even number of passes, the sorted collapses are back in the first buffer.
+    ASSERT(src == s->collapses);
+}
+
+
+
+// Candidate collapses of the current round, sorted by increasing cost.
+static void _simplify_candidates(DvzMeshSimplify* s)
+{
+    ASSERT(s != NULL);
+    uint32_t a = 0, b = 0;
+    double cab = 0, cba = 0;
+    DvzMeshCollapse* c = NULL;
+    s->collapse_count = 0;
+    for (uint32_t i = 0; i < s->index_count; i++)
+    {
+        // Every interior edge is seen twice, once in each direction.
+        a = s->indices[i];
+        b = s->indices[i % 3 == 2 ? i - 2 : i + 1];
+        if (a >= b || (s->locked[a] && s->locked[b]))
+            continue;
+        cab = s->locked[a] ? INFINITY : _simplify_cost(s, a, b);
+        cba = s->locked[b] ? INFINITY : _simplify_cost(s, b, a);
+        c = &s->collapses[s->collapse_count++];
+        c->src = cab <= cba ? a : b;
+        c->dst = cab <= cba ? b : a;
+        c->cost = (float)MIN(cab, cba);
+    }
+    _simplify_sort(s);
+}
+
+
+
+// Do one round of collapses, return the number of collapses.
+static uint32_t _simplify_round(DvzMeshSimplify* s, uint32_t target)
+{
+    ASSERT(s != NULL);
+    uint32_t face_count = s->index_count / 3;
+    if (face_count <= target)
+        return 0;
+
+    _simplify_adjacency(s);
+    _simplify_candidates(s);
+    if (s->collapse_count == 0)
+        return 0;
+
+    // Only the cheapest candidates are considered, every collapse removing about two faces, and
+    // many of them being skipped because their vertices have been touched.
+    uint32_t needed = face_count - target;
+    float cost_limit = s->collapses[MIN(needed, s->collapse_count - 1)].cost;
+
+    uint32_t nv = s->vertex_count;
+    memset(s->touched, 0, nv);
+    for (uint32_t v = 0; v < nv; v++)
+        s->remap[v] = v;
+
+    uint32_t removed = 0, count = 0;
+    uint32_t a = 0, b = 0;
+    const DvzIndex* f = NULL;
+    DvzMeshCollapse* c = NULL;
+    for (uint32_t i = 0; i < s->collapse_count && face_count - removed > target; i++)
+    {
+        c = &s->collapses[i];
+        if (c->cost > cost_limit)
+            break;
+        a = c->src;
+        b = c->dst;
+        if (s->touched[a] || s->touched[b])
+            continue;
+        if (!_simplify_link(s, a, b) || _simplify_flips(s, a, b))
+            continue;
+
+        s->remap[a] = b;
+        _quadric_add(&s->quadrics[b], &s->quadrics[a]);
+        s->error = MAX(s->error, c->cost);
+        removed += _simplify_edge_faces(s, a, b);
+        count++;
+
+        // The faces around a change: their vertices cannot be collapsed again in this round.
+        for (uint32_t k = s->adj_offsets[a]; k < s->adj_offsets[a + 1]; k++)
+        {
+            f = &s->indices[3 * s->adj[k]];
+            s->touched[f[0]] = s->touched[f[1]] = s->touched[f[2]] = 1;
+        }
+    }
+
+    // Remap the indices and remove the degenerate faces.
+    uint32_t n = 0;
+    DvzIndex i0 = 0, i1 = 0, i2 = 0;
+    for (uint32_t i = 0; i < s->index_count; i += 3)
+    {
+        i0 = s->remap[s->indices[i + 0]];
+        i1 = s->remap[s->indices[i + 1]];
+        i2 = s->remap[s->indices[i + 2]];
+        if (i0 == i1 || i1 == i2 || i2 == i0)
+            continue;
+        s->indices[n++] = i0;
+        s->indices[n++] = i1;
+        s->indices[n++] = i2;
+    }
+    s->index_count = n;
+    return count;
+}
+
+
+
+/*************************************************************************************************/
+/*  Levels                                                                                       */
+/*************************************************************************************************/
+
+// Bounding sphere of the mesh vertices.
+static void _simplify_bounds(DvzMesh* mesh, DvzMeshLod* lod)
+{
+    ASSERT(mesh != NULL);
+    ASSERT(lod != NULL);
+    const DvzGraphicsMeshVertex* vertices = (const DvzGraphicsMeshVertex*)mesh->vertices.data;
+    uint32_t nv = mesh->vertices.item_count;
+    vec3 min = {+INFINITY, +INFINITY, +INFINITY}, max = {-INFINITY, -INFINITY, -INFINITY};
+    for (uint32_t v = 0; v < nv; v++)
+    {
+        glm_vec3_minv(min, (float*)vertices[v].pos, min);
+        glm_vec3_maxv(max, (float*)vertices[v].pos, max);
+    }
+    glm_vec3_center(min, max, lod->center);
+    float r2 = 0;
+    for (uint32_t v = 0; v < nv; v++)
+        r2 = MAX(r2, glm_vec3_distance2(lod->center, (float*)vertices[v].pos));
+    lod->radius = sqrtf(r2);
+}
+
+
+
+static void _simplify_destroy(DvzMeshSimplify* s)
+{
+    ASSERT(s != NULL);
+    FREE(s->indices);
+    FREE(s->adj_offsets);
+    FREE(s->adj);
+    FREE(s->quadrics);
+    FREE(s->locked);
+    FREE(s->touched);
+    FREE(s->remap);
+    FREE(s->marks);
+    FREE(s->collapses);
+    FREE(s->collapses_tmp);
+}
+
+
+
+// Append the simplified levels to the mesh indices. The simplification is interrupted if the
+// cancel flag is set.
+static DvzMeshLod
+_mesh_simplify(DvzMesh* mesh, uint32_t level_count, float ratio, atomic(bool, *cancel))
+{
+    ASSERT(mesh != NULL);
+    ASSERT(mesh->vertices.item_size == sizeof(DvzGraphicsMeshVertex));
+    ASSERT(mesh->indices.item_size == sizeof(DvzIndex));
+
+    DvzMeshLod lod = {0};
+    uint32_t nv = mesh->vertices.item_count;
+    uint32_t ni = mesh->indices.item_count - mesh->indices.item_count % 3;
+    lod.level_count = 1;
+    lod.index_count[0] = ni;
+    if (nv == 0 || ni == 0)
+        return lod;
+    _simplify_bounds(mesh, &lod);
+
+    level_count = CLIP(level_count, 1, DVZ_MESH_LOD_MAX_LEVELS);
+    ratio = ratio > 0 && ratio < 1 ? ratio : DVZ_MESH_LOD_RATIO;
+
+    DvzMeshSimplify s = {0};
+    s.vertex_count = nv;
+    s.vertices = (const DvzGraphicsMeshVertex*)mesh->vertices.data;
+    s.index_count = ni;
+    s.indices = (DvzIndex*)malloc(ni * sizeof(DvzIndex));
+    memcpy(s.indices, mesh->indices.data, ni * sizeof(DvzIndex));
+    s.adj_offsets = (uint32_t*)calloc(nv + 1, sizeof(uint32_t));
+    s.adj = (uint32_t*)malloc(ni * sizeof(uint32_t));
+    s.quadrics = (DvzQuadric*)calloc(nv, sizeof(DvzQuadric));
+    s.locked = (uint8_t*)calloc(nv, sizeof(uint8_t));
+    s.touched = (uint8_t*)calloc(nv, sizeof(uint8_t));
+    s.remap = (uint32_t*)malloc(nv * sizeof(uint32_t));
+    s.marks = (uint32_t*)calloc(nv, sizeof(uint32_t));
+    s.collapses = (DvzMeshCollapse*)malloc(ni * sizeof(DvzMeshCollapse));
+    s.collapses_tmp = (DvzMeshCollapse*)malloc(ni * sizeof(DvzMeshCollapse));
+
+    // Quadrics of the faces around every vertex.
+    DvzQuadric q = {0};
+    const DvzIndex* f = NULL;
+    for (uint32_t i = 0; i < ni; i += 3)
+    {
+        f = &s.indices[i];
+        _quadric_face(&q, s.vertices[f[0]].pos, s.vertices[f[1]].pos, s.vertices[f[2]].pos);
+        for (uint32_t j = 0; j < 3; j++)
+            _quadric_add(&s.quadrics[f[j]], &q);
+    }
+    _simplify_adjacency(&s);
+    _simplify_lock(&s);
+
+    uint32_t face_count = ni / 3, target = 0, offset = ni;
+    for (uint32_t level = 1; level < level_count; level++)
+    {
+        target = (uint32_t)(face_count * ratio);
+        for (uint32_t round = 0; round < DVZ_MESH_LOD_MAX_ROUNDS; round++)
+        {
+            if (cancel != NULL && atomic_load(cancel))
+                break;
+            if (_simplify_round(&s, target) == 0)
+                break;
+        }
+
+        // Stop when the mesh cannot be simplified further.
+        if (s.index_count / 3 > face_count - face_count / 8 ||
+            (cancel != NULL && atomic_load(cancel)))
+            break;
+        face_count = s.index_count / 3;
+
+        dvz_array_resize(&mesh->indices, offset + s.index_count);
+        memcpy(
+            (DvzIndex*)mesh->indices.data + offset, s.indices, s.index_count * sizeof(DvzIndex));
+        lod.first_index[level] = offset;
+        lod.index_count[level] = s.index_count;
+        lod.error[level] = (float)sqrt(s.error);
+        lod.level_count = level + 1;
+        offset += s.index_count;
+    }
+
+    log_debug(
+        "mesh simplified into %d levels, from %d to %d faces, error %.3g", lod.level_count,
+        ni / 3, lod.index_count[lod.level_count - 1] / 3, lod.error[lod.level_count - 1]);
+    _simplify_destroy(&s);
+    return lod;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,272 @@
+/*************************************************************************************************/
+/*  Parallel mesh normals and grid generation                                                    */
+/*************************************************************************************************/
+
+/*
+Normals: the faces are split into chunks, one per thread. Every thread accumulates the normals of
+its faces into a private buffer covering the window of the vertex indices referenced by its chunk,
+which is small for the spatially coherent indices of most meshes (grids, OBJ files). The vertices
+are then split into ranges, and every thread sums, for each vertex of its range, the buffers of
+the chunks whose window contains it, in chunk order, before normalizing.
+
+Grid: the rows are split into chunks, and every thread writes the vertices, normals, and faces of
+its rows in a single pass. The normal of a vertex on the last row or column is the normal of its
+inner neighbour, so that it does not depend on another thread.
+
+*/
+
+#ifndef DVZ_MESH_UTILS_HEADER
+#define DVZ_MESH_UTILS_HEADER
+
+#include "../include/datoviz/common.h"
+#include "../include/datoviz/mesh.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+typedef struct DvzMeshChunk DvzMeshChunk;
+
+struct DvzMeshChunk
+{
+    DvzMesh* mesh;
+    uint32_t i0, i1; // range of faces (phase 0), vertices (phase 1), or rows (phase 2)
+
+    // Normals.
+    uint32_t v0, v1; // window of the vertices referenced by the faces of the chunk
+    vec3* acc;       // sum of the face normals of the chunk, for every vertex of the window
+    DvzMeshChunk* chunks;
+    uint32_t chunk_count;
+
+    // Grid.
+    uint32_t row_count, col_count;
+    const vec3* positions;
+    const vec2* texcoords;
+};
+
+
+
+// Number of threads for a number of items, with at least DVZ_MESH_MIN_CHUNK items per thread.
+static uint32_t _mesh_threads(uint32_t count)
+{
+    return dvz_parallel_threads(count, DVZ_MESH_MIN_CHUNK, DVZ_MESH_MAX_THREADS);
+}
+
+
+
+// Split a range into chunks, return the number of non-empty chunks.
+static uint32_t _mesh_chunks(uint32_t count, uint32_t n_threads, DvzMeshChunk* chunks)
+{
+    ASSERT(n_threads > 0);
+    ASSERT(chunks != NULL);
+    uint32_t size = (MAX(count, 1) + n_threads - 1) / n_threads;
+    n_threads = (MAX(count, 1) + size - 1) / size;
+    for (uint32_t t = 0; t < n_threads; t++)
+    {
+        chunks[t].i0 = t * size;
+        chunks[t].i1 = MIN((t + 1) * size, count);
+    }
+    return n_threads;
+}
+
+
+
+/*************************************************************************************************/
+/*  Normals                                                                                      */
+/*************************************************************************************************/
+
+static void _mesh_face_normals(DvzMeshChunk* chunk)
+{
+    ASSERT(chunk != NULL);
+    DvzMesh* mesh = chunk->mesh;
+    ASSERT(mesh != NULL);
+
+    const DvzIndex* indices = (const DvzIndex*)mesh->indices.data;
+    const DvzGraphicsMeshVertex* vertices = (const DvzGraphicsMeshVertex*)mesh->vertices.data;
+    if (chunk->i0 >= chunk->i1)
+        return;
+
+    // Window of the vertices referenced by the faces of the chunk.
+    uint32_t v0 = UINT32_MAX, v1 = 0;
+    for (uint32_t i = 3 * chunk->i0; i < 3 * chunk->i1; i++)
+    {
+        v0 = MIN(v0, indices[i]);
+        v1 = MAX(v1, indices[i]);
+    }
+    chunk->v0 = v0;
+    chunk->v1 = v1 + 1;
+    chunk->acc = (vec3*)calloc(chunk->v1 - chunk->v0, sizeof(vec3));
+    ASSERT(chunk->acc != NULL);
+
+    DvzIndex i0, i1, i2;
+    vec3 p0, u, v, n;
+    for (uint32_t i = chunk->i0; i < chunk->i1; i++)
+    {
+        i0 = indices[3 * i + 0];
+        i1 = indices[3 * i + 1];
+        i2 = indices[3 * i + 2];
+
+        _vec3_copy(vertices[i0].pos, p0);
+        _vec3_copy(vertices[i1].pos, u);
+        _vec3_copy(vertices[i2].pos, v);
+        glm_vec3_sub(u, p0, u);
+        glm_vec3_sub(v, p0, v);
+        // n is the normalized vector orthogonal to the current face
+        glm_vec3_crossn(u, v, n);
+
+        glm_vec3_add(chunk->acc[i0 - v0], n, chunk->acc[i0 - v0]);
+        glm_vec3_add(chunk->acc[i1 - v0], n, chunk->acc[i1 - v0]);
+        glm_vec3_add(chunk->acc[i2 - v0], n, chunk->acc[i2 - v0]);
+    }
+}
+
+
+
+static void _mesh_vertex_normals(DvzMeshChunk* chunk)
+{
+    ASSERT(chunk != NULL);
+    DvzMesh* mesh = chunk->mesh;
+    ASSERT(mesh != NULL);
+
+    DvzGraphicsMeshVertex* vertices = (DvzGraphicsMeshVertex*)mesh->vertices.data;
+    DvzMeshChunk* c = NULL;
+    for (uint32_t t = 0; t < chunk->chunk_count; t++)
+    {
+        c = &chunk->chunks[t];
+        if (c->acc == NULL)
+            continue;
+        for (uint32_t i = MAX(chunk->i0, c->v0); i < MIN(chunk->i1, c->v1); i++)
+            glm_vec3_add(vertices[i].normal, c->acc[i - c->v0], vertices[i].normal);
+    }
+
+    // Normalize all normals since every vertex might contain the sum of many normals.
+    for (uint32_t i = chunk->i0; i < chunk->i1; i++)
+        glm_vec3_normalize(vertices[i].normal);
+}
+
+
+
+/*************************************************************************************************/
+/*  Grid                                                                                         */
+/*************************************************************************************************/
+
+// Normal of a grid vertex, from the next vertices on its row and column.
+static void _mesh_grid_normal(DvzMeshChunk* chunk, uint32_t i, uint32_t j, vec3 normal)
+{
+    ASSERT(chunk != NULL);
+    uint32_t row_count = chunk->row_count;
+    uint32_t col_count = chunk->col_count;
+
+    // The vertices on the last row and column take the normal of their inner neighbour.
+    if (i == row_count - 1 && i > 0)
+        i--;
+    if (j == col_count - 1 && j > 0)
+        j--;
+
+    vec3 cur, next_i, next_j, u, v;
+    _vec3_copy(chunk->positions[col_count * i + j], cur);
+    _vec3_copy(chunk->positions[col_count * i + (j + 1) % col_count], next_j);
+    _vec3_copy(chunk->positions[col_count * ((i + 1) % row_count) + j], next_i);
+    glm_vec3_sub(next_i, cur, u);
+    glm_vec3_sub(next_j, cur, v);
+    glm_vec3_crossn(u, v, normal);
+}
+
+
+
+static void _mesh_grid_rows(DvzMeshChunk* chunk)
+{
+    ASSERT(chunk != NULL);
+    DvzMesh* mesh = chunk->mesh;
+    ASSERT(mesh != NULL);
+
+    uint32_t row_count = chunk->row_count;
+    uint32_t col_count = chunk->col_count;
+    DvzGraphicsMeshVertex* vertex =
+        &((DvzGraphicsMeshVertex*)mesh->vertices.data)[col_count * chunk->i0];
+    DvzIndex* index = &((DvzIndex*)mesh->indices.data)[6 * (col_count - 1) * chunk->i0];
+    uint32_t point_idx = col_count * chunk->i0;
+    for (uint32_t i = chunk->i0; i < chunk->i1; i++)
+    {
+        for (uint32_t j = 0; j < col_count; j++)
+        {
+            // Position.
+            _vec3_copy(chunk->positions[point_idx], vertex->pos);
+
+            // Texture coordinates.
+            if (chunk->texcoords == NULL)
+            {
+                vertex->uv[1] = i / (float)(row_count - 1);
+                vertex->uv[0] = j / (float)(col_count - 1);
+            }
+            else
+            {
+                vertex->uv[0] = chunk->texcoords[point_idx][0];
+                vertex->uv[1] = chunk->texcoords[point_idx][1];
+            }
+
+            // Alpha channel.
+            vertex->alpha = 255;
+
+            // Normals.
+            _mesh_grid_normal(chunk, i, j, vertex->normal);
+
+            // Vertex topology.
+            if ((i < row_count - 1) && (j < col_count - 1))
+            {
+                index[0] = col_count * (i + 0) + (j + 0);
+                index[1] = col_count * (i + 1) + (j + 0);
+                index[2] = col_count * (i + 0) + (j + 1);
+                index[3] = col_count * (i + 1) + (j + 1);
+                index[4] = col_count * (i + 0) + (j + 1);
+                index[5] = col_count * (i + 1) + (j + 0);
+                index += 6;
+            }
+
+            // Go to next vertex.
+            point_idx++;
+            vertex++; // remember this is a pointer to the mesh vertices array.
+        }
+    }
+}
+
+
+
+/*************************************************************************************************/
+/*  Threads                                                                                      */
+/*************************************************************************************************/
+
+// Phases: 0: face normals, 1: sum of the face normals per vertex, 2: grid rows.
+static void _mesh_chunk(void* item, uint32_t phase)
+{
+    DvzMeshChunk* chunk = (DvzMeshChunk*)item;
+    ASSERT(chunk != NULL);
+    switch (phase)
+    {
+    case 0:
+        _mesh_face_normals(chunk);
+        break;
+    case 1:
+        _mesh_vertex_normals(chunk);
+        break;
+    case 2:
+        _mesh_grid_rows(chunk);
+        break;
+    default:
+        break;
+    }
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,4 +1,7 @@
 #include "../include/datoviz/panel.h"
+#include "culling.h"
+#include "spatial.h"
+#include "transforms_utils.h"
 
 
 
@@ -426,6 +429,114 @@ DvzPanel* dvz_panel_at(DvzGrid* grid, vec2 screen_pos)
 
 
 
+DvzPick dvz_panel_pick(DvzPanel* panel, vec2 screen_pos, float radius)
+{
+    ASSERT(panel != NULL);
+    DvzPick pick = {0};
+    if (radius <= 0)
+    {
+        log_error("the picking radius must be positive");
+        return pick;
+    }
+
+    // Map the position and the radius to the data coordinates.
+    DvzTransformChain tc = _transforms_cds(panel, DVZ_CDS_WINDOW, DVZ_CDS_DATA);
+    dvec3 in = {screen_pos[0], screen_pos[1], 0};
+    dvec3 center = {0}, out = {0};
+    _transforms_apply(&tc, in, center);
+    dvec2 r = {0};
+    for (uint32_t k = 0; k < 2; k++)
+    {
+        in[0] = screen_pos[0] + (k == 0 ? radius : 0);
+        in[1] = screen_pos[1] + (k == 1 ? radius : 0);
+        _transforms_apply(&tc, in, out);
+        r[k] = fabs(out[k] - center[k]);
+    }
+    if (!(r[0] > 0 && r[1] > 0))
+    {
+        log_warn("degenerate panel transformation, skipping picking");
+        return pick;
+    }
+
+    uint32_t items[DVZ_PICK_MAX_ITEMS] = {0};
+    double distances[DVZ_PICK_MAX_ITEMS] = {0};
+    uint32_t count = 0, k = 0;
+    DvzVisual* visual = NULL;
+    DvzProp* prop = NULL;
+    DvzContainerIterator iter;
+    for (uint32_t i = 0; i < panel->visual_count; i++)
+    {
+        visual = panel->visuals[i];
+        iter = dvz_container_iterator(&visual->props);
+        while (iter.item != NULL)
+        {
+            prop = iter.item;
+            dvz_container_iter(&iter);
+            if (prop->prop_type != DVZ_PROP_POS || prop->spatial == NULL)
+                continue;
+            const dvec3* pos = (const dvec3*)prop->arr_orig.data;
+            if (prop->spatial->dirty)
+                _spatial_build(prop->spatial, prop->arr_orig.item_count, pos);
+
+            count = _spatial_nearest(
+                prop->spatial, pos, center, r, DVZ_PICK_MAX_ITEMS, items, distances);
+
+            // Merge with the items of the previous visuals, sorted by distance.
+            for (uint32_t j = 0; j < count; j++)
+            {
+                if (pick.count == DVZ_PICK_MAX_ITEMS &&
+                    distances[j] * radius >= pick.distances[pick.count - 1])
+                    break;
+                k = MIN(pick.count, DVZ_PICK_MAX_ITEMS - 1);
+                while (k > 0 && pick.distances[k - 1] > distances[j] * radius)
+                {
+                    pick.visuals[k] = pick.visuals[k - 1];
+                    pick.items[k] = pick.items[k - 1];
+                    pick.distances[k] = pick.distances[k - 1];
+                    k--;
+                }
+                pick.visuals[k] = visual;
+                pick.items[k] = items[j];
+                pick.distances[k] = distances[j] * radius;
+                pick.count = MIN(pick.count + 1, DVZ_PICK_MAX_ITEMS);
+            }
+        }
+    }
+    return pick;
+}
+
+
+
+void dvz_panel_culling(DvzPanel* panel, bool enable)
+{
+    ASSERT(panel != NULL);
+    panel->culling = enable;
+    panel->cull_stats = (DvzCullStats){0};
+    if (enable)
+        return;
+
+    // Draw all vertices of the visuals again.
+    for (uint32_t i = 0; i < panel->visual_count; i++)
+    {
+        if (panel->visuals[i]->culling == NULL)
+            continue;
+        _culling_destroy(panel->visuals[i]->culling);
+        FREE(panel->visuals[i]->culling);
+    }
+    ASSERT(panel->grid != NULL);
+    dvz_canvas_to_refill(panel->grid->canvas);
+}
+
+
+
+DvzCullStats dvz_panel_cull_stats(DvzPanel* panel)
+{
+    ASSERT(panel != NULL);
+    return panel->cull_stats;
+}
+
+
+
 void dvz_panel_destroy(DvzPanel* panel)
 {
     ASSERT(panel != NULL);
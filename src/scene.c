@@ -152,6 +152,7 @@ DvzController dvz_controller_builtin(DvzPanel* panel, DvzControllerType type, in
     ASSERT(panel != NULL);
     DvzController controller = dvz_controller(panel);
     controller.type = type;
+    controller.flags = flags;
 
     switch (type)
     {
@@ -385,6 +386,14 @@ void dvz_arcball_rotate(DvzPanel* panel, float angle, vec3 axis)
 
 
 
+DvzMVPStats dvz_scene_mvp_stats(DvzScene* scene)
+{
+    ASSERT(scene != NULL);
+    return scene->mvp_stats;
+}
+
+
+
 /*************************************************************************************************/
 /*  Scene destruction                                                                            */
 /*************************************************************************************************/
@@ -2,6 +2,13 @@
 #define DVZ_SCENE_UTILS_HEADER
 
 #include "../include/datoviz/scene.h"
+#include "bricks.h"
+#include "culling.h"
+#include "depth_sort.h"
+#include "lod.h"
+#include "mesh_levels.h"
+#include "tiles.h"
+#include "visuals_utils.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -20,6 +27,17 @@ static inline bool _is_visual_to_transform(DvzVisual* visual)
 
 
 
+// Whether the vertices of a visual are drawn by the default fill callback and move with the
+// panel view, in which case they can be culled.
+static inline bool _is_visual_cullable(DvzVisual* visual)
+{
+    return visual->graphics_count == 1 && visual->callback_fill == _default_visual_fill &&
+           _is_visual_to_transform(visual) &&
+           visual->interact_axis[0] == DVZ_INTERACT_FIXED_AXIS_DEFAULT;
+}
+
+
+
 static inline bool _is_aspect_fixed(DvzDataCoords* coords)
 {
     return (coords->flags & DVZ_TRANSFORM_FLAGS_FIXED_ASPECT) != 0;
@@ -214,6 +232,7 @@ static void _init_item_count_change_detection(DvzVisual* visual)
 static void _update_visual_viewport(DvzPanel* panel, DvzVisual* visual)
 {
     visual->viewport = panel->viewport;
+    visual->viewport.pick_id = visual->pick_id;
     log_trace("update visual viewport");
     // Each graphics pipeline in the visual has its own transform/clip viewport options
     for (uint32_t pidx = 0; pidx < visual->graphics_count; pidx++)
@@ -412,6 +431,8 @@ static void _process_prop_changed(DvzSceneUpdate up)
     if (up.prop->prop_type == DVZ_PROP_POS && _is_visual_to_transform(up.visual))
     {
         _transform_pos_prop(coords, up.prop);
+        if (up.visual->lod != NULL)
+            up.visual->lod->data_changed = true;
 
         // Recompute the visual box.
         DvzBox box = _visual_box(up.visual);
@@ -545,6 +566,12 @@ static void _process_visual_changed(DvzSceneUpdate up)
     // Visual data GPU upload.
     dvz_visual_update(visual, panel->viewport, panel->data_coords, NULL);
 
+    // The culling boxes must be computed from the new vertices.
+    if (visual->culling != NULL)
+        visual->culling->dirty = true;
+    if (visual->depth_sort != NULL)
+        visual->depth_sort->dirty = true;
+
     // Detect whether the number of vertices/indices has changed, in which case a command buffer
     // refill will be needed.
     if (_has_item_count_changed(visual))
@@ -768,6 +795,338 @@ static void _enqueue_all_visuals_changed(DvzScene* scene)
 
 
 
+// Visible rectangle of a panel in normalized coordinates, [-1, +1] unless the panel has a panzoom.
+static void _panel_visible_range(DvzPanel* panel, dvec2 xlim, dvec2 ylim)
+{
+    ASSERT(panel != NULL);
+    xlim[0] = ylim[0] = -1;
+    xlim[1] = ylim[1] = +1;
+    DvzInteract* interact = panel->controller != NULL && panel->controller->interact_count > 0
+                                ? &panel->controller->interacts[0]
+                                : NULL;
+    if (interact == NULL || (interact->type != DVZ_INTERACT_PANZOOM &&
+                             interact->type != DVZ_INTERACT_PANZOOM_FIXED_ASPECT))
+        return;
+
+    DvzPanzoom* p = &interact->u.p;
+    ASSERT(p->zoom[0] > 0);
+    ASSERT(p->zoom[1] > 0);
+    xlim[0] = p->camera_pos[0] - 1.0 / p->zoom[0];
+    xlim[1] = p->camera_pos[0] + 1.0 / p->zoom[0];
+    ylim[0] = p->camera_pos[1] - 1.0 / p->zoom[1];
+    ylim[1] = p->camera_pos[1] + 1.0 / p->zoom[1];
+}
+
+
+
+// MVP of the first interact of a panel, or the fallback MVP set to the identity if the panel has
+// no interact.
+static DvzMVP* _panel_mvp(DvzPanel* panel, DvzMVP* fallback)
+{
+    ASSERT(panel != NULL);
+    ASSERT(fallback != NULL);
+    if (panel->controller != NULL && panel->controller->interact_count > 0)
+        return &panel->controller->interacts[0].mvp;
+    glm_mat4_identity(fallback->model);
+    glm_mat4_identity(fallback->view);
+    glm_mat4_identity(fallback->proj);
+    return fallback;
+}
+
+
+
+// Check whether the pan and zoom of the panels require a new slice of the visuals with a level of
+// detail, and mark these visuals for upload.
+static void _update_lods(DvzScene* scene)
+{
+    ASSERT(scene != NULL);
+    DvzGrid* grid = &scene->grid;
+
+    DvzPanel* panel = NULL;
+    DvzVisual* visual = NULL;
+    DvzProp* prop = NULL;
+    DvzArray* arr = NULL;
+    DvzLod* lod = NULL;
+    dvec2 xlim = {0}, ylim = {0};
+    DvzContainerIterator iter = dvz_container_iterator(&grid->panels);
+    while (iter.item != NULL)
+    {
+        panel = iter.item;
+
+        // Visible x range in normalized coordinates.
+        _panel_visible_range(panel, xlim, ylim);
+
+        for (uint32_t j = 0; j < panel->visual_count; j++)
+        {
+            visual = panel->visuals[j];
+            lod = visual->lod;
+            if (lod == NULL || lod->level_count == 0)
+                continue;
+
+            // Skip the visuals whose pyramid is about to be rebuilt.
+            prop = dvz_prop_get(visual, DVZ_PROP_POS, 0);
+            arr = prop->arr_trans.item_count > 0 ? &prop->arr_trans : &prop->arr_orig;
+            if (arr->data == NULL || arr->item_count != lod->sample_count)
+                continue;
+
+            lod->xlim[0] = xlim[0];
+            lod->xlim[1] = xlim[1];
+            lod->width = (uint32_t)panel->viewport.viewport.width;
+            if (_lod_outdated(lod, (const dvec3*)arr->data))
+            {
+                log_trace("LOD slice outdated, upload a new slice");
+                lod->window_changed = true;
+                _source_set_changed(dvz_source_get(visual, DVZ_SOURCE_TYPE_VERTEX, 0), true);
+            }
+        }
+        dvz_container_iter(&iter);
+    }
+}
+
+
+
+// Stream the visible tiles of the tiled image visuals, and mark these visuals for upload when the
+// view has changed or when new tiles have been uploaded.
+static void _update_tiles(DvzScene* scene)
+{
+    ASSERT(scene != NULL);
+    DvzGrid* grid = &scene->grid;
+
+    DvzPanel* panel = NULL;
+    DvzVisual* visual = NULL;
+    DvzTiles* tiles = NULL;
+    dvec2 xlim = {0}, ylim = {0};
+    DvzContainerIterator iter = dvz_container_iterator(&grid->panels);
+    while (iter.item != NULL)
+    {
+        panel = iter.item;
+
+        // Visible rectangle in normalized coordinates.
+        _panel_visible_range(panel, xlim, ylim);
+
+        for (uint32_t j = 0; j < panel->visual_count; j++)
+        {
+            visual = panel->visuals[j];
+            tiles = visual->tiles;
+            if (tiles == NULL)
+                continue;
+
+            memcpy(tiles->xlim, xlim, sizeof(dvec2));
+            memcpy(tiles->ylim, ylim, sizeof(dvec2));
+            tiles->viewport[0] = (uint32_t)panel->viewport.viewport.width;
+            tiles->viewport[1] = (uint32_t)panel->viewport.viewport.height;
+            if (_tiles_update(tiles, scene->canvas))
+                _source_set_changed(dvz_source_get(visual, DVZ_SOURCE_TYPE_VERTEX, 0), true);
+        }
+        dvz_container_iter(&iter);
+    }
+}
+
+
+
+// Stream the visible bricks of the bricked volume visuals. The visuals do not need to be baked
+// again: only the atlas and the page table textures change.
+static void _update_bricks(DvzScene* scene)
+{
+    ASSERT(scene != NULL);
+    DvzGrid* grid = &scene->grid;
+
+    DvzPanel* panel = NULL;
+    DvzVisual* visual = NULL;
+    DvzProp* prop = NULL;
+    DvzMVP mvp = {0};
+    DvzMVP* pmvp = NULL;
+    vec3 box_size = {2, 2, 2};
+    uvec2 viewport = {0};
+    DvzContainerIterator iter = dvz_container_iterator(&grid->panels);
+    while (iter.item != NULL)
+    {
+        panel = iter.item;
+        pmvp = _panel_mvp(panel, &mvp);
+        viewport[0] = (uint32_t)panel->viewport.viewport.width;
+        viewport[1] = (uint32_t)panel->viewport.viewport.height;
+
+        for (uint32_t j = 0; j < panel->visual_count; j++)
+        {
+            visual = panel->visuals[j];
+            if (visual->bricks == NULL)
+                continue;
+            prop = dvz_prop_get(visual, DVZ_PROP_LENGTH, 0);
+            ASSERT(prop != NULL);
+            memcpy(box_size, dvz_prop_item(prop, 0), sizeof(vec3));
+            _bricks_update(visual->bricks, scene->canvas, pmvp, box_size, viewport);
+        }
+        dvz_container_iter(&iter);
+    }
+}
+
+
+
+// Select the level of detail of the mesh visuals from the MVP and the viewport of their panel,
+// and refill the command buffers when it changes.
+static void _update_mesh_levels(DvzScene* scene)
+{
+    ASSERT(scene != NULL);
+    DvzGrid* grid = &scene->grid;
+
+    DvzPanel* panel = NULL;
+    DvzVisual* visual = NULL;
+    DvzMVP mvp = {0};
+    DvzMVP* pmvp = NULL;
+    uvec2 viewport = {0};
+    bool refill = false;
+    DvzContainerIterator iter = dvz_container_iterator(&grid->panels);
+    while (iter.item != NULL)
+    {
+        panel = iter.item;
+        pmvp = _panel_mvp(panel, &mvp);
+        viewport[0] = (uint32_t)panel->viewport.viewport.width;
+        viewport[1] = (uint32_t)panel->viewport.viewport.height;
+
+        for (uint32_t j = 0; j < panel->visual_count; j++)
+        {
+            visual = panel->visuals[j];
+            if (visual->mesh_levels != NULL)
+                refill |= _mesh_levels_update(visual->mesh_levels, pmvp, viewport);
+        }
+        dvz_container_iter(&iter);
+    }
+    if (refill)
+        dvz_canvas_to_refill(scene->canvas);
+}
+
+
+
+// Test the chunks of vertices of the visuals against the view of the panels with culling, and
+// refill the command buffers when the ranges to draw change.
+static void _update_culling(DvzScene* scene)
+{
+    ASSERT(scene != NULL);
+    DvzGrid* grid = &scene->grid;
+
+    DvzPanel* panel = NULL;
+    DvzVisual* visual = NULL;
+    DvzSource* source = NULL;
+    DvzSource* index_source = NULL;
+    DvzCulling* culling = NULL;
+    DvzCullStats stats = {0};
+    DvzMVP mvp = {0};
+    DvzMVP* pmvp = NULL;
+    vec2 margin = {0};
+    bool indexed = false, changed = false, refill = false;
+    DvzContainerIterator iter = dvz_container_iterator(&grid->panels);
+    while (iter.item != NULL)
+    {
+        panel = iter.item;
+        dvz_container_iter(&iter);
+        if (!panel->culling)
+            continue;
+        pmvp = _panel_mvp(panel, &mvp);
+
+        stats = (DvzCullStats){0};
+        stats.refills = panel->cull_stats.refills;
+        changed = false;
+        for (uint32_t j = 0; j < panel->visual_count; j++)
+        {
+            visual = panel->visuals[j];
+            if (!_is_visual_cullable(visual))
+                continue;
+            if (visual->culling == NULL)
+            {
+                visual->culling = (DvzCulling*)calloc(1, sizeof(DvzCulling));
+                visual->culling->dirty = true;
+            }
+            culling = visual->culling;
+
+            source = dvz_source_get(visual, DVZ_SOURCE_TYPE_VERTEX, 0);
+            if (culling->dirty || culling->vertex_count != source->arr.item_count)
+            {
+                index_source = dvz_source_get(visual, DVZ_SOURCE_TYPE_INDEX, 0);
+                indexed = index_source != NULL && index_source->arr.item_count > 0;
+                _culling_build(culling, visual->graphics[0], &source->arr, indexed);
+                culling->margin = _culling_margin(visual);
+            }
+
+            // Margin around the viewport, in normalized device coordinates.
+            margin[0] = 2.0f * culling->margin / MAX(1, panel->viewport.viewport.width);
+            margin[1] = 2.0f * culling->margin / MAX(1, panel->viewport.viewport.height);
+            changed |= _culling_update(culling, pmvp, margin);
+
+            stats.visual_count++;
+            stats.vertex_count += culling->vertex_count;
+            if (!culling->visible)
+            {
+                stats.culled_visuals++;
+                stats.culled_count += culling->vertex_count;
+                continue;
+            }
+            stats.draw_count++;
+            if (!culling->indexed && visual->depth_sort == NULL)
+                stats.culled_count += culling->vertex_count - culling->count;
+        }
+        if (changed)
+        {
+            log_trace("culled ranges changed, refill the command buffers");
+            stats.refills++;
+            refill = true;
+        }
+        panel->cull_stats = stats;
+    }
+    if (refill)
+        dvz_canvas_to_refill(scene->canvas);
+}
+
+
+
+// Copy the primitives of the visuals with a depth sort once their vertices have been baked,
+// upload the last sorted indices, and sort the primitives again when the view changes.
+static void _update_depth_sorts(DvzScene* scene)
+{
+    ASSERT(scene != NULL);
+    DvzGrid* grid = &scene->grid;
+
+    DvzPanel* panel = NULL;
+    DvzVisual* visual = NULL;
+    DvzSource* source = NULL;
+    DvzSource* index_source = NULL;
+    DvzArray* indices = NULL;
+    DvzDepthSort* sort = NULL;
+    DvzMVP mvp = {0};
+    DvzMVP* pmvp = NULL;
+    bool refill = false;
+    DvzContainerIterator iter = dvz_container_iterator(&grid->panels);
+    while (iter.item != NULL)
+    {
+        panel = iter.item;
+        dvz_container_iter(&iter);
+        pmvp = _panel_mvp(panel, &mvp);
+        for (uint32_t j = 0; j < panel->visual_count; j++)
+        {
+            visual = panel->visuals[j];
+            sort = visual->depth_sort;
+            if (sort == NULL)
+                continue;
+
+            // The primitives are copied again when the worker is idle.
+            source = dvz_source_get(visual, DVZ_SOURCE_TYPE_VERTEX, 0);
+            index_source = dvz_source_get(visual, DVZ_SOURCE_TYPE_INDEX, 0);
+            indices = index_source != NULL ? &index_source->arr : NULL;
+            if ((sort->dirty || sort->vertex_count != source->arr.item_count ||
+                 sort->index_count != (indices != NULL ? indices->item_count : 0)) &&
+                !atomic_load(&sort->busy))
+            {
+                _depth_sort_build(sort, visual->graphics[0], &source->arr, indices);
+                refill = true;
+            }
+            refill |= _depth_sort_update(sort, scene->canvas, pmvp);
+        }
+    }
+    if (refill)
+        dvz_canvas_to_refill(scene->canvas);
+}
+
+
+
 // Dequeue a scene update.
 static DvzSceneUpdate _scene_update_dequeue(DvzScene* scene)
 {
@@ -959,13 +1318,33 @@ static void _scene_frame(DvzCanvas* canvas, DvzEvent ev)
     // Call the controller callbacks of all panels.
     _callback_controllers(scene);
 
+    // Update the slices of the visuals with a level of detail.
+    _update_lods(scene);
+
+    // Stream the visible tiles of the tiled images.
+    _update_tiles(scene);
+
+    // Stream the visible bricks of the bricked volumes.
+    _update_bricks(scene);
+
+    // Select the levels of detail of the meshes.
+    _update_mesh_levels(scene);
+
     // Process the scene updates.
     _process_scene_updates(scene);
+
+    // Cull the visuals outside of the view, once their vertices have been baked.
+    _update_culling(scene);
+
+    // Sort the translucent primitives back to front.
+    _update_depth_sorts(scene);
 }
 
 
 
-// Upload the MVP struct to the panels.
+// Upload the MVP struct of the panels whose MVP has changed. The uniform buffer has one region
+// per swapchain image, and only the region of the current image is updated at every frame, so
+// that a changed MVP is uploaded during the next img_count frames.
 static void _upload_mvp(DvzCanvas* canvas, DvzEvent ev)
 {
     ASSERT(canvas != NULL);
@@ -977,7 +1356,14 @@ static void _upload_mvp(DvzCanvas* canvas, DvzEvent ev)
 
     DvzInteract* interact = NULL;
     DvzController* controller = NULL;
-    // DvzBufferRegions* br = NULL;
+    uint32_t img_idx = canvas->swapchain.img_idx;
+    uint32_t img_count = canvas->swapchain.img_count;
+    ASSERT(img_idx < DVZ_MAX_SWAPCHAIN_IMAGES);
+
+    DvzMVPStats* stats = &scene->mvp_stats;
+    stats->panel_count = 0;
+    stats->uploads = 0;
+    stats->bytes = 0;
 
     // Go through all panels that need to be updated.
     DvzPanel* panel = NULL;
@@ -985,9 +1371,11 @@ static void _upload_mvp(DvzCanvas* canvas, DvzEvent ev)
     while (iter.item != NULL)
     {
         panel = iter.item;
+        dvz_container_iter(&iter);
         if (panel->controller == NULL)
             continue;
         controller = panel->controller;
+        stats->panel_count++;
 
         // Go through all interact of the controllers.
         // TODO: only 1 interact to be supported?
@@ -997,14 +1385,30 @@ static void _upload_mvp(DvzCanvas* canvas, DvzEvent ev)
             ASSERT(j == 0);
             interact = &controller->interacts[j];
 
+            // New version of the MVP when its matrices have changed, or after the swapchain
+            // has been recreated.
+            if (panel->mvp_version == 0 || panel->mvp_img_count != img_count ||
+                memcmp(&panel->mvp_last, &interact->mvp, offsetof(DvzMVP, time)) != 0)
+            {
+                panel->mvp_last = interact->mvp;
+                panel->mvp_version++;
+                panel->mvp_img_count = img_count;
+                memset(panel->mvp_uploaded, 0, sizeof(panel->mvp_uploaded));
+            }
+            if (panel->mvp_uploaded[img_idx] == panel->mvp_version)
+                continue;
+
             // NOTE: update MVP.time here.
             interact->mvp.time = canvas->clock.elapsed;
 
-            // NOTE: we need to update the uniform buffer at every frame
             dvz_upload_buffers(canvas, panel->br_mvp, 0, panel->br_mvp.size, &interact->mvp);
+            panel->mvp_uploaded[img_idx] = panel->mvp_version;
+            stats->uploads++;
+            stats->bytes += panel->br_mvp.size;
         }
-        dvz_container_iter(&iter);
     }
+    stats->total_uploads += stats->uploads;
+    stats->total_bytes += stats->bytes;
 }
 
 
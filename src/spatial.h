@@ -0,0 +1,369 @@
+/*************************************************************************************************/
+/*  Spatial index of the positions of a visual, for CPU picking                                  */
+/*************************************************************************************************/
+
+/*
+Uniform 2D grid over the xy data coordinates of the items, with DVZ_SPATIAL_ITEMS_PER_CELL items
+per cell on average. The items are sorted by cell with a parallel counting sort: every thread
+computes the cells and a histogram of its chunk, the histograms are combined into per-thread
+write offsets, and every thread scatters its chunk.
+
+Items outside of the grid bounds (after a partial update) are clamped to the border cells, so that
+a query box always overlaps the cell of every item it contains.
+
+*/
+
+#ifndef DVZ_SPATIAL_HEADER
+#define DVZ_SPATIAL_HEADER
+
+#include "../include/datoviz/visuals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+typedef struct DvzSpatialChunk DvzSpatialChunk;
+
+struct DvzSpatialChunk
+{
+    DvzSpatialIndex* index;
+    const dvec3* pos;
+    uint32_t i0, i1;
+    dvec2 p0, p1;
+    uint32_t* hist; // number of items per cell, then write offsets
+};
+
+
+
+static void _spatial_destroy(DvzSpatialIndex* index)
+{
+    ASSERT(index != NULL);
+    FREE(index->cell_start);
+    FREE(index->items);
+    FREE(index->cell_of);
+    FREE(index->moved);
+    FREE(index->overflow);
+    *index = (DvzSpatialIndex){0};
+    index->dirty = true;
+}
+
+
+
+static inline uint32_t _spatial_axis(double x, double p0, double scale, uint32_t n)
+{
+    double f = (x - p0) * scale;
+    // NOTE: NaN values end up in the first cell.
+    if (!(f >= 0))
+        return 0;
+    return f < n ? (uint32_t)f : n - 1;
+}
+
+
+
+static inline uint32_t _spatial_cell(DvzSpatialIndex* index, const double* p)
+{
+    uint32_t i = _spatial_axis(p[0], index->p0[0], index->scale[0], index->nx);
+    uint32_t j = _spatial_axis(p[1], index->p0[1], index->scale[1], index->ny);
+    return j * index->nx + i;
+}
+
+
+
+/*************************************************************************************************/
+/*  Build                                                                                        */
+/*************************************************************************************************/
+
+// Phases: 0: bounds, 1: cells and histogram, 2: scatter.
+static void _spatial_chunk(void* item, uint32_t phase)
+{
+    DvzSpatialChunk* chunk = (DvzSpatialChunk*)item;
+    ASSERT(chunk != NULL);
+    DvzSpatialIndex* index = chunk->index;
+    const dvec3* pos = chunk->pos;
+    uint32_t c = 0;
+
+    switch (phase)
+    {
+    case 0:
+        chunk->p0[0] = chunk->p0[1] = +INFINITY;
+        chunk->p1[0] = chunk->p1[1] = -INFINITY;
+        for (uint32_t i = chunk->i0; i < chunk->i1; i++)
+        {
+            if (!isfinite(pos[i][0]) || !isfinite(pos[i][1]))
+                continue;
+            chunk->p0[0] = MIN(chunk->p0[0], pos[i][0]);
+            chunk->p0[1] = MIN(chunk->p0[1], pos[i][1]);
+            chunk->p1[0] = MAX(chunk->p1[0], pos[i][0]);
+            chunk->p1[1] = MAX(chunk->p1[1], pos[i][1]);
+        }
+        break;
+
+    case 1:
+        for (uint32_t i = chunk->i0; i < chunk->i1; i++)
+        {
+            c = _spatial_cell(index, pos[i]);
+            index->cell_of[i] = c;
+            chunk->hist[c]++;
+        }
+        break;
+
+    case 2:
+        for (uint32_t i = chunk->i0; i < chunk->i1; i++)
+            index->items[chunk->hist[index->cell_of[i]]++] = i;
+        break;
+
+    default:
+        break;
+    }
+}
+
+
+
+static void _spatial_build(DvzSpatialIndex* index, uint32_t count, const dvec3* pos)
+{
+    ASSERT(index != NULL);
+    _spatial_destroy(index);
+    index->dirty = false;
+    if (count == 0 || pos == NULL)
+        return;
+    index->item_count = count;
+
+    // Split the items into chunks, one per thread.
+    uint32_t n_threads =
+        dvz_parallel_threads(count, DVZ_SPATIAL_MIN_CHUNK, DVZ_SPATIAL_MAX_THREADS);
+    uint32_t size = (count + n_threads - 1) / n_threads;
+    n_threads = (count + size - 1) / size;
+
+    DvzSpatialChunk chunks[DVZ_SPATIAL_MAX_THREADS] = {0};
+    for (uint32_t t = 0; t < n_threads; t++)
+    {
+        chunks[t].index = index;
+        chunks[t].pos = pos;
+        chunks[t].i0 = t * size;
+        chunks[t].i1 = MIN((t + 1) * size, count);
+    }
+
+    // Bounds.
+    dvz_parallel(n_threads, chunks, sizeof(DvzSpatialChunk), 0, _spatial_chunk);
+    dvec2 p0 = {+INFINITY, +INFINITY};
+    dvec2 p1 = {-INFINITY, -INFINITY};
+    for (uint32_t t = 0; t < n_threads; t++)
+    {
+        for (uint32_t k = 0; k < 2; k++)
+        {
+            p0[k] = MIN(p0[k], chunks[t].p0[k]);
+            p1[k] = MAX(p1[k], chunks[t].p1[k]);
+        }
+    }
+    if (p0[0] > p1[0])
+    {
+        // No finite position.
+        p0[0] = p0[1] = 0;
+        p1[0] = p1[1] = 0;
+    }
+
+    // Grid shape, with square-ish cells.
+    uint32_t n_cells = CLIP(count / DVZ_SPATIAL_ITEMS_PER_CELL, 1, DVZ_SPATIAL_MAX_CELLS);
+    double w = p1[0] - p0[0];
+    double h = p1[1] - p0[1];
+    uint32_t nx = 1, ny = 1;
+    if (w > 0 && h > 0)
+    {
+        nx = (uint32_t)CLIP(round(sqrt(n_cells * w / h)), 1, n_cells);
+        ny = MAX(1, n_cells / nx);
+    }
+    else if (w > 0)
+        nx = n_cells;
+    else if (h > 0)
+        ny = n_cells;
+    n_cells = nx * ny;
+
+    index->nx = nx;
+    index->ny = ny;
+    index->p0[0] = p0[0];
+    index->p0[1] = p0[1];
+    index->p1[0] = p1[0];
+    index->p1[1] = p1[1];
+    index->scale[0] = w > 0 ? nx / w : 0;
+    index->scale[1] = h > 0 ? ny / h : 0;
+
+    index->cell_start = (uint32_t*)calloc(n_cells + 1, sizeof(uint32_t));
+    index->items = (uint32_t*)malloc(count * sizeof(uint32_t));
+    index->cell_of = (uint32_t*)malloc(count * sizeof(uint32_t));
+    index->moved = (uint8_t*)calloc(count, sizeof(uint8_t));
+    uint32_t* hist = (uint32_t*)calloc((size_t)n_threads * n_cells, sizeof(uint32_t));
+    ASSERT(index->cell_start != NULL);
+    ASSERT(index->items != NULL);
+    ASSERT(index->cell_of != NULL);
+    ASSERT(index->moved != NULL);
+    ASSERT(hist != NULL);
+
+    // Cells and per-thread histograms.
+    for (uint32_t t = 0; t < n_threads; t++)
+        chunks[t].hist = &hist[(size_t)t * n_cells];
+    dvz_parallel(n_threads, chunks, sizeof(DvzSpatialChunk), 1, _spatial_chunk);
+
+    // Prefix sum: turn the histograms into write offsets, cell by cell, then thread by thread.
+    uint32_t offset = 0, k = 0;
+    for (uint32_t c = 0; c < n_cells; c++)
+    {
+        index->cell_start[c] = offset;
+        for (uint32_t t = 0; t < n_threads; t++)
+        {
+            k = chunks[t].hist[c];
+            chunks[t].hist[c] = offset;
+            offset += k;
+        }
+    }
+    ASSERT(offset == count);
+    index->cell_start[n_cells] = count;
+
+    // Scatter.
+    dvz_parallel(n_threads, chunks, sizeof(DvzSpatialChunk), 2, _spatial_chunk);
+    FREE(hist);
+
+    log_debug("built %dx%d spatial index on %d items with %d threads", nx, ny, count, n_threads);
+}
+
+
+
+/*************************************************************************************************/
+/*  Update                                                                                       */
+/*************************************************************************************************/
+
+// Update the index after the items [first, first + n) of the positions have been modified. The
+// index is marked for rebuild if the number of items changed, or if too many items moved.
+static void _spatial_update(
+    DvzSpatialIndex* index, uint32_t count, const dvec3* pos, uint32_t first, uint32_t n)
+{
+    ASSERT(index != NULL);
+    if (index->dirty || count != index->item_count || (first == 0 && n >= count))
+    {
+        index->dirty = true;
+        return;
+    }
+    ASSERT(pos != NULL);
+    ASSERT(first + n <= count);
+
+    for (uint32_t i = first; i < first + n; i++)
+    {
+        if (index->moved[i] || _spatial_cell(index, pos[i]) == index->cell_of[i])
+            continue;
+        if (index->overflow_count >= count / 8 + 1024)
+        {
+            index->dirty = true;
+            return;
+        }
+        if (index->overflow_count == index->overflow_capacity)
+        {
+            index->overflow_capacity = MAX(64, 2 * index->overflow_capacity);
+            REALLOC(index->overflow, index->overflow_capacity * sizeof(uint32_t));
+        }
+        index->moved[i] = 1;
+        index->overflow[index->overflow_count++] = i;
+    }
+}
+
+
+
+/*************************************************************************************************/
+/*  Query                                                                                        */
+/*************************************************************************************************/
+
+// Insert an item in a list sorted by increasing distance, keeping at most max_count items.
+// Return the new number of items.
+static uint32_t _spatial_insert(
+    uint32_t count, uint32_t max_count, uint32_t* items, double* distances, //
+    uint32_t item, double distance)
+{
+    ASSERT(max_count > 0);
+    if (count == max_count && distance >= distances[count - 1])
+        return count;
+    uint32_t k = MIN(count, max_count - 1);
+    while (k > 0 && distances[k - 1] > distance)
+    {
+        items[k] = items[k - 1];
+        distances[k] = distances[k - 1];
+        k--;
+    }
+    items[k] = item;
+    distances[k] = distance;
+    return MIN(count + 1, max_count);
+}
+
+
+
+// Normalized distance of an item to the center of an ellipse with the given radii, or a value
+// larger than 1 if the item is outside.
+static inline double _spatial_distance(const double* p, dvec2 center, dvec2 radius)
+{
+    double dx = (p[0] - center[0]) / radius[0];
+    double dy = (p[1] - center[1]) / radius[1];
+    double d = dx * dx + dy * dy;
+    return d <= 1 ? sqrt(d) : 2;
+}
+
+
+
+// Find the items within the ellipse with the given center and radii, in data coordinates. Return
+// the number of items, at most max_count, sorted by increasing normalized distance.
+static uint32_t _spatial_nearest(
+    DvzSpatialIndex* index, const dvec3* pos, dvec2 center, dvec2 radius, //
+    uint32_t max_count, uint32_t* items, double* distances)
+{
+    ASSERT(index != NULL);
+    ASSERT(!index->dirty);
+    ASSERT(radius[0] > 0 && radius[1] > 0);
+    if (index->item_count == 0)
+        return 0;
+    ASSERT(pos != NULL);
+
+    uint32_t count = 0, item = 0;
+    double d = 0;
+
+    // Cells overlapping the bounding box of the ellipse.
+    uint32_t i0 = _spatial_axis(center[0] - radius[0], index->p0[0], index->scale[0], index->nx);
+    uint32_t i1 = _spatial_axis(center[0] + radius[0], index->p0[0], index->scale[0], index->nx);
+    uint32_t j0 = _spatial_axis(center[1] - radius[1], index->p0[1], index->scale[1], index->ny);
+    uint32_t j1 = _spatial_axis(center[1] + radius[1], index->p0[1], index->scale[1], index->ny);
+    for (uint32_t j = j0; j <= j1; j++)
+    {
+        for (uint32_t i = i0; i <= i1; i++)
+        {
+            uint32_t c = j * index->nx + i;
+            for (uint32_t k = index->cell_start[c]; k < index->cell_start[c + 1]; k++)
+            {
+                item = index->items[k];
+                if (index->moved[item])
+                    continue;
+                d = _spatial_distance(pos[item], center, radius);
+                if (d <= 1)
+                    count = _spatial_insert(count, max_count, items, distances, item, d);
+            }
+        }
+    }
+
+    // Moved items.
+    for (uint32_t k = 0; k < index->overflow_count; k++)
+    {
+        item = index->overflow[k];
+        d = _spatial_distance(pos[item], center, radius);
+        if (d <= 1)
+            count = _spatial_insert(count, max_count, items, distances, item, d);
+    }
+    return count;
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
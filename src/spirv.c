@@ -1,6 +1,12 @@
 #include "spirv.h"
 #include "../include/datoviz/vklite.h"
 
+#include <errno.h>
+#if OS_WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 #if HAS_GLSLANG
 #include <StandAlone/resource_limits_c.h>
@@ -8,9 +14,200 @@
 #endif
 
 
-VkShaderModule dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFlagBits stage)
+
+/*************************************************************************************************/
+/*  SPIR-V cache                                                                                 */
+/*************************************************************************************************/
+
+/*
+The compiled shaders are kept in memory, with a key made of a hash of the shader stage and the
+GLSL code. The code itself is kept to resolve hash collisions. When a cache directory is set, the
+SPIR-V code is also saved in a file named after the hash, and loaded by the next processes
+compiling the same shader. The target versions of the compilation are part of the hash, so that
+a change of the compilation options does not load stale files.
+
+*/
+
+#define DVZ_SPIRV_MAGIC  0x07230203
+#define DVZ_SPIRV_TARGET "vulkan1.0-spirv1.0"
+
+typedef struct DvzSpirvEntry DvzSpirvEntry;
+
+struct DvzSpirvEntry
 {
-    VkShaderModule module = {0};
+    uint64_t hash;
+    VkShaderStageFlagBits stage;
+    char* code;
+    size_t size; // in bytes
+    uint32_t* spirv;
+};
+
+static pthread_mutex_t DVZ_SPIRV_LOCK = PTHREAD_MUTEX_INITIALIZER;
+#if HAS_GLSLANG
+static bool DVZ_SPIRV_GLSLANG_READY;
+#endif
+static bool DVZ_SPIRV_DIR_READY;
+static char DVZ_SPIRV_DIR[1024];
+static uint32_t DVZ_SPIRV_CAPACITY;
+static DvzSpirvEntry* DVZ_SPIRV_ENTRIES;
+static DvzSpirvStats DVZ_SPIRV_STATS;
+
+
+
+// FNV-1a hash of the compilation target, the shader stage, and the code.
+static uint64_t _spirv_hash(const char* code, VkShaderStageFlagBits stage)
+{
+    ASSERT(code != NULL);
+    uint64_t hash = 14695981039346656037ULL;
+    const char* target = DVZ_SPIRV_TARGET;
+    for (const char* c = target; *c != 0; c++)
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+    for (uint32_t i = 0; i < 4; i++)
+        hash = (hash ^ (((uint32_t)stage >> (8 * i)) & 0xFF)) * 1099511628211ULL;
+    for (const char* c = code; *c != 0; c++)
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+    return hash;
+}
+
+
+
+static DvzSpirvEntry* _spirv_find(uint64_t hash, VkShaderStageFlagBits stage, const char* code)
+{
+    DvzSpirvEntry* entry = NULL;
+    for (uint32_t i = 0; i < DVZ_SPIRV_STATS.entry_count; i++)
+    {
+        entry = &DVZ_SPIRV_ENTRIES[i];
+        if (entry->hash == hash && entry->stage == stage && strcmp(entry->code, code) == 0)
+            return entry;
+    }
+    return NULL;
+}
+
+
+
+// Add a compiled shader to the memory cache, which takes ownership of the SPIR-V code.
+static DvzSpirvEntry* _spirv_add(
+    uint64_t hash, VkShaderStageFlagBits stage, const char* code, uint32_t* spirv, size_t size)
+{
+    ASSERT(spirv != NULL);
+    if (DVZ_SPIRV_STATS.entry_count >= DVZ_SPIRV_CAPACITY)
+    {
+        DVZ_SPIRV_CAPACITY = DVZ_SPIRV_CAPACITY == 0 ? 16 : 2 * DVZ_SPIRV_CAPACITY;
+        REALLOC(DVZ_SPIRV_ENTRIES, DVZ_SPIRV_CAPACITY * sizeof(DvzSpirvEntry));
+    }
+    DvzSpirvEntry* entry = &DVZ_SPIRV_ENTRIES[DVZ_SPIRV_STATS.entry_count++];
+    entry->hash = hash;
+    entry->stage = stage;
+    entry->code = calloc(strlen(code) + 1, sizeof(char));
+    memcpy(entry->code, code, strlen(code));
+    entry->spirv = spirv;
+    entry->size = size;
+    return entry;
+}
+
+
+
+static void _spirv_dir(const char* path)
+{
+    DVZ_SPIRV_DIR_READY = true;
+    DVZ_SPIRV_DIR[0] = 0;
+    if (path == NULL || path[0] == 0)
+        return;
+    strncpy(DVZ_SPIRV_DIR, path, sizeof(DVZ_SPIRV_DIR) - 1);
+
+#if OS_WIN32
+    int res = _mkdir(path);
+#else
+    int res = mkdir(path, 0755);
+#endif
+    if (res != 0 && errno != EEXIST)
+        log_warn("unable to create the SPIR-V cache directory %s", path);
+    log_debug("SPIR-V cache in %s", path);
+}
+
+
+
+// Path of the file of a compiled shader in the disk cache, return false if there is no disk cache.
+static bool _spirv_path(uint64_t hash, char* path, size_t size)
+{
+    ASSERT(path != NULL);
+    if (!DVZ_SPIRV_DIR_READY)
+        _spirv_dir(getenv("DVZ_SPIRV_CACHE"));
+    if (DVZ_SPIRV_DIR[0] == 0)
+        return false;
+    snprintf(
+        path, size, "%s/%08x%08x.spv", DVZ_SPIRV_DIR, (uint32_t)(hash >> 32), (uint32_t)hash);
+    return true;
+}
+
+
+
+static uint32_t* _spirv_load(const char* path, size_t* size)
+{
+    ASSERT(path != NULL);
+    ASSERT(size != NULL);
+    FILE* f = fopen(path, "rb");
+    if (f == NULL)
+        return NULL;
+
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint32_t* spirv = NULL;
+    if (length >= 20 && length % 4 == 0)
+    {
+        spirv = malloc((size_t)length);
+        if (fread(spirv, 1, (size_t)length, f) != (size_t)length || spirv[0] != DVZ_SPIRV_MAGIC)
+            FREE(spirv);
+    }
+    fclose(f);
+
+    if (spirv == NULL)
+    {
+        log_warn("ignoring invalid SPIR-V cache file %s", path);
+        return NULL;
+    }
+    *size = (size_t)length;
+    return spirv;
+}
+
+
+
+static void _spirv_save(const char* path, const uint32_t* spirv, size_t size)
+{
+    ASSERT(path != NULL);
+    ASSERT(spirv != NULL);
+
+    // The file is renamed once written, so that other processes never load a partial file.
+    char tmp[1100];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE* f = fopen(tmp, "wb");
+    if (f == NULL)
+    {
+        log_warn("unable to write the SPIR-V cache file %s", tmp);
+        return;
+    }
+    size_t written = fwrite(spirv, 1, size, f);
+    fclose(f);
+    if (written != size || rename(tmp, path) != 0)
+    {
+        log_warn("unable to write the SPIR-V cache file %s", path);
+        remove(tmp);
+    }
+}
+
+
+
+/*************************************************************************************************/
+/*  Compilation                                                                                  */
+/*************************************************************************************************/
+
+// Compile a shader with glslang, return the SPIR-V code to be freed by the caller.
+static uint32_t* _spirv_glslang(const char* code, VkShaderStageFlagBits stage, size_t* size)
+{
+    ASSERT(code != NULL);
+    ASSERT(size != NULL);
+    uint32_t* spirv = NULL;
 
 #if HAS_GLSLANG
     glslang_stage_t glslang_stage = GLSLANG_STAGE_VERTEX;
@@ -36,7 +233,7 @@ VkShaderModule dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFl
         break;
     default:
         log_error("unsupported shader stage");
-        break;
+        return NULL;
     }
     const glslang_input_t input = {
         .language = GLSLANG_SOURCE_GLSL,
@@ -54,18 +251,20 @@ VkShaderModule dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFl
         .resource = glslang_default_resource(),
     };
 
-    glslang_initialize_process();
-
-    glslang_shader_t* shader = glslang_shader_create(&input);
-
-    if (!glslang_shader_preprocess(shader, &input))
+    // glslang is initialized once for the whole process.
+    if (!DVZ_SPIRV_GLSLANG_READY)
     {
-        // use glslang_shader_get_info_log() and glslang_shader_get_info_debug_log()
+        glslang_initialize_process();
+        DVZ_SPIRV_GLSLANG_READY = true;
     }
 
-    if (!glslang_shader_parse(shader, &input))
+    glslang_shader_t* shader = glslang_shader_create(&input);
+
+    if (!glslang_shader_preprocess(shader, &input) || !glslang_shader_parse(shader, &input))
     {
-        // use glslang_shader_get_info_log() and glslang_shader_get_info_debug_log()
+        log_error("unable to compile shader: %s", glslang_shader_get_info_log(shader));
+        glslang_shader_delete(shader);
+        return NULL;
     }
 
     glslang_program_t* program = glslang_program_create();
@@ -73,7 +272,10 @@ VkShaderModule dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFl
 
     if (!glslang_program_link(program, GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT))
     {
-        // use glslang_program_get_info_log() and glslang_program_get_info_debug_log();
+        log_error("unable to link shader: %s", glslang_program_get_info_log(program));
+        glslang_program_delete(program);
+        glslang_shader_delete(shader);
+        return NULL;
     }
 
     glslang_program_SPIRV_generate(program, input.stage);
@@ -85,10 +287,122 @@ VkShaderModule dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFl
 
     glslang_shader_delete(shader);
 
+    *size = glslang_program_SPIRV_get_size(program) * sizeof(unsigned int);
+    spirv = malloc(*size);
+    memcpy(spirv, glslang_program_SPIRV_get_ptr(program), *size);
+
+    glslang_program_delete(program);
+
+#else
+    log_error("unable to compile shader to SPIRV, Datoviz was not built with glslang support");
+#endif
+
+    return spirv;
+}
+
+
+
+const uint32_t* dvz_spirv_compile(const char* code, VkShaderStageFlagBits stage, size_t* size)
+{
+    ASSERT(code != NULL);
+    ASSERT(size != NULL);
+    *size = 0;
+
+    pthread_mutex_lock(&DVZ_SPIRV_LOCK);
+    DvzSpirvStats* stats = &DVZ_SPIRV_STATS;
+    uint64_t hash = _spirv_hash(code, stage);
+    DvzSpirvEntry* entry = _spirv_find(hash, stage, code);
+    if (entry != NULL)
+        stats->hit_count++;
+    else
+    {
+        char path[1100];
+        size_t spirv_size = 0;
+        bool on_disk = _spirv_path(hash, path, sizeof(path));
+        uint32_t* spirv = on_disk ? _spirv_load(path, &spirv_size) : NULL;
+        if (spirv != NULL)
+            stats->disk_hit_count++;
+        else
+        {
+            DvzClock clock = {0};
+            _clock_init(&clock);
+            spirv = _spirv_glslang(code, stage, &spirv_size);
+            stats->compile_time += _clock_get(&clock);
+            stats->compile_count++;
+            if (spirv == NULL)
+                stats->failure_count++;
+            else if (on_disk)
+                _spirv_save(path, spirv, spirv_size);
+        }
+        if (spirv != NULL)
+            entry = _spirv_add(hash, stage, code, spirv, spirv_size);
+    }
+
+    const uint32_t* out = NULL;
+    if (entry != NULL)
+    {
+        out = entry->spirv;
+        *size = entry->size;
+    }
+    pthread_mutex_unlock(&DVZ_SPIRV_LOCK);
+    return out;
+}
+
+
+
+void dvz_spirv_cache_dir(const char* path)
+{
+    pthread_mutex_lock(&DVZ_SPIRV_LOCK);
+    _spirv_dir(path);
+    pthread_mutex_unlock(&DVZ_SPIRV_LOCK);
+}
+
+
+
+DvzSpirvStats dvz_spirv_stats(void)
+{
+    pthread_mutex_lock(&DVZ_SPIRV_LOCK);
+    DvzSpirvStats stats = DVZ_SPIRV_STATS;
+    pthread_mutex_unlock(&DVZ_SPIRV_LOCK);
+    return stats;
+}
+
+
+
+void dvz_spirv_cache_clear(void)
+{
+    pthread_mutex_lock(&DVZ_SPIRV_LOCK);
+    for (uint32_t i = 0; i < DVZ_SPIRV_STATS.entry_count; i++)
+    {
+        FREE(DVZ_SPIRV_ENTRIES[i].code);
+        FREE(DVZ_SPIRV_ENTRIES[i].spirv);
+    }
+    FREE(DVZ_SPIRV_ENTRIES);
+    DVZ_SPIRV_CAPACITY = 0;
+    memset(&DVZ_SPIRV_STATS, 0, sizeof(DVZ_SPIRV_STATS));
+    pthread_mutex_unlock(&DVZ_SPIRV_LOCK);
+}
+
+
+
+/*************************************************************************************************/
+/*  Shader modules                                                                               */
+/*************************************************************************************************/
+
+VkShaderModule dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFlagBits stage)
+{
+    ASSERT(gpu != NULL);
+    VkShaderModule module = {0};
+
+    size_t size = 0;
+    const uint32_t* spirv = dvz_spirv_compile(code, stage, &size);
+    if (spirv == NULL)
+        return module;
+
     VkShaderModuleCreateInfo createInfo = {0};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = glslang_program_SPIRV_get_size(program) * sizeof(unsigned int);
-    createInfo.pCode = glslang_program_SPIRV_get_ptr(program);
+    createInfo.codeSize = size;
+    createInfo.pCode = spirv;
 
     VkResult res = vkCreateShaderModule(gpu->device, &createInfo, NULL, &module);
     if (res != VK_SUCCESS)
@@ -96,11 +410,5 @@ VkShaderModule dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFl
         log_error("unable to create shader module");
     }
 
-    glslang_program_delete(program);
-
-#else
-    log_error("unable to compile shader to SPIRV, Datoviz was not built with glslang support");
-#endif
-
     return module;
 }
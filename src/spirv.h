@@ -5,9 +5,66 @@
 #include <vulkan/vulkan.h>
 
 typedef struct DvzGpu DvzGpu;
+typedef struct DvzSpirvStats DvzSpirvStats;
 
 
 
+struct DvzSpirvStats
+{
+    uint32_t entry_count;    // number of SPIR-V modules in the memory cache
+    uint64_t hit_count;      // compilations found in the memory cache
+    uint64_t disk_hit_count; // compilations found in the disk cache
+    uint64_t compile_count;  // compilations done by glslang
+    uint64_t failure_count;  // failed compilations
+    double compile_time;     // total duration of the glslang compilations, in seconds
+};
+
+
+
+/**
+ * Compile a GLSL shader to SPIR-V, with a cache in memory and an optional cache on disk.
+ *
+ * The cache key is a hash of the shader stage and code. The returned SPIR-V code is owned by the
+ * cache and remains valid until `dvz_spirv_cache_clear()`.
+ *
+ * @param code the GLSL code
+ * @param stage the shader stage
+ * @param[out] size the size of the SPIR-V code, in bytes
+ * @returns the SPIR-V code, or NULL if the compilation failed
+ */
+DVZ_EXPORT const uint32_t*
+dvz_spirv_compile(const char* code, VkShaderStageFlagBits stage, size_t* size);
+
+/**
+ * Set the directory of the disk cache of the compiled shaders.
+ *
+ * The directory is created if needed. By default, it is given by the `DVZ_SPIRV_CACHE`
+ * environment variable, and there is no disk cache if this variable is not set.
+ *
+ * @param path the directory, or NULL to disable the disk cache
+ */
+DVZ_EXPORT void dvz_spirv_cache_dir(const char* path);
+
+/**
+ * Get the statistics of the SPIR-V cache.
+ *
+ * @returns the statistics
+ */
+DVZ_EXPORT DvzSpirvStats dvz_spirv_stats(void);
+
+/**
+ * Empty the memory cache and reset the statistics. The disk cache is kept.
+ */
+DVZ_EXPORT void dvz_spirv_cache_clear(void);
+
+/**
+ * Compile a GLSL shader and create a shader module.
+ *
+ * @param gpu the GPU
+ * @param code the GLSL code
+ * @param stage the shader stage
+ * @returns the shader module, or a null handle if the compilation failed
+ */
 DVZ_EXPORT VkShaderModule
 dvz_shader_compile(DvzGpu* gpu, const char* code, VkShaderStageFlagBits stage);
 
@@ -0,0 +1,603 @@
+/*************************************************************************************************/
+/*  Tiled multi-resolution image                                                                 */
+/*************************************************************************************************/
+
+/*
+Pyramid of fixed-size tiles of a large image, streamed on demand into the slots of an atlas
+texture. Level 0 is the full resolution image, and every level halves the previous one, until the
+image fits in a single tile. A tile is identified by its level, column, and row, packed into a
+64-bit key.
+
+At every frame, the level whose pixels best match the screen pixels is selected, and the tiles of
+that level that intersect the visible rectangle are requested. Missing tiles are decoded by worker
+threads and sent back to the main thread, which enqueues their upload to a free slot of the atlas,
+or to the least recently used slot not needed by the current frame. The tiles of the coarsest
+level covering the view are always requested so that a missing tile can be drawn with the part of
+its closest resident ancestor.
+
+The atlas uses nearest filtering so that adjacent slots never bleed into each other.
+
+*/
+
+#ifndef DVZ_TILES_HEADER
+#define DVZ_TILES_HEADER
+
+#include "../include/datoviz/visuals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+
+/*************************************************************************************************/
+/*  Utils                                                                                        */
+/*************************************************************************************************/
+
+#define DVZ_TILES_EMPTY_KEY UINT64_MAX
+#define DVZ_TILES_NO_SLOT   UINT32_MAX
+
+
+
+static uint32_t _tiles_pixel_size(VkFormat format)
+{
+    switch (format)
+    {
+    case VK_FORMAT_R8_UNORM:
+    case VK_FORMAT_R8_SNORM:
+    case VK_FORMAT_R8_UINT:
+        return 1;
+    case VK_FORMAT_R16_UNORM:
+    case VK_FORMAT_R16_SNORM:
+    case VK_FORMAT_R16_UINT:
+    case VK_FORMAT_R16_SFLOAT:
+        return 2;
+    case VK_FORMAT_R8G8B8A8_UNORM:
+    case VK_FORMAT_R8G8B8A8_SRGB:
+    case VK_FORMAT_R32_SFLOAT:
+    case VK_FORMAT_R32_UINT:
+        return 4;
+    case VK_FORMAT_R32G32B32A32_SFLOAT:
+        return 16;
+    default:
+        break;
+    }
+    return 0;
+}
+
+
+
+static inline uint64_t _tiles_key(uint32_t level, uint32_t col, uint32_t row)
+{
+    return ((uint64_t)level << 48) | ((uint64_t)row << 24) | (uint64_t)col;
+}
+
+
+
+// Size of the image at a given level, in pixels.
+static inline void _tiles_level_size(DvzTiles* tiles, uint32_t level, uvec2 size)
+{
+    ASSERT(tiles != NULL);
+    ASSERT(level < DVZ_TILES_MAX_LEVELS);
+    uint32_t d = 1u << level;
+    size[0] = (tiles->size[0] + d - 1) / d;
+    size[1] = (tiles->size[1] + d - 1) / d;
+}
+
+
+
+// Number of tiles along each axis at a given level.
+static inline void _tiles_level_grid(DvzTiles* tiles, uint32_t level, uvec2 grid)
+{
+    ASSERT(tiles != NULL);
+    uvec2 size = {0};
+    _tiles_level_size(tiles, level, size);
+    grid[0] = (size[0] + tiles->tile_size - 1) / tiles->tile_size;
+    grid[1] = (size[1] + tiles->tile_size - 1) / tiles->tile_size;
+}
+
+
+
+// Number of levels such that the coarsest one fits in a single tile.
+static uint32_t _tiles_level_count(uvec2 size, uint32_t tile_size)
+{
+    ASSERT(tile_size > 0);
+    uint32_t count = 1;
+    uint32_t w = size[0], h = size[1];
+    while ((w > tile_size || h > tile_size) && count < DVZ_TILES_MAX_LEVELS)
+    {
+        w = (w + 1) / 2;
+        h = (h + 1) / 2;
+        count++;
+    }
+    return count;
+}
+
+
+
+/*************************************************************************************************/
+/*  Residency map                                                                                */
+/*************************************************************************************************/
+
+static inline uint32_t _tiles_hash(DvzTiles* tiles, uint64_t key)
+{
+    // Fibonacci hashing, the capacity being a power of two.
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (tiles->map_capacity - 1);
+}
+
+
+
+static uint32_t _tiles_find(DvzTiles* tiles, uint64_t key)
+{
+    ASSERT(tiles != NULL);
+    uint32_t mask = tiles->map_capacity - 1;
+    for (uint32_t i = _tiles_hash(tiles, key);; i = (i + 1) & mask)
+    {
+        if (tiles->map_keys[i] == key)
+            return tiles->map_slots[i];
+        if (tiles->map_keys[i] == DVZ_TILES_EMPTY_KEY)
+            return DVZ_TILES_NO_SLOT;
+    }
+}
+
+
+
+static void _tiles_insert(DvzTiles* tiles, uint64_t key, uint32_t slot)
+{
+    ASSERT(tiles != NULL);
+    uint32_t mask = tiles->map_capacity - 1;
+    uint32_t i = _tiles_hash(tiles, key);
+    while (tiles->map_keys[i] != DVZ_TILES_EMPTY_KEY && tiles->map_keys[i] != key)
+        i = (i + 1) & mask;
+    tiles->map_keys[i] = key;
+    tiles->map_slots[i] = slot;
+}
+
+
+
+// Remove a key with backward shift deletion, which keeps the probe sequences valid without
+// tombstones.
+static void _tiles_remove(DvzTiles* tiles, uint64_t key)
+{
+    ASSERT(tiles != NULL);
+    uint32_t mask = tiles->map_capacity - 1;
+    uint32_t i = _tiles_hash(tiles, key);
+    while (tiles->map_keys[i] != key)
+    {
+        if (tiles->map_keys[i] == DVZ_TILES_EMPTY_KEY)
+            return;
+        i = (i + 1) & mask;
+    }
+
+    uint32_t j = i, h = 0;
+    while (true)
+    {
+        tiles->map_keys[i] = DVZ_TILES_EMPTY_KEY;
+        while (true)
+        {
+            j = (j + 1) & mask;
+            if (tiles->map_keys[j] == DVZ_TILES_EMPTY_KEY)
+                return;
+            // Move the entry at j to i if its home position is not in ]i, j].
+            h = _tiles_hash(tiles, tiles->map_keys[j]);
+            if (i <= j ? (h <= i || h > j) : (h <= i && h > j))
+                break;
+        }
+        tiles->map_keys[i] = tiles->map_keys[j];
+        tiles->map_slots[i] = tiles->map_slots[j];
+        i = j;
+    }
+}
+
+
+
+/*************************************************************************************************/
+/*  Workers                                                                                      */
+/*************************************************************************************************/
+
+// Default decoder: nearest neighbor sampling of a full resolution image kept in memory, passed
+// as user data.
+static void _tiles_array_callback(
+    DvzTiles* tiles, uint32_t level, uint32_t col, uint32_t row, uvec2 shape, void* pixels,
+    void* user_data)
+{
+    ASSERT(tiles != NULL);
+    ASSERT(pixels != NULL);
+    ASSERT(user_data != NULL);
+
+    const char* image = (const char*)user_data;
+    uint32_t ts = tiles->tile_size;
+    uint32_t ps = tiles->pixel_size;
+    uint64_t d = 1ull << level;
+    uint64_t x = 0, y = 0;
+    for (uint32_t j = 0; j < shape[1]; j++)
+    {
+        y = ((uint64_t)row * ts + j) * d;
+        for (uint32_t i = 0; i < shape[0]; i++)
+        {
+            x = ((uint64_t)col * ts + i) * d;
+            memcpy(
+                (char*)pixels + ((uint64_t)j * ts + i) * ps, //
+                image + (y * tiles->size[0] + x) * ps, ps);
+        }
+    }
+}
+
+
+
+static void* _tiles_worker(void* user_data)
+{
+    DvzTiles* tiles = (DvzTiles*)user_data;
+    ASSERT(tiles != NULL);
+
+    DvzTileRequest* req = NULL;
+    while (true)
+    {
+        req = (DvzTileRequest*)dvz_fifo_dequeue(&tiles->request_queue, true);
+        ASSERT(req != NULL);
+        if (req->tiles == NULL)
+            break;
+
+        ASSERT(req->pixels != NULL);
+        tiles->callback(
+            tiles, req->level, req->col, req->row, req->shape, req->pixels, tiles->user_data);
+        dvz_fifo_enqueue(&tiles->done_queue, req);
+    }
+    return NULL;
+}
+
+
+
+static void _tiles_request_free(DvzTileRequest* req)
+{
+    ASSERT(req != NULL);
+    FREE(req->pixels);
+    FREE(req);
+}
+
+
+
+/*************************************************************************************************/
+/*  Streaming                                                                                    */
+/*************************************************************************************************/
+
+// Free slot, or least recently used resident slot that is not needed by the current frame.
+static uint32_t _tiles_lru_slot(DvzTiles* tiles)
+{
+    ASSERT(tiles != NULL);
+    uint32_t slot = DVZ_TILES_NO_SLOT;
+    uint64_t oldest = tiles->frame;
+    DvzTileSlot* s = NULL;
+    for (uint32_t i = 0; i < tiles->slot_count; i++)
+    {
+        s = &tiles->slots[i];
+        if (s->state == DVZ_TILE_SLOT_FREE)
+            return i;
+        if (s->state == DVZ_TILE_SLOT_RESIDENT && s->last_used < oldest)
+        {
+            oldest = s->last_used;
+            slot = i;
+        }
+    }
+    return slot;
+}
+
+
+
+// Mark a tile as used by the current frame, and send it to the workers if it is not in the atlas
+// yet. Return whether the tile is resident.
+static bool _tiles_request(DvzTiles* tiles, uint32_t level, uint32_t col, uint32_t row)
+{
+    ASSERT(tiles != NULL);
+    uint64_t key = _tiles_key(level, col, row);
+    uint32_t slot = _tiles_find(tiles, key);
+    if (slot != DVZ_TILES_NO_SLOT)
+    {
+        tiles->slots[slot].last_used = tiles->frame;
+        return tiles->slots[slot].state == DVZ_TILE_SLOT_RESIDENT;
+    }
+
+    if (tiles->stats.pending >= DVZ_TILES_MAX_REQUESTS)
+        return false;
+    slot = _tiles_lru_slot(tiles);
+    if (slot == DVZ_TILES_NO_SLOT)
+    {
+        log_trace("tile atlas full, increase the memory budget");
+        return false;
+    }
+
+    // Evict the tile in the slot.
+    DvzTileSlot* s = &tiles->slots[slot];
+    if (s->state == DVZ_TILE_SLOT_RESIDENT)
+    {
+        _tiles_remove(tiles, s->key);
+        tiles->stats.evictions++;
+        tiles->stats.resident--;
+    }
+    s->key = key;
+    s->last_used = tiles->frame;
+    s->state = DVZ_TILE_SLOT_PENDING;
+    _tiles_insert(tiles, key, slot);
+    tiles->stats.pending++;
+
+    // Send the tile to the workers.
+    uint32_t ts = tiles->tile_size;
+    uvec2 size = {0};
+    _tiles_level_size(tiles, level, size);
+    DvzTileRequest* req = (DvzTileRequest*)calloc(1, sizeof(DvzTileRequest));
+    req->tiles = tiles;
+    req->key = key;
+    req->slot = slot;
+    req->level = level;
+    req->col = col;
+    req->row = row;
+    req->shape[0] = MIN(ts, size[0] - col * ts);
+    req->shape[1] = MIN(ts, size[1] - row * ts);
+    req->pixels = calloc((size_t)ts * ts, tiles->pixel_size);
+    dvz_fifo_enqueue(&tiles->request_queue, req);
+    return false;
+}
+
+
+
+// Upload the tiles decoded by the workers to their slots. The pixels are kept until the transfers
+// have been processed, at the next frame. Return the number of uploaded tiles.
+static uint32_t _tiles_receive(DvzTiles* tiles, DvzCanvas* canvas)
+{
+    ASSERT(tiles != NULL);
+    ASSERT(canvas != NULL);
+
+    uint32_t ts = tiles->tile_size;
+    VkDeviceSize size = (VkDeviceSize)ts * ts * tiles->pixel_size;
+    uint32_t count = 0;
+    DvzTileRequest* req = NULL;
+    DvzTileSlot* s = NULL;
+    while ((req = (DvzTileRequest*)dvz_fifo_dequeue(&tiles->done_queue, false)) != NULL)
+    {
+        s = &tiles->slots[req->slot];
+        ASSERT(s->state == DVZ_TILE_SLOT_PENDING);
+        ASSERT(s->key == req->key);
+
+        uvec3 offset = {(req->slot % tiles->cols) * ts, (req->slot / tiles->cols) * ts, 0};
+        dvz_upload_texture(canvas, tiles->atlas, offset, (uvec3){ts, ts, 1}, size, req->pixels);
+        s->state = DVZ_TILE_SLOT_RESIDENT;
+        tiles->stats.pending--;
+        tiles->stats.resident++;
+        tiles->stats.uploads++;
+
+        if (tiles->uploaded_count >= tiles->uploaded_capacity)
+        {
+            tiles->uploaded_capacity =
+                tiles->uploaded_capacity == 0 ? 16 : 2 * tiles->uploaded_capacity;
+            REALLOC(tiles->uploaded, tiles->uploaded_capacity * sizeof(DvzTileRequest*));
+        }
+        tiles->uploaded[tiles->uploaded_count++] = req;
+        count++;
+    }
+    return count;
+}
+
+
+
+static void _tiles_free_uploaded(DvzTiles* tiles)
+{
+    ASSERT(tiles != NULL);
+    for (uint32_t i = 0; i < tiles->uploaded_count; i++)
+        _tiles_request_free(tiles->uploaded[i]);
+    tiles->uploaded_count = 0;
+}
+
+
+
+// Fraction of the image along an axis, sorted and clipped to [0, 1].
+static void _tiles_fraction(double p0, double p1, const dvec2 lim, dvec2 f)
+{
+    double a = p1 != p0 ? (lim[0] - p0) / (p1 - p0) : 0;
+    double b = p1 != p0 ? (lim[1] - p0) / (p1 - p0) : 1;
+    f[0] = CLIP(MIN(a, b), 0, 1);
+    f[1] = CLIP(MAX(a, b), 0, 1);
+}
+
+
+
+// Select the level matching the screen resolution and compute the range of visible tiles. Return
+// whether the view has changed.
+static bool _tiles_view(DvzTiles* tiles)
+{
+    ASSERT(tiles != NULL);
+
+    // Number of image pixels per screen pixel, along each axis.
+    double w = fabs(tiles->p1[0] - tiles->p0[0]) / (tiles->xlim[1] - tiles->xlim[0]);
+    double h = fabs(tiles->p1[1] - tiles->p0[1]) / (tiles->ylim[1] - tiles->ylim[0]);
+    double rx = w > 0 ? tiles->size[0] / (w * MAX(1, tiles->viewport[0])) : 1;
+    double ry = h > 0 ? tiles->size[1] / (h * MAX(1, tiles->viewport[1])) : 1;
+    double ratio = MIN(rx, ry);
+    uint32_t level = ratio > 1 ? (uint32_t)floor(log2(ratio)) : 0;
+    level = MIN(level, tiles->level_count - 1);
+
+    // Visible tiles.
+    dvec2 fx = {0}, fy = {0};
+    _tiles_fraction(tiles->p0[0], tiles->p1[0], tiles->xlim, fx);
+    _tiles_fraction(tiles->p0[1], tiles->p1[1], tiles->ylim, fy);
+    uvec2 size = {0}, grid = {0};
+    _tiles_level_size(tiles, level, size);
+    _tiles_level_grid(tiles, level, grid);
+    double ts = tiles->tile_size;
+    uint32_t c0 = MIN((uint32_t)floor(fx[0] * size[0] / ts), grid[0]);
+    uint32_t c1 = MIN((uint32_t)ceil(fx[1] * size[0] / ts), grid[0]);
+    uint32_t r0 = MIN((uint32_t)floor(fy[0] * size[1] / ts), grid[1]);
+    uint32_t r1 = MIN((uint32_t)ceil(fy[1] * size[1] / ts), grid[1]);
+
+    bool changed = level != tiles->level || c0 != tiles->c0 || c1 != tiles->c1 ||
+                   r0 != tiles->r0 || r1 != tiles->r1;
+    tiles->level = level;
+    tiles->c0 = c0;
+    tiles->c1 = c1;
+    tiles->r0 = r0;
+    tiles->r1 = r1;
+    return changed;
+}
+
+
+
+// Per-frame update: request the visible tiles and upload the decoded ones. Return whether the
+// quads must be recomputed.
+static bool _tiles_update(DvzTiles* tiles, DvzCanvas* canvas)
+{
+    ASSERT(tiles != NULL);
+    ASSERT(canvas != NULL);
+
+    // The transfers enqueued at the previous frame have been processed.
+    _tiles_free_uploaded(tiles);
+    tiles->frame++;
+
+    bool changed = _tiles_view(tiles);
+    uint32_t level = tiles->level;
+    uint32_t top = tiles->level_count - 1;
+    uint32_t k = top - level;
+
+    // Coarsest tiles covering the view, used when a visible tile is missing.
+    for (uint32_t r = tiles->r0 >> k; r < ((tiles->r1 + (1u << k) - 1) >> k); r++)
+        for (uint32_t c = tiles->c0 >> k; c < ((tiles->c1 + (1u << k) - 1) >> k); c++)
+            _tiles_request(tiles, top, c, r);
+
+    // Visible tiles.
+    for (uint32_t r = tiles->r0; r < tiles->r1; r++)
+    {
+        for (uint32_t c = tiles->c0; c < tiles->c1; c++)
+        {
+            if (_tiles_request(tiles, level, c, r))
+                tiles->stats.hits++;
+            else
+                tiles->stats.misses++;
+        }
+    }
+
+    return _tiles_receive(tiles, canvas) > 0 || changed;
+}
+
+
+
+/*************************************************************************************************/
+/*  Quads                                                                                        */
+/*************************************************************************************************/
+
+// Maximum number of quads for the current view.
+static uint32_t _tiles_max_quads(DvzTiles* tiles)
+{
+    ASSERT(tiles != NULL);
+    return (tiles->c1 - tiles->c0) * (tiles->r1 - tiles->r0);
+}
+
+
+
+// One quad per visible tile, textured with the tile itself or with the part of its closest
+// resident ancestor. Return the number of quads.
+static uint32_t _tiles_quads(DvzTiles* tiles, DvzGraphicsImageItem* items)
+{
+    ASSERT(tiles != NULL);
+    ASSERT(items != NULL);
+
+    uint32_t level = tiles->level;
+    uint32_t ts = tiles->tile_size;
+    uvec2 size = {0};
+    _tiles_level_size(tiles, level, size);
+    double aw = tiles->cols * ts, ah = tiles->rows * ts;
+
+    uint32_t count = 0, slot = 0, k = 0;
+    double x0 = 0, x1 = 0, y0 = 0, y1 = 0, u0 = 0, u1 = 0, v0 = 0, v1 = 0, d = 0;
+    DvzGraphicsImageItem* item = NULL;
+    for (uint32_t r = tiles->r0; r < tiles->r1; r++)
+    {
+        for (uint32_t c = tiles->c0; c < tiles->c1; c++)
+        {
+            // Closest resident tile.
+            for (k = 0; level + k < tiles->level_count; k++)
+            {
+                slot = _tiles_find(tiles, _tiles_key(level + k, c >> k, r >> k));
+                if (slot != DVZ_TILES_NO_SLOT &&
+                    tiles->slots[slot].state == DVZ_TILE_SLOT_RESIDENT)
+                    break;
+            }
+            if (level + k >= tiles->level_count)
+                continue;
+
+            // Tile rectangle, in pixels of its level.
+            x0 = c * ts;
+            x1 = MIN((c + 1) * ts, size[0]);
+            y0 = r * ts;
+            y1 = MIN((r + 1) * ts, size[1]);
+
+            // Texture coordinates within the slot of the resident tile.
+            d = 1.0 / (1u << k);
+            u0 = (slot % tiles->cols) * ts + x0 * d - (c >> k) * ts;
+            u1 = u0 + (x1 - x0) * d;
+            v0 = (slot / tiles->cols) * ts + y0 * d - (r >> k) * ts;
+            v1 = v0 + (y1 - y0) * d;
+
+            // Positions, by linear interpolation between the corners of the image.
+            x0 = tiles->p0[0] + (tiles->p1[0] - tiles->p0[0]) * x0 / size[0];
+            x1 = tiles->p0[0] + (tiles->p1[0] - tiles->p0[0]) * x1 / size[0];
+            y0 = tiles->p0[1] + (tiles->p1[1] - tiles->p0[1]) * y0 / size[1];
+            y1 = tiles->p0[1] + (tiles->p1[1] - tiles->p0[1]) * y1 / size[1];
+
+            item = &items[count++];
+            memset(item, 0, sizeof(DvzGraphicsImageItem));
+            item->pos0[0] = x0, item->pos0[1] = y0;
+            item->pos1[0] = x1, item->pos1[1] = y0;
+            item->pos2[0] = x1, item->pos2[1] = y1;
+            item->pos3[0] = x0, item->pos3[1] = y1;
+            item->uv0[0] = u0 / aw, item->uv0[1] = v0 / ah;
+            item->uv1[0] = u1 / aw, item->uv1[1] = v0 / ah;
+            item->uv2[0] = u1 / aw, item->uv2[1] = v1 / ah;
+            item->uv3[0] = u0 / aw, item->uv3[1] = v1 / ah;
+        }
+    }
+    ASSERT(count <= _tiles_max_quads(tiles));
+    return count;
+}
+
+
+
+/*************************************************************************************************/
+/*  Destruction                                                                                  */
+/*************************************************************************************************/
+
+static void _tiles_destroy(DvzTiles* tiles)
+{
+    ASSERT(tiles != NULL);
+
+    // Stop the workers with a NULL tiles pointer, once the pending requests have been decoded.
+    DvzTileRequest stop = {0};
+    for (uint32_t i = 0; i < tiles->worker_count; i++)
+        dvz_fifo_enqueue(&tiles->request_queue, &stop);
+    for (uint32_t i = 0; i < tiles->worker_count; i++)
+        dvz_thread_join(&tiles->workers[i]);
+
+    DvzTileRequest* req = NULL;
+    while ((req = (DvzTileRequest*)dvz_fifo_dequeue(&tiles->done_queue, false)) != NULL)
+        _tiles_request_free(req);
+    _tiles_free_uploaded(tiles);
+    FREE(tiles->uploaded);
+    dvz_fifo_destroy(&tiles->request_queue);
+    dvz_fifo_destroy(&tiles->done_queue);
+
+    FREE(tiles->slots);
+    FREE(tiles->map_keys);
+    FREE(tiles->map_slots);
+
+    if (tiles->atlas != NULL)
+    {
+        dvz_gpu_wait(tiles->atlas->context->gpu);
+        dvz_texture_destroy(tiles->atlas);
+        tiles->atlas = NULL;
+    }
+}
+
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -96,6 +96,14 @@ static void _process_buffer_upload(DvzCanvas* canvas, DvzTransfer tr)
             br.buffer, br.offsets[0] + tr.u.buf.offset, tr.u.buf.size, tr.u.buf.data);
     }
 
+    // Large non-mappable buffers are streamed in chunks to bound the size of the staging
+    // buffer.
+    else if (_stream_upload(context, tr.u.buf.size))
+    {
+        ASSERT(br.count == 1);
+        _stream_buffer_upload(context, br, tr.u.buf.offset, tr.u.buf.size, tr.u.buf.data);
+    }
+
     // All other (non-mappable) buffers. Require synchronization and copy on command
     // buffer.
     else
@@ -253,6 +261,8 @@ void dvz_process_transfers(DvzCanvas* canvas)
         return;
 
     // Process all pending transfer tasks.
+    // NOTE: the staging buffer and the transfer command buffer are shared by all canvases.
+    dvz_gpu_lock(gpu);
     DvzTransfer tr = {0};
     while (true)
     {
@@ -283,6 +293,7 @@ void dvz_process_transfers(DvzCanvas* canvas)
 
         fifo->is_processing = false;
     }
+    dvz_gpu_unlock(gpu);
 }
 
 
@@ -1,6 +1,13 @@
 #include "../include/datoviz/visuals.h"
 #include "../include/datoviz/canvas.h"
 #include "../include/datoviz/graphics.h"
+#include "bricks.h"
+#include "culling.h"
+#include "depth_sort.h"
+#include "lod.h"
+#include "mesh_levels.h"
+#include "spatial.h"
+#include "tiles.h"
 #include "visuals_utils.h"
 
 
@@ -15,6 +22,7 @@ DvzVisual dvz_visual(DvzCanvas* canvas)
 
     DvzVisual visual = {0};
     visual.canvas = canvas;
+    visual.pick_id = ++canvas->last_visual_id;
     visual.props =
         dvz_container(DVZ_CONTAINER_DEFAULT_COUNT, sizeof(DvzProp), DVZ_OBJECT_TYPE_PROP);
     visual.sources =
@@ -47,6 +55,11 @@ void dvz_visual_destroy(DvzVisual* visual)
         dvz_array_destroy(&prop->arr_orig);
         dvz_array_destroy(&prop->arr_trans);
         dvz_array_destroy(&prop->arr_staging);
+        if (prop->spatial != NULL)
+        {
+            _spatial_destroy(prop->spatial);
+            FREE(prop->spatial);
+        }
         if (prop->default_value != NULL)
         {
             FREE(prop->default_value)
@@ -71,6 +84,48 @@ void dvz_visual_destroy(DvzVisual* visual)
     CONTAINER_DESTROY_ITEMS(DvzBindings, visual->bindings, dvz_bindings_destroy)
     CONTAINER_DESTROY_ITEMS(DvzBindings, visual->bindings_comp, dvz_bindings_destroy)
 
+    // Free the level of detail pyramid.
+    if (visual->lod != NULL)
+    {
+        _lod_destroy(visual->lod);
+        FREE(visual->lod);
+    }
+
+    // Stop the tile workers and free the tile atlas.
+    if (visual->tiles != NULL)
+    {
+        _tiles_destroy(visual->tiles);
+        FREE(visual->tiles);
+    }
+
+    // Stop the brick workers and free the brick atlas and the pyramid.
+    if (visual->bricks != NULL)
+    {
+        _bricks_destroy(visual->bricks);
+        FREE(visual->bricks);
+    }
+
+    // Stop the mesh simplification worker.
+    if (visual->mesh_levels != NULL)
+    {
+        _mesh_levels_destroy(visual->mesh_levels);
+        FREE(visual->mesh_levels);
+    }
+
+    // Free the culling boxes.
+    if (visual->culling != NULL)
+    {
+        _culling_destroy(visual->culling);
+        FREE(visual->culling);
+    }
+
+    // Stop the depth sort worker.
+    if (visual->depth_sort != NULL)
+    {
+        _depth_sort_destroy(visual->depth_sort);
+        FREE(visual->depth_sort);
+    }
+
     dvz_obj_destroyed(&visual->obj);
 }
 
@@ -264,6 +319,38 @@ void dvz_visual_group(DvzVisual* visual, uint32_t group_idx, uint32_t size)
 
 
 
+// Mark the prop and its source as changed after an update of its original data.
+static void
+_prop_changed(DvzVisual* visual, DvzProp* prop, uint32_t first_item, uint32_t item_count)
+{
+    ASSERT(visual != NULL);
+    ASSERT(prop != NULL);
+
+    // The level of detail pyramid must be rebuilt from the new positions.
+    if (visual->lod != NULL && prop->prop_type == DVZ_PROP_POS)
+        visual->lod->data_changed = true;
+
+    // Keep the spatial index in sync with the new positions.
+    if (prop->spatial != NULL)
+        _spatial_update(
+            prop->spatial, prop->arr_orig.item_count, (const dvec3*)prop->arr_orig.data,
+            first_item, item_count);
+
+    prop->obj.request = DVZ_VISUAL_REQUEST_UPLOAD;
+
+    DvzSource* source = prop->source;
+    if (source != NULL)
+    {
+        log_trace("source type %d #%d handled by lib", source->source_type, source->source_idx);
+        source->origin = DVZ_SOURCE_ORIGIN_LIB;
+        // source->obj.status = DVZ_OBJECT_STATUS_NEED_UPDATE;
+        // visual->obj.status = DVZ_OBJECT_STATUS_NEED_UPDATE;
+        _source_set_changed(source, true);
+    }
+}
+
+
+
 void dvz_visual_data(
     DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count, const void* data)
 {
@@ -300,22 +387,55 @@ void dvz_visual_data_partial(
         count = 1;
     }
 
+    // A borrowed buffer is not copied if it is entirely replaced.
+    if (first_item == 0)
+        _array_release(&prop->arr_orig);
+
     // Make sure the array has the right size.
     dvz_array_resize(&prop->arr_orig, count);
 
     // Copy the specified array to the prop array.
     dvz_array_data(&prop->arr_orig, first_item, item_count, data_item_count, data);
 
-    prop->obj.request = DVZ_VISUAL_REQUEST_UPLOAD;
+    _prop_changed(visual, prop, first_item, item_count);
+}
 
-    if (source != NULL)
-    {
-        log_trace("source type %d #%d handled by lib", source->source_type, source->source_idx);
-        source->origin = DVZ_SOURCE_ORIGIN_LIB;
-        // source->obj.status = DVZ_OBJECT_STATUS_NEED_UPDATE;
-        // visual->obj.status = DVZ_OBJECT_STATUS_NEED_UPDATE;
-        _source_set_changed(source, true);
-    }
+
+
+void dvz_visual_data_borrow(
+    DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count, void* data)
+{
+    ASSERT(visual != NULL);
+    ASSERT(count > 0);
+    ASSERT(data != NULL);
+
+    DvzProp* prop = dvz_prop_get(visual, prop_type, prop_idx);
+    ASSERT(prop != NULL);
+    if (prop->source != NULL && prop->source->source_kind == DVZ_SOURCE_KIND_UNIFORM)
+        count = 1;
+
+    dvz_array_borrow(&prop->arr_orig, count, data);
+    _prop_changed(visual, prop, 0, count);
+}
+
+
+
+void dvz_visual_data_convert(
+    DvzVisual* visual, DvzPropType prop_type, uint32_t prop_idx, uint32_t count,
+    DvzDataType dtype, const void* data)
+{
+    ASSERT(visual != NULL);
+    ASSERT(count > 0);
+    ASSERT(data != NULL);
+
+    DvzProp* prop = dvz_prop_get(visual, prop_type, prop_idx);
+    ASSERT(prop != NULL);
+    if (prop->source != NULL && prop->source->source_kind == DVZ_SOURCE_KIND_UNIFORM)
+        count = 1;
+
+    if (dvz_array_convert(&prop->arr_orig, count, dtype, data) != 0)
+        return;
+    _prop_changed(visual, prop, 0, count);
 }
 
 
@@ -332,6 +452,97 @@ void dvz_visual_data_append(
 
 
 
+void dvz_visual_spatial_index(DvzVisual* visual, uint32_t prop_idx, bool enable)
+{
+    ASSERT(visual != NULL);
+    DvzProp* prop = dvz_prop_get(visual, DVZ_PROP_POS, prop_idx);
+    if (prop == NULL)
+    {
+        log_error("the visual has no POS prop #%d", prop_idx);
+        return;
+    }
+    if (prop->dtype != DVZ_DTYPE_DVEC3)
+    {
+        log_error("the spatial index requires a dvec3 POS prop");
+        return;
+    }
+
+    if (!enable)
+    {
+        if (prop->spatial != NULL)
+        {
+            _spatial_destroy(prop->spatial);
+            FREE(prop->spatial);
+        }
+        return;
+    }
+    if (prop->spatial == NULL)
+        prop->spatial = (DvzSpatialIndex*)calloc(1, sizeof(DvzSpatialIndex));
+    ASSERT(prop->spatial != NULL);
+    _spatial_build(prop->spatial, prop->arr_orig.item_count, (const dvec3*)prop->arr_orig.data);
+}
+
+
+
+void dvz_visual_depth_sort(DvzVisual* visual, bool enable)
+{
+    ASSERT(visual != NULL);
+    ASSERT(visual->canvas != NULL);
+
+    if (!enable)
+    {
+        if (visual->depth_sort != NULL)
+        {
+            _depth_sort_destroy(visual->depth_sort);
+            FREE(visual->depth_sort);
+            dvz_canvas_to_refill(visual->canvas);
+        }
+        return;
+    }
+    if (visual->depth_sort != NULL)
+        return;
+
+    // The sorted index buffer replaces the draw command of the default fill callback.
+    DvzGraphics* graphics = visual->graphics_count > 0 ? visual->graphics[0] : NULL;
+    if (graphics == NULL || (graphics->topology != VK_PRIMITIVE_TOPOLOGY_POINT_LIST &&
+                             graphics->topology != VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST))
+    {
+        log_error("the depth sort requires a point list or a triangle list graphics");
+        return;
+    }
+    if (graphics->instance_vertex_count > 0 || visual->mesh_levels != NULL ||
+        visual->callback_fill != _default_visual_fill)
+    {
+        log_error("the depth sort is not supported by instanced graphics or custom draw commands");
+        return;
+    }
+
+    DvzDepthSort* sort = (DvzDepthSort*)calloc(1, sizeof(DvzDepthSort));
+    sort->visual = visual;
+    sort->dirty = true;
+    sort->queue = dvz_fifo(4);
+    atomic_init(&sort->busy, false);
+    atomic_init(&sort->cancel, false);
+    visual->depth_sort = sort;
+    sort->worker = dvz_thread(_depth_sort_worker, sort);
+}
+
+
+
+DvzDepthSortStats dvz_visual_depth_sort_stats(DvzVisual* visual)
+{
+    ASSERT(visual != NULL);
+    DvzDepthSortStats stats = {0};
+    if (visual->depth_sort == NULL)
+    {
+        log_error("the visual has no depth sort");
+        return stats;
+    }
+    return visual->depth_sort->stats;
+}
+
+
+
 static DvzSource*
 _assert_source_exists(DvzVisual* visual, DvzSourceType source_type, uint32_t source_idx)
 {
@@ -794,19 +1005,30 @@ void dvz_visual_update(
         dvz_container_iter(&iter);
     }
 
-    // Update the bindings that need to be updated.
+    // Update the bindings that need to be updated. The command buffers must be refilled when the
+    // bindings switch to descriptor sets shared with other bindings, or stop sharing them.
+    VkDescriptorSet dset = VK_NULL_HANDLE;
+    bool refill = false;
     for (uint32_t i = 0; i < visual->graphics_count; i++)
     {
         bindings = dvz_container_get(&visual->bindings, i);
         ASSERT(bindings != NULL);
-        if (bindings->obj.status == DVZ_OBJECT_STATUS_NEED_UPDATE)
-            dvz_bindings_update(bindings);
+        if (bindings->obj.status != DVZ_OBJECT_STATUS_NEED_UPDATE)
+            continue;
+        dset = bindings->dsets[0];
+        dvz_bindings_update(bindings);
+        refill |= bindings->dsets[0] != dset;
     }
     for (uint32_t i = 0; i < visual->compute_count; i++)
     {
         bindings = dvz_container_get(&visual->bindings_comp, i);
         ASSERT(bindings != NULL);
-        if (bindings->obj.status == DVZ_OBJECT_STATUS_NEED_UPDATE)
-            dvz_bindings_update(bindings);
+        if (bindings->obj.status != DVZ_OBJECT_STATUS_NEED_UPDATE)
+            continue;
+        dset = bindings->dsets[0];
+        dvz_bindings_update(bindings);
+        refill |= bindings->dsets[0] != dset;
     }
+    if (refill)
+        dvz_canvas_to_refill(canvas);
 }
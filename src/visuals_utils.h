@@ -616,17 +616,43 @@ static void _default_visual_fill(DvzVisual* visual, DvzVisualFillEvent ev)
         }
         ASSERT(vertex_count > 0);
 
+        // Viewport culling: skip the visual, or only draw the range of the visible chunks.
+        uint32_t first_vertex = 0;
+        DvzCulling* culling = pipeline_idx == 0 ? visual->culling : NULL;
+        if (culling != NULL && culling->vertex_count == vertex_count)
+        {
+            if (!culling->visible)
+            {
+                log_debug("skip the visual outside of the view");
+                continue;
+            }
+            // The indexed or sorted primitives may come from any chunk.
+            if (!culling->indexed && visual->depth_sort == NULL)
+            {
+                first_vertex = culling->first;
+                vertex_count = culling->count;
+            }
+        }
+
         // Bind the vertex buffer.
         DvzBufferRegions* vertex_buf = &vertex_source->u.br;
         ASSERT(vertex_buf != NULL);
         dvz_cmd_bind_vertex_buffer(cmds, idx, *vertex_buf, 0);
 
-        // Index buffer?
+        // Index buffer? The depth sort replaces it with the sorted primitives.
         DvzSource* index_source =
             _get_pipeline_source(visual, DVZ_SOURCE_TYPE_INDEX, pipeline_idx);
+        DvzDepthSort* sort = pipeline_idx == 0 ? visual->depth_sort : NULL;
         uint32_t index_count = 0;
         DvzBufferRegions* index_buf = NULL;
-        if (index_source != NULL)
+        bool sorted = sort != NULL && sort->ready && sort->primitive_count > 0;
+        if (sorted)
+        {
+            index_count = sort->primitive_count * sort->primitive_size;
+            index_buf = &sort->br;
+            dvz_cmd_bind_index_buffer(cmds, idx, *index_buf, 0);
+        }
+        else if (index_source != NULL)
         {
             index_count = index_source->arr.item_count;
             if (index_count > 0)
@@ -638,21 +664,45 @@ static void _default_visual_fill(DvzVisual* visual, DvzVisualFillEvent ev)
         }
 
         // Draw command.
-        dvz_cmd_bind_graphics(cmds, idx, visual->graphics[pipeline_idx], bindings, 0);
+        DvzGraphics* graphics = visual->graphics[pipeline_idx];
+        dvz_cmd_bind_graphics(cmds, idx, graphics, bindings, 0);
 
-        if (index_count == 0)
+        // Instanced graphics: every vertex is an instance of the shared primitive.
+        if (graphics->instance_vertex_count > 0)
+        {
+            log_debug("draw %d instances", vertex_count);
+            ASSERT(
+                vertex_buf->size >= (first_vertex + vertex_count) * vertex_source->arr.item_size);
+            if (index_count > 0)
+                dvz_cmd_draw_indexed_instanced(cmds, idx, index_count, first_vertex, vertex_count);
+            else
+                dvz_cmd_draw_instanced(
+                    cmds, idx, graphics->instance_vertex_count, first_vertex, vertex_count);
+        }
+        else if (index_count == 0)
         {
             log_debug("draw %d vertices", vertex_count);
             // Make sure the bound vertex buffer is large enough.
-            ASSERT(vertex_buf->size >= vertex_count * vertex_source->arr.item_size);
-            dvz_cmd_draw(cmds, idx, 0, vertex_count);
+            ASSERT(
+                vertex_buf->size >= (first_vertex + vertex_count) * vertex_source->arr.item_size);
+            dvz_cmd_draw(cmds, idx, first_vertex, vertex_count);
         }
         else
         {
+            // Only draw the index range of the selected level of detail of a mesh.
+            uint32_t first_index = 0;
+            DvzMeshLevels* levels = visual->mesh_levels;
+            if (!sorted && levels != NULL && levels->index_count > 0 &&
+                levels->first_index + levels->index_count <= index_count)
+            {
+                first_index = levels->first_index;
+                index_count = levels->index_count;
+            }
+
             log_debug("draw %d indices", index_count);
             // Make sure the bound index buffer is large enough.
-            ASSERT(index_buf->size >= index_count * sizeof(DvzIndex));
-            dvz_cmd_draw_indexed(cmds, idx, 0, 0, index_count);
+            ASSERT(index_buf->size >= (first_index + index_count) * sizeof(DvzIndex));
+            dvz_cmd_draw_indexed(cmds, idx, first_index, 0, index_count);
         }
     }
 }
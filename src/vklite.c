@@ -175,6 +175,19 @@ void dvz_gpu_create(DvzGpu* gpu, VkSurfaceKHR surface)
         // Create command pool only for the queue families that appear in the requested queues.
         if (q->cmd_pools[qf] == VK_NULL_HANDLE)
             create_command_pool(gpu->device, qf, &q->cmd_pools[qf]);
+
+        if (pthread_mutex_init(&q->locks[i], NULL) != 0)
+            log_error("queue mutex creation failed");
+    }
+
+    // The GPU lock is recursive as the transfer functions may be nested.
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+        if (pthread_mutex_init(&gpu->lock, &attr) != 0)
+            log_error("GPU mutex creation failed");
+        pthread_mutexattr_destroy(&attr);
     }
 
     // Create descriptor pool.
@@ -186,12 +199,64 @@ void dvz_gpu_create(DvzGpu* gpu, VkSurfaceKHR surface)
 
 
 
+// Several queue indices may refer to the same VkQueue: they must share the same lock.
+static pthread_mutex_t* _queue_mutex(DvzQueues* q, uint32_t queue_idx)
+{
+    ASSERT(q != NULL);
+    ASSERT(queue_idx < q->queue_count);
+    VkQueue queue = q->queues[queue_idx];
+    for (uint32_t i = 0; i < queue_idx; i++)
+    {
+        if (q->queues[i] == queue)
+            return &q->locks[i];
+    }
+    return &q->locks[queue_idx];
+}
+
+
+
+static void _queue_lock(DvzGpu* gpu, uint32_t queue_idx)
+{
+    pthread_mutex_lock(_queue_mutex(&gpu->queues, queue_idx));
+}
+
+
+
+static void _queue_unlock(DvzGpu* gpu, uint32_t queue_idx)
+{
+    pthread_mutex_unlock(_queue_mutex(&gpu->queues, queue_idx));
+}
+
+
+
 void dvz_queue_wait(DvzGpu* gpu, uint32_t queue_idx)
 {
     ASSERT(gpu != NULL);
     ASSERT(queue_idx < gpu->queues.queue_count);
     // log_trace("waiting for queue #%d", queue_idx);
+    _queue_lock(gpu, queue_idx);
     vkQueueWaitIdle(gpu->queues.queues[queue_idx]);
+    _queue_unlock(gpu, queue_idx);
+}
+
+
+
+void dvz_gpu_lock(DvzGpu* gpu)
+{
+    ASSERT(gpu != NULL);
+    if (!dvz_obj_is_created(&gpu->obj))
+        return;
+    pthread_mutex_lock(&gpu->lock);
+}
+
+
+
+void dvz_gpu_unlock(DvzGpu* gpu)
+{
+    ASSERT(gpu != NULL);
+    if (!dvz_obj_is_created(&gpu->obj))
+        return;
+    pthread_mutex_unlock(&gpu->lock);
 }
 
 
@@ -254,6 +319,7 @@ void dvz_gpu_destroy(DvzGpu* gpu)
     }
 
 
+    _bindings_cache_destroy(gpu);
     if (gpu->dset_pool != VK_NULL_HANDLE)
     {
         log_trace("destroy descriptor pool");
@@ -261,6 +327,10 @@ void dvz_gpu_destroy(DvzGpu* gpu)
         gpu->dset_pool = VK_NULL_HANDLE;
     }
 
+    for (uint32_t i = 0; i < gpu->queues.queue_count; i++)
+        pthread_mutex_destroy(&gpu->queues.locks[i]);
+    pthread_mutex_destroy(&gpu->lock);
+
 
     // Destroy the device.
     log_trace("destroy device");
@@ -548,7 +618,9 @@ void dvz_swapchain_present(
     info.pSwapchains = &swapchain->swapchain;
     info.pImageIndices = &swapchain->img_idx;
 
+    _queue_lock(swapchain->gpu, queue_idx);
     VkResult res = vkQueuePresentKHR(swapchain->gpu->queues.queues[queue_idx], &info);
+    _queue_unlock(swapchain->gpu, queue_idx);
 
     switch (res)
     {
@@ -687,6 +759,7 @@ void dvz_cmd_submit_sync(DvzCommands* cmds, uint32_t idx)
     DvzQueues* q = &cmds->gpu->queues;
     VkQueue queue = q->queues[cmds->queue_idx];
 
+    _queue_lock(cmds->gpu, cmds->queue_idx);
     vkQueueWaitIdle(queue);
     VkSubmitInfo info = {0};
     info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
@@ -694,6 +767,7 @@ void dvz_cmd_submit_sync(DvzCommands* cmds, uint32_t idx)
     info.pCommandBuffers = cmds->cmds;
     vkQueueSubmit(queue, 1, &info, VK_NULL_HANDLE);
     vkQueueWaitIdle(queue);
+    _queue_unlock(cmds->gpu, cmds->queue_idx);
 }
 
 
@@ -889,9 +963,8 @@ void dvz_buffer_resize(DvzBuffer* buffer, VkDeviceSize size, DvzCommands* cmds)
         dvz_cmd_copy_buffer(cmds, 0, buffer, 0, &new_buffer, 0, buffer->size);
         dvz_cmd_end(cmds, 0);
 
-        VkQueue queue = gpu->queues.queues[queue_idx];
         dvz_cmd_submit_sync(cmds, 0);
-        vkQueueWaitIdle(queue);
+        dvz_queue_wait(gpu, queue_idx);
     }
 
     // Delete the old buffer after the transfer has finished.
@@ -1613,8 +1686,10 @@ DvzBindings dvz_bindings(DvzSlots* slots, uint32_t dset_count)
     log_trace("starting creation of bindings with %d descriptor sets...", dset_count);
     bindings.dset_count = dset_count;
 
-    allocate_descriptor_sets(
-        gpu->device, gpu->dset_pool, slots->dset_layout, bindings.dset_count, bindings.dsets);
+    dvz_gpu_lock(gpu);
+    bindings.entry = _bindings_cache_acquire(gpu, slots, dset_count);
+    memcpy(bindings.dsets, bindings.entry->dsets, dset_count * sizeof(VkDescriptorSet));
+    dvz_gpu_unlock(gpu);
 
     dvz_obj_created(&bindings.obj);
     log_trace("bindings created");
@@ -1671,14 +1746,79 @@ void dvz_bindings_update(DvzBindings* bindings)
     ASSERT(bindings->slots->dset_layout != VK_NULL_HANDLE);
     ASSERT(bindings->dset_count > 0);
     ASSERT(bindings->dset_count <= DVZ_MAX_SWAPCHAIN_IMAGES);
+    ASSERT(bindings->entry != NULL);
 
-    for (uint32_t i = 0; i < bindings->dset_count; i++)
+    DvzGpu* gpu = bindings->gpu;
+    DvzSlots* slots = bindings->slots;
+    uint32_t n = slots->slot_count;
+    uint32_t count = bindings->dset_count;
+
+    // Resources of every slot of every descriptor set.
+    DvzDescriptor* descriptors = (DvzDescriptor*)calloc(MAX(1, count * n), sizeof(DvzDescriptor));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!resolve_descriptors(
+                n, slots->types, bindings->br, bindings->images, bindings->samplers, i,
+                &descriptors[i * n]))
+        {
+            FREE(descriptors);
+            return;
+        }
+    }
+    uint64_t hash = descriptors_hash(count * n, descriptors);
+
+    dvz_gpu_lock(gpu);
+    DvzBindingsCache* cache = &gpu->bindings_cache;
+    DvzBindingsCacheEntry* entry = bindings->entry;
+    cache->stats.updates++;
+
+    if (_bindings_cache_match(entry, slots, count, hash, descriptors))
+    {
+        // The resources have not changed.
+        cache->stats.skipped += count * n;
+        FREE(descriptors);
+    }
+    else if ((entry = _bindings_cache_find(cache, slots, count, hash, descriptors)) != NULL)
     {
-        update_descriptor_set(
-            bindings->gpu->device, bindings->slots->slot_count, bindings->slots->types,
-            bindings->br, bindings->images, bindings->samplers, //
-            i, bindings->dsets[i]);
+        // Other bindings use the same resources: share their descriptor sets.
+        log_trace("reuse descriptor sets with the same resources");
+        _bindings_cache_release(cache, bindings->entry);
+        entry->ref_count++;
+        bindings->entry = entry;
+        cache->stats.hits++;
+        cache->stats.skipped += count * n;
+        FREE(descriptors);
+    }
+    else
+    {
+        // The descriptor sets shared with other bindings are left untouched.
+        entry = bindings->entry;
+        if (entry->ref_count > 1)
+        {
+            _bindings_cache_release(cache, entry);
+            entry = _bindings_cache_acquire(gpu, slots, count);
+            bindings->entry = entry;
+        }
+
+        // Only write the descriptors that have changed.
+        uint32_t written = 0;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            written += update_descriptor_set(
+                gpu->device, n, slots->types, &descriptors[i * n],
+                entry->written ? &entry->descriptors[i * n] : NULL, i, entry->dsets[i]);
+        }
+        cache->stats.misses++;
+        cache->stats.writes += written;
+        cache->stats.skipped += count * n - written;
+
+        FREE(entry->descriptors);
+        entry->descriptors = descriptors;
+        entry->hash = hash;
+        entry->written = true;
     }
+    memcpy(bindings->dsets, bindings->entry->dsets, count * sizeof(VkDescriptorSet));
+    dvz_gpu_unlock(gpu);
 
     if (bindings->obj.status == DVZ_OBJECT_STATUS_NEED_UPDATE)
         bindings->obj.status = DVZ_OBJECT_STATUS_CREATED;
@@ -1696,11 +1836,39 @@ void dvz_bindings_destroy(DvzBindings* bindings)
         return;
     }
     log_trace("destroy bindings");
+
+    // The descriptor sets are kept in the cache of the GPU, to be reused by other bindings.
+    if (bindings->entry != NULL && dvz_obj_is_created(&bindings->gpu->obj))
+    {
+        dvz_gpu_lock(bindings->gpu);
+        _bindings_cache_release(&bindings->gpu->bindings_cache, bindings->entry);
+        dvz_gpu_unlock(bindings->gpu);
+    }
+    bindings->entry = NULL;
     dvz_obj_destroyed(&bindings->obj);
 }
 
 
 
+DvzBindingsStats dvz_bindings_stats(DvzGpu* gpu)
+{
+    ASSERT(gpu != NULL);
+    return gpu->bindings_cache.stats;
+}
+
+
+
+void dvz_bindings_retire(DvzGpu* gpu, uint64_t serial)
+{
+    ASSERT(gpu != NULL);
+    dvz_gpu_lock(gpu);
+    DvzBindingsCache* cache = &gpu->bindings_cache;
+    cache->retired = MAX(cache->retired, MIN(serial, cache->serial));
+    dvz_gpu_unlock(gpu);
+}
+
+
+
 /*************************************************************************************************/
 /*  Compute                                                                                      */
 /*************************************************************************************************/
@@ -1919,6 +2087,20 @@ void dvz_graphics_vertex_binding(DvzGraphics* graphics, uint32_t binding, VkDevi
 
 
 
+void dvz_graphics_instanced(DvzGraphics* graphics, uint32_t binding, uint32_t vertex_count)
+{
+    ASSERT(graphics != NULL);
+    ASSERT(vertex_count > 0);
+    for (uint32_t i = 0; i < graphics->vertex_binding_count; i++)
+    {
+        if (graphics->vertex_bindings[i].binding == binding)
+            graphics->vertex_bindings[i].input_rate = VK_VERTEX_INPUT_RATE_INSTANCE;
+    }
+    graphics->instance_vertex_count = vertex_count;
+}
+
+
+
 void dvz_graphics_vertex_attr(
     DvzGraphics* graphics, uint32_t binding, uint32_t location, VkFormat format,
     VkDeviceSize offset)
@@ -1941,6 +2123,14 @@ void dvz_graphics_blend(DvzGraphics* graphics, DvzBlendType blend_type)
 
 
 
+void dvz_graphics_pick(DvzGraphics* graphics, bool pick)
+{
+    ASSERT(graphics != NULL);
+    graphics->pick = pick;
+}
+
+
+
 void dvz_graphics_depth_test(DvzGraphics* graphics, DvzDepthTest depth_test)
 {
     ASSERT(graphics != NULL);
@@ -2012,7 +2202,7 @@ void dvz_graphics_create(DvzGraphics* graphics)
     {
         bindings_info[i].binding = graphics->vertex_bindings[i].binding;
         bindings_info[i].stride = graphics->vertex_bindings[i].stride;
-        bindings_info[i].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+        bindings_info[i].inputRate = graphics->vertex_bindings[i].input_rate;
     }
     vertex_input_info.vertexBindingDescriptionCount = graphics->vertex_binding_count;
     vertex_input_info.pVertexBindingDescriptions = bindings_info;
@@ -2047,9 +2237,23 @@ void dvz_graphics_create(DvzGraphics* graphics)
     VkPipelineRasterizationStateCreateInfo rasterizer =
         create_rasterizer(graphics->cull_mode, graphics->front_face);
     VkPipelineMultisampleStateCreateInfo multisampling = create_multisampling();
-    VkPipelineColorBlendAttachmentState color_blend_attachment = create_color_blend_attachment();
+
+    // One blend state per color attachment of the subpass.
+    VkPipelineColorBlendAttachmentState color_blend_attachments[DVZ_MAX_ATTACHMENTS_PER_RENDERPASS];
+    DvzRenderpassSubpass* subpass = &graphics->renderpass->subpasses[graphics->subpass];
+    uint32_t color_count = 0;
+    for (uint32_t i = 0; i < subpass->attachment_count; i++)
+    {
+        if (graphics->renderpass->attachments[subpass->attachments[i]].type ==
+            DVZ_RENDERPASS_ATTACHMENT_DEPTH)
+            continue;
+        color_blend_attachments[color_count] =
+            color_count == 0 ? create_color_blend_attachment()
+                             : create_color_blend_attachment_extra(graphics->pick);
+        color_count++;
+    }
     VkPipelineColorBlendStateCreateInfo color_blending =
-        create_color_blending(&color_blend_attachment);
+        create_color_blending(color_count, color_blend_attachments);
     VkPipelineDepthStencilStateCreateInfo depth_stencil =
         create_depth_stencil((bool)graphics->depth_test);
     VkPipelineViewportStateCreateInfo viewport_state = create_viewport_state();
@@ -2557,12 +2761,12 @@ void dvz_renderpass_create(DvzRenderpass* renderpass)
             ASSERT(attachment < renderpass->attachment_count);
             if (renderpass->attachments[attachment].type == DVZ_RENDERPASS_ATTACHMENT_DEPTH)
             {
-                subpasses[i].pDepthStencilAttachment = &attachment_refs[j];
+                subpasses[i].pDepthStencilAttachment = &attachment_refs[attachment];
             }
             else
             {
-                attachment_refs_matrix[i][k++] =
-                    create_attachment_ref(i, renderpass->attachments[i].ref_layout);
+                attachment_refs_matrix[i][k++] = create_attachment_ref(
+                    attachment, renderpass->attachments[attachment].ref_layout);
             }
         }
         subpasses[i].colorAttachmentCount = k;
@@ -2887,7 +3091,9 @@ void dvz_submit_send(DvzSubmit* submit, uint32_t cmd_idx, DvzFences* fence, uint
         dvz_fences_reset(fence, fence_idx);
     }
     // log_trace("submit queue and signal fence %d", vfence);
+    _queue_lock(submit->gpu, queue_idx);
     VK_CHECK_RESULT(vkQueueSubmit(submit->gpu->queues.queues[queue_idx], 1, &submit_info, vfence));
+    _queue_unlock(submit->gpu, queue_idx);
 
     // log_trace("submit done");
 }
@@ -3078,6 +3284,39 @@ void dvz_cmd_copy_buffer_to_image(
 
 
 
+void dvz_cmd_copy_buffer_to_image_region(
+    DvzCommands* cmds, uint32_t idx, DvzBuffer* buffer, VkDeviceSize buf_offset,
+    DvzImages* images, uvec3 offset, uvec3 shape)
+{
+    CMD_START_CLIP(images->count)
+
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = buf_offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    region.imageOffset.x = (int32_t)offset[0];
+    region.imageOffset.y = (int32_t)offset[1];
+    region.imageOffset.z = (int32_t)offset[2];
+
+    region.imageExtent.width = shape[0];
+    region.imageExtent.height = shape[1];
+    region.imageExtent.depth = shape[2];
+
+    vkCmdCopyBufferToImage(
+        cb, buffer->buffer, images->images[iclip], //
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    CMD_END
+}
+
+
+
 void dvz_cmd_copy_image_to_buffer(
     DvzCommands* cmds, uint32_t idx, DvzImages* images, DvzBuffer* buffer)
 {
@@ -3110,6 +3349,39 @@ void dvz_cmd_copy_image_to_buffer(
 
 
 
+void dvz_cmd_copy_image_to_buffer_region(
+    DvzCommands* cmds, uint32_t idx, DvzImages* images, uvec3 offset, uvec3 shape,
+    DvzBuffer* buffer, VkDeviceSize buf_offset)
+{
+    CMD_START_CLIP(images->count)
+
+    VkBufferImageCopy region = {0};
+    region.bufferOffset = buf_offset;
+    region.bufferRowLength = 0;
+    region.bufferImageHeight = 0;
+
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = 0;
+    region.imageSubresource.baseArrayLayer = 0;
+    region.imageSubresource.layerCount = 1;
+
+    region.imageOffset.x = (int32_t)offset[0];
+    region.imageOffset.y = (int32_t)offset[1];
+    region.imageOffset.z = (int32_t)offset[2];
+
+    region.imageExtent.width = shape[0];
+    region.imageExtent.height = shape[1];
+    region.imageExtent.depth = shape[2];
+
+    vkCmdCopyImageToBuffer(
+        cb, images->images[iclip], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, //
+        buffer->buffer, 1, &region);
+
+    CMD_END
+}
+
+
+
 void dvz_cmd_copy_image(DvzCommands* cmds, uint32_t idx, DvzImages* src_img, DvzImages* dst_img)
 {
     ASSERT(src_img != NULL);
@@ -3235,6 +3507,32 @@ void dvz_cmd_draw_indexed(
 
 
 
+void dvz_cmd_draw_instanced(
+    DvzCommands* cmds, uint32_t idx, uint32_t vertex_count, uint32_t first_instance,
+    uint32_t instance_count)
+{
+    ASSERT(vertex_count > 0);
+    ASSERT(instance_count > 0);
+    CMD_START
+    vkCmdDraw(cb, vertex_count, instance_count, 0, first_instance);
+    CMD_END
+}
+
+
+
+void dvz_cmd_draw_indexed_instanced(
+    DvzCommands* cmds, uint32_t idx, uint32_t index_count, uint32_t first_instance,
+    uint32_t instance_count)
+{
+    ASSERT(index_count > 0);
+    ASSERT(instance_count > 0);
+    CMD_START
+    vkCmdDrawIndexed(cb, index_count, instance_count, 0, 0, first_instance);
+    CMD_END
+}
+
+
+
 void dvz_cmd_draw_indirect(DvzCommands* cmds, uint32_t idx, DvzBufferRegions indirect)
 {
     CMD_START_CLIP(indirect.count)
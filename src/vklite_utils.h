@@ -1365,27 +1365,23 @@ static bool is_descriptor_type_image(VkDescriptorType binding_type)
 
 
 
-static void update_descriptor_set(
-    VkDevice device, uint32_t binding_count, VkDescriptorType* types,            //
+// Resolve the resources bound to the slots for the descriptor set #idx.
+static bool resolve_descriptors(
+    uint32_t binding_count, VkDescriptorType* types,                             //
     DvzBufferRegions* buffer_regions, DvzImages** images, DvzSampler** samplers, //
-    uint32_t idx, VkDescriptorSet dset)
+    uint32_t idx, DvzDescriptor* descriptors)
 {
-    log_trace("update descriptor set #%d", idx);
-    VkWriteDescriptorSet* descriptor_writes = calloc(binding_count, sizeof(VkWriteDescriptorSet));
-
-    VkDescriptorBufferInfo buffer_infos[DVZ_MAX_BINDINGS_SIZE] = {0};
-    VkDescriptorImageInfo image_infos[DVZ_MAX_BINDINGS_SIZE] = {0};
-
     VkDescriptorType binding_type = {0};
     DvzBufferRegions* br = NULL;
+    uint32_t idx_clip = 0;
 
     for (uint32_t i = 0; i < binding_count; i++)
     {
         binding_type = types[i];
+        descriptors[i] = (DvzDescriptor){0};
 
         if (is_descriptor_type_buffer(binding_type))
         {
-            // log_trace("bind buffer for binding point %d", i);
             if (buffer_regions[i].buffer == NULL)
             {
                 log_error("buffer of type %d #%d is not set", binding_type, i);
@@ -1394,46 +1390,207 @@ static void update_descriptor_set(
             ASSERT(buffer_regions[i].buffer != NULL);
             ASSERT(br->size > 0);
 
-            uint32_t idx_clip = MIN(idx, br->count - 1);
-            buffer_infos[i].buffer = br->buffer->buffer;
-            buffer_infos[i].offset = br->offsets[idx_clip];
-            buffer_infos[i].range = br->size;
+            idx_clip = MIN(idx, br->count - 1);
+            descriptors[i].buffer.buffer = br->buffer->buffer;
+            descriptors[i].buffer.offset = br->offsets[idx_clip];
+            descriptors[i].buffer.range = br->size;
         }
         else if (is_descriptor_type_image(binding_type))
         {
-            // log_trace("bind texture for binding point %d", i);
             ASSERT(images[i] != NULL);
-            // if (images[i] != NULL)
-            // {
-            uint32_t idx_clip = MIN(idx, images[i]->count - 1);
-            image_infos[i].imageLayout = images[i]->layout;
-            image_infos[i].imageView = images[i]->image_views[idx_clip];
-            image_infos[i].sampler = samplers[i]->sampler;
-            // }
-            // else
-            // {
-            //     log_warn("empty texture for binding point %d", i);
-            // }
+            idx_clip = MIN(idx, images[i]->count - 1);
+            descriptors[i].image.imageLayout = images[i]->layout;
+            descriptors[i].image.imageView = images[i]->image_views[idx_clip];
+            descriptors[i].image.sampler = samplers[i]->sampler;
         }
         else
         {
             log_error("unsupported descriptor type %d", binding_type);
-            return;
+            return false;
         }
-        descriptor_writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptor_writes[i].pNext = VK_NULL_HANDLE;
-        descriptor_writes[i].dstSet = dset;
-        descriptor_writes[i].dstBinding = i;
-        descriptor_writes[i].dstArrayElement = 0;
-        descriptor_writes[i].descriptorCount = 1;
-        descriptor_writes[i].descriptorType = binding_type;
-        descriptor_writes[i].pImageInfo = &image_infos[i];
-        descriptor_writes[i].pBufferInfo = &buffer_infos[i];
-        descriptor_writes[i].pTexelBufferView = VK_NULL_HANDLE;
     }
+    return true;
+}
+
+
+
+static bool descriptor_equal(DvzDescriptor* a, DvzDescriptor* b)
+{
+    return a->buffer.buffer == b->buffer.buffer && a->buffer.offset == b->buffer.offset &&
+           a->buffer.range == b->buffer.range && a->image.sampler == b->image.sampler &&
+           a->image.imageView == b->image.imageView && a->image.imageLayout == b->image.imageLayout;
+}
 
-    vkUpdateDescriptorSets(device, binding_count, descriptor_writes, 0, NULL);
-    FREE(descriptor_writes);
+
+
+// FNV-1a hash of the resources of the descriptors.
+static uint64_t descriptors_hash(uint32_t count, DvzDescriptor* descriptors)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t values[6] = {0};
+    for (uint32_t i = 0; i < count; i++)
+    {
+        values[0] = (uint64_t)descriptors[i].buffer.buffer;
+        values[1] = (uint64_t)descriptors[i].buffer.offset;
+        values[2] = (uint64_t)descriptors[i].buffer.range;
+        values[3] = (uint64_t)descriptors[i].image.sampler;
+        values[4] = (uint64_t)descriptors[i].image.imageView;
+        values[5] = (uint64_t)descriptors[i].image.imageLayout;
+        for (uint32_t k = 0; k < 6; k++)
+        {
+            hash ^= values[k];
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+
+
+// Write the descriptors that differ from the previously written ones (all of them if NULL), and
+// return the number of written descriptors.
+static uint32_t update_descriptor_set(
+    VkDevice device, uint32_t binding_count, VkDescriptorType* types, //
+    DvzDescriptor* descriptors, DvzDescriptor* written, uint32_t idx, VkDescriptorSet dset)
+{
+    VkWriteDescriptorSet descriptor_writes[DVZ_MAX_BINDINGS_SIZE] = {0};
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < binding_count; i++)
+    {
+        if (written != NULL && descriptor_equal(&descriptors[i], &written[i]))
+            continue;
+        descriptor_writes[count].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_writes[count].pNext = VK_NULL_HANDLE;
+        descriptor_writes[count].dstSet = dset;
+        descriptor_writes[count].dstBinding = i;
+        descriptor_writes[count].dstArrayElement = 0;
+        descriptor_writes[count].descriptorCount = 1;
+        descriptor_writes[count].descriptorType = types[i];
+        descriptor_writes[count].pImageInfo = &descriptors[i].image;
+        descriptor_writes[count].pBufferInfo = &descriptors[i].buffer;
+        descriptor_writes[count].pTexelBufferView = VK_NULL_HANDLE;
+        count++;
+    }
+    log_trace("update %d/%d descriptors of descriptor set #%d", count, binding_count, idx);
+    if (count > 0)
+        vkUpdateDescriptorSets(device, count, descriptor_writes, 0, NULL);
+    return count;
+}
+
+
+
+/*************************************************************************************************/
+/*  Bindings cache                                                                               */
+/*************************************************************************************************/
+
+static bool _bindings_cache_match(
+    DvzBindingsCacheEntry* entry, DvzSlots* slots, uint32_t dset_count, uint64_t hash,
+    DvzDescriptor* descriptors)
+{
+    ASSERT(entry != NULL);
+    if (entry->slot_count != slots->slot_count || entry->dset_count != dset_count)
+        return false;
+    if (memcmp(entry->types, slots->types, slots->slot_count * sizeof(VkDescriptorType)) != 0)
+        return false;
+    if (descriptors == NULL)
+        return true;
+    if (!entry->written || entry->hash != hash)
+        return false;
+    for (uint32_t i = 0; i < dset_count * slots->slot_count; i++)
+    {
+        if (!descriptor_equal(&entry->descriptors[i], &descriptors[i]))
+            return false;
+    }
+    return true;
+}
+
+
+
+// Find the descriptor sets already written with the same resources.
+static DvzBindingsCacheEntry* _bindings_cache_find(
+    DvzBindingsCache* cache, DvzSlots* slots, uint32_t dset_count, uint64_t hash,
+    DvzDescriptor* descriptors)
+{
+    ASSERT(cache != NULL);
+    ASSERT(descriptors != NULL);
+    for (uint32_t i = 0; i < cache->entry_count; i++)
+    {
+        if (_bindings_cache_match(cache->entries[i], slots, dset_count, hash, descriptors))
+            return cache->entries[i];
+    }
+    return NULL;
+}
+
+
+
+// Return retired descriptor sets with the layout of the slots, allocating them if needed.
+static DvzBindingsCacheEntry*
+_bindings_cache_acquire(DvzGpu* gpu, DvzSlots* slots, uint32_t dset_count)
+{
+    ASSERT(gpu != NULL);
+    ASSERT(slots != NULL);
+    ASSERT(dset_count <= DVZ_MAX_SWAPCHAIN_IMAGES);
+    DvzBindingsCache* cache = &gpu->bindings_cache;
+
+    DvzBindingsCacheEntry* entry = NULL;
+    for (uint32_t i = 0; i < cache->entry_count; i++)
+    {
+        entry = cache->entries[i];
+        if (entry->ref_count == 0 && entry->released <= cache->retired &&
+            _bindings_cache_match(entry, slots, dset_count, 0, NULL))
+        {
+            log_trace("reuse descriptor sets from the bindings cache");
+            entry->ref_count = 1;
+            return entry;
+        }
+    }
+
+    entry = (DvzBindingsCacheEntry*)calloc(1, sizeof(DvzBindingsCacheEntry));
+    entry->slot_count = slots->slot_count;
+    memcpy(entry->types, slots->types, slots->slot_count * sizeof(VkDescriptorType));
+    entry->dset_count = dset_count;
+    uint32_t count = MAX(1, dset_count * slots->slot_count);
+    entry->descriptors = (DvzDescriptor*)calloc(count, sizeof(DvzDescriptor));
+    entry->ref_count = 1;
+    create_descriptor_set_layout(gpu->device, entry->slot_count, entry->types, &entry->dset_layout);
+    allocate_descriptor_sets(
+        gpu->device, gpu->dset_pool, entry->dset_layout, dset_count, entry->dsets);
+
+    REALLOC(cache->entries, (cache->entry_count + 1) * sizeof(DvzBindingsCacheEntry*));
+    cache->entries[cache->entry_count++] = entry;
+    cache->stats.entry_count = cache->entry_count;
+    cache->stats.dset_count += dset_count;
+    return entry;
+}
+
+
+
+// The sets released by all their bindings are reused once retired.
+static void _bindings_cache_release(DvzBindingsCache* cache, DvzBindingsCacheEntry* entry)
+{
+    ASSERT(cache != NULL);
+    ASSERT(entry != NULL);
+    ASSERT(entry->ref_count > 0);
+    entry->ref_count--;
+    if (entry->ref_count == 0)
+        entry->released = ++cache->serial;
+}
+
+
+
+// The descriptor sets are freed with the descriptor pool.
+static void _bindings_cache_destroy(DvzGpu* gpu)
+{
+    ASSERT(gpu != NULL);
+    DvzBindingsCache* cache = &gpu->bindings_cache;
+    for (uint32_t i = 0; i < cache->entry_count; i++)
+    {
+        vkDestroyDescriptorSetLayout(gpu->device, cache->entries[i]->dset_layout, NULL);
+        FREE(cache->entries[i]->descriptors);
+        FREE(cache->entries[i]);
+    }
+    FREE(cache->entries);
+    *cache = (DvzBindingsCache){0};
 }
 
 
@@ -1549,15 +1706,30 @@ static VkPipelineColorBlendAttachmentState create_color_blend_attachment()
 }
 
 
+// Extra color attachments (e.g. the ID buffer used for picking) hold integer values that cannot
+// be blended: the fragments overwrite them, or leave them untouched if the shader does not write
+// to them.
+static VkPipelineColorBlendAttachmentState create_color_blend_attachment_extra(bool write)
+{
+    VkPipelineColorBlendAttachmentState color_blend_attachment = {0};
+    if (write)
+        color_blend_attachment.colorWriteMask =
+            VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | //
+            VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    color_blend_attachment.blendEnable = VK_FALSE;
+    return color_blend_attachment;
+}
+
+
 static VkPipelineColorBlendStateCreateInfo
-create_color_blending(VkPipelineColorBlendAttachmentState* attachment)
+create_color_blending(uint32_t count, VkPipelineColorBlendAttachmentState* attachments)
 {
     VkPipelineColorBlendStateCreateInfo color_blending = {0};
     color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
     color_blending.logicOpEnable = VK_FALSE;
     color_blending.logicOp = VK_LOGIC_OP_COPY;
-    color_blending.attachmentCount = 1;
-    color_blending.pAttachments = attachment;
+    color_blending.attachmentCount = count;
+    color_blending.pAttachments = attachments;
     color_blending.blendConstants[0] = 0.0f;
     color_blending.blendConstants[1] = 0.0f;
     color_blending.blendConstants[2] = 0.0f;